@@ -0,0 +1,184 @@
+// absorptionmodel.cpp
+#include "absorptionmodel.h"
+#include <cmath>
+
+namespace {
+
+// Fraction left on board once the curve's duration has elapsed
+const double RESIDUAL_AT_DURATION = 0.02;
+
+// The active time constant is b = k * a. The duration/peak ratio is
+// smallest just above k = 1 (~3.76) and grows steadily with k.
+const double MIN_RATIO_K = 1.001;
+const double MAX_RATIO_K = 100.0;
+
+// Amount in the active compartment t minutes after a unit dose entered depot1
+double activeAfter(double t, double a, double b)
+{
+    double c = 1.0 / a - 1.0 / b;
+    double e = std::exp(-t / a);
+    double f = std::exp(-t / b);
+    return (f - e * (1.0 + t * c)) / ((a * c) * (a * c));
+}
+
+// Fraction of a unit dose still on board after t minutes
+double onBoardAfter(double t, double a, double b)
+{
+    return std::exp(-t / a) * (1.0 + t / a) + activeAfter(t, a, b);
+}
+
+// Time of peak activity for a = 1 (activity is unimodal)
+double peakTime(double k)
+{
+    double lo = 0.0;
+    double hi = 50.0 + 20.0 * k;
+    for (int i = 0; i < 100; ++i) {
+        double m1 = lo + (hi - lo) / 3.0;
+        double m2 = hi - (hi - lo) / 3.0;
+        if (activeAfter(m1, 1.0, k) < activeAfter(m2, 1.0, k)) {
+            lo = m1;
+        } else {
+            hi = m2;
+        }
+    }
+    return 0.5 * (lo + hi);
+}
+
+// Time at which RESIDUAL_AT_DURATION is left, for a = 1
+double durationTime(double k)
+{
+    double lo = 0.0;
+    double hi = 2000.0 + 1000.0 * k;
+    for (int i = 0; i < 100; ++i) {
+        double mid = 0.5 * (lo + hi);
+        if (onBoardAfter(mid, 1.0, k) > RESIDUAL_AT_DURATION) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0.5 * (lo + hi);
+}
+
+}
+
+AbsorptionModel::AbsorptionModel(double peakMinutes, double durationMinutes)
+{
+    setCurve(peakMinutes, durationMinutes);
+}
+
+void AbsorptionModel::setCurve(double peakMinutes, double durationMinutes)
+{
+    m_peak = peakMinutes > 1.0 ? peakMinutes : 1.0;
+    m_duration = durationMinutes > m_peak ? durationMinutes : 4.0 * m_peak;
+
+    // Bisect for the time constant ratio whose duration/peak ratio matches
+    double target = m_duration / m_peak;
+    double lo = MIN_RATIO_K;
+    double hi = MAX_RATIO_K;
+    if (durationTime(lo) / peakTime(lo) >= target) {
+        hi = lo;
+    } else if (durationTime(hi) / peakTime(hi) <= target) {
+        lo = hi;
+    }
+    for (int i = 0; i < 60 && hi - lo > 1e-6; ++i) {
+        double mid = 0.5 * (lo + hi);
+        if (durationTime(mid) / peakTime(mid) < target) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    double k = 0.5 * (lo + hi);
+    m_tauDepot = m_peak / peakTime(k);
+    m_tauActive = k * m_tauDepot;
+    m_stepMinutes = -1.0;
+}
+
+double AbsorptionModel::peakMinutes() const
+{
+    return m_peak;
+}
+
+double AbsorptionModel::durationMinutes() const
+{
+    return m_duration;
+}
+
+void AbsorptionModel::add(double amount)
+{
+    if (amount > 0.0) {
+        m_depot1 += amount;
+    }
+}
+
+double AbsorptionModel::advance(double minutes)
+{
+    if (minutes <= 0.0) {
+        return 0.0;
+    }
+    if (minutes != m_stepMinutes) {
+        m_step = transition(minutes);
+        m_stepMinutes = minutes;
+    }
+
+    double before = remaining();
+    m_active = m_active * m_step.activeDecay + m_depot2 * m_step.fromDepot2 + m_depot1 * m_step.fromDepot1;
+    m_depot2 = m_depot2 * m_step.depotDecay + m_depot1 * m_step.depotShift;
+    m_depot1 *= m_step.depotDecay;
+
+    // Drop negligible remainders so long runs don't carry denormals
+    double after = remaining();
+    if (after < 1e-9) {
+        reset();
+        after = 0.0;
+    }
+    return before - after;
+}
+
+double AbsorptionModel::remaining() const
+{
+    return m_depot1 + m_depot2 + m_active;
+}
+
+double AbsorptionModel::activity() const
+{
+    return m_active / m_tauActive;
+}
+
+void AbsorptionModel::reset()
+{
+    m_depot1 = 0.0;
+    m_depot2 = 0.0;
+    m_active = 0.0;
+}
+
+void AbsorptionModel::state(double &depot1, double &depot2, double &active) const
+{
+    depot1 = m_depot1;
+    depot2 = m_depot2;
+    active = m_active;
+}
+
+void AbsorptionModel::setState(double depot1, double depot2, double active)
+{
+    m_depot1 = depot1;
+    m_depot2 = depot2;
+    m_active = active;
+}
+
+AbsorptionModel::Transition AbsorptionModel::transition(double minutes) const
+{
+    double a = m_tauDepot;
+    double b = m_tauActive;
+    double c = 1.0 / a - 1.0 / b;
+
+    Transition t;
+    t.depotDecay = std::exp(-minutes / a);
+    t.depotShift = (minutes / a) * t.depotDecay;
+    t.activeDecay = std::exp(-minutes / b);
+    t.fromDepot2 = (t.activeDecay - t.depotDecay) / (a * c);
+    t.fromDepot1 = activeAfter(minutes, a, b);
+    return t;
+}
@@ -0,0 +1,74 @@
+// absorptionmodel.h
+#ifndef ABSORPTIONMODEL_H
+#define ABSORPTIONMODEL_H
+
+// Insulin action / carb absorption as a linear three-compartment chain:
+//
+//     dose -> depot1 --(1/a)--> depot2 --(1/a)--> active --(1/b)--> used
+//
+// The "used" rate is a smooth activity curve that rises from zero, peaks and
+// decays. The amount still on board is the sum of the three compartments.
+// Because the chain is linear, every dose in flight shares the same state.
+// advance() applies the exact solution for any step length, so each update
+// is O(1) however many doses are active, and results do not depend on the
+// tick size.
+class AbsorptionModel
+{
+public:
+    // Exact transition of the chain over one step, as linear factors
+    struct Transition {
+        double depotDecay = 1.0;    // depot1 -> depot1 and depot2 -> depot2
+        double depotShift = 0.0;    // depot1 -> depot2
+        double activeDecay = 1.0;   // active -> active
+        double fromDepot2 = 0.0;    // depot2 -> active
+        double fromDepot1 = 0.0;    // depot1 -> active
+    };
+
+    // Activity peaks at peakMinutes; durationMinutes is when all but 2% is used.
+    // Durations shorter than ~3.8x the peak are not reachable and give the
+    // shortest tail the chain allows.
+    AbsorptionModel(double peakMinutes, double durationMinutes);
+
+    // Reshape the curve; amounts already on board follow the new curve
+    void setCurve(double peakMinutes, double durationMinutes);
+    double peakMinutes() const;
+    double durationMinutes() const;
+
+    // Add a dose (units of insulin or grams of carbs)
+    void add(double amount);
+
+    // Advance by the given time and return the amount used in that interval
+    double advance(double minutes);
+
+    // Amount still on board (IOB / COB)
+    double remaining() const;
+
+    // Current rate of use, amount per minute
+    double activity() const;
+
+    void reset();
+
+    // Factors advance() applies for a step of the given length, for callers
+    // that keep many chains' state in their own arrays
+    Transition transition(double minutes) const;
+
+    // Raw compartment state, for snapshots
+    void state(double &depot1, double &depot2, double &active) const;
+    void setState(double depot1, double depot2, double active);
+
+private:
+    double m_peak;
+    double m_duration;
+    double m_tauDepot;      // a: depot time constant (minutes)
+    double m_tauActive;     // b: active time constant (minutes)
+
+    double m_depot1 = 0.0;
+    double m_depot2 = 0.0;
+    double m_active = 0.0;
+
+    // Transition for the last step length
+    double m_stepMinutes = -1.0;
+    Transition m_step;
+};
+
+#endif // ABSORPTIONMODEL_H
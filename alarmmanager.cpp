@@ -0,0 +1,146 @@
+// alarmmanager.cpp
+#include "alarmmanager.h"
+
+AlarmManager::AlarmManager()
+    : m_ackPending(0)
+{
+}
+
+void AlarmManager::setSettings(AlarmType type, const AlarmSettings &settings)
+{
+    m_settings[type] = settings;
+}
+
+AlarmSettings AlarmManager::settings(AlarmType type) const
+{
+    return m_settings[type];
+}
+
+const AlarmInfo &AlarmManager::info(AlarmType type) const
+{
+    return m_alarms[type];
+}
+
+void AlarmManager::acknowledge(AlarmType type)
+{
+    m_ackPending |= 1u << type;
+}
+
+AlarmChange AlarmManager::update(AlarmType type, double value, double minutes)
+{
+    const quint32 bit = 1u << type;
+    bool acknowledged = m_ackPending & bit;
+    m_ackPending &= ~bit;
+
+    const AlarmSettings &s = m_settings[type];
+    AlarmInfo &a = m_alarms[type];
+    if (a.status == AlarmClear) {
+        if (s.below ? value > s.raiseAt : value < s.raiseAt) {
+            return NoAlarmChange;
+        }
+        a.status = AlarmSounding;
+        a.level = 0;
+        a.value = value;
+        a.sinceMinutes = minutes;
+        a.nextMinutes = minutes + s.escalateMinutes;
+        ++a.announcements;
+        return AlarmRaised;
+    }
+
+    a.value = value;
+    if (s.below ? value >= s.clearAt : value <= s.clearAt) {
+        a.status = AlarmClear;
+        a.level = 0;
+        return AlarmCleared;
+    }
+    if (acknowledged && a.status == AlarmSounding) {
+        a.status = AlarmSnoozed;
+        a.nextMinutes = minutes + s.snoozeMinutes;
+        return AlarmAcknowledged;
+    }
+    if (minutes < a.nextMinutes) {
+        return NoAlarmChange;
+    }
+
+    if (a.status == AlarmSnoozed) {
+        a.status = AlarmSounding;
+        a.nextMinutes = minutes + s.escalateMinutes;
+        ++a.announcements;
+        return AlarmRepeated;
+    }
+    if (a.level < ALARM_MAX_LEVEL) {
+        ++a.level;
+        a.nextMinutes = minutes + s.escalateMinutes;
+        ++a.announcements;
+        return AlarmEscalated;
+    }
+
+    // At the top level it keeps sounding until acknowledged or cleared
+    a.nextMinutes = minutes + s.escalateMinutes;
+    return NoAlarmChange;
+}
+
+void AlarmManager::reset()
+{
+    for (AlarmInfo &a : m_alarms) {
+        a.status = AlarmClear;
+        a.level = 0;
+    }
+    m_ackPending = 0;
+}
+
+void AlarmManager::saveState(QDataStream &out) const
+{
+    for (const AlarmInfo &a : m_alarms) {
+        out << qint32(a.status) << qint32(a.level) << a.value << a.sinceMinutes << a.nextMinutes;
+    }
+}
+
+bool AlarmManager::restoreState(QDataStream &in)
+{
+    AlarmInfo alarms[AlarmTypeCount];
+    for (AlarmInfo &a : alarms) {
+        qint32 status, level;
+        in >> status >> level >> a.value >> a.sinceMinutes >> a.nextMinutes;
+        if (status < AlarmClear || status > AlarmSnoozed || level < 0 || level > ALARM_MAX_LEVEL) {
+            in.setStatus(QDataStream::ReadCorruptData);
+        }
+        a.status = AlarmStatus(status);
+        a.level = level;
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    // Announcement counts stay as they are; see announceAll()
+    for (int i = 0; i < AlarmTypeCount; ++i) {
+        alarms[i].announcements = m_alarms[i].announcements;
+        m_alarms[i] = alarms[i];
+    }
+    m_ackPending = 0;
+    return true;
+}
+
+void AlarmManager::announceAll()
+{
+    for (AlarmInfo &a : m_alarms) {
+        ++a.announcements;
+    }
+}
+
+QString AlarmManager::name(AlarmType type)
+{
+    switch (type) {
+    case LowGlucoseAlarm:
+        return "Low glucose";
+    case HighGlucoseAlarm:
+        return "High glucose";
+    case LowBatteryAlarm:
+        return "Low battery";
+    case LowInsulinAlarm:
+        return "Low insulin";
+    case AlarmTypeCount:
+        break;
+    }
+    return "Unknown";
+}
@@ -0,0 +1,104 @@
+// alarmmanager.h
+#ifndef ALARMMANAGER_H
+#define ALARMMANAGER_H
+
+#include <QDataStream>
+#include <QString>
+
+// Conditions the pump alarms on. Stored in log records, so only append.
+enum AlarmType {
+    LowGlucoseAlarm,
+    HighGlucoseAlarm,
+    LowBatteryAlarm,
+    LowInsulinAlarm,
+    AlarmTypeCount
+};
+
+enum AlarmStatus {
+    AlarmClear,
+    AlarmSounding,          // Raised and not acknowledged
+    AlarmSnoozed            // Acknowledged; sounds again if still raised at the end
+};
+
+// What one update did to an alarm; nearly always nothing
+enum AlarmChange {
+    NoAlarmChange,
+    AlarmRaised,
+    AlarmEscalated,         // Unacknowledged for escalateMinutes
+    AlarmRepeated,          // Snooze ran out with the condition still there
+    AlarmAcknowledged,
+    AlarmCleared
+};
+
+// Levels above the first that an ignored alarm climbs through
+const int ALARM_MAX_LEVEL = 2;
+
+// Thresholds and timers of one alarm. The alarm is raised at raiseAt or
+// beyond and only clears once the value is back past clearAt, so a
+// reading hovering at the threshold does not raise it over and over.
+// The defaults never raise.
+struct AlarmSettings {
+    bool   below = true;            // Raised by low values
+    double raiseAt = -1e300;
+    double clearAt = -1e300;
+    double escalateMinutes = 15.0;
+    double snoozeMinutes = 30.0;
+};
+
+// Where one alarm stands. Announcements counts raises, escalations and
+// repeats, so a reader can tell a new announcement from one it has shown.
+struct AlarmInfo {
+    AlarmStatus status = AlarmClear;
+    int level = 0;
+    double value = 0.0;             // Latest value fed while not clear
+    double sinceMinutes = 0.0;      // Simulated minute it was raised
+    double nextMinutes = 0.0;       // Escalation or end of snooze
+    quint32 announcements = 0;
+};
+
+// One small state machine per alarm type: clear, sounding (climbing a
+// level every escalateMinutes while ignored, up to ALARM_MAX_LEVEL, then
+// sounding on without new announcements) and snoozed after an
+// acknowledgement. update() is a few comparisons and never allocates or
+// blocks, so it runs on every reading and error check.
+//
+// Not thread-safe: every call, acknowledge() included, belongs on the
+// engine's thread (the UI goes through SimulationWorker). An
+// acknowledgement takes effect at the next update of its alarm;
+// acknowledging an alarm that has cleared meanwhile does nothing.
+class AlarmManager
+{
+public:
+    AlarmManager();
+
+    void setSettings(AlarmType type, const AlarmSettings &settings);
+    AlarmSettings settings(AlarmType type) const;
+
+    // Feed the watched value at the given simulated minute
+    AlarmChange update(AlarmType type, double value, double minutes);
+
+    const AlarmInfo &info(AlarmType type) const;
+
+    void acknowledge(AlarmType type);
+
+    // Clear every alarm
+    void reset();
+
+    // Alarm states; settings and pending acknowledgements are not saved,
+    // and restoring leaves the announcement counts alone
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+
+    // Count a new announcement of every alarm, so one that is sounding
+    // after a restore is shown again
+    void announceAll();
+
+    static QString name(AlarmType type);
+
+private:
+    AlarmSettings m_settings[AlarmTypeCount];
+    AlarmInfo m_alarms[AlarmTypeCount];
+    quint32 m_ackPending;           // Bit per type, until its next update
+};
+
+#endif // ALARMMANAGER_H
@@ -0,0 +1,130 @@
+// batchpatient.h
+#ifndef BATCHPATIENT_H
+#define BATCHPATIENT_H
+
+#include <QVector>
+#include <cmath>
+#include "absorptionmodel.h"
+#include "controliqcontroller.h"
+#include "glucosemodel.h"
+#include "philox.h"
+#include "profilemanager.h"
+#include "simulationengine.h"
+#include "therapyrules.h"
+
+// Lean single-patient simulation for batch runs. Follows the same per-tick
+// order as SimulationEngine::tick() (reading, meals, Control-IQ, basal) and
+// the same therapy rules (therapyrules.h), profile segments included, but
+// has no QObjects, signals or logging, and the glucose model is a template
+// policy so the inner loop has no virtual calls. The clock starts at
+// midnight. The pump is assumed to be serviced whenever it runs low, as in
+// a batch SimulationEngine.
+//
+// Left out compared with the engine: alarms, scenarios and sensor
+// dropouts, extended boluses, user basal suspends, trace replay, and the
+// battery and reservoir levels.
+template <class Model>
+class BatchPatient
+{
+public:
+    BatchPatient(const ProfileData &therapy, double baseGlucose,
+                 double insulinSensitivity, quint64 seed)
+        : m_schedule(therapy),
+          m_basalInsulin(DEFAULT_INSULIN_PEAK, DEFAULT_INSULIN_DURATION),
+          m_bolusInsulin(DEFAULT_INSULIN_PEAK, DEFAULT_INSULIN_DURATION),
+          m_carbs(DEFAULT_CARB_PEAK, DEFAULT_CARB_DURATION),
+          m_rng(seed)
+    {
+        m_controller.setTherapy(m_schedule.settings(m_segment));
+        m_inputs.baseGlucose = baseGlucose;
+        m_inputs.insulinSensitivity = insulinSensitivity;
+        m_model.reset(baseGlucose, m_inputs);
+        m_glucose = baseGlucose;
+    }
+
+    void setMealPattern(const QVector<MealEvent> &meals) { m_meals = meals; }
+    void setTickMinutes(double minutes) { m_tickMinutes = minutes; }
+    void setModelStepMinutes(double minutes) { m_model.setStepMinutes(minutes); }
+
+    double glucose() const { return m_glucose; }
+    double insulinOnBoard() const { return m_bolusInsulin.remaining(); }
+    double carbsOnBoard() const { return m_carbs.remaining(); }
+
+    // One simulation tick; returns the new CGM reading
+    double tick()
+    {
+        followProfileSegment(m_schedule, m_elapsedMinutes, m_segment, m_controller);
+
+        // 1) CGM reading
+        double minutes = m_tickMinutes;
+        m_inputs.basalActive = m_basalActive;
+        m_inputs.insulinRate = (m_basalInsulin.advance(minutes) + m_bolusInsulin.advance(minutes)) / minutes;
+        m_inputs.carbRate = m_carbs.advance(minutes) / minutes;
+        double next = m_model.step(minutes, m_inputs);
+        if (m_basalActive) {
+            next += (m_rng.uniform(m_ticks) * 0.4 - 0.2) * std::sqrt(minutes / 5.0);
+            m_model.setGlucose(next);
+        }
+        if (next > 0.0 && next < MAX_VALID_GLUCOSE) {
+            m_glucose = next;
+        } else {
+            m_model.setGlucose(m_glucose);
+        }
+
+        // 2) Meals
+        eatScheduledMeals();
+
+        // 3) Control-IQ
+        ControlIQDecision d = m_controller.update(m_glucose, m_elapsedMinutes,
+                                                  insulinOnBoard(), carbsOnBoard());
+        if (d.correctionBolus > 0.0) {
+            m_bolusInsulin.add(d.correctionBolus);
+        }
+        m_basalActive = d.basalMultiplier > 0.0;
+
+        // 4) Basal
+        if (m_basalActive) {
+            double units = scheduledBasalUnits(m_schedule, m_elapsedMinutes, m_elapsedMinutes + minutes,
+                                               d.basalMultiplier);
+            if (units > 0.0) {
+                m_basalInsulin.add(units);
+            }
+        }
+
+        m_elapsedMinutes += minutes;
+        ++m_ticks;
+        return m_glucose;
+    }
+
+private:
+    void eatScheduledMeals()
+    {
+        for (const MealEvent &meal : m_meals) {
+            if (dailyMealDue(meal.minuteOfDay, m_elapsedMinutes, m_tickMinutes)) {
+                m_carbs.add(meal.grams);
+                m_bolusInsulin.add(mealBolusUnits(m_schedule.settingsAt(m_elapsedMinutes), m_glucose,
+                                                  meal.grams, insulinOnBoard()));
+            }
+        }
+    }
+
+    ProfileSchedule m_schedule;
+    int m_segment = 0;
+    QVector<MealEvent> m_meals;
+    double m_tickMinutes = SIMULATION_SPEED;
+    double m_elapsedMinutes = 0.0;
+    quint64 m_ticks = 0;
+
+    AbsorptionModel m_basalInsulin;
+    AbsorptionModel m_bolusInsulin;
+    AbsorptionModel m_carbs;
+    FixedStepIntegrator<Model> m_model;
+    GlucoseInputs m_inputs;
+    PhiloxRandom m_rng;             // Noise for tick n is m_rng.uniform(n)
+    ControlIQController m_controller;
+
+    double m_glucose;
+    bool m_basalActive = true;
+};
+
+#endif // BATCHPATIENT_H
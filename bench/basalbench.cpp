@@ -0,0 +1,88 @@
+// basalbench.cpp
+#include "benchmarks.h"
+#include "profileschedule.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Written after each timed loop so the compiler cannot drop the work
+volatile double g_sink;
+
+// A full 16-segment day: rates, ratios and targets change every 90 min
+ProfileData segmentedProfile()
+{
+    ProfileData profile = {0.8, 10.0, 2.0, 6.0, {}};
+    for (int i = 0; i < MAX_PROFILE_SEGMENTS; ++i) {
+        profile.segments.append({i * 90, 0.5 + 0.1 * (i % 7), 8.0 + i % 4, 1.5 + 0.1 * (i % 3), 5.5 + 0.1 * (i % 5)});
+    }
+    return profile;
+}
+
+// Reference: step minute by minute at the rate in effect at each minute
+double steppedUnits(const ProfileSchedule &schedule, double from, double to)
+{
+    double units = 0.0;
+    for (double t = from; t < to; t += 1.0) {
+        units += schedule.basalRateAt(t) / 60.0 * qMin(1.0, to - t);
+    }
+    return units;
+}
+
+}
+
+int runBasalBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    int intervals = args.size() > 0 ? args.at(0).toInt() : 1000000;
+    if (intervals <= 0) {
+        out << "basal: intervals must be positive\n";
+        return 1;
+    }
+
+    ProfileSchedule schedule(segmentedProfile());
+    out << QString("Basal over %1 random intervals, %2 segments, %3 U/day\n")
+           .arg(intervals).arg(schedule.segmentCount()).arg(schedule.dailyBasalUnits(), 0, 'f', 2);
+
+    // Whole-minute intervals of up to a week, so stepping is exact too
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> startDist(0, 30 * 1440);
+    std::uniform_int_distribution<int> lengthDist(1, 7 * 1440);
+    std::vector<double> from(intervals);
+    std::vector<double> to(intervals);
+    for (int i = 0; i < intervals; ++i) {
+        from[i] = startDist(rng);
+        to[i] = from[i] + lengthDist(rng);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    double total = 0.0;
+    for (int i = 0; i < intervals; ++i) {
+        total += schedule.basalUnits(from[i], to[i]);
+    }
+    double lookupNs = timer.nsecsElapsed() / double(intervals);
+    g_sink = total;
+
+    // Stepping is far slower; check a sample of the intervals against it
+    int checked = qMin(intervals, 2000);
+    double worstError = 0.0;
+    timer.start();
+    for (int i = 0; i < checked; ++i) {
+        double stepped = steppedUnits(schedule, from[i], to[i]);
+        worstError = qMax(worstError, std::fabs(stepped - schedule.basalUnits(from[i], to[i])));
+    }
+    double steppedNs = timer.nsecsElapsed() / double(checked);
+
+    out << QString("Prefix-sum lookup:    %1 ns per interval\n").arg(lookupNs, 0, 'f', 1);
+    out << QString("Minute stepping:      %1 ns per interval\n").arg(steppedNs, 0, 'f', 0);
+    out << QString("Worst difference:     %1 U over %2 intervals\n").arg(worstError, 0, 'g', 3).arg(checked);
+
+    bool ok = worstError < 1e-6;
+    out << (ok ? "Results ok\n" : "Results MISMATCH\n");
+    return ok ? 0 : 1;
+}
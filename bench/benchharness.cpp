@@ -0,0 +1,167 @@
+// benchharness.cpp
+#include "benchharness.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Largest batch tried while calibrating
+const qint64 MAX_CALLS_PER_BATCH = qint64(1) << 30;
+
+double nearestRank(const std::vector<double> &sorted, double percent)
+{
+    size_t rank = size_t(std::ceil(percent / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+}
+
+BenchHarness::BenchHarness(const QString &suite)
+    : m_suite(suite)
+{
+}
+
+void BenchHarness::setWarmupMs(double ms)
+{
+    m_warmupMs = qMax(0.0, ms);
+}
+
+void BenchHarness::setRepetitions(int repetitions)
+{
+    m_repetitions = qMax(1, repetitions);
+}
+
+void BenchHarness::setMinBatchUs(double us)
+{
+    m_minBatchUs = qMax(1.0, us);
+}
+
+void BenchHarness::setFilter(const QString &filter)
+{
+    m_filter = filter;
+}
+
+qint64 BenchHarness::calibrate(const std::function<void(qint64)> &batch) const
+{
+    // One untimed call first: first-use costs (allocation, page faults)
+    // would otherwise make a single call look long enough. Then double
+    // the batch until it lasts long enough to time reliably.
+    batch(1);
+    QElapsedTimer timer;
+    qint64 calls = 1;
+    while (calls < MAX_CALLS_PER_BATCH) {
+        timer.start();
+        batch(calls);
+        if (timer.nsecsElapsed() >= m_minBatchUs * 1000.0) {
+            break;
+        }
+        calls *= 2;
+    }
+    return calls;
+}
+
+bool BenchHarness::run(const QString &name, const std::function<void(qint64 calls)> &batch)
+{
+    if (!m_filter.isEmpty() && !name.contains(m_filter)) {
+        return false;
+    }
+
+    qint64 calls = calibrate(batch);
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.nsecsElapsed() < m_warmupMs * 1e6) {
+        batch(calls);
+    }
+
+    std::vector<double> perCall;
+    perCall.reserve(m_repetitions);
+    for (int r = 0; r < m_repetitions; ++r) {
+        timer.start();
+        batch(calls);
+        perCall.push_back(double(timer.nsecsElapsed()) / calls);
+    }
+    std::sort(perCall.begin(), perCall.end());
+
+    MicroResult result;
+    result.name = name;
+    result.callsPerRepetition = calls;
+    result.repetitions = m_repetitions;
+    result.medianNs = nearestRank(perCall, 50.0);
+    result.p99Ns = nearestRank(perCall, 99.0);
+    result.minNs = perCall.front();
+    double sum = 0.0;
+    std::vector<double> deviation;
+    deviation.reserve(perCall.size());
+    for (double ns : perCall) {
+        sum += ns;
+        deviation.push_back(std::fabs(ns - result.medianNs));
+    }
+    result.meanNs = sum / perCall.size();
+    std::sort(deviation.begin(), deviation.end());
+    result.madNs = nearestRank(deviation, 50.0);
+    m_results.append(result);
+    return true;
+}
+
+const QVector<MicroResult> &BenchHarness::results() const
+{
+    return m_results;
+}
+
+QString BenchHarness::table() const
+{
+    QString text = QString("%1  %2  %3  %4  %5  %6\n")
+                   .arg("operation", -44).arg("median ns", 10).arg("p99 ns", 10)
+                   .arg("min ns", 10).arg("MAD ns", 8).arg("calls x reps", 14);
+    for (const MicroResult &r : m_results) {
+        text += QString("%1  %2  %3  %4  %5  %6\n")
+                .arg(r.name, -44)
+                .arg(r.medianNs, 10, 'f', 1)
+                .arg(r.p99Ns, 10, 'f', 1)
+                .arg(r.minNs, 10, 'f', 1)
+                .arg(r.madNs, 8, 'f', 1)
+                .arg(QString("%1 x %2").arg(r.callsPerRepetition).arg(r.repetitions), 14);
+    }
+    return text;
+}
+
+QByteArray BenchHarness::json() const
+{
+    QJsonArray results;
+    for (const MicroResult &r : m_results) {
+        QJsonObject o;
+        o.insert("name", r.name);
+        o.insert("calls_per_repetition", r.callsPerRepetition);
+        o.insert("repetitions", r.repetitions);
+        o.insert("median_ns", r.medianNs);
+        o.insert("p99_ns", r.p99Ns);
+        o.insert("min_ns", r.minNs);
+        o.insert("mean_ns", r.meanNs);
+        o.insert("mad_ns", r.madNs);
+        results.append(o);
+    }
+
+    QJsonObject environment;
+    environment.insert("qt", QString(qVersion()));
+    environment.insert("cpu", QSysInfo::currentCpuArchitecture());
+    environment.insert("os", QSysInfo::prettyProductName());
+    environment.insert("threads", QThread::idealThreadCount());
+
+    QJsonObject root;
+    root.insert("suite", m_suite);
+    root.insert("format", 1);
+    root.insert("time", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    root.insert("warmup_ms", m_warmupMs);
+    root.insert("min_batch_us", m_minBatchUs);
+    root.insert("environment", environment);
+    root.insert("results", results);
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
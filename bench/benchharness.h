@@ -0,0 +1,73 @@
+// benchharness.h
+#ifndef BENCHHARNESS_H
+#define BENCHHARNESS_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// Per-call cost of one operation, from repeated timed batches
+struct MicroResult {
+    QString name;
+    qint64 callsPerRepetition = 0;
+    int repetitions = 0;
+    double medianNs = 0.0;
+    double p99Ns = 0.0;
+    double minNs = 0.0;
+    double meanNs = 0.0;
+    double madNs = 0.0;         // Median absolute deviation from the median
+};
+
+// Keeps a value alive so the compiler cannot drop the call producing it
+template <class T>
+inline void keepResult(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char *>(&value);
+#endif
+}
+
+// Microbenchmark runner. An operation is given as a batch function that
+// makes the requested number of calls. The batch size is calibrated so
+// one batch lasts at least the minimum batch time, which keeps the
+// timer's own cost and resolution out of the figures. After a warm-up,
+// repetitions batches are timed and reduced to per-call median, p99,
+// minimum, mean and MAD. Percentiles are nearest-rank over the batches,
+// so a rare slow call is averaged into its batch.
+class BenchHarness
+{
+public:
+    explicit BenchHarness(const QString &suite);
+
+    void setWarmupMs(double ms);
+    void setRepetitions(int repetitions);
+    void setMinBatchUs(double us);
+
+    // Names not containing the filter are skipped (empty runs everything)
+    void setFilter(const QString &filter);
+
+    // Returns false if the operation was filtered out
+    bool run(const QString &name, const std::function<void(qint64 calls)> &batch);
+
+    const QVector<MicroResult> &results() const;
+
+    // Aligned text table, and JSON with the suite, environment and results
+    QString table() const;
+    QByteArray json() const;
+
+private:
+    qint64 calibrate(const std::function<void(qint64)> &batch) const;
+
+    QString m_suite;
+    QString m_filter;
+    double m_warmupMs = 200.0;
+    int m_repetitions = 200;
+    double m_minBatchUs = 200.0;
+    QVector<MicroResult> m_results;
+};
+
+#endif // BENCHHARNESS_H
@@ -0,0 +1,83 @@
+// benchmain.cpp
+#include <QCoreApplication>
+#include <QTextStream>
+#include "benchmarks.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments().mid(1);
+    QTextStream out(stdout);
+
+    QString name = args.isEmpty() ? QString("cohort") : args.takeFirst();
+
+    if (name == "cohort") {
+        return runCohortBenchmark(args);
+    }
+    if (name == "cgm") {
+        return runCgmHistoryBenchmark(args);
+    }
+    if (name == "simd") {
+        return runSimdBenchmark(args);
+    }
+    if (name == "control") {
+        return runControlLatencyBenchmark(args);
+    }
+    if (name == "events") {
+        return runEventBenchmark(args);
+    }
+    if (name == "log") {
+        return runLogBenchmark(args);
+    }
+    if (name == "logview") {
+        return runLogViewBenchmark(args);
+    }
+    if (name == "basal") {
+        return runBasalBenchmark(args);
+    }
+    if (name == "snapshot") {
+        return runSnapshotBenchmark(args);
+    }
+    if (name == "bolus") {
+        return runBolusBenchmark(args);
+    }
+    if (name == "export") {
+        return runExportBenchmark(args);
+    }
+    if (name == "metrics") {
+        return runMetricsBenchmark(args);
+    }
+    if (name == "micro") {
+        return runMicroBenchmark(args);
+    }
+    if (name == "profile") {
+        return runProfileBenchmark(args);
+    }
+    if (name == "replay") {
+        return runReplayBenchmark(args);
+    }
+
+    out << "Usage: pump1_bench <benchmark> [options]\n"
+        << "Benchmarks:\n"
+        << "  cohort [patients] [days] [randomwalk|bergman]\n"
+        << "                             cohort runner scaling over thread counts\n"
+        << "  cgm [iterations]           CGM history cost vs retention length\n"
+        << "  simd [patients] [days] [randomwalk|bergman]\n"
+        << "                             batched patient steps/s, scalar vs vector\n"
+        << "  control [decisions]        Control-IQ decision latency percentiles\n"
+        << "  events [days] [randomwalk|bergman]\n"
+        << "                             tick polling vs event-driven engine\n"
+        << "  log [records]              event log append and indexed query cost\n"
+        << "  logview [records]          log view model responsiveness\n"
+        << "  basal [intervals]          segmented basal delivery lookups\n"
+        << "  snapshot [days]            engine checkpoint save/restore cost\n"
+        << "  bolus [candidates]         parallel what-if bolus forecasts\n"
+        << "  replay [MB]                memory-mapped trace parse and replay\n"
+        << "  export [patients] [days]   streaming column file export\n"
+        << "  metrics [days]             sliding-window TIR, CV, GMI and percentiles\n"
+        << "  micro [--json file|-] [--reps N] [filter]\n"
+        << "                             per-call cost of core methods, median and p99\n"
+        << "  profile [ticks] [trace.json]\n"
+        << "                             tick phase timer overhead and trace export\n";
+    return 1;
+}
@@ -0,0 +1,60 @@
+// benchmarks.h
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <QStringList>
+
+// Each benchmark takes the remaining command line arguments and returns
+// the process exit code.
+
+// Cohort runner scaling from 1 thread up to all cores
+int runCohortBenchmark(const QStringList &args);
+
+// CGM history append/view cost at 24 h, 7 d, 30 d and 90 d retention
+int runCgmHistoryBenchmark(const QStringList &args);
+
+// Batched patient stepping, scalar vs AVX2 / AVX-512, checked against
+// one-patient-at-a-time results
+int runSimdBenchmark(const QStringList &args);
+
+// Distribution of Control-IQ controller decision latency
+int runControlLatencyBenchmark(const QStringList &args);
+
+// 30-day single-patient run, tick polling vs the event scheduler
+int runEventBenchmark(const QStringList &args);
+
+// Event log append rate, reopen cost and indexed query latency
+int runLogBenchmark(const QStringList &args);
+
+// Log view model: page render, filter, batched insert and search cost
+int runLogViewBenchmark(const QStringList &args);
+
+// Basal insulin over time intervals, prefix-sum table vs minute stepping
+int runBasalBenchmark(const QStringList &args);
+
+// Engine snapshot size, save/restore time and resumed-run equality
+int runSnapshotBenchmark(const QStringList &args);
+
+// What-if bolus forecasts from a forked live state, time per exploration
+int runBolusBenchmark(const QStringList &args);
+
+// Recorded CSV trace: parse throughput and an exact engine replay
+int runReplayBenchmark(const QStringList &args);
+
+// Cohort and engine outputs streamed to a column file: overhead,
+// compression, stalls and a read-back check
+int runExportBenchmark(const QStringList &args);
+
+// Sliding-window glycemic metrics: cost per reading, recount check and
+// merged percentiles
+int runMetricsBenchmark(const QStringList &args);
+
+// Per-call cost of the core classes' hot methods (median, p99), with
+// optional JSON output for tracking between releases
+int runMicroBenchmark(const QStringList &args);
+
+// Tick phase profiler: timer cost, overhead per tick at several sampling
+// rates and Chrome trace export
+int runProfileBenchmark(const QStringList &args);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,106 @@
+// bolusbench.cpp
+#include "benchmarks.h"
+#include "bolusexplorer.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Timed explorations, after one untimed warm-up
+const int REPEATS = 20;
+
+// Interactive budget for the whole set of candidates
+const double TARGET_MS = 200.0;
+
+const double CARBS = 60.0;
+
+// One patient on the default cohort therapy, a day and a half into the run
+void setUpScenario(SimulationEngine &engine)
+{
+    ProfileData therapy = CohortRunner().therapy();
+    engine.profileManager()->createProfile("Bench", therapy.basalRate, therapy.carbRatio,
+                                           therapy.correctionFactor, therapy.targetBG);
+    engine.setCurrentProfile(therapy);
+    engine.insulinPump()->setActiveProfile(therapy);
+    engine.insulinPump()->startBasalDelivery();
+
+    engine.cgm()->setGlucoseModel(BergmanGlucoseModel);
+    engine.cgm()->setNoiseSeed(42);
+
+    QVector<MealEvent> meals;
+    meals.append(MealEvent{420, 45.0});
+    meals.append(MealEvent{1110, 55.0});
+    engine.setMealPattern(meals);
+
+    engine.setAutoService(true);
+    engine.setLoggingEnabled(false);
+    engine.runFor(1440.0 + 720.0);
+}
+
+double median(std::vector<double> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+}
+
+int runBolusBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    QVector<BolusCandidate> candidates = BolusExplorer::defaultCandidates();
+    int count = args.size() > 0 ? args.at(0).toInt() : candidates.size();
+    if (count <= 0) {
+        out << "bolus: candidates must be positive\n";
+        return 1;
+    }
+    // Repeat the default grid to reach the requested count
+    while (candidates.size() < count) {
+        candidates.append(candidates.at(candidates.size() % BolusExplorer::defaultCandidates().size()));
+    }
+    candidates.resize(count);
+
+    SimulationEngine live;
+    setUpScenario(live);
+    double units = live.insulinPump()->calculateBolus(live.cgm()->currentGlucose(), CARBS);
+
+    for (int threads : {1, 0}) {
+        BolusExplorer explorer(threads);
+        explorer.explore(live, units, CARBS, candidates);
+        std::vector<double> runMs;
+        for (int i = 0; i < REPEATS; ++i) {
+            explorer.explore(live, units, CARBS, candidates);
+            runMs.push_back(explorer.lastRunMs());
+        }
+        out << QString("%1 candidates x %2 h, %3 thread(s): median %4 ms\n")
+               .arg(count).arg(explorer.horizonHours())
+               .arg(threads > 0 ? threads : QThread::idealThreadCount())
+               .arg(median(runMs), 0, 'f', 1);
+    }
+
+    // The forecast of a split must be what the live run then does with it
+    BolusExplorer explorer;
+    QVector<BolusOutcome> outcomes = explorer.explore(live, units, CARBS, candidates);
+    const BolusOutcome &pick = outcomes.at(outcomes.size() / 2);
+    live.cgm()->registerCarbEffect(CARBS);
+    if (pick.immediateUnits > 0.0) {
+        live.insulinPump()->deliverBolus(pick.immediateUnits);
+    }
+    if (pick.extendedUnits > 0.0) {
+        live.scheduleExtendedBolus(pick.extendedUnits, pick.candidate.extendedHours);
+    }
+    bool same = !pick.glucose.isEmpty();
+    for (int i = 0; i < pick.glucose.size() && same; ++i) {
+        live.runFor(NOMINAL_READING_MINUTES);    // Ticked, as SimulationWorker runs it
+        same = float(live.cgm()->currentGlucose()) == pick.glucose.at(i);
+    }
+
+    bool fast = explorer.lastRunMs() < TARGET_MS;
+    out << QString("Within %1 ms:              %2\n").arg(TARGET_MS).arg(fast ? "yes" : "NO");
+    out << QString("Forecast matches live run: %1\n").arg(same ? "yes" : "NO");
+    return same ? 0 : 1;
+}
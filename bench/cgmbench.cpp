@@ -0,0 +1,63 @@
+// cgmbench.cpp
+#include "benchmarks.h"
+#include "cgm.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+
+// Written after each timed loop so the compiler cannot drop the work
+static volatile double g_sink;
+
+int runCgmHistoryBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    int iterations = args.size() > 0 ? args.at(0).toInt() : 200000;
+    if (iterations <= 0) {
+        out << "cgm: iterations must be positive\n";
+        return 1;
+    }
+
+    const int retentionHours[] = {24, 7 * 24, 30 * 24, 90 * 24};
+    QDateTime start(QDate(2025, 1, 1), QTime(0, 0, 0));
+
+    out << QString("CGM history cost per call, %1 iterations, history kept full\n").arg(iterations);
+    out << "retention    readings  generateReading ns  getReadings(6h) ns\n";
+
+    for (int hours : retentionHours) {
+        CGM cgm;
+        cgm.setRetentionHours(hours);
+
+        // Fill the history so every new reading overwrites the oldest one
+        int capacity = hours * READINGS_PER_HOUR;
+        qint64 t = 0;
+        for (int i = 0; i < capacity; ++i, ++t) {
+            cgm.generateReading(start.addSecs(t * 300));
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; ++i, ++t) {
+            cgm.generateReading(start.addSecs(t * 300));
+        }
+        double generateNs = double(timer.nsecsElapsed()) / iterations;
+
+        // View creation plus a full pass over the 6 h window
+        double sink = 0.0;
+        timer.restart();
+        for (int i = 0; i < iterations; ++i) {
+            GlucoseReadingView view = cgm.getReadings(6);
+            for (const GlucoseReading &r : view) {
+                sink += r.value;
+            }
+        }
+        double viewNs = double(timer.nsecsElapsed()) / iterations;
+        g_sink = sink;
+
+        out << QString("%1 h  %2  %3  %4\n")
+               .arg(hours, 7)
+               .arg(capacity, 10)
+               .arg(generateNs, 18, 'f', 1)
+               .arg(viewNs, 18, 'f', 1);
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// cohortbench.cpp
+#include "benchmarks.h"
+#include "cohortrunner.h"
+#include <QThread>
+#include <QTextStream>
+
+int runCohortBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    int patients = args.size() > 0 ? args.at(0).toInt() : 256;
+    double days = args.size() > 1 ? args.at(1).toDouble() : 7.0;
+    GlucoseModelType model = (args.size() > 2 && args.at(2) == "bergman")
+                             ? BergmanGlucoseModel : RandomWalkGlucoseModel;
+    int maxThreads = QThread::idealThreadCount();
+    if (patients <= 0 || days <= 0.0) {
+        out << "cohort: patients and days must be positive\n";
+        return 1;
+    }
+
+    QVector<VirtualPatient> cohort = CohortRunner::generateCohort(patients, 42);
+
+    // 1, 2, 4, ... threads, always ending with every core
+    QVector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        threadCounts.append(t);
+    }
+    threadCounts.append(maxThreads);
+
+    out << QString("Cohort scaling: %1 patients x %2 days, %3, up to %4 threads\n")
+           .arg(patients).arg(days).arg(GlucoseModel::name(model)).arg(maxThreads);
+    out << "threads    seconds     ticks/s   speedup  efficiency  steals\n";
+
+    double baseline = 0.0;
+    for (int threads : threadCounts) {
+        CohortRunner runner;
+        runner.setDays(days);
+        runner.setThreadCount(threads);
+        runner.setGlucoseModel(model);
+        CohortStats stats = runner.run(cohort);
+
+        double seconds = runner.elapsedSeconds();
+        if (baseline <= 0.0) {
+            baseline = seconds;
+        }
+        double speedup = seconds > 0.0 ? baseline / seconds : 0.0;
+
+        out << QString("%1  %2  %3  %4  %5%  %6\n")
+               .arg(threads, 7)
+               .arg(seconds, 9, 'f', 3)
+               .arg(runner.ticksPerSecond(), 10, 'e', 3)
+               .arg(speedup, 8, 'f', 2)
+               .arg(100.0 * speedup / threads, 9, 'f', 1)
+               .arg(runner.stealCount(), 6);
+        out.flush();
+
+        if (threads == threadCounts.last()) {
+            out << QString("Cohort mean BG %1 mmol/L, time in range %2%, median %3 (5-95%: %4-%5)\n")
+                   .arg(stats.meanGlucose(), 0, 'f', 2)
+                   .arg(stats.timeInRange(), 0, 'f', 1)
+                   .arg(stats.percentile(50.0), 0, 'f', 1)
+                   .arg(stats.percentile(5.0), 0, 'f', 1)
+                   .arg(stats.percentile(95.0), 0, 'f', 1);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+// controlbench.cpp
+#include "benchmarks.h"
+#include "batchpatient.h"
+#include "cohortrunner.h"
+#include "controliqcontroller.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Per-decision budget for batch runs
+const double DECISION_BUDGET_NS = 1000.0;
+
+// One controller input, recorded from a simulated patient
+struct ControlInput {
+    double glucose;
+    double minutes;
+    double iob;
+    double cob;
+};
+
+// Written after each timed loop so the compiler cannot drop the work
+volatile double g_sink;
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[qMin(i, sorted.size() - 1)];
+}
+
+// Realistic inputs: readings, IOB and COB of virtual patients on Control-IQ
+std::vector<std::vector<ControlInput> > recordTraces(int patients, int ticks)
+{
+    ProfileData therapy = CohortRunner().therapy();
+    QVector<VirtualPatient> cohort = CohortRunner::generateCohort(patients, 42);
+
+    std::vector<std::vector<ControlInput> > traces(patients);
+    for (int p = 0; p < patients; ++p) {
+        BatchPatient<RandomWalkModel> patient(therapy, cohort[p].baseGlucose,
+                                              cohort[p].insulinSensitivity, cohort[p].seed);
+        patient.setMealPattern(cohort[p].meals);
+        traces[p].reserve(ticks);
+        for (int t = 0; t < ticks; ++t) {
+            double g = patient.tick();
+            traces[p].push_back({g, t * SIMULATION_SPEED, patient.insulinOnBoard(),
+                                 patient.carbsOnBoard()});
+        }
+    }
+    return traces;
+}
+
+}
+
+int runControlLatencyBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    int decisions = args.size() > 0 ? args.at(0).toInt() : 1000000;
+    const int patients = 64;
+    if (decisions < patients) {
+        out << QString("control: decisions must be at least %1\n").arg(patients);
+        return 1;
+    }
+    int ticks = decisions / patients;
+    decisions = ticks * patients;
+
+    std::vector<std::vector<ControlInput> > traces = recordTraces(patients, ticks);
+    ProfileData therapy = CohortRunner().therapy();
+
+    // Cost of reading the clock, taken off every sample
+    QElapsedTimer timer;
+    std::vector<double> empty(10000);
+    for (double &e : empty) {
+        timer.start();
+        e = double(timer.nsecsElapsed());
+    }
+    std::sort(empty.begin(), empty.end());
+    double overhead = percentile(empty, 0.5);
+
+    // Patients interleaved tick by tick, as in a batch run
+    std::vector<ControlIQController> controllers(patients);
+    for (ControlIQController &c : controllers) {
+        c.setTherapy(therapy);
+    }
+    std::vector<double> latency;
+    latency.reserve(decisions);
+    double sink = 0.0;
+    for (int t = 0; t < ticks; ++t) {
+        for (int p = 0; p < patients; ++p) {
+            const ControlInput &in = traces[p][t];
+            timer.start();
+            ControlIQDecision d = controllers[p].update(in.glucose, in.minutes, in.iob, in.cob);
+            qint64 ns = timer.nsecsElapsed();
+            sink += d.basalMultiplier + d.correctionBolus;
+            latency.push_back(qMax(0.0, ns - overhead));
+        }
+    }
+
+    // Same decisions back to back, for the mean without timer noise
+    for (ControlIQController &c : controllers) {
+        c.reset();
+    }
+    timer.start();
+    for (int t = 0; t < ticks; ++t) {
+        for (int p = 0; p < patients; ++p) {
+            const ControlInput &in = traces[p][t];
+            ControlIQDecision d = controllers[p].update(in.glucose, in.minutes, in.iob, in.cob);
+            sink += d.basalMultiplier + d.correctionBolus;
+        }
+    }
+    double meanNs = double(timer.nsecsElapsed()) / decisions;
+    g_sink = sink;
+
+    std::sort(latency.begin(), latency.end());
+    double p99 = percentile(latency, 0.99);
+
+    out << QString("Control-IQ decision latency: %1 decisions, %2 patients, timer overhead %3 ns (times in ns)\n")
+           .arg(decisions).arg(patients).arg(overhead, 0, 'f', 0);
+    out << "     min      p50      p90      p99    p99.9      max   mean (untimed)\n";
+    out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+           .arg(latency.front(), 8, 'f', 0)
+           .arg(percentile(latency, 0.5), 8, 'f', 0)
+           .arg(percentile(latency, 0.9), 8, 'f', 0)
+           .arg(p99, 8, 'f', 0)
+           .arg(percentile(latency, 0.999), 8, 'f', 0)
+           .arg(latency.back(), 8, 'f', 0)
+           .arg(meanNs, 16, 'f', 1);
+    out << QString("Budget %1 ns at p99: %2\n")
+           .arg(DECISION_BUDGET_NS, 0, 'f', 0)
+           .arg(p99 <= DECISION_BUDGET_NS ? "ok" : "EXCEEDED");
+    return p99 <= DECISION_BUDGET_NS ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// eventbench.cpp
+#include "benchmarks.h"
+#include "cohortrunner.h"
+#include "simulationengine.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+// One patient on the default cohort therapy: three meals a day and a
+// snack off the 5 min sensor grid, an extended bolus at the start, pump
+// serviced automatically
+std::unique_ptr<SimulationEngine> makeScenario(GlucoseModelType model, double days)
+{
+    std::unique_ptr<SimulationEngine> engine(new SimulationEngine);
+    ProfileData therapy = CohortRunner().therapy();
+    engine->profileManager()->createProfile("Bench", therapy.basalRate, therapy.carbRatio,
+                                            therapy.correctionFactor, therapy.targetBG);
+    engine->setCurrentProfile(therapy);
+    engine->insulinPump()->setActiveProfile(therapy);
+    engine->insulinPump()->startBasalDelivery();
+
+    engine->cgm()->setGlucoseModel(model);
+    engine->cgm()->setNoiseSeed(42);
+    engine->cgm()->setRetentionHours(static_cast<int>(std::ceil(days)) * 24);
+
+    QVector<MealEvent> meals;
+    meals.append(MealEvent{420, 45.0});
+    meals.append(MealEvent{750, 60.0});
+    meals.append(MealEvent{1110, 55.0});
+    meals.append(MealEvent{932, 20.0});     // 15:32, between two readings
+    engine->setMealPattern(meals);
+    engine->scheduleExtendedBolus(3.0, 2.0);
+
+    engine->setAutoService(true);
+    engine->setLoggingEnabled(false);
+    return engine;
+}
+
+struct LoopResult {
+    double seconds;
+    qint64 work;        // Ticks or events processed
+    double glucose;     // Final reading
+};
+
+LoopResult runTickLoop(GlucoseModelType model, double days, double tickMinutes)
+{
+    std::unique_ptr<SimulationEngine> engine = makeScenario(model, days);
+    engine->setTickMinutes(tickMinutes);
+
+    QElapsedTimer timer;
+    timer.start();
+    engine->runFor(days * 1440.0);
+    return {timer.nsecsElapsed() / 1e9, engine->ticksRun(), engine->cgm()->currentGlucose()};
+}
+
+LoopResult runEventLoop(GlucoseModelType model, double days)
+{
+    std::unique_ptr<SimulationEngine> engine = makeScenario(model, days);
+
+    QElapsedTimer timer;
+    timer.start();
+    engine->runEventsFor(days * 1440.0);
+    return {timer.nsecsElapsed() / 1e9, engine->eventsRun(), engine->cgm()->currentGlucose()};
+}
+
+void printRow(QTextStream &out, const QString &name, const LoopResult &r, double days,
+              double baseline)
+{
+    out << QString("%1  %2  %3  %4  %5  %6\n")
+           .arg(name, -16)
+           .arg(r.seconds, 9, 'f', 3)
+           .arg(r.work, 9)
+           .arg(r.work / (days * 24.0), 7, 'f', 1)
+           .arg(r.seconds > 0.0 ? days / r.seconds : 0.0, 10, 'f', 1)
+           .arg(r.seconds > 0.0 ? baseline / r.seconds : 0.0, 7, 'f', 2);
+    out.flush();
+}
+
+}
+
+int runEventBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    double days = args.size() > 0 ? args.at(0).toDouble() : 30.0;
+    GlucoseModelType model = (args.size() > 1 && args.at(1) == "bergman")
+                             ? BergmanGlucoseModel : RandomWalkGlucoseModel;
+    if (days <= 0.0) {
+        out << "events: days must be positive\n";
+        return 1;
+    }
+
+    out << QString("Tick polling vs event-driven: 1 patient x %1 days, %2\n")
+           .arg(days).arg(GlucoseModel::name(model));
+    out << "loop                seconds      work  work/h      days/s  speedup\n";
+
+    LoopResult fine = runTickLoop(model, days, 1.0);
+    printRow(out, "ticks, 1 min", fine, days, fine.seconds);
+    LoopResult coarse = runTickLoop(model, days, SIMULATION_SPEED);
+    printRow(out, "ticks, 5 min", coarse, days, fine.seconds);
+    LoopResult events = runEventLoop(model, days);
+    printRow(out, "event-driven", events, days, fine.seconds);
+
+    // Same sensor interval, so the two must agree reading for reading
+    double diff = std::fabs(events.glucose - coarse.glucose);
+    bool ok = diff <= 1e-9;
+    out << QString("Final BG: events %1, 5 min ticks %2 mmol/L, |diff| %3: %4\n")
+           .arg(events.glucose, 0, 'f', 3)
+           .arg(coarse.glucose, 0, 'f', 3)
+           .arg(diff, 0, 'e', 2)
+           .arg(ok ? "ok" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+// exportbench.cpp
+#include "benchmarks.h"
+#include "cohortrunner.h"
+#include "columnarwriter.h"
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Largest difference allowed between a patient's mean glucose from the
+// file (float32) and from the run (double)
+const double MEAN_TOLERANCE = 1e-3;
+
+// Simulated days for the single-engine export
+const double ENGINE_DAYS = 30.0;
+
+}
+
+int runExportBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    int patients = args.size() > 0 ? args.at(0).toInt() : 2048;
+    double days = args.size() > 1 ? args.at(1).toDouble() : 7.0;
+    if (patients <= 0 || days <= 0.0) {
+        out << "export: patients and days must be positive\n";
+        return 1;
+    }
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        out << "export: cannot create a temporary directory\n";
+        return 1;
+    }
+    QString path = dir.path() + "/cohort.pcol";
+    QVector<VirtualPatient> cohort = CohortRunner::generateCohort(patients, 42);
+
+    // Same cohort without and with the export
+    CohortRunner plain;
+    plain.setDays(days);
+    plain.run(cohort);
+
+    ColumnarWriter writer;
+    writer.setColumns(ALL_OUTPUT_COLUMNS & ~((1 << BatteryColumn) | (1 << ReservoirColumn)));
+    writer.setThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    if (!writer.open(path)) {
+        out << "export: cannot open " << path << ": " << writer.errorString() << "\n";
+        return 1;
+    }
+    CohortRunner runner;
+    runner.setDays(days);
+    runner.setOutputWriter(&writer);
+    runner.run(cohort);
+    bool closed = writer.close();
+
+    double ratio = writer.bytesWritten() > 0 ? double(writer.rawBytesWritten()) / writer.bytesWritten() : 0.0;
+    out << QString("Cohort %1 patients x %2 days, %3 rows\n")
+           .arg(patients).arg(days).arg(writer.rowsWritten());
+    out << QString("Without export:    %1 ticks/s\n").arg(plain.ticksPerSecond(), 0, 'e', 3);
+    out << QString("With export:       %1 ticks/s\n").arg(runner.ticksPerSecond(), 0, 'e', 3);
+    out << QString("File:              %1 MB, %2 bytes/row, compression %3x\n")
+           .arg(writer.bytesWritten() / 1e6, 0, 'f', 1)
+           .arg(double(writer.bytesWritten()) / qMax<qint64>(1, writer.rowsWritten()), 0, 'f', 2)
+           .arg(ratio, 0, 'f', 1);
+    out << QString("Stalls:            %1 (%2 s)\n")
+           .arg(writer.stallCount()).arg(writer.stallSeconds(), 0, 'f', 3);
+
+    // Read it back: every row present and each patient's mean as run
+    ColumnarReader reader;
+    bool readable = closed && reader.open(path);
+    std::vector<double> sums(patients, 0.0);
+    std::vector<qint64> counts(patients, 0);
+    qint64 rows = 0;
+    OutputBatch batch;
+    for (int g = 0; readable && g < reader.groupCount(); ++g) {
+        readable = reader.readGroup(g, batch);
+        for (int i = 0; readable && i < batch.size(); ++i) {
+            quint32 p = batch.patient[i];
+            readable = p < quint32(patients);
+            if (readable) {
+                sums[p] += batch.column(GlucoseColumn)[i];
+                ++counts[p];
+            }
+        }
+        rows += batch.size();
+    }
+    qint64 expectedRows = runner.ticksRun();
+    double worst = 0.0;
+    for (int p = 0; readable && p < patients; ++p) {
+        double mean = counts[p] > 0 ? sums[p] / counts[p] : 0.0;
+        worst = qMax(worst, std::fabs(mean - runner.patientResults().at(p).meanGlucose));
+    }
+    bool roundTrip = readable && rows == expectedRows && reader.rowCount() == expectedRows
+                     && worst < MEAN_TOLERANCE;
+    out << QString("Read back:         %1 rows in %2 groups, worst mean difference %3\n")
+           .arg(rows).arg(reader.groupCount()).arg(worst, 0, 'e', 1);
+
+    // One engine, every column
+    SimulationEngine engine;
+    engine.setLoggingEnabled(false);
+    engine.setAutoService(true);
+    engine.insulinPump()->startBasalDelivery();
+    QString enginePath = dir.path() + "/engine.pcol";
+    ColumnarWriter engineWriter;
+    bool engineOk = engineWriter.open(enginePath);
+    engine.setOutputWriter(&engineWriter);
+    engine.runFor(ENGINE_DAYS * 1440.0);
+    engine.setOutputWriter(nullptr);
+    engineOk = engineWriter.close() && engineOk;
+
+    ColumnarReader engineReader;
+    engineOk = engineOk && engineReader.open(enginePath)
+               && engineReader.rowCount() == engine.ticksRun();
+    engineOk = engineOk && engineReader.readGroup(engineReader.groupCount() - 1, batch)
+               && batch.size() > 0;
+    if (engineOk) {
+        int last = batch.size() - 1;
+        engineOk = batch.column(GlucoseColumn)[last] == float(engine.cgm()->currentGlucose())
+                && batch.column(ReservoirColumn)[last]
+                   == float(engine.insulinPump()->insulinUnitsRemaining());
+    }
+    out << QString("Engine %1 days:    %2 rows, last row %3\n")
+           .arg(ENGINE_DAYS).arg(engineReader.rowCount()).arg(engineOk ? "matches" : "MISMATCH");
+
+    bool ok = roundTrip && engineOk;
+    out << (ok ? "Results ok\n" : "Results MISMATCH\n");
+    return ok ? 0 : 1;
+}
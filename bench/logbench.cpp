@@ -0,0 +1,99 @@
+// logbench.cpp
+#include "benchmarks.h"
+#include "systemlog.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+
+// A month of simulated time spread evenly over the records
+const qint64 MONTH_MS = 30LL * 24 * 3600 * 1000;
+
+// Mostly routine records with a rare alarm mixed in, like a long run
+LogEventCode recordCode(qint64 i)
+{
+    if (i % 1000 == 0) {
+        return CriticalLowLogEvent;
+    }
+    return (i % 3 == 0) ? MealLogEvent : BasalResumedLogEvent;
+}
+
+double msSince(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+}
+
+int runLogBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    qint64 records = args.size() > 0 ? args.at(0).toLongLong() : 5000000;
+    if (records <= 0) {
+        out << "log: records must be positive\n";
+        return 1;
+    }
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        out << "log: cannot create a temporary directory\n";
+        return 1;
+    }
+
+    qint64 startMs = QDateTime(QDate(2025, 1, 1), QTime(0, 0, 0)).toMSecsSinceEpoch();
+    qint64 stepMs = qMax<qint64>(1, MONTH_MS / records);
+    qint64 expectedAlarms = 0;
+
+    QElapsedTimer timer;
+    {
+        SystemLog log;
+        log.open(dir.path());
+        timer.start();
+        for (qint64 i = 0; i < records; ++i) {
+            LogEventCode code = recordCode(i);
+            expectedAlarms += (code == CriticalLowLogEvent);
+            log.append(startMs + i * stepMs, code, 3.1);
+        }
+        double appendMs = msSince(timer);
+        out << QString("Appended %1 records in %2 ms (%3 ns/record), %4 segments\n")
+               .arg(records)
+               .arg(appendMs, 0, 'f', 1)
+               .arg(appendMs * 1e6 / records, 0, 'f', 1)
+               .arg(log.segmentCount());
+    }
+
+    // As after a restart: nothing cached but the notes
+    timer.start();
+    SystemLog log;
+    log.open(dir.path());
+    out << QString("Reopened in %1 ms, %2 records\n").arg(msSince(timer), 0, 'f', 2).arg(log.size());
+
+    qint64 endMs = startMs + records * stepMs;
+    qint64 dayFrom = startMs + (endMs - startMs) / 2;
+    qint64 dayTo = dayFrom + 24LL * 3600 * 1000;
+    quint32 alarms = logEventBit(CriticalLowLogEvent);
+
+    timer.start();
+    qint64 all = log.count(startMs, endMs, alarms);
+    double allMs = msSince(timer);
+    timer.start();
+    qint64 day = log.count(dayFrom, dayTo);
+    double dayMs = msSince(timer);
+    timer.start();
+    std::vector<LogRecord> found = log.query(startMs, endMs, alarms);
+    double queryMs = msSince(timer);
+    timer.start();
+    std::vector<LogRecord> dayAlarms = log.query(dayFrom, dayTo, alarms);
+    double dayQueryMs = msSince(timer);
+
+    out << QString("Count alarms, whole log:   %1 in %2 ms\n").arg(all).arg(allMs, 0, 'f', 3);
+    out << QString("Count all, one day:        %1 in %2 ms\n").arg(day).arg(dayMs, 0, 'f', 3);
+    out << QString("Fetch alarms, whole log:   %1 in %2 ms\n").arg(qint64(found.size())).arg(queryMs, 0, 'f', 3);
+    out << QString("Fetch alarms, one day:     %1 in %2 ms\n").arg(qint64(dayAlarms.size())).arg(dayQueryMs, 0, 'f', 3);
+
+    bool ok = all == expectedAlarms && qint64(found.size()) == expectedAlarms;
+    out << (ok ? "Index results ok\n" : "Index results MISMATCH\n");
+    return ok ? 0 : 1;
+}
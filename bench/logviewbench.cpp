@@ -0,0 +1,154 @@
+// logviewbench.cpp
+#include "benchmarks.h"
+#include "logmodel.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QTimer>
+#include <limits>
+#include <random>
+
+namespace {
+
+// Rows a log view shows at once
+const int PAGE_ROWS = 50;
+
+// Fill the log with a month of routine records, an alert every 1000 and
+// one distinctive note near the end for the search to find
+void fillLog(SystemLog &log, qint64 records, qint64 startMs)
+{
+    qint64 stepMs = qMax<qint64>(1, 30LL * 24 * 3600 * 1000 / records);
+    for (qint64 i = 0; i < records; ++i) {
+        qint64 t = startMs + i * stepMs;
+        if (i == records - records / 20) {
+            log.appendNote(t, "Sensor replaced");
+        } else if (i % 1000 == 0) {
+            log.append(t, CriticalLowLogEvent, 3.1);
+        } else if (i % 7 == 0) {
+            log.appendNote(t, "Simulation resumed");
+        } else {
+            log.append(t, (i % 3 == 0) ? MealLogEvent : BasalResumedLogEvent, 40.0, 4.0);
+        }
+    }
+}
+
+// Render one screenful of rows, as a view does on scroll
+double pageMicros(const LogModel &model, int firstRow)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int bytes = 0;
+    for (int row = firstRow; row < qMin(firstRow + PAGE_ROWS, model.rowCount()); ++row) {
+        for (int col = 0; col < LogModel::ColumnCount; ++col) {
+            bytes += model.data(model.index(row, col)).toString().size();
+        }
+    }
+    Q_UNUSED(bytes);
+    return timer.nsecsElapsed() / 1e3;
+}
+
+// Longest gap between 1 ms ticks while the event loop runs until the
+// given signal, i.e. the worst stall a user would feel
+template <typename Signal>
+qint64 worstStallMs(LogModel *model, Signal signal, double *totalMs)
+{
+    QEventLoop loop;
+    QTimer probe;
+    QElapsedTimer sinceTick;
+    qint64 worst = 0;
+    probe.setInterval(1);
+    QObject::connect(&probe, &QTimer::timeout, [&]() {
+        worst = qMax(worst, sinceTick.elapsed());
+        sinceTick.start();
+    });
+    QObject::connect(model, signal, &loop, &QEventLoop::quit);
+
+    QElapsedTimer total;
+    total.start();
+    sinceTick.start();
+    probe.start();
+    loop.exec();
+    *totalMs = total.nsecsElapsed() / 1e6;
+    return qMax(worst, sinceTick.elapsed());
+}
+
+}
+
+int runLogViewBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    qint64 records = args.size() > 0 ? args.at(0).toLongLong() : 10000000;
+    if (records <= 0 || records > std::numeric_limits<int>::max()) {
+        out << "logview: records must be between 1 and 2^31 - 1\n";
+        return 1;
+    }
+
+    SystemLog log;
+    qint64 startMs = QDateTime(QDate(2025, 1, 1), QTime(0, 0, 0)).toMSecsSinceEpoch();
+    fillLog(log, records, startMs);
+    out << QString("Log view over %1 entries\n").arg(records);
+
+    QElapsedTimer timer;
+    timer.start();
+    LogModel model(&log);
+    out << QString("Model ready:                %1 ms, %2 rows\n")
+           .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 3).arg(model.rowCount());
+
+    // Scrolling: random screenfuls
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> rowDist(0, qMax(0, model.rowCount() - PAGE_ROWS));
+    double worstPage = 0.0;
+    double sumPage = 0.0;
+    const int pages = 200;
+    for (int i = 0; i < pages; ++i) {
+        double us = pageMicros(model, rowDist(rng));
+        worstPage = qMax(worstPage, us);
+        sumPage += us;
+    }
+    out << QString("Render %1 rows:             mean %2 us, worst %3 us\n")
+           .arg(PAGE_ROWS).arg(sumPage / pages, 0, 'f', 1).arg(worstPage, 0, 'f', 1);
+
+    // Filtering
+    timer.start();
+    model.setFilter(logEventBit(CriticalLowLogEvent), std::numeric_limits<qint64>::min(),
+                    std::numeric_limits<qint64>::max());
+    out << QString("Filter to alerts:           %1 ms, %2 rows\n")
+           .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 3).arg(model.rowCount());
+    qint64 lastMs = log.at(log.size() - 1).timestampMs;
+    timer.start();
+    model.setFilter(ALL_LOG_EVENTS, lastMs - 24LL * 3600 * 1000, std::numeric_limits<qint64>::max());
+    out << QString("Filter to last 24 h:        %1 ms, %2 rows\n")
+           .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 3).arg(model.rowCount());
+    model.setFilter(ALL_LOG_EVENTS, std::numeric_limits<qint64>::min(),
+                    std::numeric_limits<qint64>::max());
+
+    // Live appends arrive as one insert per frame
+    int batches = 0;
+    int inserted = 0;
+    QObject::connect(&model, &LogModel::rowsInserted, [&](const QModelIndex &, int first, int last) {
+        ++batches;
+        inserted += last - first + 1;
+    });
+    for (int i = 0; i < 1000; ++i) {
+        log.append(lastMs + i, BasalResumedLogEvent);
+    }
+    double appendMs = 0.0;
+    worstStallMs(&model, &LogModel::rowsInserted, &appendMs);
+    out << QString("1000 appends:               %1 row(s) in %2 insert(s)\n")
+           .arg(inserted).arg(batches);
+
+    // Search from the top for the one distinctive note
+    double searchMs = 0.0;
+    int found = -1;
+    QObject::connect(&model, &LogModel::searchFinished, [&](int row) { found = row; });
+    model.startSearch("sensor replaced", 0);
+    qint64 stall = worstStallMs(&model, &LogModel::searchFinished, &searchMs);
+    out << QString("Search to row %1:      %2 ms, worst UI stall %3 ms\n")
+           .arg(found, 9).arg(searchMs, 0, 'f', 1).arg(stall);
+
+    bool ok = batches == 1 && inserted == 1000 && found >= 0;
+    out << (ok ? "Results ok\n" : "Results MISMATCH\n");
+    return ok ? 0 : 1;
+}
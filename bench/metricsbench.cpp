@@ -0,0 +1,168 @@
+// metricsbench.cpp
+#include "benchmarks.h"
+#include "cohortrunner.h"
+#include "glycemicmetrics.h"
+#include "philox.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const qint64 READING_MS = 5 * 60 * 1000;
+
+// Summaries checked against a full recount, spread over the run
+const int CHECKPOINTS = 25;
+
+// Partial results merged in the combination check
+const int PARTS = 8;
+
+// A day of glucose with meal peaks, overnight lows now and then, and noise
+double syntheticGlucose(const PhiloxRandom &rng, qint64 n)
+{
+    double day = (n % 288) / 288.0;
+    double g = 6.5 + 3.5 * std::sin(day * 6 * M_PI) * std::sin(day * 6 * M_PI)
+             - 5.0 * (rng.uniform(n / 288, 1) < 0.3 ? std::exp(-std::pow((day - 0.12) * 20, 2)) : 0.0)
+             + (rng.uniform(n) - 0.5) * 2.0;
+    return qBound(2.2, g, 22.0);
+}
+
+// Window summary recounted from every reading in it
+GlycemicSummary recount(const std::vector<double> &values, qint64 first, qint64 last)
+{
+    GlycemicSummary s;
+    std::vector<double> sorted;
+    double sum = 0.0;
+    qint64 veryLow = 0, low = 0, in = 0, high = 0, veryHigh = 0;
+    for (qint64 i = first; i <= last; ++i) {
+        double g = std::round(values[i] * 1000.0) / 1000.0;
+        sorted.push_back(g);
+        sum += g;
+        veryLow += g < 3.0;
+        low += g < LOW_GLUCOSE_THRESHOLD;
+        in += g >= LOW_GLUCOSE_THRESHOLD && g <= HIGH_GLUCOSE_THRESHOLD;
+        high += g > HIGH_GLUCOSE_THRESHOLD;
+        veryHigh += g > 13.9;
+    }
+    double n = double(sorted.size());
+    s.readings = qint64(sorted.size());
+    s.meanGlucose = sum / n;
+    double squares = 0.0;
+    for (double g : sorted) {
+        squares += (g - s.meanGlucose) * (g - s.meanGlucose);
+    }
+    s.standardDeviation = std::sqrt(squares / n);
+    s.timeBelow3_0 = 100.0 * veryLow / n;
+    s.timeBelow3_9 = 100.0 * low / n;
+    s.timeInRange = 100.0 * in / n;
+    s.timeAbove10_0 = 100.0 * high / n;
+    s.timeAbove13_9 = 100.0 * veryHigh / n;
+    std::sort(sorted.begin(), sorted.end());
+    s.median = sorted[std::min<size_t>(sorted.size() - 1, size_t(n * 0.5))];
+    s.percentile5 = sorted[size_t(n * 0.05)];
+    s.percentile95 = sorted[std::min<size_t>(sorted.size() - 1, size_t(n * 0.95))];
+    return s;
+}
+
+bool close(double a, double b, double tolerance)
+{
+    return std::fabs(a - b) <= tolerance;
+}
+
+}
+
+int runMetricsBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    double days = args.size() > 0 ? args.at(0).toDouble() : 180.0;
+    if (days <= 0.0) {
+        out << "metrics: days must be positive\n";
+        return 1;
+    }
+    qint64 readings = qint64(days * 288);
+    PhiloxRandom rng(42);
+    std::vector<double> values(readings);
+    for (qint64 n = 0; n < readings; ++n) {
+        values[n] = syntheticGlucose(rng, n);
+    }
+
+    // Streaming cost, all three windows
+    GlycemicMetrics metrics;
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 n = 0; n < readings; ++n) {
+        metrics.addReading(n * READING_MS, values[n]);
+    }
+    double perReadingNs = double(timer.nsecsElapsed()) / readings;
+    out << QString("%1 days, %2 readings: %3 ns per reading (3 windows)\n")
+           .arg(days).arg(readings).arg(perReadingNs, 0, 'f', 1);
+
+    timer.start();
+    GlycemicSummary latest;
+    for (int i = 0; i < 1000; ++i) {
+        latest = metrics.summary(NinetyDayWindow);
+    }
+    out << QString("Summary with percentiles:   %1 us\n").arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2);
+
+    // Sliding results against a recount of each window, at checkpoints
+    GlycemicMetrics replay;
+    int mismatches = 0;
+    qint64 next = 0;
+    for (int c = 1; c <= CHECKPOINTS; ++c) {
+        qint64 upTo = readings * c / CHECKPOINTS - 1;
+        for (; next <= upTo; ++next) {
+            replay.addReading(next * READING_MS, values[next]);
+        }
+        for (int w = 0; w < MetricsWindowCount; ++w) {
+            qint64 span = GlycemicMetrics::windowMs(MetricsWindow(w)) / READING_MS;
+            GlycemicSummary got = replay.summary(MetricsWindow(w));
+            GlycemicSummary want = recount(values, qMax<qint64>(0, upTo - span + 1), upTo);
+            bool same = got.readings == want.readings
+                        && close(got.meanGlucose, want.meanGlucose, 1e-9)
+                        && close(got.standardDeviation, want.standardDeviation, 1e-6)
+                        && close(got.timeBelow3_0, want.timeBelow3_0, 1e-9)
+                        && close(got.timeBelow3_9, want.timeBelow3_9, 1e-9)
+                        && close(got.timeInRange, want.timeInRange, 1e-9)
+                        && close(got.timeAbove10_0, want.timeAbove10_0, 1e-9)
+                        && close(got.timeAbove13_9, want.timeAbove13_9, 1e-9)
+                        && close(got.percentile5, want.percentile5, GLUCOSE_HISTOGRAM_BIN)
+                        && close(got.median, want.median, GLUCOSE_HISTOGRAM_BIN)
+                        && close(got.percentile95, want.percentile95, GLUCOSE_HISTOGRAM_BIN);
+            mismatches += !same;
+        }
+    }
+    out << QString("Windows vs recount:         %1 of %2 checks differ\n")
+           .arg(mismatches).arg(CHECKPOINTS * MetricsWindowCount);
+
+    // Parts merged in any grouping give the same distribution as one pass
+    CohortStats whole;
+    std::vector<CohortStats> parts(PARTS);
+    for (qint64 n = 0; n < readings; ++n) {
+        whole.add(values[n]);
+        parts[n % PARTS].add(values[n]);
+    }
+    CohortStats merged;
+    for (int p = PARTS - 1; p >= 0; --p) {
+        merged.merge(parts[p]);
+    }
+    bool mergeSame = merged.readings == whole.readings;
+    for (double q : {1.0, 5.0, 25.0, 50.0, 75.0, 95.0, 99.0}) {
+        mergeSame = mergeSame && merged.percentile(q) == whole.percentile(q);
+    }
+    out << QString("Merged parts:               %1, median %2, 5-95%: %3-%4 mmol/L\n")
+           .arg(mergeSame ? "identical" : "DIFFERENT")
+           .arg(merged.percentile(50.0), 0, 'f', 2)
+           .arg(merged.percentile(5.0), 0, 'f', 2)
+           .arg(merged.percentile(95.0), 0, 'f', 2);
+    out << QString("90 d: in range %1%, below 3.9 %2%, below 3.0 %3%, CV %4%, GMI %5%\n")
+           .arg(latest.timeInRange, 0, 'f', 1).arg(latest.timeBelow3_9, 0, 'f', 1)
+           .arg(latest.timeBelow3_0, 0, 'f', 1).arg(latest.coefficientOfVariation, 0, 'f', 1)
+           .arg(latest.gmi, 0, 'f', 2);
+
+    bool ok = mismatches == 0 && mergeSame;
+    out << (ok ? "Results ok\n" : "Results MISMATCH\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// microbench.cpp
+#include "benchmarks.h"
+#include "benchharness.h"
+#include "simulationengine.h"
+#include <QFile>
+#include <QTextStream>
+
+namespace {
+
+const qint64 READING_MS = 5 * 60 * 1000;
+
+// Therapy with a few time-of-day segments, like a typical pump setup
+ProfileData benchProfile()
+{
+    ProfileData p{0.9, 10.0, 2.0, 5.5, {}};
+    p.segments.append(ProfileSegment{0, 0.9, 10.0, 2.0, 5.5});
+    p.segments.append(ProfileSegment{6 * 60, 1.2, 8.0, 1.8, 5.5});
+    p.segments.append(ProfileSegment{12 * 60, 1.0, 9.0, 2.0, 5.5});
+    p.segments.append(ProfileSegment{22 * 60, 0.8, 11.0, 2.2, 6.0});
+    return p;
+}
+
+void benchCgm(BenchHarness &harness, GlucoseModelType model)
+{
+    CGM cgm;
+    cgm.setGlucoseModel(model);
+    cgm.setNoiseSeed(42);
+    qint64 now = 0;
+    harness.run(QString("CGM::generateReading (%1)").arg(GlucoseModel::name(model)),
+                [&](qint64 calls) {
+        for (qint64 i = 0; i < calls; ++i) {
+            now += READING_MS;
+            cgm.generateReading(now);
+        }
+        keepResult(cgm.currentGlucose());
+    });
+}
+
+}
+
+int runMicroBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    QString jsonPath;
+    QString filter;
+    int repetitions = 200;
+    for (int i = 0; i < args.size(); ++i) {
+        if (args.at(i) == "--json" && i + 1 < args.size()) {
+            jsonPath = args.at(++i);
+        } else if (args.at(i) == "--reps" && i + 1 < args.size()) {
+            repetitions = args.at(++i).toInt();
+        } else {
+            filter = args.at(i);
+        }
+    }
+    if (repetitions <= 0) {
+        out << "micro: repetitions must be positive\n";
+        return 1;
+    }
+
+    BenchHarness harness("pump1_bench micro");
+    harness.setRepetitions(repetitions);
+    harness.setFilter(filter);
+
+    benchCgm(harness, RandomWalkGlucoseModel);
+    benchCgm(harness, BergmanGlucoseModel);
+
+    CGM history;
+    history.setNoiseSeed(42);
+    history.setRetentionHours(MAX_RETENTION_HOURS);
+    for (qint64 n = 1; n <= MAX_RETENTION_HOURS * READINGS_PER_HOUR; ++n) {
+        history.generateReading(n * READING_MS);
+    }
+    for (int hours : {24, MAX_RETENTION_HOURS}) {
+        harness.run(QString("CGM::getReadings (%1 h)").arg(hours), [&](qint64 calls) {
+            for (qint64 i = 0; i < calls; ++i) {
+                GlucoseReadingView view = history.getReadings(hours);
+                keepResult(view);
+            }
+        });
+    }
+
+    // The reservoir is topped up now and then so every tick delivers
+    CGM pumpCgm;
+    InsulinPump pump;
+    pump.setCGM(&pumpCgm);
+    pump.setActiveProfile(benchProfile());
+    pump.startBasalDelivery();
+    harness.run("InsulinPump::performBasalTick", [&](qint64 calls) {
+        for (qint64 i = 0; i < calls; ++i) {
+            if ((i & 1023) == 0) {
+                pump.replenishInsulin();
+            }
+            pump.performBasalTick(SIMULATION_SPEED);
+        }
+        keepResult(pump.insulinUnitsRemaining());
+    });
+    harness.run("InsulinPump::calculateBolus", [&](qint64 calls) {
+        double total = 0.0;
+        for (qint64 i = 0; i < calls; ++i) {
+            total += pump.calculateBolus(6.0 + (i & 7), 45.0);
+        }
+        keepResult(total);
+    });
+
+    ProfileManager profiles;
+    QStringList names;
+    for (int p = 0; p < 8; ++p) {
+        names.append(QString("Profile %1").arg(p));
+        profiles.createProfile(names.last(), 0.8 + 0.1 * p, 10.0, 2.0, 5.5);
+        profiles.setSegments(names.last(), benchProfile().segments);
+    }
+    harness.run("ProfileManager::profile", [&](qint64 calls) {
+        for (qint64 i = 0; i < calls; ++i) {
+            ProfileData p = profiles.profile(names.at(int(i & 7)));
+            keepResult(p.basalRate);
+        }
+    });
+
+    // MainWindow::logEvent only forwards to the engine, which is what is
+    // timed here without the GUI
+    SimulationEngine engine;
+    const QString notes[] = {"Bolus delivered", "Basal started", "Profile updated", "Snapshot saved"};
+    harness.run("MainWindow::logEvent", [&](qint64 calls) {
+        for (qint64 i = 0; i < calls; ++i) {
+            engine.logEvent(notes[i & 3]);
+        }
+    });
+
+    SimulationEngine ticking;
+    ticking.setLoggingEnabled(false);
+    ticking.setAutoService(true);
+    ticking.setCurrentProfile(benchProfile());
+    ticking.insulinPump()->setActiveProfile(benchProfile());
+    ticking.insulinPump()->startBasalDelivery();
+    harness.run("SimulationEngine::tick", [&](qint64 calls) {
+        ticking.runTicks(calls);
+    });
+
+    // JSON on stdout stays parseable: the table goes to stderr instead
+    QTextStream err(stderr);
+    (jsonPath == "-" ? err : out) << harness.table();
+    if (!jsonPath.isEmpty()) {
+        QByteArray json = harness.json();
+        if (jsonPath == "-") {
+            out << json;
+        } else {
+            QFile file(jsonPath);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+                out << "micro: cannot write " << jsonPath << "\n";
+                return 1;
+            }
+            out << "Wrote " << jsonPath << "\n";
+        }
+    }
+    return harness.results().isEmpty() ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+// profilebench.cpp
+#include "benchmarks.h"
+#include "simulationengine.h"
+#include "tickprofiler.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+
+namespace {
+
+// Alternating rounds; the fastest of each setting is reported
+const int ROUNDS = 5;
+
+// Ticks as SimulationWorker runs them
+double nsPerTick(SimulationEngine &engine, qint64 ticks)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 i = 0; i < ticks; ++i) {
+        TickProfileFrame frame;
+        engine.tick();
+    }
+    return double(timer.nsecsElapsed()) / ticks;
+}
+
+void setUp(SimulationEngine &engine)
+{
+    ProfileData p{0.9, 10.0, 2.0, 5.5, {}};
+    engine.setLoggingEnabled(false);
+    engine.setAutoService(true);
+    engine.setCurrentProfile(p);
+    engine.insulinPump()->setActiveProfile(p);
+    engine.insulinPump()->startBasalDelivery();
+}
+
+}
+
+int runProfileBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    qint64 ticks = args.size() > 0 ? args.at(0).toLongLong() : 200000;
+    QString tracePath = args.size() > 1 ? args.at(1) : QString();
+    if (ticks <= 0) {
+        out << "profile: ticks must be positive\n";
+        return 1;
+    }
+    out << "Tick timers " << (TickProfiler::compiledIn() ? "compiled in" : "compiled out") << "\n";
+
+    // Cost of one phase timer in a sampled frame
+    TickProfiler::setEnabled(true);
+    TickProfiler::setSampleInterval(1);
+    const int scopes = 1000000;
+    QElapsedTimer timer;
+    {
+        TickProfileFrame frame;
+        timer.start();
+        for (int i = 0; i < scopes; ++i) {
+            TickPhaseTimer phase(BasalPhase);
+        }
+    }
+    double scopeNs = double(timer.nsecsElapsed()) / scopes;
+    TickProfiler::setEnabled(false);
+    timer.start();
+    for (int i = 0; i < scopes; ++i) {
+        TickProfileFrame frame;
+        TickPhaseTimer phase(BasalPhase);
+    }
+    double idleNs = double(timer.nsecsElapsed()) / scopes;
+    out << QString("Phase timer: %1 ns recording, %2 ns per frame + timer while off\n")
+           .arg(scopeNs, 0, 'f', 1).arg(idleNs, 0, 'f', 1);
+
+    // Headless engine ticks: the cheapest tick there is, so the worst case
+    // for the relative overhead. GUI ticks add the chart and labels.
+    SimulationEngine engine;
+    setUp(engine);
+    nsPerTick(engine, ticks / 10);
+    const int intervals[] = {0, 1, 8, 32};       // 0: off; 8 is the default
+    double best[4] = {1e300, 1e300, 1e300, 1e300};
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (int k = 0; k < 4; ++k) {
+            TickProfiler::setEnabled(intervals[k] > 0);
+            TickProfiler::setSampleInterval(qMax(1, intervals[k]));
+            best[k] = qMin(best[k], nsPerTick(engine, ticks));
+        }
+    }
+    TickProfiler::setEnabled(false);
+    out << QString("Engine tick, profiler off:     %1 ns\n").arg(best[0], 0, 'f', 1);
+    for (int k = 1; k < 4; ++k) {
+        out << QString("Recording 1 tick in %1:        %2 ns (%3%)\n")
+               .arg(intervals[k], 2).arg(best[k], 0, 'f', 1)
+               .arg(100.0 * (best[k] - best[0]) / best[0], 0, 'f', 2);
+    }
+    double recordedNs = best[1] - best[0];
+    out << QString("A recorded tick costs %1 ns more: under 1% at 1 in %2 for ticks over %3 us\n")
+           .arg(recordedNs, 0, 'f', 0).arg(intervals[2])
+           .arg(recordedNs / intervals[2] * 100.0 / 1000.0, 0, 'f', 1);
+
+    // What the panel and the export see
+    QVector<TickSample> samples = TickProfiler::samples();
+    QVector<TickPhaseStats> stats = TickProfiler::phaseStats();
+    out << QString("%1 samples held\n").arg(samples.size());
+    for (int p = 0; p < TickPhaseCount; ++p) {
+        if (stats.at(p).samples > 0) {
+            out << QString("  %1 p50 %2 us  p99 %3 us\n").arg(TickProfiler::phaseName(TickPhase(p)), -16)
+                   .arg(stats.at(p).p50Us, 7, 'f', 3).arg(stats.at(p).p99Us, 7, 'f', 3);
+        }
+    }
+    timer.start();
+    QByteArray trace = TickProfiler::chromeTrace();
+    out << QString("Chrome trace: %1 KB in %2 ms\n").arg(trace.size() / 1024)
+           .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1);
+    if (!tracePath.isEmpty()) {
+        if (!TickProfiler::writeChromeTrace(tracePath)) {
+            out << "profile: cannot write " << tracePath << "\n";
+            return 1;
+        }
+        out << "Wrote " << tracePath << "\n";
+    }
+
+    // Every sampled tick has all its phases, if the timers are compiled in
+    bool ok = true;
+    if (TickProfiler::compiledIn()) {
+        qint64 whole = stats.at(WholeTickPhase).samples;
+        for (int p = SensorPhase; p <= ErrorChecksPhase; ++p) {
+            ok = ok && stats.at(p).samples == whole;
+        }
+        ok = ok && whole > 0;
+    }
+    out << (ok ? "Results ok\n" : "Results MISMATCH\n");
+    return ok ? 0 : 1;
+}
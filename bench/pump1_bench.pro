@@ -0,0 +1,34 @@
+# Headless benchmarks for the simulation core (no QtWidgets/QtCharts)
+
+QT -= gui
+QT += core
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = pump1_bench
+
+include(../core.pri)
+
+SOURCES += \
+    basalbench.cpp \
+    benchharness.cpp \
+    benchmain.cpp \
+    bolusbench.cpp \
+    cgmbench.cpp \
+    cohortbench.cpp \
+    controlbench.cpp \
+    eventbench.cpp \
+    exportbench.cpp \
+    logbench.cpp \
+    logviewbench.cpp \
+    metricsbench.cpp \
+    microbench.cpp \
+    profilebench.cpp \
+    replaybench.cpp \
+    simdbench.cpp \
+    snapshotbench.cpp
+
+HEADERS += \
+    benchharness.h \
+    benchmarks.h
@@ -0,0 +1,167 @@
+// replaybench.cpp
+#include "benchmarks.h"
+#include "simulationengine.h"
+#include "tracereplay.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const qint64 MINUTE_MS = 60 * 1000;
+const qint64 DAY_MS = 24 * 60 * MINUTE_MS;
+
+// One row in this many is malformed, cycling through the kinds of damage
+const int BAD_ROW_EVERY = 10007;
+
+// Simulated days replayed through the engine
+const double REPLAY_DAYS = 30.0;
+
+// Calendar date of a day number since 1970-01-01
+void civilFromDays(qint64 z, int &y, int &m, int &d)
+{
+    z += 719468;
+    qint64 era = (z >= 0 ? z : z - 146096) / 146097;
+    qint64 doe = z - era * 146097;
+    qint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    qint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    qint64 mp = (5 * doy + 2) / 153;
+    d = int(doy - (153 * mp + 2) / 5 + 1);
+    m = int(mp < 10 ? mp + 3 : mp - 9);
+    y = int(yoe + era * 400 + (m <= 2));
+}
+
+// Glucose for the n-th reading: a daily swing plus a slow drift
+double traceGlucose(qint64 n)
+{
+    return 7.0 + 2.5 * std::sin(n * 0.0218) + 1.0 * std::sin(n * 0.0031);
+}
+
+// A pump export of the given size: a CGM reading every 5 min with
+// dated times, boluses and carbs at meals, basal changes and a few
+// damaged rows. Returns the rows written and the damaged ones.
+bool writeTrace(const QString &path, qint64 bytes, qint64 &rows, qint64 &badRows)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray chunk;
+    chunk.reserve(1 << 20);
+    chunk.append("time,type,value\n");
+    rows = 0;
+    badRows = 0;
+    qint64 written = 0;
+    char line[96];
+
+    for (qint64 n = 0; written + chunk.size() < bytes; ++n) {
+        qint64 t = n * 5 * MINUTE_MS;
+        int y, mo, d;
+        civilFromDays(t / DAY_MS, y, mo, d);
+        qint64 minuteOfDay = (t % DAY_MS) / MINUTE_MS;
+        char when[32];
+        std::snprintf(when, sizeof(when), "%04d-%02d-%02d %02d:%02d:00",
+                      y, mo, d, int(minuteOfDay / 60), int(minuteOfDay % 60));
+
+        std::snprintf(line, sizeof(line), "%s,cgm,%.1f\n", when, traceGlucose(n));
+        chunk.append(line);
+        ++rows;
+        if (minuteOfDay == 7 * 60 || minuteOfDay == 12 * 60 + 30 || minuteOfDay == 18 * 60 + 30) {
+            std::snprintf(line, sizeof(line), "%s,carbs,50\n%s,bolus,4.5\n", when, when);
+            chunk.append(line);
+            rows += 2;
+        }
+        if (minuteOfDay % 240 == 0) {
+            std::snprintf(line, sizeof(line), "%s,basal,%.2f\n", when, 0.6 + 0.1 * (minuteOfDay / 240));
+            chunk.append(line);
+            ++rows;
+        }
+        if (n % BAD_ROW_EVERY == BAD_ROW_EVERY - 1) {
+            const char *damage[] = {"yesterday,cgm,5.0\n", "%s,ketones,0.4\n", "%s,cgm,HIGH\n"};
+            std::snprintf(line, sizeof(line), damage[badRows % 3], when);
+            chunk.append(line);
+            ++badRows;
+        }
+
+        if (chunk.size() >= (1 << 20) - 128) {
+            written += file.write(chunk);
+            chunk.clear();
+        }
+    }
+    written += file.write(chunk);
+    return written > 0;
+}
+
+}
+
+int runReplayBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    double megabytes = args.size() > 0 ? args.at(0).toDouble() : 200.0;
+    if (megabytes <= 0.0) {
+        out << "replay: size must be positive\n";
+        return 1;
+    }
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        out << "replay: cannot create a temporary directory\n";
+        return 1;
+    }
+
+    QString path = dir.path() + "/trace.csv";
+    qint64 rows = 0;
+    qint64 badRows = 0;
+    QElapsedTimer timer;
+    timer.start();
+    if (!writeTrace(path, qint64(megabytes * 1e6), rows, badRows)) {
+        out << "replay: cannot write " << path << "\n";
+        return 1;
+    }
+    out << QString("Wrote %1 rows (%2 damaged) in %3 s\n")
+           .arg(rows).arg(badRows).arg(timer.nsecsElapsed() / 1e9, 0, 'f', 1);
+
+    // Parse the whole file
+    TraceReplay trace;
+    if (!trace.open(path)) {
+        out << "replay: cannot open the trace: " << trace.errorString() << "\n";
+        return 1;
+    }
+    TraceScan scan = trace.scan();
+    out << QString("Parsed %1 MB:               %2 MB/s, %3 rows, %4 skipped\n")
+           .arg(trace.fileSize() / 1e6, 0, 'f', 1).arg(scan.megabytesPerSecond, 0, 'f', 0)
+           .arg(scan.records).arg(scan.errors);
+    bool counted = scan.records == rows && scan.errors == badRows;
+
+    // Replay the start of it through the engine, which must show the
+    // recorded readings exactly
+    SimulationEngine engine;
+    engine.setLoggingEnabled(false);
+    engine.setAutoService(true);
+    engine.cgm()->setRetentionHours(int(REPLAY_DAYS) * 24);
+    engine.insulinPump()->startBasalDelivery();
+    trace.setTimeShiftMs(engine.currentSimulatedMsecs() - trace.firstTimestampMs());
+    engine.setTraceReplay(&trace);
+    timer.start();
+    engine.runEventsFor(REPLAY_DAYS * 1440.0);
+    double replayMs = timer.nsecsElapsed() / 1e6;
+
+    GlucoseReadingView view = engine.cgm()->getReadings(int(REPLAY_DAYS) * 24);
+    qint64 mismatches = 0;
+    for (int i = 0; i < view.size(); ++i) {
+        qint64 n = (view.timeAt(i) - view.timeAt(0)) / (5 * MINUTE_MS);
+        char text[16];
+        std::snprintf(text, sizeof(text), "%.1f", traceGlucose(n));
+        mismatches += (view.valueAt(i) != float(std::strtod(text, nullptr)));
+    }
+    out << QString("Replayed %1 days:            %2 ms, %3 readings, %4 mismatched\n")
+           .arg(REPLAY_DAYS).arg(replayMs, 0, 'f', 1).arg(view.size()).arg(mismatches);
+
+    bool ok = counted && mismatches == 0 && view.size() > 0;
+    out << (ok ? "Results ok\n" : "Results MISMATCH\n");
+    return ok ? 0 : 1;
+}
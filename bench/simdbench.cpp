@@ -0,0 +1,124 @@
+// simdbench.cpp
+#include "benchmarks.h"
+#include "batchpatient.h"
+#include "cohortrunner.h"
+#include "patientbatch.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Final glucose of every patient, one BatchPatient at a time
+template <class Model>
+std::vector<double> runReference(const QVector<VirtualPatient> &cohort, const ProfileData &therapy,
+                                 qint64 ticks, double &seconds)
+{
+    std::vector<double> glucose(cohort.size());
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < cohort.size(); ++i) {
+        BatchPatient<Model> patient(therapy, cohort[i].baseGlucose,
+                                    cohort[i].insulinSensitivity, cohort[i].seed);
+        patient.setMealPattern(cohort[i].meals);
+        for (qint64 t = 0; t < ticks; ++t) {
+            patient.tick();
+        }
+        glucose[i] = patient.glucose();
+    }
+    seconds = timer.nsecsElapsed() / 1e9;
+    return glucose;
+}
+
+// Final glucose of every patient, all patients in one PatientBatch
+template <class Model>
+std::vector<double> runBatched(const QVector<VirtualPatient> &cohort, const ProfileData &therapy,
+                               qint64 ticks, SimdLevel level, double &seconds)
+{
+    PatientBatch<Model> batch(therapy, cohort);
+    batch.setSimdLevel(level);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 t = 0; t < ticks; ++t) {
+        batch.tick();
+    }
+    seconds = timer.nsecsElapsed() / 1e9;
+
+    std::vector<double> glucose(cohort.size());
+    for (int i = 0; i < cohort.size(); ++i) {
+        glucose[i] = batch.glucose(i);
+    }
+    return glucose;
+}
+
+template <class Model>
+int compareSimdLevels(const QVector<VirtualPatient> &cohort, qint64 ticks, QTextStream &out)
+{
+    ProfileData therapy = CohortRunner().therapy();
+    double steps = double(ticks) * cohort.size();
+
+    double refSeconds = 0.0;
+    std::vector<double> reference = runReference<Model>(cohort, therapy, ticks, refSeconds);
+
+    out << "path              seconds   patient-steps/s  speedup   max |diff|\n";
+    out << QString("%1  %2  %3  %4\n")
+           .arg("BatchPatient", -14)
+           .arg(refSeconds, 9, 'f', 3)
+           .arg(refSeconds > 0.0 ? steps / refSeconds : 0.0, 16, 'e', 3)
+           .arg(1.0, 7, 'f', 2);
+    out.flush();
+
+    bool ok = true;
+    for (int level = ScalarSimd; level <= bestSimdLevel(); ++level) {
+        double seconds = 0.0;
+        std::vector<double> glucose = runBatched<Model>(cohort, therapy, ticks,
+                                                        SimdLevel(level), seconds);
+        double maxDiff = 0.0;
+        for (size_t i = 0; i < glucose.size(); ++i) {
+            maxDiff = qMax(maxDiff, std::fabs(glucose[i] - reference[i]));
+        }
+        ok = ok && maxDiff <= PATIENT_BATCH_TOLERANCE;
+
+        out << QString("%1  %2  %3  %4  %5\n")
+               .arg("batch " + simdLevelName(SimdLevel(level)), -14)
+               .arg(seconds, 9, 'f', 3)
+               .arg(seconds > 0.0 ? steps / seconds : 0.0, 16, 'e', 3)
+               .arg(seconds > 0.0 ? refSeconds / seconds : 0.0, 7, 'f', 2)
+               .arg(maxDiff, 11, 'e', 2);
+        out.flush();
+    }
+
+    out << QString("Tolerance %1 mmol/L: %2\n")
+           .arg(PATIENT_BATCH_TOLERANCE, 0, 'e', 0).arg(ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+}
+
+int runSimdBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    int patients = args.size() > 0 ? args.at(0).toInt() : 1024;
+    double days = args.size() > 1 ? args.at(1).toDouble() : 7.0;
+    GlucoseModelType model = (args.size() > 2 && args.at(2) == "bergman")
+                             ? BergmanGlucoseModel : RandomWalkGlucoseModel;
+    if (patients <= 0 || days <= 0.0) {
+        out << "simd: patients and days must be positive\n";
+        return 1;
+    }
+
+    QVector<VirtualPatient> cohort = CohortRunner::generateCohort(patients, 42);
+    qint64 ticks = static_cast<qint64>(days * 24 * 60 / SIMULATION_SPEED);
+
+    out << QString("Batched stepping: %1 patients x %2 days, %3, single thread, best %4\n")
+           .arg(patients).arg(days).arg(GlucoseModel::name(model))
+           .arg(simdLevelName(bestSimdLevel()));
+
+    if (model == BergmanGlucoseModel) {
+        return compareSimdLevels<BergmanMinimalModel>(cohort, ticks, out);
+    }
+    return compareSimdLevels<RandomWalkModel>(cohort, ticks, out);
+}
@@ -0,0 +1,109 @@
+// snapshotbench.cpp
+#include "benchmarks.h"
+#include "cohortrunner.h"
+#include "simulationengine.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Timed repetitions of save and restore
+const int REPEATS = 200;
+
+// One patient on the default cohort therapy with three meals a day and
+// a full CGM history for the run
+void setUpScenario(SimulationEngine &engine, double days)
+{
+    ProfileData therapy = CohortRunner().therapy();
+    engine.profileManager()->createProfile("Bench", therapy.basalRate, therapy.carbRatio,
+                                           therapy.correctionFactor, therapy.targetBG);
+    engine.setCurrentProfile(therapy);
+    engine.insulinPump()->setActiveProfile(therapy);
+    engine.insulinPump()->startBasalDelivery();
+
+    engine.cgm()->setGlucoseModel(BergmanGlucoseModel);
+    engine.cgm()->setNoiseSeed(42);
+    engine.cgm()->setRetentionHours(static_cast<int>(std::ceil(days)) * 24);
+
+    QVector<MealEvent> meals;
+    meals.append(MealEvent{420, 45.0});
+    meals.append(MealEvent{750, 60.0});
+    meals.append(MealEvent{1110, 55.0});
+    engine.setMealPattern(meals);
+
+    engine.setAutoService(true);
+    engine.setLoggingEnabled(false);
+}
+
+double median(std::vector<double> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+}
+
+int runSnapshotBenchmark(const QStringList &args)
+{
+    QTextStream out(stdout);
+
+    double days = args.size() > 0 ? args.at(0).toDouble() : 30.0;
+    if (days <= 0.0 || days > MAX_RETENTION_HOURS / 24) {
+        out << "snapshot: days must be between 0 and " << MAX_RETENTION_HOURS / 24 << "\n";
+        return 1;
+    }
+
+    // Warm-up that a snapshot saves re-running
+    SimulationEngine warm;
+    setUpScenario(warm, days);
+    QElapsedTimer timer;
+    timer.start();
+    warm.runEventsFor(days * 1440.0);
+    double warmUpMs = timer.nsecsElapsed() / 1e6;
+    out << QString("Warm-up of %1 days:        %2 ms\n").arg(days).arg(warmUpMs, 0, 'f', 1);
+
+    QByteArray snapshot;
+    std::vector<double> saveUs;
+    for (int i = 0; i < REPEATS; ++i) {
+        timer.start();
+        snapshot = warm.saveSnapshot();
+        saveUs.push_back(timer.nsecsElapsed() / 1e3);
+    }
+
+    SimulationEngine resumed;
+    setUpScenario(resumed, days);
+    std::vector<double> restoreUs;
+    bool restored = true;
+    for (int i = 0; i < REPEATS; ++i) {
+        timer.start();
+        restored = resumed.restoreSnapshot(snapshot) && restored;
+        restoreUs.push_back(timer.nsecsElapsed() / 1e3);
+    }
+
+    out << QString("Snapshot size:             %1 KiB\n").arg(snapshot.size() / 1024.0, 0, 'f', 1);
+    out << QString("Save:                      median %1 us\n").arg(median(saveUs), 0, 'f', 1);
+    out << QString("Restore:                   median %1 us\n").arg(median(restoreUs), 0, 'f', 1);
+
+    // Both copies must go on identically
+    bool same = restored;
+    for (int i = 0; i < 288 && same; ++i) {
+        warm.runEventsFor(NOMINAL_READING_MINUTES);
+        resumed.runEventsFor(NOMINAL_READING_MINUTES);
+        same = warm.cgm()->currentGlucose() == resumed.cgm()->currentGlucose()
+               && warm.insulinPump()->insulinUnitsRemaining()
+                  == resumed.insulinPump()->insulinUnitsRemaining();
+    }
+    same = same && warm.saveSnapshot() == resumed.saveSnapshot();
+
+    // A damaged snapshot is refused and changes nothing
+    QByteArray damaged = snapshot.left(snapshot.size() / 2);
+    QByteArray before = resumed.saveSnapshot();
+    bool refused = !resumed.restoreSnapshot(damaged) && resumed.saveSnapshot() == before;
+
+    out << QString("Resumed run matches:       %1\n").arg(same ? "yes" : "NO");
+    out << QString("Damaged snapshot refused:  %1\n").arg(refused ? "yes" : "NO");
+    return (same && refused) ? 0 : 1;
+}
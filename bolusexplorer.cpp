@@ -0,0 +1,112 @@
+// bolusexplorer.cpp
+#include "bolusexplorer.h"
+#include <QElapsedTimer>
+
+BolusExplorer::BolusExplorer(int threads)
+    : m_pool(threads),
+      m_horizonHours(MAX_EXPLORER_HOURS),
+      m_lastRunMs(0.0)
+{
+    // Forks are built once and reused; restoring a snapshot into an engine
+    // is far cheaper than constructing one
+    for (int i = 0; i < m_pool.threadCount(); ++i) {
+        m_forks.emplace_back(new SimulationEngine);
+        // Forks run on pool threads and nobody listens to them; blocking
+        // their signals keeps alerts from being queued back to this thread
+        m_forks.back()->blockSignals(true);
+        m_forks.back()->cgm()->blockSignals(true);
+    }
+}
+
+BolusExplorer::~BolusExplorer() = default;
+
+void BolusExplorer::setHorizonHours(double hours)
+{
+    m_horizonHours = qBound(MIN_EXPLORER_HOURS, hours, MAX_EXPLORER_HOURS);
+}
+
+double BolusExplorer::horizonHours() const
+{
+    return m_horizonHours;
+}
+
+QVector<BolusCandidate> BolusExplorer::defaultCandidates()
+{
+    QVector<BolusCandidate> candidates;
+    for (int percent = 0; percent < 100; percent += 20) {
+        for (int hours = 1; hours <= 6; ++hours) {
+            candidates.append(BolusCandidate{percent, double(hours)});
+        }
+    }
+    candidates.append(BolusCandidate{100, 0.0});
+    return candidates;
+}
+
+QVector<BolusOutcome> BolusExplorer::explore(const SimulationEngine &engine, double totalUnits,
+                                             double carbs, const QVector<BolusCandidate> &candidates)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Taken once; every fork reads the same bytes
+    const QByteArray snapshot = engine.saveSnapshot();
+    const double tickMinutes = engine.tickMinutes();
+
+    QVector<BolusOutcome> outcomes(candidates.size());
+    for (int i = 0; i < candidates.size(); ++i) {
+        outcomes[i].candidate = candidates.at(i);
+    }
+
+    m_pool.run(outcomes.size(), [&](int index, int worker) {
+        forecast(*m_forks[worker], snapshot, tickMinutes, totalUnits, carbs, outcomes[index]);
+    });
+
+    m_lastRunMs = timer.nsecsElapsed() / 1e6;
+    return outcomes;
+}
+
+double BolusExplorer::lastRunMs() const
+{
+    return m_lastRunMs;
+}
+
+void BolusExplorer::forecast(SimulationEngine &fork, const QByteArray &snapshot, double tickMinutes,
+                             double totalUnits, double carbs, BolusOutcome &outcome) const
+{
+    // No extended time means it all goes now
+    int percent = outcome.candidate.extendedHours > 0.0
+                  ? qBound(0, outcome.candidate.immediatePercent, 100) : 100;
+    outcome.immediateUnits = totalUnits * percent / 100.0;
+    outcome.extendedUnits = totalUnits - outcome.immediateUnits;
+
+    if (!fork.restoreSnapshot(snapshot)) {
+        return;
+    }
+    fork.setLoggingEnabled(false);
+    fork.setTickMinutes(tickMinutes);
+
+    if (carbs > 0.0) {
+        fork.cgm()->registerCarbEffect(carbs);
+    }
+    if (outcome.immediateUnits > 0.0) {
+        fork.insulinPump()->deliverBolus(outcome.immediateUnits);
+    }
+    if (outcome.extendedUnits > 0.0) {
+        fork.scheduleExtendedBolus(outcome.extendedUnits, outcome.candidate.extendedHours);
+    }
+
+    int readings = qRound(m_horizonHours * 60.0 / NOMINAL_READING_MINUTES);
+    outcome.glucose.reserve(readings);
+    outcome.stats.patients = 1;
+    // Stepped with tick(), as SimulationWorker steps the live engine
+    double start = fork.elapsedSimulatedMinutes();
+    for (int i = 0; i < readings; ++i) {
+        double readingAt = start + (i + 1) * NOMINAL_READING_MINUTES;
+        while (fork.elapsedSimulatedMinutes() < readingAt - 1e-9) {
+            fork.tick();
+        }
+        double glucose = fork.cgm()->currentGlucose();
+        outcome.glucose.append(float(glucose));
+        outcome.stats.add(glucose);
+    }
+}
@@ -0,0 +1,71 @@
+// bolusexplorer.h
+#ifndef BOLUSEXPLORER_H
+#define BOLUSEXPLORER_H
+
+#include <QVector>
+#include <memory>
+#include <vector>
+#include "cohortrunner.h"
+#include "simulationengine.h"
+#include "workstealingpool.h"
+
+// How a bolus is split between now and an extended tail
+struct BolusCandidate {
+    int    immediatePercent;     // Share delivered now, 0-100
+    double extendedHours;        // Spread of the rest
+};
+
+// Forecast for one candidate
+struct BolusOutcome {
+    BolusCandidate candidate;
+    double immediateUnits;
+    double extendedUnits;
+    QVector<float> glucose;      // One reading per 5 min, starting 5 min from now
+    CohortStats stats;           // Time in range, mean, min and max over the horizon
+};
+
+// Hours a forecast looks ahead
+const double MIN_EXPLORER_HOURS = 4.0;
+const double MAX_EXPLORER_HOURS = 6.0;
+
+// What-if explorer for a manual bolus. The live engine is captured once as
+// a snapshot; the byte array is shared, never copied, by every worker, and
+// each worker restores it into an engine of its own, delivers one candidate
+// split and ticks it over the horizon at the live tick length. The forks
+// carry the live CGM noise stream, Control-IQ memory and pending meals, so
+// the forecast is what the live run would do with that bolus. Snapshots do
+// not include a trace replay, so while one drives the live engine the forks
+// follow the glucose model instead; the caller should not explore then.
+class BolusExplorer
+{
+public:
+    // threads <= 0 uses all cores
+    explicit BolusExplorer(int threads = 0);
+    ~BolusExplorer();
+
+    void setHorizonHours(double hours);     // Clamped to 4-6 h
+    double horizonHours() const;
+
+    // Every split from 0 to 100% immediate in 20% steps, each extended over
+    // 1 to 6 hours (all-immediate only once)
+    static QVector<BolusCandidate> defaultCandidates();
+
+    // Forecast each candidate for a bolus of totalUnits taken with carbs
+    // grams, from the engine's current state. The engine is not changed.
+    QVector<BolusOutcome> explore(const SimulationEngine &engine, double totalUnits, double carbs,
+                                  const QVector<BolusCandidate> &candidates);
+
+    // Wall time of the last explore()
+    double lastRunMs() const;
+
+private:
+    void forecast(SimulationEngine &fork, const QByteArray &snapshot, double tickMinutes,
+                  double totalUnits, double carbs, BolusOutcome &outcome) const;
+
+    WorkStealingPool m_pool;
+    std::vector<std::unique_ptr<SimulationEngine>> m_forks;   // One per worker
+    double m_horizonHours;
+    double m_lastRunMs;
+};
+
+#endif // BOLUSEXPLORER_H
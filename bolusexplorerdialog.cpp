@@ -0,0 +1,181 @@
+// bolusexplorerdialog.cpp
+#include "bolusexplorerdialog.h"
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include <QtCharts/QValueAxis>
+#include <algorithm>
+
+namespace {
+
+const QColor OTHER_COLOR(190, 190, 190);
+const QColor SELECTED_COLOR(0, 90, 200);
+
+// Better time in range first; ties go to the higher low
+bool betterOutcome(const BolusOutcome &a, const BolusOutcome &b)
+{
+    if (a.stats.timeInRange() != b.stats.timeInRange()) {
+        return a.stats.timeInRange() > b.stats.timeInRange();
+    }
+    return a.stats.minGlucose > b.stats.minGlucose;
+}
+
+// Forecast readings against hours from now
+QVector<QPointF> tracePoints(const BolusOutcome &outcome)
+{
+    QVector<QPointF> points;
+    points.reserve(outcome.glucose.size());
+    for (int i = 0; i < outcome.glucose.size(); ++i) {
+        points.append(QPointF((i + 1) * NOMINAL_READING_MINUTES / 60.0, outcome.glucose.at(i)));
+    }
+    return points;
+}
+
+QTableWidgetItem *numberItem(double value, int decimals)
+{
+    QTableWidgetItem *item = new QTableWidgetItem(QString::number(value, 'f', decimals));
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+}
+
+BolusExplorerDialog::BolusExplorerDialog(const QVector<BolusOutcome> &outcomes, double totalUnits,
+                                         double carbs, double runMs, QWidget *parent)
+    : QDialog(parent),
+      m_outcomes(outcomes),
+      m_table(new QTableWidget(this)),
+      m_view(new QChartView(this)),
+      m_highlight(nullptr),
+      m_selected(-1)
+{
+    setWindowTitle("Bolus Options");
+    std::stable_sort(m_outcomes.begin(), m_outcomes.end(), betterOutcome);
+
+    int readings = m_outcomes.isEmpty() ? 0 : m_outcomes.first().glucose.size();
+    double hours = readings * NOMINAL_READING_MINUTES / 60.0;
+
+    QLabel *summary = new QLabel(
+        QString("%1 U for %2 g carbs. Forecast of %3 splits over the next %4 h (%5 ms).")
+            .arg(totalUnits, 0, 'f', 2).arg(carbs).arg(m_outcomes.size())
+            .arg(hours).arg(runMs, 0, 'f', 0), this);
+
+    buildChart(hours);
+    fillTable();
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    buttons->button(QDialogButtonBox::Ok)->setText("Deliver");
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(summary);
+    layout->addWidget(m_view, 3);
+    layout->addWidget(m_table, 2);
+    layout->addWidget(buttons);
+    resize(800, 700);
+
+    connect(m_table, &QTableWidget::itemSelectionChanged, this, &BolusExplorerDialog::onSelectionChanged);
+    if (!m_outcomes.isEmpty()) {
+        m_table->selectRow(0);
+    }
+    buttons->button(QDialogButtonBox::Ok)->setEnabled(!m_outcomes.isEmpty());
+}
+
+BolusCandidate BolusExplorerDialog::selectedCandidate() const
+{
+    return m_selected >= 0 ? m_outcomes.at(m_selected).candidate : BolusCandidate{100, 0.0};
+}
+
+void BolusExplorerDialog::onSelectionChanged()
+{
+    QList<QTableWidgetItem *> items = m_table->selectedItems();
+    if (items.isEmpty()) {
+        return;
+    }
+    int row = items.first()->row();
+    m_selected = row;
+    m_highlight->replace(tracePoints(m_outcomes.at(row)));
+}
+
+void BolusExplorerDialog::fillTable()
+{
+    const QStringList headers = {"Now %", "Extended (h)", "Now (U)", "Extended (U)",
+                                 "In range %", "Min", "Max"};
+    m_table->setColumnCount(headers.size());
+    m_table->setHorizontalHeaderLabels(headers);
+    m_table->setRowCount(m_outcomes.size());
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->verticalHeader()->hide();
+
+    for (int row = 0; row < m_outcomes.size(); ++row) {
+        const BolusOutcome &o = m_outcomes.at(row);
+        bool extended = o.extendedUnits > 0.0;
+        m_table->setItem(row, 0, numberItem(extended ? o.candidate.immediatePercent : 100, 0));
+        m_table->setItem(row, 1, extended ? numberItem(o.candidate.extendedHours, 0)
+                                          : new QTableWidgetItem("-"));
+        m_table->setItem(row, 2, numberItem(o.immediateUnits, 2));
+        m_table->setItem(row, 3, numberItem(o.extendedUnits, 2));
+        m_table->setItem(row, 4, numberItem(o.stats.timeInRange(), 0));
+        m_table->setItem(row, 5, numberItem(o.stats.minGlucose, 1));
+        m_table->setItem(row, 6, numberItem(o.stats.maxGlucose, 1));
+    }
+}
+
+void BolusExplorerDialog::buildChart(double hours)
+{
+    QChart *chart = new QChart();
+    chart->legend()->hide();
+
+    QValueAxis *axisX = new QValueAxis();
+    axisX->setRange(0.0, hours);
+    axisX->setTickCount(int(hours) + 1);
+    axisX->setLabelFormat("%.0f");
+    axisX->setTitleText("Hours from now");
+    chart->addAxis(axisX, Qt::AlignBottom);
+
+    double maxShown = HIGH_GLUCOSE_THRESHOLD;
+    for (const BolusOutcome &o : m_outcomes) {
+        maxShown = qMax(maxShown, o.stats.maxGlucose);
+    }
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setRange(0.0, maxShown + 1.0);
+    axisY->setLabelFormat("%.1f");
+    axisY->setTitleText("Glucose (mmol/L)");
+    chart->addAxis(axisY, Qt::AlignLeft);
+
+    // Target range edges
+    for (double level : {LOW_GLUCOSE_THRESHOLD, HIGH_GLUCOSE_THRESHOLD}) {
+        QLineSeries *edge = new QLineSeries();
+        edge->append(0.0, level);
+        edge->append(hours, level);
+        edge->setPen(QPen(QColor(60, 160, 60), 1, Qt::DashLine));
+        chart->addSeries(edge);
+        edge->attachAxis(axisX);
+        edge->attachAxis(axisY);
+    }
+
+    for (const BolusOutcome &o : m_outcomes) {
+        QLineSeries *series = new QLineSeries();
+        series->replace(tracePoints(o));
+        series->setPen(QPen(OTHER_COLOR, 1));
+        chart->addSeries(series);
+        series->attachAxis(axisX);
+        series->attachAxis(axisY);
+    }
+
+    // Added last so the selected trace is drawn over the others
+    m_highlight = new QLineSeries();
+    m_highlight->setPen(QPen(SELECTED_COLOR, 3));
+    chart->addSeries(m_highlight);
+    m_highlight->attachAxis(axisX);
+    m_highlight->attachAxis(axisY);
+
+    m_view->setChart(chart);
+    m_view->setRenderHint(QPainter::Antialiasing);
+}
@@ -0,0 +1,43 @@
+// bolusexplorerdialog.h
+#ifndef BOLUSEXPLORERDIALOG_H
+#define BOLUSEXPLORERDIALOG_H
+
+#include <QDialog>
+#include <QVector>
+#include <QtCharts/QChartView>
+#include <QtCharts/QLineSeries>
+#include "bolusexplorer.h"
+
+QT_CHARTS_USE_NAMESPACE
+
+class QLabel;
+class QTableWidget;
+
+// Shows the forecast of every bolus split side by side before one is
+// delivered: predicted glucose traces on a chart and time in range per
+// candidate in a table, best first. Picking a row highlights its trace.
+class BolusExplorerDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    BolusExplorerDialog(const QVector<BolusOutcome> &outcomes, double totalUnits, double carbs,
+                        double runMs, QWidget *parent = nullptr);
+
+    // Candidate picked when the dialog was accepted
+    BolusCandidate selectedCandidate() const;
+
+private slots:
+    void onSelectionChanged();
+
+private:
+    void fillTable();
+    void buildChart(double hours);
+
+    QVector<BolusOutcome> m_outcomes;    // Best time in range first
+    QTableWidget *m_table;
+    QChartView   *m_view;
+    QLineSeries  *m_highlight;           // Copy of the selected trace, drawn on top
+    int m_selected;
+};
+
+#endif // BOLUSEXPLORERDIALOG_H
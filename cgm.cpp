@@ -1,17 +1,26 @@
 // cgm.cpp
 #include "cgm.h"
+#include "glycemicmetrics.h"
+#include <cmath>
+#include <utility>
 
 CGM::CGM(QObject *parent)
     : QObject(parent),
+      m_readings(MIN_RETENTION_HOURS),
+      m_metrics(new GlycemicMetrics),
       m_baseGlucose(DEFAULT_BASE_GLUCOSE),
-      m_pendingInsulinEffect(0.0),
-      m_pendingCarbEffect(0.0)
+      m_basalInsulin(DEFAULT_INSULIN_PEAK, DEFAULT_INSULIN_DURATION),
+      m_bolusInsulin(DEFAULT_INSULIN_PEAK, DEFAULT_INSULIN_DURATION),
+      m_carbs(DEFAULT_CARB_PEAK, DEFAULT_CARB_DURATION),
+      m_model(GlucoseModel::create(RandomWalkGlucoseModel)),
+      m_noise(QRandomGenerator::global()->generate64())
+{
+    m_mealCarbs.reserve(MAX_MEAL_CARB_CURVES);
+    m_model->reset(m_baseGlucose, modelInputs());
+}
+
+CGM::~CGM()
 {
-    // Initialize with a starting reading
-    GlucoseReading initialReading;
-    initialReading.timestamp = QDateTime::currentDateTime();
-    initialReading.value = m_baseGlucose;
-    m_readings.append(initialReading);
 }
 
 double CGM::currentGlucose() const
@@ -29,81 +38,141 @@ double CGM::glucoseTrend() const
     }
 
     // Calculate the difference between last two readings
-    return m_readings.last().value - m_readings[m_readings.size() - 2].value;
+    return m_readings.last().value - m_readings.at(m_readings.size() - 2).value;
 }
 
 void CGM::generateReading(const QDateTime &simulatedTime)
 {
-    GlucoseReading newReading;
-    newReading.timestamp = simulatedTime;
-    newReading.value = calculateNextGlucose();
-
-    if (isValidReading(newReading.value)) {
-        m_readings.append(newReading);
+    generateReading(simulatedTime.toMSecsSinceEpoch());
+}
 
-        if (newReading.value <= LOW_GLUCOSE_THRESHOLD) {
-            emit criticalLowGlucose(newReading.value);
-        } else if (newReading.value >= HIGH_GLUCOSE_THRESHOLD) {
-            emit criticalHighGlucose(newReading.value);
-        }
+void CGM::generateReading(qint64 simulatedMsecs)
+{
+    double minutes = minutesSinceLastStep(simulatedMsecs);
+    double value = calculateNextGlucose(minutes);
 
-        m_pendingInsulinEffect *= 0.95;
-        m_pendingCarbEffect *= 0.9;
+    if (!isValidReading(value)) {
+        // Hold the model at the last valid reading, as the sensor does
+        m_model->setGlucose(currentGlucose());
+    } else {
+        appendReading(simulatedMsecs, value);
     }
+}
 
-    if (m_readings.size() > 288) {
-        m_readings.removeFirst();
+void CGM::skipReading(qint64 simulatedMsecs)
+{
+    double value = calculateNextGlucose(minutesSinceLastStep(simulatedMsecs));
+    if (!isValidReading(value)) {
+        m_model->setGlucose(currentGlucose());
     }
 }
 
-QVector<GlucoseReading> CGM::getReadings(int hours) const
+bool CGM::addRecordedReading(qint64 timestampMs, double value)
 {
-    // Return readings for the specified number of hours (12 per hour at 5 min intervals)
-    int count = std::min(hours * 12, m_readings.size());
-    if (count <= 0) {
-        return QVector<GlucoseReading>();
+    if (!isValidReading(value)
+        || (!m_readings.isEmpty() && timestampMs < m_readings.last().timestampMs)) {
+        return false;
     }
-
-    return m_readings.mid(m_readings.size() - count);
+    stepModel(minutesSinceLastStep(timestampMs));
+    m_model->setGlucose(value);
+    appendReading(timestampMs, value);
+    return true;
 }
 
-/*
-double CGM::predictGlucose(int minutesInFuture) const
+void CGM::appendReading(qint64 timestampMs, double value)
 {
-    // Simple linear prediction based on recent trend
-    if (m_readings.size() < 2) {
-        return currentGlucose();
-    }
+    m_readings.append(timestampMs, float(value));
+    m_metrics->addReading(timestampMs, value);
+    emit readingAdded(timestampMs, value);
 
-    // Calculate average change per minute over last few readings
-    double avgChangePerMinute = 0.0;
-    int numReadings = std::min(3, m_readings.size() - 1);
+    if (value <= LOW_GLUCOSE_THRESHOLD) {
+        emit criticalLowGlucose(value);
+    } else if (value >= HIGH_GLUCOSE_THRESHOLD) {
+        emit criticalHighGlucose(value);
+    }
+}
 
-    for (int i = 0; i < numReadings; i++) {
-        double diff = m_readings[m_readings.size() - 1 - i].value -
-                      m_readings[m_readings.size() - 2 - i].value;
+GlucoseReadingView CGM::getReadings(int hours) const
+{
+    // Return readings for the specified number of hours (12 per hour at 5 min intervals)
+    return m_readings.readings(hours);
+}
 
-        // Assuming readings are 5 minutes apart
-        avgChangePerMinute += diff / 5.0;
-    }
+GlucoseStore::AggregateView CGM::getAggregates(GlucoseStore::Tier tier, int hours) const
+{
+    return m_readings.aggregates(tier, hours);
+}
 
-    avgChangePerMinute /= numReadings;
+const GlucoseStore &CGM::store() const
+{
+    return m_readings;
+}
 
-    // Predict future glucose by extrapolating the trend
-    double futureBG = currentGlucose() + (avgChangePerMinute * minutesInFuture);
+const GlycemicMetrics &CGM::metrics() const
+{
+    return *m_metrics;
+}
 
-    // Account for pending insulin and carb effects
-    futureBG -= m_pendingInsulinEffect * (minutesInFuture / 30.0);
-    futureBG += m_pendingCarbEffect * (minutesInFuture / 30.0);
+void CGM::setRetentionHours(int hours)
+{
+    m_readings.setRetentionHours(qBound(MIN_RETENTION_HOURS, hours, MAX_RETENTION_HOURS));
+}
 
-    return std::max(0.0, futureBG);
+int CGM::retentionHours() const
+{
+    return m_readings.retentionHours();
 }
-*/
 
 void CGM::setBaseGlucose(double baseLevel)
 {
     if (baseLevel > 0.0 && baseLevel < MAX_VALID_GLUCOSE) {
         m_baseGlucose = baseLevel;
+        if (m_readings.isEmpty()) {
+            m_model->reset(m_baseGlucose, modelInputs());
+        }
+    }
+}
+
+void CGM::setGlucoseModel(GlucoseModelType type)
+{
+    if (type == m_model->type()) {
+        return;
+    }
+    double step = m_model->stepMinutes();
+    m_model.reset(GlucoseModel::create(type));
+    m_model->setStepMinutes(step);
+    m_model->reset(currentGlucose(), modelInputs());
+}
+
+GlucoseModelType CGM::glucoseModelType() const
+{
+    return m_model->type();
+}
+
+void CGM::setModelStepMinutes(double minutes)
+{
+    m_model->setStepMinutes(minutes);
+}
+
+double CGM::modelStepMinutes() const
+{
+    return m_model->stepMinutes();
+}
+
+void CGM::setNoiseSeed(quint64 seed)
+{
+    m_noise.setSeed(seed);
+}
+
+quint64 CGM::noiseSeed() const
+{
+    return m_noise.seed();
+}
+
+void CGM::setInsulinSensitivity(double sensitivity)
+{
+    if (sensitivity > 0.0) {
+        m_insulinSensitivity = sensitivity;
     }
 }
 
@@ -111,36 +180,119 @@ void CGM::registerInsulinEffect(double units)
 {
     // Each unit of insulin will lower BG by approximately 1-3 mmol/L or 18-54 mg/dL
     // Effect peaks at around 60-90 minutes and lasts ~3-5 hours
-    m_pendingInsulinEffect += units * 1.0; // Simple approximation
+    m_basalInsulin.add(units);
+}
+
+void CGM::registerBolusEffect(double units)
+{
+    m_bolusInsulin.add(units);
 }
 
 void CGM::registerCarbEffect(double grams)
 {
     // Carbohydrates raise blood glucose
     // Effect typically starts within 15 minutes and peaks at 45-60 minutes
-    m_pendingCarbEffect += grams * 0.05; // Simple approximation
+    m_carbs.add(grams);
 }
 
-double CGM::calculateNextGlucose() const
+void CGM::registerCarbEffect(double grams, double peakMinutes, double durationMinutes)
 {
-    // Start with the current glucose level
-    double nextValue = currentGlucose();
+    AbsorptionModel *nearest = nullptr;
+    AbsorptionModel *idle = nullptr;
+    for (AbsorptionModel &curve : m_mealCarbs) {
+        if (curve.peakMinutes() == peakMinutes && curve.durationMinutes() == durationMinutes) {
+            curve.add(grams);
+            return;
+        }
+        if (!idle && curve.remaining() == 0.0) {
+            idle = &curve;
+        }
+        if (!nearest || std::abs(curve.durationMinutes() - durationMinutes)
+                        < std::abs(nearest->durationMinutes() - durationMinutes)) {
+            nearest = &curve;
+        }
+    }
+    // A chain whose meal is fully absorbed takes the new curve
+    if (idle) {
+        idle->setCurve(peakMinutes, durationMinutes);
+        nearest = idle;
+    } else if (int(m_mealCarbs.size()) < MAX_MEAL_CARB_CURVES) {
+        m_mealCarbs.emplace_back(peakMinutes, durationMinutes);
+        nearest = &m_mealCarbs.back();
+    }
+    nearest->add(grams);
+}
+
+double CGM::insulinOnBoard() const
+{
+    return m_bolusInsulin.remaining();
+}
+
+double CGM::carbsOnBoard() const
+{
+    double grams = m_carbs.remaining();
+    for (const AbsorptionModel &curve : m_mealCarbs) {
+        grams += curve.remaining();
+    }
+    return grams;
+}
+
+void CGM::setInsulinAction(double peakMinutes, double durationMinutes)
+{
+    m_basalInsulin.setCurve(peakMinutes, durationMinutes);
+    m_bolusInsulin.setCurve(peakMinutes, durationMinutes);
+}
+
+void CGM::setCarbAbsorption(double peakMinutes, double durationMinutes)
+{
+    m_carbs.setCurve(peakMinutes, durationMinutes);
+}
+
+GlucoseInputs CGM::modelInputs() const
+{
+    GlucoseInputs in;
+    in.baseGlucose = m_baseGlucose;
+    in.insulinSensitivity = m_insulinSensitivity;
+    in.basalActive = m_basalActive;
+    return in;
+}
+
+double CGM::minutesSinceLastStep(qint64 simulatedMsecs)
+{
+    // Step the absorption curves by the real gap since the last reading
+    double minutes = NOMINAL_READING_MINUTES;
+    if (m_lastStepMs >= 0 && simulatedMsecs > m_lastStepMs) {
+        minutes = (simulatedMsecs - m_lastStepMs) / 60000.0;
+    }
+    m_lastStepMs = simulatedMsecs;
+    return minutes;
+}
+
+double CGM::stepModel(double minutes)
+{
+    // Insulin and carbs absorbed since the last reading drive the model
+    GlucoseInputs in = modelInputs();
+    in.insulinRate = (m_basalInsulin.advance(minutes) + m_bolusInsulin.advance(minutes)) / minutes;
+    double carbs = m_carbs.advance(minutes);
+    for (AbsorptionModel &curve : m_mealCarbs) {
+        carbs += curve.advance(minutes);
+    }
+    in.carbRate = carbs / minutes;
+    return m_model->step(minutes, in);
+}
+
+double CGM::calculateNextGlucose(double minutes)
+{
+    double nextValue = stepModel(minutes);
 
     if (m_basalActive) {
         // Add some natural variation/noise
-        double noise = QRandomGenerator::global()->generateDouble() * 0.4 - 0.2;
-        nextValue += noise;
-        // Apply a pull towards the base level (homeostasis simulation)
-        double homeostasisEffect = (m_baseGlucose - nextValue) * 0.05;
-        nextValue += homeostasisEffect;
-    } else {
-        nextValue += 0.1; // Basal suspended, linear rise of 0.1 mmol/L
+        double noise = m_noise.uniform(m_readingIndex) * 0.4 - 0.2;
+        nextValue += noise * std::sqrt(minutes / NOMINAL_READING_MINUTES);
+        m_model->setGlucose(nextValue);
     }
 
-    // Apply pending insulin and carb effects
-    nextValue -= m_pendingInsulinEffect * 0.2;
-    nextValue += m_pendingCarbEffect * 0.25;
-
+    ++m_readingIndex;
     return nextValue;
 }
 
@@ -153,3 +305,121 @@ bool CGM::isValidReading(double value) const
 void CGM::setBasalActive(bool active) {
     m_basalActive = active;
 }
+
+// --- Snapshots ---
+
+namespace {
+
+void saveCurve(QDataStream &out, const AbsorptionModel &curve)
+{
+    double depot1, depot2, active;
+    curve.state(depot1, depot2, active);
+    out << curve.peakMinutes() << curve.durationMinutes() << depot1 << depot2 << active;
+}
+
+void restoreCurve(QDataStream &in, AbsorptionModel &curve)
+{
+    double peak, duration, depot1, depot2, active;
+    in >> peak >> duration >> depot1 >> depot2 >> active;
+    if (peak != curve.peakMinutes() || duration != curve.durationMinutes()) {
+        curve.setCurve(peak, duration);     // Solves for the shape; skip if unchanged
+    }
+    curve.setState(depot1, depot2, active);
+}
+
+}
+
+void CGM::saveState(QDataStream &out) const
+{
+    out << qint32(m_readings.retentionHours());
+    m_readings.saveState(out);
+    out << m_baseGlucose;
+    saveCurve(out, m_basalInsulin);
+    saveCurve(out, m_bolusInsulin);
+    saveCurve(out, m_carbs);
+    out << qint32(m_mealCarbs.size());
+    for (const AbsorptionModel &curve : m_mealCarbs) {
+        saveCurve(out, curve);
+    }
+    out << m_lastStepMs
+        << qint32(m_model->type()) << m_model->stepMinutes() << m_model->state()
+        << m_noise.seed() << m_readingIndex
+        << m_insulinSensitivity << m_basalActive;
+    m_metrics->saveState(out);
+}
+
+void CGM::swapState(CGM &other)
+{
+    std::swap(m_readings, other.m_readings);
+    m_metrics.swap(other.m_metrics);
+    std::swap(m_baseGlucose, other.m_baseGlucose);
+    std::swap(m_basalInsulin, other.m_basalInsulin);
+    std::swap(m_bolusInsulin, other.m_bolusInsulin);
+    std::swap(m_carbs, other.m_carbs);
+    m_mealCarbs.swap(other.m_mealCarbs);
+    std::swap(m_lastStepMs, other.m_lastStepMs);
+    m_model.swap(other.m_model);
+    std::swap(m_noise, other.m_noise);
+    std::swap(m_readingIndex, other.m_readingIndex);
+    std::swap(m_insulinSensitivity, other.m_insulinSensitivity);
+    std::swap(m_basalActive, other.m_basalActive);
+}
+
+bool CGM::restoreState(QDataStream &in)
+{
+    qint32 retention = 0;
+    in >> retention;
+    if (in.status() != QDataStream::Ok
+        || retention < MIN_RETENTION_HOURS || retention > MAX_RETENTION_HOURS) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    m_readings.setRetentionHours(retention);
+    if (!m_readings.restoreState(in)) {
+        return false;
+    }
+
+    in >> m_baseGlucose;
+    restoreCurve(in, m_basalInsulin);
+    restoreCurve(in, m_bolusInsulin);
+    restoreCurve(in, m_carbs);
+    qint32 mealCurves = 0;
+    in >> mealCurves;
+    if (in.status() != QDataStream::Ok || mealCurves < 0 || mealCurves > MAX_MEAL_CARB_CURVES) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    // Constructing a curve solves for its shape, so only make missing ones
+    while (int(m_mealCarbs.size()) > mealCurves) {
+        m_mealCarbs.pop_back();
+    }
+    while (int(m_mealCarbs.size()) < mealCurves) {
+        m_mealCarbs.emplace_back(DEFAULT_CARB_PEAK, DEFAULT_CARB_DURATION);
+    }
+    for (AbsorptionModel &curve : m_mealCarbs) {
+        restoreCurve(in, curve);
+    }
+
+    qint32 modelType = 0;
+    double modelStep = 0.0;
+    QVector<double> modelState;
+    quint64 seed = 0;
+    in >> m_lastStepMs >> modelType >> modelStep >> modelState
+       >> seed >> m_readingIndex >> m_insulinSensitivity >> m_basalActive;
+    if (in.status() != QDataStream::Ok
+        || (modelType != RandomWalkGlucoseModel && modelType != BergmanGlucoseModel)) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+
+    if (modelType != m_model->type()) {
+        m_model.reset(GlucoseModel::create(GlucoseModelType(modelType)));
+    }
+    m_model->setStepMinutes(modelStep);
+    m_noise.setSeed(seed);
+    if (!m_model->setState(modelState)) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    return m_metrics->restoreState(in);
+}
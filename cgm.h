@@ -7,7 +7,16 @@
 #include <QDateTime>
 #include <QRandomGenerator>
 #include <QDebug>
+#include <QDataStream>
 #include <algorithm>
+#include "glucosestore.h"
+#include "absorptionmodel.h"
+#include "glucosemodel.h"
+#include "philox.h"
+#include <memory>
+#include <vector>
+
+class GlycemicMetrics;
 
 // Constants for glucose simulation
 const double LOW_GLUCOSE_THRESHOLD = 3.9;   // mmol/L or 70 mg/dL
@@ -15,16 +24,32 @@ const double HIGH_GLUCOSE_THRESHOLD = 10; // mmol/L or 250 mg/dL
 const double DEFAULT_BASE_GLUCOSE = 5.6;    // mmol/L or 100 mg/dL
 const double MAX_VALID_GLUCOSE = 33.3;      // mmol/L or 600 mg/dL
 
-struct GlucoseReading {
-    QDateTime timestamp;
-    double value;      // Blood glucose value in mmol/L or mg/dL
-};
+// Sensor reading interval, which the noise amplitude is tuned for, and
+// CGM history retention (one reading every 5 minutes)
+const double NOMINAL_READING_MINUTES = 5.0;
+const int READINGS_PER_HOUR = 12;
+const int MIN_RETENTION_HOURS = 24;
+const int MAX_RETENTION_HOURS = 90 * 24;
+
+// Default insulin action and carb absorption curves (minutes)
+const double DEFAULT_INSULIN_PEAK = 75.0;
+const double DEFAULT_INSULIN_DURATION = 300.0;  // DIA
+const double DEFAULT_CARB_PEAK = 45.0;
+const double DEFAULT_CARB_DURATION = 180.0;
+
+// Distinct per-meal carb curves in flight at once; a meal on a further
+// curve joins the one with the nearest duration
+const int MAX_MEAL_CARB_CURVES = 8;
+
+// Zero-copy window onto the CGM history, valid until the next reading
+typedef GlucoseStore::ReadingView GlucoseReadingView;
 
 class CGM : public QObject
 {
     Q_OBJECT
 public:
     explicit CGM(QObject *parent = nullptr);
+    ~CGM() override;
 
     // Get the current glucose reading
     double currentGlucose() const;
@@ -34,38 +59,110 @@ public:
 
     // Generate a new reading (called by simulation timer)
     void generateReading(const QDateTime &simulatedTime);
+    void generateReading(qint64 simulatedMsecs);
+
+    // A reading the sensor missed: the physiology and the noise stream move
+    // on as for generateReading(), but nothing is recorded or signalled
+    void skipReading(qint64 simulatedMsecs);
+
+    // Take a reading from a recorded trace instead of the model. Insulin,
+    // carbs and the model still advance to its time, so simulated readings
+    // can carry on from it. Refused if invalid or older than the last one.
+    bool addRecordedReading(qint64 timestampMs, double value);
 
     // Get historical readings for graphing
-    QVector<GlucoseReading> getReadings(int hours) const;
+    GlucoseReadingView getReadings(int hours) const;
+
+    // Pre-aggregated 15 min / 1 h buckets for long-range views
+    GlucoseStore::AggregateView getAggregates(GlucoseStore::Tier tier, int hours) const;
+    const GlucoseStore &store() const;
+
+    // Time in range, mean, CV, GMI and percentiles over the last 24 h,
+    // 14 d and 90 d, kept up to date with every reading. swapState()
+    // replaces the object, so don't hold on to it across a restore.
+    const GlycemicMetrics &metrics() const;
 
-    // Predict glucose level at a future time (for Control-IQ) (feature removed)
-    //double predictGlucose(int minutesInFuture) const;
+    // How many hours of readings are kept (24 h up to 90 days)
+    void setRetentionHours(int hours);
+    int retentionHours() const;
 
     // Set a base glucose level for simulation
     void setBaseGlucose(double baseLevel);
 
+    // Physiology behind the readings, and its internal integration step
+    void setGlucoseModel(GlucoseModelType type);
+    GlucoseModelType glucoseModelType() const;
+    void setModelStepMinutes(double minutes);
+    double modelStepMinutes() const;
+
+    // Sensor noise is drawn from a counter-based generator keyed by this
+    // seed and indexed by reading number, so a run can be replayed exactly
+    void setNoiseSeed(quint64 seed);
+    quint64 noiseSeed() const;
+
+    // Scale the glucose-lowering effect of insulin (1.0 = default patient)
+    void setInsulinSensitivity(double sensitivity);
+
     // Register insulin effect (will lower future readings)
     void registerInsulinEffect(double units);
 
+    // Register bolus insulin; counted in insulinOnBoard()
+    void registerBolusEffect(double units);
+
     // Register carb effect (will raise future readings)
     void registerCarbEffect(double grams);
 
+    // Carbs absorbed on a curve of their own (a slow or fast meal) rather
+    // than the shared one; meals on the same curve share its chain, and a
+    // chain with nothing left on board is reshaped for the next new curve
+    void registerCarbEffect(double grams, double peakMinutes, double durationMinutes);
+
+    // Bolus insulin and carbs still to act, O(1)
+    double insulinOnBoard() const;
+    double carbsOnBoard() const;
+
+    // Shape of the insulin action and carb absorption curves
+    void setInsulinAction(double peakMinutes, double durationMinutes);
+    void setCarbAbsorption(double peakMinutes, double durationMinutes);
+
     // Sets basal activity to True or False
     void setBasalActive(bool active);
 
+    // Everything that decides the next readings: history, curves, model,
+    // noise stream position. Restoring emits no signals.
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+
+    // Exchange that state with another CGM, so a snapshot can be read into
+    // a spare one and swapped in once all of it has checked out
+    void swapState(CGM &other);
+
 signals:
+    void readingAdded(qint64 timestampMs, double value);
     void criticalLowGlucose(double value);  // Below 3.9 mmol/L (70 mg/dL)
     void criticalHighGlucose(double value); // Above 10 mmol/L (250 mg/dL)
 
 private:
-    QVector<GlucoseReading> m_readings;     // Historical readings
+    GlucoseStore m_readings;                // Historical readings
+    std::unique_ptr<GlycemicMetrics> m_metrics;  // Outcomes over sliding windows
     double m_baseGlucose;                   // Base glucose level for simulation
-    double m_pendingInsulinEffect;          // How much insulin is affecting glucose
-    double m_pendingCarbEffect;             // How much carbs are affecting glucose
+    AbsorptionModel m_basalInsulin;         // Basal insulin in flight
+    AbsorptionModel m_bolusInsulin;         // Bolus insulin in flight (IOB)
+    AbsorptionModel m_carbs;                // Carbs being absorbed (COB)
+    std::vector<AbsorptionModel> m_mealCarbs;   // Per-meal curves, one chain each
+    qint64 m_lastStepMs = -1;               // Time the curves were last advanced to
+    std::unique_ptr<GlucoseModel> m_model;  // Physiological glucose model
+    PhiloxRandom m_noise;                   // Sensor noise generator
+    quint64 m_readingIndex = 0;             // Readings generated so far
+    double m_insulinSensitivity = 1.0;      // Multiplier on insulin effect
     bool m_basalActive = true;              // Boolean tracking basal activity
 
     // Helper functions
-    double calculateNextGlucose() const;
+    GlucoseInputs modelInputs() const;
+    double minutesSinceLastStep(qint64 simulatedMsecs);
+    double stepModel(double minutes);
+    double calculateNextGlucose(double minutes);
+    void appendReading(qint64 timestampMs, double value);
     bool isValidReading(double value) const;
 };
 
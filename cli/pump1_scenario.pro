@@ -0,0 +1,14 @@
+# Headless scenario runner for the simulation core (no QtWidgets/QtCharts)
+
+QT -= gui
+QT += core
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = pump1_scenario
+
+include(../core.pri)
+
+SOURCES += \
+    scenariomain.cpp
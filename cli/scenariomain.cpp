@@ -0,0 +1,128 @@
+// scenariomain.cpp
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include "glycemicmetrics.h"
+#include "scenario.h"
+#include "simulationengine.h"
+#include <limits>
+
+namespace {
+
+void usage(QTextStream &out)
+{
+    out << "Usage: pump1_scenario <file> [--events] [--log]\n"
+        << "  --events    event-driven run instead of fixed ticks\n"
+        << "  --log       print the event log after the metrics\n";
+}
+
+void setUp(SimulationEngine &engine, const Scenario &scenario)
+{
+    QDateTime start(QDate(2025, 1, 1), QTime(0, 0, 0));
+    engine.setStartTime(start.addSecs(qint64(scenario.startMinuteOfDay() * 60.0)));
+    engine.setTickMinutes(scenario.tickMinutes());
+
+    CGM *cgm = engine.cgm();
+    cgm->setGlucoseModel(scenario.glucoseModel());
+    if (scenario.hasNoiseSeed()) {
+        cgm->setNoiseSeed(scenario.noiseSeed());
+    }
+    if (scenario.startGlucose() > 0.0) {
+        cgm->setBaseGlucose(scenario.startGlucose());
+    }
+
+    for (int i = 0; i < scenario.profiles().size(); ++i) {
+        const ProfileData &p = scenario.profiles().at(i);
+        engine.profileManager()->createProfile(scenario.profileNames().at(i), p.basalRate,
+                                               p.carbRatio, p.correctionFactor, p.targetBG);
+    }
+    const ProfileData &first = scenario.profiles().first();
+    engine.setCurrentProfile(first);
+    engine.insulinPump()->setActiveProfile(first);
+    engine.insulinPump()->startBasalDelivery();
+}
+
+// Smallest metrics window that covers the whole run
+MetricsWindow windowFor(double minutes)
+{
+    if (minutes <= GlycemicMetrics::windowMs(DayWindow) / 60000.0) {
+        return DayWindow;
+    }
+    if (minutes <= GlycemicMetrics::windowMs(TwoWeekWindow) / 60000.0) {
+        return TwoWeekWindow;
+    }
+    return NinetyDayWindow;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments().mid(1);
+    QTextStream out(stdout);
+
+    bool events = args.removeAll("--events") > 0;
+    bool printLog = args.removeAll("--log") > 0;
+    if (args.size() != 1 || args.first().startsWith("-")) {
+        usage(out);
+        return 1;
+    }
+
+    Scenario scenario;
+    if (!scenario.load(args.first())) {
+        out << args.first() << ": " << scenario.errorString() << "\n";
+        return 1;
+    }
+
+    SimulationEngine engine;
+    setUp(engine, scenario);
+    engine.setScenario(&scenario);
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 steps = 0;
+    if (events) {
+        engine.runEventsFor(scenario.durationMinutes());
+        steps = engine.eventsRun();
+    } else {
+        engine.runFor(scenario.durationMinutes());
+        steps = engine.ticksRun();
+    }
+    double ms = timer.nsecsElapsed() / 1e6;
+
+    out << QString("%1: %2 days, %3 events, %4\n")
+           .arg(args.first()).arg(scenario.days()).arg(scenario.events().size())
+           .arg(events ? QString("event-driven") : QString("%1 min ticks").arg(scenario.tickMinutes()));
+    out << QString("Ran %1 %2 in %3 ms\n")
+           .arg(steps).arg(events ? "events" : "ticks").arg(ms, 0, 'f', 1);
+
+    MetricsWindow window = windowFor(scenario.durationMinutes());
+    GlycemicSummary s = engine.cgm()->metrics().summary(window);
+    out << QString("Glucose over the last %1: %2 readings\n")
+           .arg(GlycemicMetrics::windowName(window)).arg(s.readings);
+    out << QString("  mean %1 mmol/L, CV %2 %, GMI %3 %\n")
+           .arg(s.meanGlucose, 0, 'f', 1).arg(s.coefficientOfVariation, 0, 'f', 1).arg(s.gmi, 0, 'f', 1);
+    out << QString("  in range %1 %, below 3.9 %2 % (below 3.0 %3 %), above 10.0 %4 % (above 13.9 %5 %)\n")
+           .arg(s.timeInRange, 0, 'f', 1).arg(s.timeBelow3_9, 0, 'f', 1).arg(s.timeBelow3_0, 0, 'f', 1)
+           .arg(s.timeAbove10_0, 0, 'f', 1).arg(s.timeAbove13_9, 0, 'f', 1);
+
+    InsulinPump *pump = engine.insulinPump();
+    out << QString("Pump: %1 U bolused, %2 U left, battery %3 %\n")
+           .arg(pump->bolusUnitsDelivered(), 0, 'f', 2)
+           .arg(pump->insulinUnitsRemaining(), 0, 'f', 1)
+           .arg(pump->batteryLevel(), 0, 'f', 1);
+
+    SystemLog *log = engine.systemLog();
+    qint64 from = std::numeric_limits<qint64>::min();
+    qint64 to = std::numeric_limits<qint64>::max();
+    out << QString("Alarms: %1 announced\n").arg(log->count(from, to, logEventBit(AlarmRaisedLogEvent)));
+
+    if (printLog) {
+        log->forEach(from, to, ALL_LOG_EVENTS, [&](qint64, const LogRecord &r) {
+            out << log->format(r) << "\n";
+            return true;
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+// cohortrunner.cpp
+#include "cohortrunner.h"
+#include "columnarwriter.h"
+#include "workstealingpool.h"
+#include "patientbatch.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Patients simulated together by one PatientBatch; one unit of pool work
+const int PATIENTS_PER_BATCH = 64;
+
+// Per-worker statistics and output rows, padded to a cache line so
+// workers never share one
+struct alignas(64) WorkerStats {
+    CohortStats stats;
+    OutputBatch rows;
+};
+
+}
+
+// --- CohortStats ---
+
+void CohortStats::add(double glucose)
+{
+    ++readings;
+    sumGlucose += glucose;
+    sumSquares += glucose * glucose;
+    histogram.add(glucose);
+    minGlucose = qMin(minGlucose, glucose);
+    maxGlucose = qMax(maxGlucose, glucose);
+
+    if (glucose < LOW_GLUCOSE_THRESHOLD) {
+        ++belowRange;
+    } else if (glucose > HIGH_GLUCOSE_THRESHOLD) {
+        ++aboveRange;
+    } else {
+        ++inRange;
+    }
+}
+
+void CohortStats::merge(const CohortStats &other)
+{
+    patients += other.patients;
+    readings += other.readings;
+    belowRange += other.belowRange;
+    inRange += other.inRange;
+    aboveRange += other.aboveRange;
+    sumGlucose += other.sumGlucose;
+    sumSquares += other.sumSquares;
+    histogram.merge(other.histogram);
+    minGlucose = qMin(minGlucose, other.minGlucose);
+    maxGlucose = qMax(maxGlucose, other.maxGlucose);
+}
+
+double CohortStats::meanGlucose() const
+{
+    return readings > 0 ? sumGlucose / readings : 0.0;
+}
+
+double CohortStats::standardDeviation() const
+{
+    if (readings == 0) {
+        return 0.0;
+    }
+    double mean = meanGlucose();
+    return std::sqrt(qMax(0.0, sumSquares / readings - mean * mean));
+}
+
+double CohortStats::timeInRange() const
+{
+    return readings > 0 ? 100.0 * inRange / readings : 0.0;
+}
+
+double CohortStats::percentile(double percent) const
+{
+    return histogram.percentile(percent);
+}
+
+// --- CohortRunner ---
+
+CohortRunner::CohortRunner()
+    : m_therapy({1.0, 10.0, 2.0, 5.5, {}}),
+      m_days(1.0),
+      m_model(RandomWalkGlucoseModel),
+      m_modelStepMinutes(1.0),
+      m_simdLevel(bestSimdLevel()),
+      m_threads(0)
+{
+}
+
+void CohortRunner::setTherapy(const ProfileData &profile)
+{
+    m_therapy = profile;
+}
+
+ProfileData CohortRunner::therapy() const
+{
+    return m_therapy;
+}
+
+void CohortRunner::setDays(double days)
+{
+    if (days > 0.0) {
+        m_days = days;
+    }
+}
+
+double CohortRunner::days() const
+{
+    return m_days;
+}
+
+void CohortRunner::setGlucoseModel(GlucoseModelType type)
+{
+    m_model = type;
+}
+
+GlucoseModelType CohortRunner::glucoseModel() const
+{
+    return m_model;
+}
+
+void CohortRunner::setModelStepMinutes(double minutes)
+{
+    if (minutes > 0.0) {
+        m_modelStepMinutes = minutes;
+    }
+}
+
+double CohortRunner::modelStepMinutes() const
+{
+    return m_modelStepMinutes;
+}
+
+void CohortRunner::setSimdLevel(SimdLevel level)
+{
+    m_simdLevel = level;
+}
+
+SimdLevel CohortRunner::simdLevel() const
+{
+    return m_simdLevel;
+}
+
+void CohortRunner::setThreadCount(int threads)
+{
+    m_threads = threads;
+}
+
+int CohortRunner::threadCount() const
+{
+    return m_threads;
+}
+
+void CohortRunner::setOutputWriter(ColumnarWriter *writer)
+{
+    m_output = writer;
+}
+
+ColumnarWriter *CohortRunner::outputWriter() const
+{
+    return m_output;
+}
+
+QVector<VirtualPatient> CohortRunner::generateCohort(int count, quint32 seed)
+{
+    QRandomGenerator rng(seed);
+    QVector<VirtualPatient> patients;
+    patients.reserve(count);
+
+    for (int i = 0; i < count; ++i) {
+        VirtualPatient p;
+        p.baseGlucose = 4.8 + rng.generateDouble() * 3.5;          // 4.8 - 8.3 mmol/L
+        p.insulinSensitivity = 0.6 + rng.generateDouble() * 1.0;   // 0.6 - 1.6
+
+        // Breakfast, lunch and dinner with +/- 45 min jitter and 30 - 90 g carbs
+        const int mealTimes[] = {7 * 60, 12 * 60 + 30, 18 * 60 + 30};
+        for (int t : mealTimes) {
+            MealEvent meal;
+            meal.minuteOfDay = t + static_cast<int>(rng.generateDouble() * 90.0) - 45;
+            meal.grams = 30.0 + rng.generateDouble() * 60.0;
+            p.meals.append(meal);
+        }
+        p.seed = rng.generate64();
+        patients.append(p);
+    }
+    return patients;
+}
+
+CohortStats CohortRunner::run(const QVector<VirtualPatient> &patients)
+{
+    // Pick the model once; everything below is specialised for it
+    switch (m_model) {
+    case BergmanGlucoseModel:
+        return runWith<BergmanMinimalModel>(patients);
+    case RandomWalkGlucoseModel:
+    default:
+        return runWith<RandomWalkModel>(patients);
+    }
+}
+
+template <class Model>
+CohortStats CohortRunner::runWith(const QVector<VirtualPatient> &patients)
+{
+    WorkStealingPool pool(m_threads);
+    qint64 ticksPerPatient = static_cast<qint64>(m_days * 24 * 60 / SIMULATION_SPEED);
+
+    // Every patient index is written by exactly one worker
+    m_results = QVector<PatientResult>(patients.size());
+    PatientResult *results = m_results.data();
+    std::vector<WorkerStats> perWorker(pool.threadCount());
+    int batches = (patients.size() + PATIENTS_PER_BATCH - 1) / PATIENTS_PER_BATCH;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    pool.run(batches, [&](int batch, int worker) {
+        int first = batch * PATIENTS_PER_BATCH;
+        simulateBatch<Model>(patients.mid(first, PATIENTS_PER_BATCH), first, ticksPerPatient,
+                             results + first, perWorker[worker].stats, perWorker[worker].rows);
+    });
+    if (m_output) {
+        for (WorkerStats &w : perWorker) {
+            m_output->submit(w.rows);
+        }
+    }
+
+    m_elapsedSeconds = timer.nsecsElapsed() / 1e9;
+    m_ticksRun = ticksPerPatient * patients.size();
+    m_stealCount = pool.stealCount();
+
+    CohortStats total;
+    for (const WorkerStats &w : perWorker) {
+        total.merge(w.stats);
+    }
+    return total;
+}
+
+const QVector<PatientResult> &CohortRunner::patientResults() const
+{
+    return m_results;
+}
+
+double CohortRunner::elapsedSeconds() const
+{
+    return m_elapsedSeconds;
+}
+
+qint64 CohortRunner::ticksRun() const
+{
+    return m_ticksRun;
+}
+
+double CohortRunner::ticksPerSecond() const
+{
+    return m_elapsedSeconds > 0.0 ? m_ticksRun / m_elapsedSeconds : 0.0;
+}
+
+int CohortRunner::stealCount() const
+{
+    return m_stealCount;
+}
+
+template <class Model>
+void CohortRunner::simulateBatch(const QVector<VirtualPatient> &patients, int firstPatient,
+                                 qint64 ticks, PatientResult *results, CohortStats &stats,
+                                 OutputBatch &rows) const
+{
+    // Created on the worker thread and never shared with another one
+    PatientBatch<Model> batch(m_therapy, patients);
+    batch.setModelStepMinutes(m_modelStepMinutes);
+    batch.setSimdLevel(m_simdLevel);
+
+    std::vector<CohortStats> own(patients.size());
+    OutputRow row;
+    for (qint64 i = 0; i < ticks; ++i) {
+        batch.tick();
+        for (int p = 0; p < batch.size(); ++p) {
+            own[p].add(batch.glucose(p));
+        }
+        if (!m_output) {
+            continue;
+        }
+        // Full batches go to the writer's threads; this worker carries on
+        row.timeMs = static_cast<qint64>(i * SIMULATION_SPEED * 60000.0);
+        for (int p = 0; p < batch.size(); ++p) {
+            row.patient = quint32(firstPatient + p);
+            row.value(GlucoseColumn) = float(batch.glucose(p));
+            row.value(IobColumn) = float(batch.insulinOnBoard(p));
+            row.value(CobColumn) = float(batch.carbsOnBoard(p));
+            row.value(BasalRateColumn) = float(batch.basalRate(p));
+            row.value(BolusColumn) = float(batch.bolusUnits(p));
+            rows.append(row);
+            if (rows.isFull()) {
+                m_output->submit(rows);
+            }
+        }
+    }
+
+    for (int p = 0; p < batch.size(); ++p) {
+        own[p].patients = 1;
+        stats.merge(own[p]);
+
+        results[p].meanGlucose = own[p].meanGlucose();
+        results[p].minGlucose = own[p].minGlucose;
+        results[p].maxGlucose = own[p].maxGlucose;
+        results[p].timeInRange = own[p].timeInRange();
+    }
+}
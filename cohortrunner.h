@@ -0,0 +1,127 @@
+// cohortrunner.h
+#ifndef COHORTRUNNER_H
+#define COHORTRUNNER_H
+
+#include <QVector>
+#include "profilemanager.h"
+#include "simulationengine.h"
+#include "glucosemodel.h"
+#include "glycemicmetrics.h"
+#include "patientbatch.h"
+
+class ColumnarWriter;
+class OutputBatch;
+
+// One virtual patient of a cohort
+struct VirtualPatient {
+    double baseGlucose;          // mmol/L the patient settles at
+    double insulinSensitivity;   // Multiplier on insulin effect (1.0 = default)
+    QVector<MealEvent> meals;    // Daily meal pattern
+    quint64 seed = 0;            // Sensor noise seed (PhiloxRandom key)
+};
+
+// Glucose outcome of a single patient
+struct PatientResult {
+    double meanGlucose;
+    double minGlucose;
+    double maxGlucose;
+    double timeInRange;          // % of readings in [3.9, 10] mmol/L
+};
+
+// Mergeable glucose statistics; each worker keeps its own and they are
+// combined once all patients are done, so no lock is taken while running
+struct CohortStats {
+    qint64 patients = 0;
+    qint64 readings = 0;
+    qint64 belowRange = 0;
+    qint64 inRange = 0;
+    qint64 aboveRange = 0;
+    double sumGlucose = 0.0;
+    double sumSquares = 0.0;
+    double minGlucose = MAX_VALID_GLUCOSE;
+    double maxGlucose = 0.0;
+    GlucoseHistogram histogram;
+
+    void add(double glucose);
+    void merge(const CohortStats &other);
+    double meanGlucose() const;
+    double standardDeviation() const;
+    double timeInRange() const;  // %
+    double percentile(double percent) const;
+};
+
+// Runs the same therapy settings against many virtual patients, in
+// PatientBatch groups spread over all cores. The glucose model is picked
+// once per run and fixed at compile time inside the batch.
+class CohortRunner
+{
+public:
+    CohortRunner();
+
+    // Therapy applied to every patient, time-of-day segments included.
+    // Patients run the BatchPatient rules, without alarms, scenarios,
+    // extended boluses or pump levels.
+    void setTherapy(const ProfileData &profile);
+    ProfileData therapy() const;
+
+    // Simulated duration per patient
+    void setDays(double days);
+    double days() const;
+
+    // Physiology used for every patient, and its RK4 step
+    void setGlucoseModel(GlucoseModelType type);
+    GlucoseModelType glucoseModel() const;
+    void setModelStepMinutes(double minutes);
+    double modelStepMinutes() const;
+
+    // Vector instruction set for the batched physics (defaults to the best)
+    void setSimdLevel(SimdLevel level);
+    SimdLevel simdLevel() const;
+
+    // Worker threads (<= 0 uses all cores)
+    void setThreadCount(int threads);
+    int threadCount() const;
+
+    // Stream every patient's outputs, one row per tick, to a column file
+    // (not owned). Time is ms since the start of the run. Battery and
+    // reservoir are not simulated per patient and come out as 0, so
+    // leave them out of the writer's columns.
+    void setOutputWriter(ColumnarWriter *writer);
+    ColumnarWriter *outputWriter() const;
+
+    // Reproducible cohort with varied base glucose, sensitivity and meals
+    static QVector<VirtualPatient> generateCohort(int count, quint32 seed);
+
+    // Simulate every patient and return the combined statistics
+    CohortStats run(const QVector<VirtualPatient> &patients);
+
+    // Details of the last run
+    const QVector<PatientResult> &patientResults() const;
+    double elapsedSeconds() const;
+    qint64 ticksRun() const;
+    double ticksPerSecond() const;
+    int stealCount() const;
+
+private:
+    template <class Model>
+    CohortStats runWith(const QVector<VirtualPatient> &patients);
+
+    template <class Model>
+    void simulateBatch(const QVector<VirtualPatient> &patients, int firstPatient, qint64 ticks,
+                       PatientResult *results, CohortStats &stats, OutputBatch &rows) const;
+
+    ProfileData m_therapy;
+    double m_days;
+    GlucoseModelType m_model;
+    double m_modelStepMinutes;
+    SimdLevel m_simdLevel;
+    int m_threads;
+    ColumnarWriter *m_output = nullptr;
+
+    QVector<PatientResult> m_results;
+    double m_elapsedSeconds = 0.0;
+    qint64 m_ticksRun = 0;
+    int m_stealCount = 0;
+};
+
+#endif // COHORTRUNNER_H
@@ -0,0 +1,501 @@
+// columnarwriter.cpp
+#include "columnarwriter.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const int HEADER_BYTES = 16;
+const int FOOTER_TAIL_BYTES = 20;     // Group count, total rows, magic
+
+template <class T>
+void appendLittleEndian(QByteArray &out, T value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <class T>
+T readLittleEndian(const char *p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return qFromLittleEndian(value);
+}
+
+// Byte planes of n values: byte k of value i goes to k * n + i. Values are
+// taken as the unsigned integer U of the same width, little-endian.
+template <class U, class T>
+QByteArray shuffle(const T *values, int n)
+{
+    static_assert(sizeof(U) == sizeof(T), "shuffle needs a same-width integer");
+    QByteArray out(n * int(sizeof(U)), '\0');
+    char *dst = out.data();
+    for (int i = 0; i < n; ++i) {
+        U bits;
+        std::memcpy(&bits, &values[i], sizeof(U));
+        bits = qToLittleEndian(bits);
+        const char *b = reinterpret_cast<const char *>(&bits);
+        for (int k = 0; k < int(sizeof(U)); ++k) {
+            dst[k * n + i] = b[k];
+        }
+    }
+    return out;
+}
+
+template <class U, class T>
+void unshuffle(const char *src, int n, T *values)
+{
+    for (int i = 0; i < n; ++i) {
+        U bits;
+        char *b = reinterpret_cast<char *>(&bits);
+        for (int k = 0; k < int(sizeof(U)); ++k) {
+            b[k] = src[k * n + i];
+        }
+        bits = qFromLittleEndian(bits);
+        std::memcpy(&values[i], &bits, sizeof(U));
+    }
+}
+
+int columnWidth(int column)
+{
+    return column == TimeColumn ? 8 : 4;
+}
+
+}
+
+// --- OutputBatch ---
+
+void OutputBatch::append(const OutputRow &row)
+{
+    time.push_back(row.timeMs);
+    patient.push_back(row.patient);
+    for (int c = 0; c < VALUE_COLUMN_COUNT; ++c) {
+        values[c].push_back(row.values[c]);
+    }
+}
+
+int OutputBatch::size() const
+{
+    return int(time.size());
+}
+
+bool OutputBatch::isFull() const
+{
+    return size() >= OUTPUT_BATCH_ROWS;
+}
+
+void OutputBatch::clear()
+{
+    time.clear();
+    patient.clear();
+    for (std::vector<float> &v : values) {
+        v.clear();
+    }
+}
+
+// --- ColumnarWriter ---
+
+ColumnarWriter::ColumnarWriter()
+{
+}
+
+ColumnarWriter::~ColumnarWriter()
+{
+    close();
+}
+
+void ColumnarWriter::setColumns(quint16 mask)
+{
+    m_columns = (mask | (1 << TimeColumn)) & ALL_OUTPUT_COLUMNS;
+}
+
+quint16 ColumnarWriter::columns() const
+{
+    return m_columns;
+}
+
+void ColumnarWriter::setMaxQueuedBatches(int batches)
+{
+    m_maxQueued = qMax(1, batches);
+}
+
+void ColumnarWriter::setThreadCount(int threads)
+{
+    m_threadCount = qMax(1, threads);
+}
+
+void ColumnarWriter::setCompressionLevel(int level)
+{
+    m_level = qBound(1, level, 9);
+}
+
+bool ColumnarWriter::open(const QString &path)
+{
+    close();
+    m_groupOffsets.clear();
+    m_rows = 0;
+    m_rawBytes = 0;
+    m_error.clear();
+    m_stalls = 0;
+    m_stallNs = 0;
+    m_closing = false;
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    QByteArray header;
+    appendLittleEndian(header, COLUMNAR_MAGIC);
+    appendLittleEndian(header, COLUMNAR_VERSION);
+    appendLittleEndian(header, m_columns);
+    appendLittleEndian(header, quint32(OUTPUT_BATCH_ROWS));
+    appendLittleEndian(header, quint32(0));
+    if (m_file.write(header) != header.size()) {
+        m_error = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    m_bytes = header.size();
+
+    for (int i = 0; i < m_threadCount; ++i) {
+        QThread *thread = QThread::create([this]() { compressLoop(); });
+        thread->start();
+        m_threads.append(thread);
+    }
+    return true;
+}
+
+bool ColumnarWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void ColumnarWriter::append(const OutputRow &row)
+{
+    m_current.append(row);
+    if (m_current.isFull()) {
+        submit(m_current);
+    }
+}
+
+void ColumnarWriter::submit(OutputBatch &batch)
+{
+    if (batch.size() == 0) {
+        return;
+    }
+    QMutexLocker lock(&m_queueMutex);
+    if (m_threads.isEmpty() || m_closing) {
+        batch.clear();
+        return;
+    }
+
+    // Backpressure: wait for a compressor rather than queue without bound
+    if (int(m_queue.size()) >= m_maxQueued) {
+        QElapsedTimer timer;
+        timer.start();
+        while (int(m_queue.size()) >= m_maxQueued) {
+            m_notFull.wait(&m_queueMutex);
+        }
+        ++m_stalls;
+        m_stallNs += timer.nsecsElapsed();
+    }
+
+    m_queue.push_back(std::move(batch));
+    if (!m_spare.empty()) {
+        batch = std::move(m_spare.back());
+        m_spare.pop_back();
+    } else {
+        batch = OutputBatch();
+    }
+    m_notEmpty.wakeOne();
+}
+
+void ColumnarWriter::compressLoop()
+{
+    for (;;) {
+        OutputBatch batch;
+        {
+            QMutexLocker lock(&m_queueMutex);
+            while (m_queue.empty() && !m_closing) {
+                m_notEmpty.wait(&m_queueMutex);
+            }
+            if (m_queue.empty()) {
+                return;
+            }
+            batch = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_notFull.wakeAll();
+        }
+
+        // Encoding and compression run unlocked, in parallel across threads
+        qint64 rawBytes = 0;
+        QByteArray group = encode(batch, rawBytes);
+        {
+            QMutexLocker lock(&m_fileMutex);
+            if (m_error.isEmpty()) {
+                if (m_file.write(group) == group.size()) {
+                    m_groupOffsets.append(quint64(m_bytes));
+                    m_rows += batch.size();
+                    m_bytes += group.size();
+                    m_rawBytes += rawBytes;
+                } else {
+                    m_error = m_file.errorString();
+                }
+            }
+        }
+
+        batch.clear();
+        QMutexLocker lock(&m_queueMutex);
+        m_spare.push_back(std::move(batch));
+    }
+}
+
+QByteArray ColumnarWriter::encode(const OutputBatch &batch, qint64 &rawBytes) const
+{
+    int n = batch.size();
+    QByteArray group;
+    appendLittleEndian(group, quint32(n));
+
+    for (int c = 0; c < OutputColumnCount; ++c) {
+        if (!(m_columns & (1 << c))) {
+            continue;
+        }
+        QByteArray raw;
+        if (c == TimeColumn) {
+            std::vector<qint64> delta(n);
+            qint64 previous = 0;
+            for (int i = 0; i < n; ++i) {
+                delta[i] = batch.time[i] - previous;
+                previous = batch.time[i];
+            }
+            raw = shuffle<quint64>(delta.data(), n);
+        } else if (c == PatientColumn) {
+            std::vector<quint32> delta(n);
+            quint32 previous = 0;
+            for (int i = 0; i < n; ++i) {
+                delta[i] = batch.patient[i] - previous;
+                previous = batch.patient[i];
+            }
+            raw = shuffle<quint32>(delta.data(), n);
+        } else {
+            raw = shuffle<quint32>(batch.values[c - GlucoseColumn].data(), n);
+        }
+        rawBytes += raw.size();
+
+        QByteArray chunk = qCompress(raw, m_level);
+        appendLittleEndian(group, quint32(chunk.size()));
+        group.append(chunk);
+    }
+    return group;
+}
+
+bool ColumnarWriter::close()
+{
+    if (!isOpen()) {
+        return m_error.isEmpty();
+    }
+    submit(m_current);
+    {
+        QMutexLocker lock(&m_queueMutex);
+        m_closing = true;
+        m_notEmpty.wakeAll();
+    }
+    for (QThread *thread : m_threads) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+    m_queue.clear();
+    m_spare.clear();
+
+    QByteArray footer;
+    for (quint64 offset : m_groupOffsets) {
+        appendLittleEndian(footer, offset);
+    }
+    appendLittleEndian(footer, quint64(m_groupOffsets.size()));
+    appendLittleEndian(footer, quint64(m_rows));
+    appendLittleEndian(footer, COLUMNAR_MAGIC);
+    if (m_error.isEmpty() && m_file.write(footer) != footer.size()) {
+        setError(m_file.errorString());
+    }
+    m_bytes += footer.size();
+    m_file.close();
+    return m_error.isEmpty();
+}
+
+QString ColumnarWriter::errorString() const
+{
+    QMutexLocker lock(&m_fileMutex);
+    return m_error;
+}
+
+void ColumnarWriter::setError(const QString &message)
+{
+    QMutexLocker lock(&m_fileMutex);
+    if (m_error.isEmpty()) {
+        m_error = message;
+    }
+}
+
+qint64 ColumnarWriter::rowsWritten() const
+{
+    QMutexLocker lock(&m_fileMutex);
+    return m_rows;
+}
+
+qint64 ColumnarWriter::rowGroupsWritten() const
+{
+    QMutexLocker lock(&m_fileMutex);
+    return m_groupOffsets.size();
+}
+
+qint64 ColumnarWriter::bytesWritten() const
+{
+    QMutexLocker lock(&m_fileMutex);
+    return m_bytes;
+}
+
+qint64 ColumnarWriter::rawBytesWritten() const
+{
+    QMutexLocker lock(&m_fileMutex);
+    return m_rawBytes;
+}
+
+qint64 ColumnarWriter::stallCount() const
+{
+    QMutexLocker lock(&m_queueMutex);
+    return m_stalls;
+}
+
+double ColumnarWriter::stallSeconds() const
+{
+    QMutexLocker lock(&m_queueMutex);
+    return m_stallNs / 1e9;
+}
+
+// --- ColumnarReader ---
+
+bool ColumnarReader::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    qint64 size = m_file.size();
+    QByteArray header = m_file.read(HEADER_BYTES);
+    if (size < HEADER_BYTES + FOOTER_TAIL_BYTES || header.size() != HEADER_BYTES
+        || readLittleEndian<quint32>(header.constData()) != COLUMNAR_MAGIC
+        || readLittleEndian<quint16>(header.constData() + 4) != COLUMNAR_VERSION) {
+        m_error = "Not a column file of this version";
+        close();
+        return false;
+    }
+    m_columns = readLittleEndian<quint16>(header.constData() + 6);
+
+    m_file.seek(size - FOOTER_TAIL_BYTES);
+    QByteArray tail = m_file.read(FOOTER_TAIL_BYTES);
+    quint64 groups = readLittleEndian<quint64>(tail.constData());
+    if (tail.size() != FOOTER_TAIL_BYTES
+        || readLittleEndian<quint32>(tail.constData() + 16) != COLUMNAR_MAGIC
+        || groups > quint64(size - HEADER_BYTES - FOOTER_TAIL_BYTES) / 8) {
+        m_error = "Missing or damaged footer; the file was not closed";
+        close();
+        return false;
+    }
+    m_rows = qint64(readLittleEndian<quint64>(tail.constData() + 8));
+
+    m_file.seek(size - FOOTER_TAIL_BYTES - qint64(groups) * 8);
+    QByteArray offsets = m_file.read(qint64(groups) * 8);
+    for (quint64 g = 0; g < groups; ++g) {
+        m_groupOffsets.append(readLittleEndian<quint64>(offsets.constData() + g * 8));
+    }
+    return true;
+}
+
+void ColumnarReader::close()
+{
+    m_file.close();
+    m_columns = 0;
+    m_groupOffsets.clear();
+    m_rows = 0;
+}
+
+QString ColumnarReader::errorString() const
+{
+    return m_error;
+}
+
+quint16 ColumnarReader::columns() const
+{
+    return m_columns;
+}
+
+int ColumnarReader::groupCount() const
+{
+    return m_groupOffsets.size();
+}
+
+qint64 ColumnarReader::rowCount() const
+{
+    return m_rows;
+}
+
+bool ColumnarReader::readGroup(int index, OutputBatch &batch)
+{
+    batch.clear();
+    if (index < 0 || index >= m_groupOffsets.size() || !m_file.seek(qint64(m_groupOffsets.at(index)))) {
+        m_error = "No such row group";
+        return false;
+    }
+    QByteArray count = m_file.read(4);
+    if (count.size() != 4) {
+        m_error = "Truncated row group";
+        return false;
+    }
+    int n = int(readLittleEndian<quint32>(count.constData()));
+    if (n > OUTPUT_BATCH_ROWS) {
+        m_error = "Damaged row group";
+        return false;
+    }
+    batch.time.resize(n);
+    batch.patient.resize(n);
+    for (std::vector<float> &v : batch.values) {
+        v.resize(n);
+    }
+
+    for (int c = 0; c < OutputColumnCount; ++c) {
+        if (!(m_columns & (1 << c))) {
+            continue;
+        }
+        QByteArray size = m_file.read(4);
+        QByteArray chunk = size.size() == 4
+                         ? m_file.read(readLittleEndian<quint32>(size.constData())) : QByteArray();
+        QByteArray raw = qUncompress(chunk);
+        if (raw.size() != n * columnWidth(c)) {
+            m_error = "Damaged column chunk";
+            batch.clear();
+            return false;
+        }
+        if (c == TimeColumn) {
+            unshuffle<quint64>(raw.constData(), n, batch.time.data());
+            for (int i = 1; i < n; ++i) {
+                batch.time[i] += batch.time[i - 1];
+            }
+        } else if (c == PatientColumn) {
+            unshuffle<quint32>(raw.constData(), n, batch.patient.data());
+            for (int i = 1; i < n; ++i) {
+                batch.patient[i] += batch.patient[i - 1];
+            }
+        } else {
+            unshuffle<quint32>(raw.constData(), n, batch.values[c - GlucoseColumn].data());
+        }
+    }
+    return true;
+}
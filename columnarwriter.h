@@ -0,0 +1,175 @@
+// columnarwriter.h
+#ifndef COLUMNARWRITER_H
+#define COLUMNARWRITER_H
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+#include <deque>
+#include <vector>
+
+class QThread;
+
+// Columns of the simulation output, in file order
+enum OutputColumn {
+    TimeColumn,         // int64, ms since the epoch (cohorts: since the run start)
+    PatientColumn,      // uint32, 0 for a single engine
+    GlucoseColumn,      // float32 from here on; mmol/L
+    IobColumn,          // Insulin on board, U
+    CobColumn,          // Carbs on board, g
+    BasalRateColumn,    // U/hr actually running, 0 when suspended
+    BolusColumn,        // U delivered as boluses since the previous row
+    BatteryColumn,      // %
+    ReservoirColumn,    // U left
+    OutputColumnCount
+};
+
+const int VALUE_COLUMN_COUNT = OutputColumnCount - GlucoseColumn;
+const quint16 ALL_OUTPUT_COLUMNS = (1 << OutputColumnCount) - 1;
+
+// Rows per row group: the unit of buffering, compression and reading back
+const int OUTPUT_BATCH_ROWS = 65536;
+
+const quint32 COLUMNAR_MAGIC = 0x4c4f4350;    // "PCOL"
+const quint16 COLUMNAR_VERSION = 1;
+
+struct OutputRow {
+    qint64 timeMs = 0;
+    quint32 patient = 0;
+    float values[VALUE_COLUMN_COUNT] = {};  // Indexed by column - GlucoseColumn
+
+    float &value(OutputColumn column) { return values[column - GlucoseColumn]; }
+};
+
+// Up to OUTPUT_BATCH_ROWS rows held column by column
+class OutputBatch
+{
+public:
+    void append(const OutputRow &row);
+    int size() const;
+    bool isFull() const;
+    void clear();
+
+    // Values of a float column, GlucoseColumn onwards
+    const std::vector<float> &column(OutputColumn column) const { return values[column - GlucoseColumn]; }
+
+    std::vector<qint64> time;
+    std::vector<quint32> patient;
+    std::vector<float> values[VALUE_COLUMN_COUNT];
+};
+
+// Streams simulation outputs to a compressed column file. Rows are
+// gathered into row groups of OUTPUT_BATCH_ROWS; full groups are handed
+// to background threads that encode, compress and append them, so the
+// simulation only copies rows into a batch. At most maxQueuedBatches
+// groups wait to be compressed; beyond that the producer waits (a stall,
+// counted) instead of memory growing, however many rows are written.
+//
+// File layout, all integers little-endian:
+//
+//     header      "PCOL", u16 version, u16 column mask, u32 rows per group, u32 0
+//     row group   u32 rows, then for each column in the mask, in OutputColumn
+//                 order: u32 chunk size, chunk
+//     footer      u64 offset of each row group, u64 group count,
+//                 u64 total rows, "PCOL"
+//
+// A chunk is a qCompress() block (u32 big-endian raw size, zlib stream)
+// of the column's values with their bytes regrouped by significance: all
+// first bytes, then all second bytes, and so on. Time and patient are
+// stored as differences from the previous row of the group (the first
+// from 0). Row groups are written in the order they finish, which with
+// several threads need not be the order they were submitted in.
+class ColumnarWriter
+{
+public:
+    ColumnarWriter();
+    ~ColumnarWriter();
+
+    // Settings, applied by the next open()
+    void setColumns(quint16 mask);          // Time is always kept
+    quint16 columns() const;
+    void setMaxQueuedBatches(int batches);
+    void setThreadCount(int threads);       // <= 0 uses one thread
+    void setCompressionLevel(int level);    // zlib 1 (fast) - 9 (small)
+
+    bool open(const QString &path);
+    bool isOpen() const;
+
+    // Add one row; not thread-safe, for a single producer such as an engine
+    void append(const OutputRow &row);
+
+    // Hand over a whole batch; thread-safe. batch comes back empty.
+    void submit(OutputBatch &batch);
+
+    // Write what is left and the footer, and stop the threads. False if
+    // anything failed to write.
+    bool close();
+    QString errorString() const;
+
+    qint64 rowsWritten() const;
+    qint64 rowGroupsWritten() const;
+    qint64 bytesWritten() const;            // Of the file so far
+    qint64 rawBytesWritten() const;         // Before compression
+    qint64 stallCount() const;              // Submits that had to wait
+    double stallSeconds() const;
+
+private:
+    void compressLoop();
+    QByteArray encode(const OutputBatch &batch, qint64 &rawBytes) const;
+    void setError(const QString &message);
+
+    quint16 m_columns = ALL_OUTPUT_COLUMNS;
+    int m_maxQueued = 8;
+    int m_threadCount = 1;
+    int m_level = 1;
+
+    QFile m_file;
+    QVector<QThread *> m_threads;
+    OutputBatch m_current;                  // Filled by append()
+
+    // Queue to the compressor threads, and spent batches kept for reuse
+    mutable QMutex m_queueMutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    std::deque<OutputBatch> m_queue;
+    std::vector<OutputBatch> m_spare;
+    bool m_closing = false;
+
+    // File position and totals, taken by each group as it is written
+    mutable QMutex m_fileMutex;
+    QVector<quint64> m_groupOffsets;
+    qint64 m_rows = 0;
+    qint64 m_bytes = 0;
+    qint64 m_rawBytes = 0;
+    QString m_error;
+
+    qint64 m_stalls = 0;
+    qint64 m_stallNs = 0;
+};
+
+// Reads a file written by ColumnarWriter back, one row group at a time
+class ColumnarReader
+{
+public:
+    bool open(const QString &path);
+    void close();
+    QString errorString() const;
+
+    quint16 columns() const;
+    int groupCount() const;
+    qint64 rowCount() const;
+
+    // Columns missing from the file come back as zeros
+    bool readGroup(int index, OutputBatch &batch);
+
+private:
+    QFile m_file;
+    QString m_error;
+    quint16 m_columns = 0;
+    QVector<quint64> m_groupOffsets;
+    qint64 m_rows = 0;
+};
+
+#endif // COLUMNARWRITER_H
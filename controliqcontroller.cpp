@@ -0,0 +1,201 @@
+// controliqcontroller.cpp
+#include "controliqcontroller.h"
+#include "cgm.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Share of what is on board that acts within the horizon. Treated as an
+// exponential decay with the curve's peak time as time constant, which
+// leaves ~2% at the insulin's duration of action, as the CGM curves do.
+double actingFraction(double horizonMinutes, double peakMinutes)
+{
+    return 1.0 - std::exp(-horizonMinutes / peakMinutes);
+}
+
+}
+
+ControlIQController::ControlIQController()
+    : m_therapy(),
+      m_basalHorizon(0.0),
+      m_correctionHorizon(0.0)
+{
+    setHorizons(30.0, 60.0);
+    reset();
+}
+
+void ControlIQController::setTherapy(const ProfileData &therapy)
+{
+    m_therapy = therapy;
+}
+
+ProfileData ControlIQController::therapy() const
+{
+    return m_therapy;
+}
+
+void ControlIQController::setHorizons(double basalMinutes, double correctionMinutes)
+{
+    if (basalMinutes <= 0.0 || correctionMinutes <= 0.0) {
+        return;
+    }
+    m_basalHorizon = basalMinutes;
+    m_correctionHorizon = correctionMinutes;
+    m_basalInsulinFraction = actingFraction(basalMinutes, DEFAULT_INSULIN_PEAK);
+    m_basalCarbFraction = actingFraction(basalMinutes, DEFAULT_CARB_PEAK);
+    m_correctionInsulinFraction = actingFraction(correctionMinutes, DEFAULT_INSULIN_PEAK);
+    m_correctionCarbFraction = actingFraction(correctionMinutes, DEFAULT_CARB_PEAK);
+}
+
+double ControlIQController::basalHorizon() const
+{
+    return m_basalHorizon;
+}
+
+double ControlIQController::correctionHorizon() const
+{
+    return m_correctionHorizon;
+}
+
+void ControlIQController::reset()
+{
+    m_next = 0;
+    m_count = 0;
+    m_trend = 0.0;
+    m_lastCorrection = -MIN_CORRECTION_INTERVAL;
+}
+
+void ControlIQController::saveState(QDataStream &out) const
+{
+    out << m_basalHorizon << m_correctionHorizon << qint32(m_next) << qint32(m_count);
+    for (int i = 0; i < TREND_READINGS; ++i) {
+        out << m_times[i] << m_values[i];
+    }
+    out << m_trend << m_lastCorrection;
+}
+
+bool ControlIQController::restoreState(QDataStream &in)
+{
+    double basalHorizon, correctionHorizon;
+    qint32 next, count;
+    in >> basalHorizon >> correctionHorizon >> next >> count;
+    for (int i = 0; i < TREND_READINGS; ++i) {
+        in >> m_times[i] >> m_values[i];
+    }
+    in >> m_trend >> m_lastCorrection;
+    if (in.status() != QDataStream::Ok || next < 0 || next >= TREND_READINGS
+        || count < 0 || count > TREND_READINGS) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        reset();
+        return false;
+    }
+    setHorizons(basalHorizon, correctionHorizon);
+    m_next = next;
+    m_count = count;
+    return true;
+}
+
+ControlIQDecision ControlIQController::update(double glucose, double minutes, double iob, double cob)
+{
+    // A gap or a clock jump makes the old readings useless for the trend
+    if (m_count > 0) {
+        double last = m_times[(m_next + TREND_READINGS - 1) % TREND_READINGS];
+        if (minutes <= last || minutes - last > MAX_READING_GAP) {
+            m_next = 0;
+            m_count = 0;
+        }
+    }
+    m_times[m_next] = minutes;
+    m_values[m_next] = glucose;
+    m_next = (m_next + 1) % TREND_READINGS;
+    m_count = std::min(m_count + 1, static_cast<int>(TREND_READINGS));
+    updateTrend();
+
+    ControlIQDecision d;
+    double cf = m_therapy.correctionFactor;
+    double carbEffect = (m_therapy.carbRatio > 0.0) ? cf / m_therapy.carbRatio : 0.0;
+    if (cf <= 0.0) {
+        cf = 0.0;
+        carbEffect = 0.0;
+    }
+
+    // Carbs already matched by bolus insulin would be counted twice
+    double uncovered = std::max(0.0, cob - iob * m_therapy.carbRatio);
+    d.predictedGlucose = glucose + m_trend * m_basalHorizon
+                       + uncovered * carbEffect * m_basalCarbFraction
+                       - iob * cf * m_basalInsulinFraction;
+    d.correctionPrediction = glucose + m_trend * m_correctionHorizon
+                           + uncovered * carbEffect * m_correctionCarbFraction
+                           - iob * cf * m_correctionInsulinFraction;
+    d.basalMultiplier = basalMultiplierFor(d.predictedGlucose);
+
+    // Correct towards target, less everything still on board so that
+    // corrections never stack
+    if (cf > 0.0 && d.correctionPrediction > CORRECT_ABOVE
+        && minutes - m_lastCorrection >= MIN_CORRECTION_INTERVAL) {
+        double need = (d.correctionPrediction - m_therapy.targetBG) / cf - iob;
+        if (need > 0.0) {
+            d.correctionBolus = CORRECTION_FRACTION * need;
+            m_lastCorrection = minutes;
+        }
+    }
+    return d;
+}
+
+double ControlIQController::trend() const
+{
+    return m_trend;
+}
+
+double ControlIQController::predict(double horizonMinutes, double iob, double cob) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+    double cf = std::max(0.0, m_therapy.correctionFactor);
+    double carbEffect = (m_therapy.carbRatio > 0.0) ? cf / m_therapy.carbRatio : 0.0;
+    double latest = m_values[(m_next + TREND_READINGS - 1) % TREND_READINGS];
+    double uncovered = std::max(0.0, cob - iob * m_therapy.carbRatio);
+    return latest + m_trend * horizonMinutes
+         + uncovered * carbEffect * actingFraction(horizonMinutes, DEFAULT_CARB_PEAK)
+         - iob * cf * actingFraction(horizonMinutes, DEFAULT_INSULIN_PEAK);
+}
+
+void ControlIQController::updateTrend()
+{
+    if (m_count < 2) {
+        m_trend = 0.0;
+        return;
+    }
+
+    // Least-squares slope; times relative to the newest reading keep the
+    // sums small however long the run has been going
+    double newest = m_times[(m_next + TREND_READINGS - 1) % TREND_READINGS];
+    double st = 0.0, sg = 0.0, stt = 0.0, stg = 0.0;
+    for (int i = 0; i < m_count; ++i) {
+        int k = (m_next + TREND_READINGS - 1 - i) % TREND_READINGS;
+        double t = m_times[k] - newest;
+        st += t;
+        sg += m_values[k];
+        stt += t * t;
+        stg += t * m_values[k];
+    }
+    double denom = m_count * stt - st * st;
+    m_trend = (denom > 0.0) ? (m_count * stg - st * sg) / denom : 0.0;
+}
+
+double ControlIQController::basalMultiplierFor(double predicted) const
+{
+    if (predicted < SUSPEND_BELOW) {
+        return 0.0;
+    }
+    if (predicted < REDUCE_BELOW) {
+        return (predicted - SUSPEND_BELOW) / (REDUCE_BELOW - SUSPEND_BELOW);
+    }
+    if (predicted > INCREASE_ABOVE) {
+        double rise = (predicted - INCREASE_ABOVE) / (CORRECT_ABOVE - INCREASE_ABOVE);
+        return std::min(MAX_BASAL_MULTIPLIER, 1.0 + rise * (MAX_BASAL_MULTIPLIER - 1.0));
+    }
+    return 1.0;
+}
@@ -0,0 +1,91 @@
+// controliqcontroller.h
+#ifndef CONTROLIQCONTROLLER_H
+#define CONTROLIQCONTROLLER_H
+
+#include "profilemanager.h"
+#include <QDataStream>
+
+// What the controller wants done after one CGM reading
+struct ControlIQDecision {
+    double predictedGlucose = 0.0;      // mmol/L at the basal horizon
+    double correctionPrediction = 0.0;  // mmol/L at the correction horizon
+    double basalMultiplier = 1.0;       // Times the profile basal rate, 0 = suspend
+    double correctionBolus = 0.0;       // U to deliver now, 0 for none
+};
+
+// Predictive Control-IQ style controller. Glucose is projected ahead from
+// the least-squares CGM trend plus the expected effect of insulin on board
+// and of any carbs on board it does not already cover; the short-horizon
+// prediction modulates basal and the long one triggers automatic
+// corrections (60% of the need, at most once an hour).
+//
+// The working state is a handful of readings and coefficients that only
+// change with the therapy or horizons, so update() is a fixed amount of
+// arithmetic with no allocation. It has no QObject so batch code can keep
+// one per patient.
+class ControlIQController
+{
+public:
+    static constexpr int TREND_READINGS = 4;                // ~15 min at 5 min ticks
+    static constexpr double MAX_READING_GAP = 30.0;         // Minutes before the trend restarts
+    static constexpr double SUSPEND_BELOW = 3.9;            // mmol/L, 70 mg/dL
+    static constexpr double REDUCE_BELOW = 6.25;            // mmol/L, 112.5 mg/dL
+    static constexpr double INCREASE_ABOVE = 8.9;           // mmol/L, 160 mg/dL
+    static constexpr double CORRECT_ABOVE = 10.0;           // mmol/L, 180 mg/dL
+    static constexpr double MAX_BASAL_MULTIPLIER = 1.5;
+    static constexpr double CORRECTION_FRACTION = 0.6;
+    static constexpr double MIN_CORRECTION_INTERVAL = 60.0; // Minutes
+
+    ControlIQController();
+
+    void setTherapy(const ProfileData &therapy);
+    ProfileData therapy() const;
+
+    // Prediction horizons in minutes (defaults 30 for basal, 60 for corrections)
+    void setHorizons(double basalMinutes, double correctionMinutes);
+    double basalHorizon() const;
+    double correctionHorizon() const;
+
+    // Forget the reading history and the last correction
+    void reset();
+
+    // Horizons, reading history and last correction; the therapy is the
+    // owner's to restore
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+
+    // Feed one reading taken at the given simulated minute, with the bolus
+    // insulin (U) and carbs (g) still on board, and get the decision
+    ControlIQDecision update(double glucose, double minutes, double iob, double cob);
+
+    // Current trend in mmol/L per minute (0 until two readings are in)
+    double trend() const;
+
+    // Projected glucose horizonMinutes after the latest reading
+    double predict(double horizonMinutes, double iob, double cob) const;
+
+private:
+    void updateTrend();
+    double basalMultiplierFor(double predicted) const;
+
+    ProfileData m_therapy;
+    double m_basalHorizon;
+    double m_correctionHorizon;
+
+    // Fraction of IOB/COB expected to act within each horizon
+    double m_basalInsulinFraction;
+    double m_basalCarbFraction;
+    double m_correctionInsulinFraction;
+    double m_correctionCarbFraction;
+
+    // Last TREND_READINGS readings, oldest overwritten first
+    double m_times[TREND_READINGS];
+    double m_values[TREND_READINGS];
+    int m_next;
+    int m_count;
+    double m_trend;
+
+    double m_lastCorrection;            // Minute of the last automatic correction
+};
+
+#endif // CONTROLIQCONTROLLER_H
@@ -0,0 +1,65 @@
+# Simulation core shared by the GUI app and the headless tools.
+# Depends on QtCore only.
+
+CONFIG += c++17
+INCLUDEPATH += $$PWD
+
+# Per-phase tick timers (see tickprofiler.h): qmake CONFIG+=tick_profiler
+tick_profiler: DEFINES += PUMP1_TICK_PROFILER
+
+SOURCES += \
+    $$PWD/absorptionmodel.cpp \
+    $$PWD/alarmmanager.cpp \
+    $$PWD/bolusexplorer.cpp \
+    $$PWD/cgm.cpp \
+    $$PWD/cohortrunner.cpp \
+    $$PWD/columnarwriter.cpp \
+    $$PWD/controliqcontroller.cpp \
+    $$PWD/eventscheduler.cpp \
+    $$PWD/glucosemodel.cpp \
+    $$PWD/glucosestore.cpp \
+    $$PWD/glycemicmetrics.cpp \
+    $$PWD/insulinpump.cpp \
+    $$PWD/logmodel.cpp \
+    $$PWD/patientbatch.cpp \
+    $$PWD/profilemanager.cpp \
+    $$PWD/profileschedule.cpp \
+    $$PWD/scenario.cpp \
+    $$PWD/simulationengine.cpp \
+    $$PWD/simulationworker.cpp \
+    $$PWD/systemlog.cpp \
+    $$PWD/tickprofiler.cpp \
+    $$PWD/timesimulator.cpp \
+    $$PWD/tracereplay.cpp \
+    $$PWD/workstealingpool.cpp
+
+HEADERS += \
+    $$PWD/absorptionmodel.h \
+    $$PWD/alarmmanager.h \
+    $$PWD/batchpatient.h \
+    $$PWD/bolusexplorer.h \
+    $$PWD/cgm.h \
+    $$PWD/cohortrunner.h \
+    $$PWD/columnarwriter.h \
+    $$PWD/controliqcontroller.h \
+    $$PWD/eventscheduler.h \
+    $$PWD/glucosemodel.h \
+    $$PWD/glucosestore.h \
+    $$PWD/glycemicmetrics.h \
+    $$PWD/insulinpump.h \
+    $$PWD/logmodel.h \
+    $$PWD/patientbatch.h \
+    $$PWD/philox.h \
+    $$PWD/profilemanager.h \
+    $$PWD/profileschedule.h \
+    $$PWD/ringbuffer.h \
+    $$PWD/scenario.h \
+    $$PWD/simulationengine.h \
+    $$PWD/simulationworker.h \
+    $$PWD/spscqueue.h \
+    $$PWD/systemlog.h \
+    $$PWD/therapyrules.h \
+    $$PWD/tickprofiler.h \
+    $$PWD/timesimulator.h \
+    $$PWD/tracereplay.h \
+    $$PWD/workstealingpool.h
@@ -0,0 +1,89 @@
+// eventscheduler.cpp
+#include "eventscheduler.h"
+#include <algorithm>
+
+EventScheduler::EventScheduler()
+    : m_sequence(0)
+{
+}
+
+void EventScheduler::schedule(double minutes, SimulationEventType type, int index, quint32 generation)
+{
+    m_heap.push_back({minutes, type, index, generation, m_sequence++});
+    std::push_heap(m_heap.begin(), m_heap.end(), later);
+}
+
+bool EventScheduler::isEmpty() const
+{
+    return m_heap.empty();
+}
+
+int EventScheduler::size() const
+{
+    return static_cast<int>(m_heap.size());
+}
+
+void EventScheduler::clear()
+{
+    m_heap.clear();
+}
+
+const ScheduledEvent &EventScheduler::next() const
+{
+    return m_heap.front();
+}
+
+ScheduledEvent EventScheduler::pop()
+{
+    std::pop_heap(m_heap.begin(), m_heap.end(), later);
+    ScheduledEvent e = m_heap.back();
+    m_heap.pop_back();
+    return e;
+}
+
+// Heap order: std::*_heap keep the "largest" first, so the event that
+// should run later compares as smaller
+bool EventScheduler::later(const ScheduledEvent &a, const ScheduledEvent &b)
+{
+    if (a.minutes != b.minutes) {
+        return a.minutes > b.minutes;
+    }
+    if (a.type != b.type) {
+        return a.type > b.type;
+    }
+    return a.sequence > b.sequence;
+}
+
+void EventScheduler::saveState(QDataStream &out) const
+{
+    // The heap array as is, so the restored queue pops in the same order
+    out << m_sequence << qint32(m_heap.size());
+    for (const ScheduledEvent &e : m_heap) {
+        out << e.minutes << qint32(e.type) << qint32(e.index) << e.generation << e.sequence;
+    }
+}
+
+bool EventScheduler::restoreState(QDataStream &in)
+{
+    qint32 size = 0;
+    in >> m_sequence >> size;
+    m_heap.clear();
+    for (qint32 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+        ScheduledEvent e;
+        qint32 type, index;
+        in >> e.minutes >> type >> index >> e.generation >> e.sequence;
+        if (type < ProfileSegmentEvent || type > BatteryAlarmEvent) {
+            in.setStatus(QDataStream::ReadCorruptData);
+        }
+        e.type = SimulationEventType(type);
+        e.index = index;
+        m_heap.push_back(e);
+    }
+    if (in.status() != QDataStream::Ok || size < 0
+        || !std::is_heap(m_heap.begin(), m_heap.end(), later)) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        m_heap.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+// eventscheduler.h
+#ifndef EVENTSCHEDULER_H
+#define EVENTSCHEDULER_H
+
+#include <QtGlobal>
+#include <QDataStream>
+#include <vector>
+
+// Kinds of simulation event. Events due at the same minute run in this
+// order, which is the order SimulationEngine::tick() does things in.
+enum SimulationEventType {
+    ProfileSegmentEvent,    // A new time-of-day profile segment takes effect
+    CgmSampleEvent,         // Sensor reading (steps the physiology)
+    MealDueEvent,           // index = position in the meal pattern
+    ScenarioDueEvent,       // Next event of the scenario timeline
+    ExtendedBolusEvent,     // One pulse of an extended bolus
+    ControlDecisionEvent,   // Control-IQ decision, basal and reservoir check
+    BatteryAlarmEvent       // Battery predicted to cross LOW_BATTERY_LEVEL
+};
+
+struct ScheduledEvent {
+    double minutes;             // Simulated minutes since the start
+    SimulationEventType type;
+    int index;                  // Type-specific payload
+    quint32 generation;         // Lets the owner drop events it has superseded
+    quint64 sequence;           // Insertion order, breaks remaining ties
+};
+
+// Pending simulation events, earliest first. A binary heap: schedule() and
+// pop() are O(log n) and the queue only ever holds a handful of events, so
+// time can jump straight from one event to the next however far apart.
+class EventScheduler
+{
+public:
+    EventScheduler();
+
+    void schedule(double minutes, SimulationEventType type, int index = 0, quint32 generation = 0);
+
+    bool isEmpty() const;
+    int size() const;
+    void clear();
+
+    // Earliest event; the queue must not be empty
+    const ScheduledEvent &next() const;
+    ScheduledEvent pop();
+
+    // Pending events and the tie-break counter, for snapshots
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+
+private:
+    static bool later(const ScheduledEvent &a, const ScheduledEvent &b);
+
+    std::vector<ScheduledEvent> m_heap;
+    quint64 m_sequence;
+};
+
+#endif // EVENTSCHEDULER_H
@@ -0,0 +1,244 @@
+// glucosechartwidget.cpp
+#include "glucosechartwidget.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QResizeEvent>
+#include <QDateTime>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const qint64 HOUR_MS = 60 * 60 * 1000;
+const int WINDOW_HOURS[] = {1, 3, 6, 24, 14 * 24};
+
+// Align a timestamp to the start of its bucket
+qint64 bucketStart(qint64 timeMs, qint64 bucketMs)
+{
+    qint64 r = timeMs % bucketMs;
+    return (r < 0) ? timeMs - r - bucketMs : timeMs - r;
+}
+
+}
+
+GlucoseChartWidget::GlucoseChartWidget(QWidget *parent)
+    : QWidget(parent),
+      m_store(CHART_RETENTION_HOURS),
+      m_chart(new QChart()),
+      m_series(new QLineSeries()),
+      m_axisX(new QDateTimeAxis()),
+      m_axisY(new QValueAxis()),
+      m_windowHours(6),
+      m_bucketMs(0),
+      m_lastBucketStart(0),
+      m_lastMin(0.0),
+      m_lastMax(0.0),
+      m_maxShown(0.0)
+{
+    // Chart, series and axes live for the lifetime of the widget
+    m_chart->addSeries(m_series);
+    m_chart->legend()->hide();
+    m_axisX->setTickCount(6);
+    m_axisX->setLabelsAngle(-45);
+    m_axisX->setTitleText("Time");
+    m_chart->addAxis(m_axisX, Qt::AlignBottom);
+    m_series->attachAxis(m_axisX);
+    m_axisY->setLabelFormat("%.1f");
+    m_axisY->setTitleText("Glucose (mmol/L)");
+    m_chart->addAxis(m_axisY, Qt::AlignLeft);
+    m_series->attachAxis(m_axisY);
+
+    m_view = new QChartView(m_chart, this);
+    m_view->setRenderHint(QPainter::Antialiasing);
+
+    // Window selection
+    QHBoxLayout *buttons = new QHBoxLayout();
+    for (int hours : WINDOW_HOURS) {
+        QString label = hours < 24 ? QString("%1h").arg(hours)
+                      : hours == 24 ? QString("24h") : QString("%1d").arg(hours / 24);
+        QPushButton *btn = new QPushButton(label, this);
+        btn->setCheckable(true);
+        btn->setChecked(hours == m_windowHours);
+        connect(btn, &QPushButton::clicked, this, [this, hours]() { setWindowHours(hours); });
+        buttons->addWidget(btn);
+        m_windowButtons.append(btn);
+    }
+    buttons->addStretch();
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(buttons);
+    layout->addWidget(m_view);
+
+    reload();
+}
+
+void GlucoseChartWidget::setWindowHours(int hours)
+{
+    m_windowHours = qMax(1, hours);
+    for (int i = 0; i < m_windowButtons.size(); ++i) {
+        m_windowButtons[i]->setChecked(WINDOW_HOURS[i] == m_windowHours);
+    }
+    reload();
+}
+
+int GlucoseChartWidget::windowHours() const
+{
+    return m_windowHours;
+}
+
+void GlucoseChartWidget::setReadings(const QVector<GlucoseReading> &readings)
+{
+    m_store.clear();
+    for (const GlucoseReading &r : readings) {
+        m_store.append(r.timestampMs, float(r.value));
+    }
+    reload();
+}
+
+void GlucoseChartWidget::addReadings(const QVector<GlucoseReading> &readings)
+{
+    qint64 latest = m_store.isEmpty() ? std::numeric_limits<qint64>::min() : m_store.last().timestampMs;
+    for (const GlucoseReading &r : readings) {
+        if (r.timestampMs <= latest) {
+            continue;
+        }
+        latest = r.timestampMs;
+        m_store.append(r.timestampMs, float(r.value));
+        appendSample(r.timestampMs, r.value, r.value);
+    }
+    if (latest > std::numeric_limits<qint64>::min()) {
+        trimBefore(latest - m_windowHours * HOUR_MS);
+        updateAxes(latest);
+    }
+}
+
+void GlucoseChartWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+
+    // Only redo the decimation when the column width actually changes
+    if (bucketWidthMs() != m_bucketMs) {
+        reload();
+    }
+}
+
+// Load the visible window from the store in one replace() call
+void GlucoseChartWidget::reload()
+{
+    m_bucketMs = bucketWidthMs();
+    m_maxShown = 0.0;
+
+    // Feed the series from the coarsest tier that is still finer than a column
+    GlucoseStore::Tier tier = GlucoseStore::RawTier;
+    if (m_bucketMs >= GlucoseStore::bucketMs(GlucoseStore::HourTier)) {
+        tier = GlucoseStore::HourTier;
+    } else if (m_bucketMs >= GlucoseStore::bucketMs(GlucoseStore::QuarterHourTier)) {
+        tier = GlucoseStore::QuarterHourTier;
+    }
+    if (m_bucketMs > 0) {
+        // Whole source buckets per column keeps appended readings aligned
+        qint64 source = GlucoseStore::bucketMs(tier);
+        m_bucketMs = (m_bucketMs + source - 1) / source * source;
+    }
+
+    QVector<QPointF> points;
+    qint64 latest = 0;
+    m_lastBucketStart = 0;
+
+    auto add = [&](qint64 timeMs, double low, double high) {
+        m_maxShown = qMax(m_maxShown, high);
+        latest = timeMs;
+        if (m_bucketMs == 0) {
+            points.append(QPointF(timeMs, low));
+            return;
+        }
+        qint64 start = bucketStart(timeMs, m_bucketMs);
+        if (!points.isEmpty() && start == m_lastBucketStart) {
+            m_lastMin = qMin(m_lastMin, low);
+            m_lastMax = qMax(m_lastMax, high);
+            points[points.size() - 2].setY(m_lastMin);
+            points[points.size() - 1].setY(m_lastMax);
+        } else {
+            m_lastBucketStart = start;
+            m_lastMin = low;
+            m_lastMax = high;
+            points.append(QPointF(start, low));
+            points.append(QPointF(start + m_bucketMs / 2, high));
+        }
+    };
+
+    if (tier == GlucoseStore::RawTier) {
+        for (const GlucoseReading &r : m_store.readings(m_windowHours)) {
+            add(r.timestampMs, r.value, r.value);
+        }
+    } else {
+        for (const GlucoseAggregate &a : m_store.aggregates(tier, m_windowHours)) {
+            add(a.startMs, a.min, a.max);
+        }
+    }
+
+    m_series->replace(points);
+    if (!points.isEmpty()) {
+        updateAxes(latest);
+    }
+}
+
+// Time span of one pixel column, or 0 when every reading gets its own point
+qint64 GlucoseChartWidget::bucketWidthMs() const
+{
+    int columns = qRound(m_chart->plotArea().width());
+    if (columns <= 0) {
+        columns = width();
+    }
+    columns = qMax(columns, 100);
+
+    qint64 bucket = m_windowHours * HOUR_MS / columns;
+    return bucket <= GlucoseStore::bucketMs(GlucoseStore::RawTier) ? 0 : bucket;
+}
+
+void GlucoseChartWidget::appendSample(qint64 timeMs, double low, double high)
+{
+    m_maxShown = qMax(m_maxShown, high);
+
+    if (m_bucketMs == 0) {
+        m_series->append(timeMs, low);
+        return;
+    }
+
+    qint64 start = bucketStart(timeMs, m_bucketMs);
+    int n = m_series->count();
+    if (n >= 2 && start == m_lastBucketStart) {
+        // Same pixel column: widen the min/max pair in place
+        m_lastMin = qMin(m_lastMin, low);
+        m_lastMax = qMax(m_lastMax, high);
+        m_series->replace(n - 2, QPointF(start, m_lastMin));
+        m_series->replace(n - 1, QPointF(start + m_bucketMs / 2, m_lastMax));
+    } else {
+        m_lastBucketStart = start;
+        m_lastMin = low;
+        m_lastMax = high;
+        m_series->append(start, low);
+        m_series->append(start + m_bucketMs / 2, high);
+    }
+}
+
+void GlucoseChartWidget::trimBefore(qint64 timeMs)
+{
+    int n = 0;
+    int count = m_series->count();
+    while (n < count && m_series->at(n).x() < timeMs) {
+        ++n;
+    }
+    if (n > 0) {
+        m_series->removePoints(0, n);
+    }
+}
+
+void GlucoseChartWidget::updateAxes(qint64 latestMs)
+{
+    m_axisX->setFormat(m_windowHours > 24 ? "MMM d" : "hh:mm");
+    m_axisX->setRange(QDateTime::fromMSecsSinceEpoch(latestMs - m_windowHours * HOUR_MS),
+                      QDateTime::fromMSecsSinceEpoch(latestMs));
+    m_axisY->setRange(2.0, qMax(20.0, std::ceil(m_maxShown + 1.0)));
+}
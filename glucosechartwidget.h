@@ -0,0 +1,69 @@
+// glucosechartwidget.h
+#ifndef GLUCOSECHARTWIDGET_H
+#define GLUCOSECHARTWIDGET_H
+
+#include <QWidget>
+#include <QVector>
+#include <QPointF>
+#include <QtCharts/QChartView>
+#include <QtCharts/QChart>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QDateTimeAxis>
+#include <QtCharts/QValueAxis>
+#include "glucosestore.h"
+
+QT_CHARTS_USE_NAMESPACE
+
+class QPushButton;
+
+// Longest window the chart offers, and so the history it keeps
+const int CHART_RETENTION_HOURS = 14 * 24;
+
+// Live CGM chart. The chart, series and axes are created once. Readings
+// come from the simulation thread's published states and are kept in a
+// store of the chart's own; new ones are appended to the series. Windows
+// that hold more readings than the plot is wide are decimated to one
+// min/max pair per pixel column, so the number of points drawn stays
+// bounded however much history exists.
+class GlucoseChartWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit GlucoseChartWidget(QWidget *parent = nullptr);
+
+    // Visible time window; reloads the series from the store
+    void setWindowHours(int hours);
+    int windowHours() const;
+
+    // Replace the whole history, or append readings, oldest first; ones
+    // not newer than the last reading held are skipped
+    void setReadings(const QVector<GlucoseReading> &readings);
+    void addReadings(const QVector<GlucoseReading> &readings);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void reload();
+    qint64 bucketWidthMs() const;
+    void appendSample(qint64 timeMs, double low, double high);
+    void trimBefore(qint64 timeMs);
+    void updateAxes(qint64 latestMs);
+
+    GlucoseStore   m_store;
+    QChart        *m_chart;
+    QChartView    *m_view;
+    QLineSeries   *m_series;
+    QDateTimeAxis *m_axisX;
+    QValueAxis    *m_axisY;
+    QVector<QPushButton *> m_windowButtons;
+
+    int    m_windowHours;
+    qint64 m_bucketMs;            // Time covered by one pixel column
+    qint64 m_lastBucketStart;     // Bucket currently held by the series tail
+    double m_lastMin;
+    double m_lastMax;
+    double m_maxShown;            // Highest value on screen, for the Y axis
+};
+
+#endif // GLUCOSECHARTWIDGET_H
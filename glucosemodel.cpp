@@ -0,0 +1,24 @@
+// glucosemodel.cpp
+#include "glucosemodel.h"
+
+GlucoseModel *GlucoseModel::create(GlucoseModelType type)
+{
+    switch (type) {
+    case BergmanGlucoseModel:
+        return new GlucoseModelAdapter<BergmanMinimalModel, BergmanGlucoseModel>();
+    case RandomWalkGlucoseModel:
+    default:
+        return new GlucoseModelAdapter<RandomWalkModel, RandomWalkGlucoseModel>();
+    }
+}
+
+QString GlucoseModel::name(GlucoseModelType type)
+{
+    switch (type) {
+    case BergmanGlucoseModel:
+        return "Bergman minimal model";
+    case RandomWalkGlucoseModel:
+    default:
+        return "Random walk";
+    }
+}
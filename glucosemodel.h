@@ -0,0 +1,269 @@
+// glucosemodel.h
+#ifndef GLUCOSEMODEL_H
+#define GLUCOSEMODEL_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// What drives the patient's glucose over one step. The rates are the
+// average absorption rates over the step, from the CGM's absorption curves.
+struct GlucoseInputs {
+    double insulinRate = 0.0;         // U/min of insulin reaching the blood
+    double carbRate = 0.0;            // g/min of carbs reaching the blood
+    double baseGlucose = 5.6;         // mmol/L the patient settles at
+    double insulinSensitivity = 1.0;  // Multiplier on insulin effect
+    bool   basalActive = true;
+};
+
+// A glucose model is a policy class with:
+//
+//     static constexpr int StateSize;           // state[0] is plasma glucose
+//     template <class T> using StateOf = std::array<T, StateSize>;
+//     static State initialState(double glucose, const GlucoseInputs &in);
+//     template <class T, class In>
+//     static StateOf<T> derivative(const StateOf<T> &s, const In &in);
+//
+// derivative() only uses arithmetic, so T can be double or a SIMD lane type
+// and In any struct with GlucoseInputs' fields (basalActive as 0 or 1).
+// FixedStepIntegrator<Model> integrates it with RK4. Batch code uses the
+// integrator directly so the model is fixed at compile time; the GUI picks
+// one at runtime through GlucoseModel.
+
+// The original random walk as an ODE: a pull towards the base level plus
+// linear insulin and carb terms, or a slow rise while basal is suspended.
+struct RandomWalkModel
+{
+    static constexpr int StateSize = 1;
+    template <class T> using StateOf = std::array<T, StateSize>;
+    typedef StateOf<double> State;
+
+    static constexpr double HOMEOSTASIS_RATE = 0.0102587;  // -ln(0.95) / 5 min
+    static constexpr double INSULIN_EFFECT = 4.0;          // mmol/L per U
+    static constexpr double CARB_EFFECT = 0.125;           // mmol/L per g
+    static constexpr double SUSPENDED_RISE = 0.02;         // mmol/L per min
+
+    static State initialState(double glucose, const GlucoseInputs &)
+    {
+        return State{{glucose}};
+    }
+
+    template <class T, class In>
+    static StateOf<T> derivative(const StateOf<T> &s, const In &in)
+    {
+        T pull = HOMEOSTASIS_RATE * (in.baseGlucose - s[0]);
+        T dG = in.basalActive * pull + (1.0 - in.basalActive) * SUSPENDED_RISE
+             + in.carbRate * CARB_EFFECT
+             - in.insulinRate * INSULIN_EFFECT * in.insulinSensitivity;
+        return StateOf<T>{{dG}};
+    }
+};
+
+// Bergman minimal model for a patient without endogenous insulin:
+//
+//     dG/dt = -(p1 + X) G + p1 Gb + Ra / VG
+//     dX/dt = -p2 X + p3 (I - Ib)
+//     dI/dt = -n I + u / VI
+//
+// G plasma glucose (mmol/L), X remote insulin action (1/min), I plasma
+// insulin (uU/mL), u insulin entering the blood, Ra glucose appearance from
+// the gut. Ib is the plasma insulin a reference basal rate settles at, so a
+// patient on that basal rate holds at Gb.
+struct BergmanMinimalModel
+{
+    static constexpr int StateSize = 3;
+    template <class T> using StateOf = std::array<T, StateSize>;
+    typedef StateOf<double> State;
+
+    static constexpr double P1 = 0.01;                 // Glucose effectiveness (1/min)
+    static constexpr double P2 = 0.025;                // Insulin action decay (1/min)
+    static constexpr double P3 = 1.3e-5;               // Insulin action gain (mL/uU/min^2)
+    static constexpr double N = 0.1;                   // Plasma insulin clearance (1/min)
+    static constexpr double VI = 12.0;                 // Insulin distribution volume (L)
+    static constexpr double VG = 16.0;                 // Glucose distribution volume (L)
+    static constexpr double CARB_BIOAVAILABILITY = 0.9;
+    static constexpr double MMOL_PER_GRAM = 1000.0 / 180.16;
+    static constexpr double REFERENCE_BASAL = 1.0;     // U/h that holds G at Gb
+
+    // uU/mL of plasma insulin per U/min entering the blood, per minute
+    static constexpr double INSULIN_INPUT = 1000.0 / VI;
+    static constexpr double BASAL_INSULIN = REFERENCE_BASAL / 60.0 * INSULIN_INPUT / N;
+
+    static State initialState(double glucose, const GlucoseInputs &)
+    {
+        return State{{glucose, 0.0, BASAL_INSULIN}};
+    }
+
+    template <class T, class In>
+    static StateOf<T> derivative(const StateOf<T> &s, const In &in)
+    {
+        T ra = in.carbRate * (MMOL_PER_GRAM * CARB_BIOAVAILABILITY / VG);
+        return StateOf<T>{{
+            -(P1 + s[1]) * s[0] + P1 * in.baseGlucose + ra,
+            -P2 * s[1] + P3 * in.insulinSensitivity * (s[2] - BASAL_INSULIN),
+            -N * s[2] + in.insulinRate * INSULIN_INPUT
+        }};
+    }
+};
+
+// Number of equal RK4 substeps, each no longer than stepMinutes, for a step
+inline int rk4Substeps(double minutes, double stepMinutes)
+{
+    return qMax(1, static_cast<int>(std::ceil(minutes / stepMinutes - 1e-9)));
+}
+
+// Classic fourth-order Runge-Kutta: advance s by substeps steps of h
+template <class Model, class T, class In>
+inline void rk4Advance(typename Model::template StateOf<T> &s, double h, int substeps, const In &in)
+{
+    typedef typename Model::template StateOf<T> State;
+    auto offset = [](const State &x, const State &d, double dt) {
+        State r;
+        for (int j = 0; j < Model::StateSize; ++j) {
+            r[j] = x[j] + d[j] * dt;
+        }
+        return r;
+    };
+
+    for (int i = 0; i < substeps; ++i) {
+        State k1 = Model::template derivative<T>(s, in);
+        State k2 = Model::template derivative<T>(offset(s, k1, h / 2.0), in);
+        State k3 = Model::template derivative<T>(offset(s, k2, h / 2.0), in);
+        State k4 = Model::template derivative<T>(offset(s, k3, h), in);
+        for (int j = 0; j < Model::StateSize; ++j) {
+            s[j] += h / 6.0 * (k1[j] + 2.0 * k2[j] + 2.0 * k3[j] + k4[j]);
+        }
+    }
+}
+
+// Fixed-step RK4 integrator for one patient. A call to step() is split
+// into equal substeps no longer than stepMinutes().
+template <class Model>
+class FixedStepIntegrator
+{
+public:
+    typedef typename Model::State State;
+
+    explicit FixedStepIntegrator(double stepMinutes = 1.0)
+    {
+        setStepMinutes(stepMinutes);
+        reset(5.6, GlucoseInputs());
+    }
+
+    void setStepMinutes(double minutes)
+    {
+        m_stepMinutes = minutes > 0.0 ? minutes : 1.0;
+    }
+
+    double stepMinutes() const
+    {
+        return m_stepMinutes;
+    }
+
+    void reset(double glucose, const GlucoseInputs &in)
+    {
+        m_state = Model::initialState(glucose, in);
+    }
+
+    double glucose() const
+    {
+        return m_state[0];
+    }
+
+    void setGlucose(double glucose)
+    {
+        m_state[0] = glucose;
+    }
+
+    const State &state() const
+    {
+        return m_state;
+    }
+
+    void setState(const State &state)
+    {
+        m_state = state;
+    }
+
+    // Advance by the given time with constant inputs; returns the new glucose
+    double step(double minutes, const GlucoseInputs &in)
+    {
+        if (minutes <= 0.0) {
+            return m_state[0];
+        }
+        int substeps = rk4Substeps(minutes, m_stepMinutes);
+        rk4Advance<Model, double>(m_state, minutes / substeps, substeps, in);
+        return m_state[0];
+    }
+
+private:
+    State m_state;
+    double m_stepMinutes = 1.0;
+};
+
+// Runtime-selectable model, for the GUI and other non-batch callers.
+enum GlucoseModelType {
+    RandomWalkGlucoseModel,
+    BergmanGlucoseModel
+};
+
+class GlucoseModel
+{
+public:
+    virtual ~GlucoseModel() {}
+
+    virtual GlucoseModelType type() const = 0;
+    virtual void reset(double glucose, const GlucoseInputs &in) = 0;
+    virtual double glucose() const = 0;
+    virtual void setGlucose(double glucose) = 0;
+    virtual double step(double minutes, const GlucoseInputs &in) = 0;
+    virtual void setStepMinutes(double minutes) = 0;
+    virtual double stepMinutes() const = 0;
+
+    // Full model state, for snapshots; setState() rejects a wrong size
+    virtual QVector<double> state() const = 0;
+    virtual bool setState(const QVector<double> &state) = 0;
+
+    static GlucoseModel *create(GlucoseModelType type);
+    static QString name(GlucoseModelType type);
+};
+
+// Binds a model policy to the runtime interface. The RK4 loop inside
+// step() is still fully inlined; only the call into step() is virtual.
+template <class Model, GlucoseModelType Type>
+class GlucoseModelAdapter final : public GlucoseModel
+{
+public:
+    GlucoseModelType type() const override { return Type; }
+    void reset(double glucose, const GlucoseInputs &in) override { m_integrator.reset(glucose, in); }
+    double glucose() const override { return m_integrator.glucose(); }
+    void setGlucose(double glucose) override { m_integrator.setGlucose(glucose); }
+    double step(double minutes, const GlucoseInputs &in) override { return m_integrator.step(minutes, in); }
+    void setStepMinutes(double minutes) override { m_integrator.setStepMinutes(minutes); }
+    double stepMinutes() const override { return m_integrator.stepMinutes(); }
+
+    QVector<double> state() const override
+    {
+        const typename Model::State &s = m_integrator.state();
+        return QVector<double>(s.begin(), s.end());
+    }
+
+    bool setState(const QVector<double> &state) override
+    {
+        if (state.size() != Model::StateSize) {
+            return false;
+        }
+        typename Model::State s;
+        std::copy(state.begin(), state.end(), s.begin());
+        m_integrator.setState(s);
+        return true;
+    }
+
+private:
+    FixedStepIntegrator<Model> m_integrator;
+};
+
+#endif // GLUCOSEMODEL_H
@@ -0,0 +1,193 @@
+// glucosestore.cpp
+#include "glucosestore.h"
+
+namespace {
+
+const qint64 RAW_INTERVAL_MS = 5 * 60 * 1000;
+
+qint64 alignDown(qint64 timeMs, qint64 bucket)
+{
+    qint64 r = timeMs % bucket;
+    return (r < 0) ? timeMs - r - bucket : timeMs - r;
+}
+
+}
+
+GlucoseStore::GlucoseStore(int retentionHours)
+    : m_retentionHours(0)
+{
+    setRetentionHours(retentionHours);
+}
+
+void GlucoseStore::setRetentionHours(int hours)
+{
+    m_retentionHours = qMax(1, hours);
+
+    int rawCapacity = m_retentionHours * int(3600000 / RAW_INTERVAL_MS);
+    m_rawTimes.setCapacity(rawCapacity);
+    m_rawValues.setCapacity(rawCapacity);
+
+    for (int t = QuarterHourTier; t < TierCount; ++t) {
+        // One extra slot for the partial bucket at the head
+        int capacity = m_retentionHours * bucketsPerHour(Tier(t)) + 1;
+        AggregateColumns &c = m_tiers[t];
+        c.start.setCapacity(capacity);
+        c.min.setCapacity(capacity);
+        c.mean.setCapacity(capacity);
+        c.max.setCapacity(capacity);
+        c.count.setCapacity(capacity);
+    }
+}
+
+int GlucoseStore::retentionHours() const
+{
+    return m_retentionHours;
+}
+
+void GlucoseStore::append(qint64 timeMs, float value)
+{
+    m_rawTimes.push(timeMs);
+    m_rawValues.push(value);
+
+    addToTier(QuarterHourTier, timeMs, value);
+    addToTier(HourTier, timeMs, value);
+}
+
+void GlucoseStore::clear()
+{
+    m_rawTimes.clear();
+    m_rawValues.clear();
+    for (int t = QuarterHourTier; t < TierCount; ++t) {
+        AggregateColumns &c = m_tiers[t];
+        c.start.clear();
+        c.min.clear();
+        c.mean.clear();
+        c.max.clear();
+        c.count.clear();
+    }
+}
+
+void GlucoseStore::saveState(QDataStream &out) const
+{
+    out << m_rawTimes << m_rawValues;
+    for (int t = QuarterHourTier; t < TierCount; ++t) {
+        const AggregateColumns &c = m_tiers[t];
+        out << c.start << c.min << c.mean << c.max << c.count;
+    }
+}
+
+bool GlucoseStore::restoreState(QDataStream &in)
+{
+    in >> m_rawTimes >> m_rawValues;
+    bool aligned = m_rawTimes.size() == m_rawValues.size();
+    for (int t = QuarterHourTier; t < TierCount; ++t) {
+        AggregateColumns &c = m_tiers[t];
+        in >> c.start >> c.min >> c.mean >> c.max >> c.count;
+        int n = c.start.size();
+        aligned = aligned && c.min.size() == n && c.mean.size() == n
+                  && c.max.size() == n && c.count.size() == n;
+    }
+    if (in.status() != QDataStream::Ok || !aligned) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+int GlucoseStore::size() const
+{
+    return m_rawValues.size();
+}
+
+bool GlucoseStore::isEmpty() const
+{
+    return m_rawValues.isEmpty();
+}
+
+GlucoseReading GlucoseStore::last() const
+{
+    return {m_rawTimes.last(), m_rawValues.last()};
+}
+
+GlucoseReading GlucoseStore::at(int i) const
+{
+    return {m_rawTimes.at(i), m_rawValues.at(i)};
+}
+
+GlucoseStore::ReadingView GlucoseStore::readings(int hours) const
+{
+    int count = qBound(0, hours * int(3600000 / RAW_INTERVAL_MS), size());
+    return ReadingView(this, size() - count, count);
+}
+
+GlucoseStore::AggregateView GlucoseStore::aggregates(Tier tier, int hours) const
+{
+    if (tier == RawTier) {
+        return AggregateView();
+    }
+    int available = m_tiers[tier].start.size();
+    int count = qBound(0, hours * bucketsPerHour(tier), available);
+    return AggregateView(this, tier, available - count, count);
+}
+
+GlucoseStore::Tier GlucoseStore::tierForHours(int hours)
+{
+    // Keep plots in the ~50 - 400 point range
+    if (hours <= 6) {
+        return RawTier;
+    }
+    if (hours <= 48) {
+        return QuarterHourTier;
+    }
+    return HourTier;
+}
+
+qint64 GlucoseStore::bucketMs(Tier tier)
+{
+    switch (tier) {
+    case QuarterHourTier: return 15 * 60 * 1000;
+    case HourTier:        return 60 * 60 * 1000;
+    default:              return RAW_INTERVAL_MS;
+    }
+}
+
+int GlucoseStore::bucketsPerHour(Tier tier)
+{
+    return int(3600000 / bucketMs(tier));
+}
+
+void GlucoseStore::addToTier(Tier tier, qint64 timeMs, float value)
+{
+    AggregateColumns &c = m_tiers[tier];
+    qint64 bucket = bucketMs(tier);
+    qint64 start = alignDown(timeMs, bucket);
+
+    if (c.start.isEmpty() || c.start.last() != start) {
+        // First reading of a new bucket
+        c.start.push(start);
+        c.min.push(value);
+        c.mean.push(value);
+        c.max.push(value);
+        c.count.push(1);
+        return;
+    }
+
+    // Update the partial bucket in place
+    quint16 n = c.count.last() + 1;
+    c.count.last() = n;
+    c.min.last() = qMin(c.min.last(), value);
+    c.max.last() = qMax(c.max.last(), value);
+    c.mean.last() += (value - c.mean.last()) / n;
+}
+
+GlucoseAggregate GlucoseStore::aggregateAt(Tier tier, int i) const
+{
+    const AggregateColumns &c = m_tiers[tier];
+    GlucoseAggregate a;
+    a.startMs = c.start.at(i);
+    a.min = c.min.at(i);
+    a.mean = c.mean.at(i);
+    a.max = c.max.at(i);
+    a.count = c.count.at(i);
+    return a;
+}
@@ -0,0 +1,181 @@
+// glucosestore.h
+#ifndef GLUCOSESTORE_H
+#define GLUCOSESTORE_H
+
+#include <QtGlobal>
+#include <QDateTime>
+#include <QDataStream>
+#include <iterator>
+#include "ringbuffer.h"
+
+struct GlucoseReading {
+    qint64 timestampMs;   // Simulated time, milliseconds since epoch
+    double value;         // Blood glucose value in mmol/L or mg/dL
+
+    QDateTime timestamp() const { return QDateTime::fromMSecsSinceEpoch(timestampMs); }
+};
+
+// Summary of all readings that fall into one fixed-length time bucket
+struct GlucoseAggregate {
+    qint64 startMs;       // Bucket start, aligned to the bucket length
+    float  min;
+    float  mean;
+    float  max;
+    int    count;
+};
+
+// Column-oriented CGM history. Raw readings are kept as separate time and
+// value columns, and two pre-aggregated tiers (15 min and 1 h min/mean/max)
+// are updated incrementally as readings arrive, so long-range views never
+// have to scan raw data. The newest bucket of each tier is partial and is
+// updated in place until a reading lands in the next bucket.
+class GlucoseStore
+{
+public:
+    enum Tier {
+        RawTier,              // One reading every 5 minutes
+        QuarterHourTier,      // 15 minute buckets
+        HourTier,             // 1 hour buckets
+        TierCount
+    };
+
+    // Iterator that assembles a value of type Item from the columns on the fly
+    template <typename View, typename Item>
+    class ColumnIterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Item;
+        using difference_type = int;
+        using pointer = const Item *;
+        using reference = Item;
+
+        ColumnIterator() = default;
+        ColumnIterator(const View *view, int index) : m_view(view), m_index(index) {}
+
+        Item operator*() const { return m_view->at(m_index); }
+        Item operator[](int n) const { return m_view->at(m_index + n); }
+
+        ColumnIterator &operator++() { ++m_index; return *this; }
+        ColumnIterator operator++(int) { ColumnIterator it = *this; ++m_index; return it; }
+        ColumnIterator &operator--() { --m_index; return *this; }
+        ColumnIterator operator--(int) { ColumnIterator it = *this; --m_index; return it; }
+        ColumnIterator &operator+=(int n) { m_index += n; return *this; }
+        ColumnIterator &operator-=(int n) { m_index -= n; return *this; }
+        ColumnIterator operator+(int n) const { return ColumnIterator(m_view, m_index + n); }
+        ColumnIterator operator-(int n) const { return ColumnIterator(m_view, m_index - n); }
+        int operator-(const ColumnIterator &other) const { return m_index - other.m_index; }
+
+        bool operator==(const ColumnIterator &other) const { return m_index == other.m_index; }
+        bool operator!=(const ColumnIterator &other) const { return m_index != other.m_index; }
+        bool operator<(const ColumnIterator &other) const { return m_index < other.m_index; }
+        bool operator>(const ColumnIterator &other) const { return m_index > other.m_index; }
+        bool operator<=(const ColumnIterator &other) const { return m_index <= other.m_index; }
+        bool operator>=(const ColumnIterator &other) const { return m_index >= other.m_index; }
+
+    private:
+        const View *m_view = nullptr;
+        int m_index = 0;
+    };
+
+    // Zero-copy window onto the newest raw readings
+    class ReadingView
+    {
+    public:
+        typedef ColumnIterator<ReadingView, GlucoseReading> const_iterator;
+
+        ReadingView() = default;
+        ReadingView(const GlucoseStore *store, int offset, int count)
+            : m_store(store), m_offset(offset), m_count(count) {}
+
+        int size() const { return m_count; }
+        bool isEmpty() const { return m_count == 0; }
+        qint64 timeAt(int i) const { return m_store->m_rawTimes.at(m_offset + i); }
+        float valueAt(int i) const { return m_store->m_rawValues.at(m_offset + i); }
+        GlucoseReading at(int i) const { return {timeAt(i), valueAt(i)}; }
+        GlucoseReading front() const { return at(0); }
+        GlucoseReading back() const { return at(m_count - 1); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, m_count); }
+
+    private:
+        const GlucoseStore *m_store = nullptr;
+        int m_offset = 0;
+        int m_count = 0;
+    };
+
+    // Zero-copy window onto the newest buckets of an aggregate tier
+    class AggregateView
+    {
+    public:
+        typedef ColumnIterator<AggregateView, GlucoseAggregate> const_iterator;
+
+        AggregateView() = default;
+        AggregateView(const GlucoseStore *store, Tier tier, int offset, int count)
+            : m_store(store), m_tier(tier), m_offset(offset), m_count(count) {}
+
+        int size() const { return m_count; }
+        bool isEmpty() const { return m_count == 0; }
+        GlucoseAggregate at(int i) const { return m_store->aggregateAt(m_tier, m_offset + i); }
+        GlucoseAggregate front() const { return at(0); }
+        GlucoseAggregate back() const { return at(m_count - 1); }
+
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, m_count); }
+
+    private:
+        const GlucoseStore *m_store = nullptr;
+        Tier m_tier = HourTier;
+        int m_offset = 0;
+        int m_count = 0;
+    };
+
+    explicit GlucoseStore(int retentionHours = 24);
+
+    // Hours of history kept in every tier
+    void setRetentionHours(int hours);
+    int retentionHours() const;
+
+    // Append a reading; timestamps are expected to be non-decreasing
+    void append(qint64 timeMs, float value);
+    void clear();
+
+    int size() const;
+    bool isEmpty() const;
+    GlucoseReading last() const;
+    GlucoseReading at(int i) const;   // 0 = oldest
+
+    // Newest readings / buckets covering the given number of hours
+    ReadingView readings(int hours) const;
+    AggregateView aggregates(Tier tier, int hours) const;
+
+    // Readings and buckets; restoring keeps the current retention, which
+    // must match the one saved
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+
+    // Coarsest tier that still gives a detailed plot of the span
+    static Tier tierForHours(int hours);
+    static qint64 bucketMs(Tier tier);
+
+private:
+    struct AggregateColumns {
+        RingBuffer<qint64>  start;
+        RingBuffer<float>   min;
+        RingBuffer<float>   mean;
+        RingBuffer<float>   max;
+        RingBuffer<quint16> count;
+    };
+
+    void addToTier(Tier tier, qint64 timeMs, float value);
+    GlucoseAggregate aggregateAt(Tier tier, int i) const;
+    static int bucketsPerHour(Tier tier);
+
+    int m_retentionHours;
+    RingBuffer<qint64> m_rawTimes;
+    RingBuffer<float>  m_rawValues;
+    AggregateColumns   m_tiers[TierCount];   // RawTier entry unused
+};
+
+#endif // GLUCOSESTORE_H
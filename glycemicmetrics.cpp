@@ -0,0 +1,255 @@
+// glycemicmetrics.cpp
+#include "glycemicmetrics.h"
+#include <cmath>
+
+namespace {
+
+const qint64 HOUR_MS = 60 * 60 * 1000;
+
+// Readings kept: the longest window at one every 5 min
+const int MAX_METRIC_SAMPLES = MAX_RETENTION_HOURS * READINGS_PER_HOUR;
+
+qint32 toMilli(double glucose)
+{
+    return qint32(std::lround(glucose * 1000.0));
+}
+
+// Band edges in 0.001 mmol/L: level 2 low, target range, level 2 high
+const qint32 VERY_LOW_MILLI = 3000;
+const qint32 LOW_MILLI = toMilli(LOW_GLUCOSE_THRESHOLD);
+const qint32 HIGH_MILLI = toMilli(HIGH_GLUCOSE_THRESHOLD);
+const qint32 VERY_HIGH_MILLI = 13900;
+
+GlucoseBand bandOf(qint32 milli)
+{
+    if (milli < VERY_LOW_MILLI) {
+        return VeryLowBand;
+    }
+    if (milli < LOW_MILLI) {
+        return LowBand;
+    }
+    if (milli <= HIGH_MILLI) {
+        return InRangeBand;
+    }
+    if (milli <= VERY_HIGH_MILLI) {
+        return HighBand;
+    }
+    return VeryHighBand;
+}
+
+}
+
+double glucoseManagementIndicator(double meanGlucose)
+{
+    // GMI (%) = 3.31 + 0.02392 x mean glucose in mg/dL
+    return 3.31 + 0.02392 * meanGlucose * 18.0;
+}
+
+// --- GlucoseHistogram ---
+
+int GlucoseHistogram::bin(double glucose)
+{
+    return qBound(0, int(glucose / GLUCOSE_HISTOGRAM_BIN), GLUCOSE_HISTOGRAM_BINS - 1);
+}
+
+void GlucoseHistogram::add(double glucose)
+{
+    ++m_bins[bin(glucose)];
+    ++m_count;
+}
+
+void GlucoseHistogram::remove(double glucose)
+{
+    --m_bins[bin(glucose)];
+    --m_count;
+}
+
+void GlucoseHistogram::merge(const GlucoseHistogram &other)
+{
+    for (int b = 0; b < GLUCOSE_HISTOGRAM_BINS; ++b) {
+        m_bins[b] += other.m_bins[b];
+    }
+    m_count += other.m_count;
+}
+
+void GlucoseHistogram::clear()
+{
+    m_bins.fill(0);
+    m_count = 0;
+}
+
+qint64 GlucoseHistogram::count() const
+{
+    return m_count;
+}
+
+double GlucoseHistogram::percentile(double percent) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+    // Readings are taken as spread evenly across their bin
+    double rank = qBound(0.0, percent, 100.0) / 100.0 * m_count;
+    qint64 below = 0;
+    for (int b = 0; b < GLUCOSE_HISTOGRAM_BINS; ++b) {
+        if (m_bins[b] > 0 && below + m_bins[b] >= rank) {
+            return (b + (rank - below) / m_bins[b]) * GLUCOSE_HISTOGRAM_BIN;
+        }
+        below += m_bins[b];
+    }
+    return MAX_VALID_GLUCOSE;
+}
+
+// --- GlycemicMetrics ---
+
+void GlycemicMetrics::Window::add(qint32 milli)
+{
+    sum += milli;
+    sumSquares += qint64(milli) * milli;
+    ++bands[bandOf(milli)];
+    histogram.add(milli / 1000.0);
+}
+
+void GlycemicMetrics::Window::remove(qint32 milli)
+{
+    sum -= milli;
+    sumSquares -= qint64(milli) * milli;
+    --bands[bandOf(milli)];
+    histogram.remove(milli / 1000.0);
+}
+
+GlycemicMetrics::GlycemicMetrics()
+    : m_samples(MAX_METRIC_SAMPLES)
+{
+}
+
+const GlycemicMetrics::Sample &GlycemicMetrics::sample(qint64 sequence) const
+{
+    return m_samples.at(int(sequence - (m_pushed - m_samples.size())));
+}
+
+void GlycemicMetrics::addReading(qint64 timestampMs, double glucose)
+{
+    Sample s{timestampMs, toMilli(glucose)};
+
+    // The oldest reading is about to be overwritten; let go of it first
+    if (m_samples.isFull()) {
+        qint64 oldest = m_pushed - m_samples.size();
+        for (Window &w : m_windows) {
+            if (w.tail == oldest) {
+                w.remove(m_samples.first().milli);
+                ++w.tail;
+            }
+        }
+    }
+    m_samples.push(s);
+    qint64 sequence = m_pushed++;
+
+    for (int i = 0; i < MetricsWindowCount; ++i) {
+        Window &w = m_windows[i];
+        w.add(s.milli);
+        qint64 cutoff = timestampMs - windowMs(MetricsWindow(i));
+        while (w.tail < sequence && sample(w.tail).timestampMs <= cutoff) {
+            w.remove(sample(w.tail).milli);
+            ++w.tail;
+        }
+    }
+}
+
+void GlycemicMetrics::clear()
+{
+    m_samples.clear();
+    m_pushed = 0;
+    for (Window &w : m_windows) {
+        w = Window();
+    }
+}
+
+GlycemicSummary GlycemicMetrics::summary(MetricsWindow window) const
+{
+    const Window &w = m_windows[window];
+    GlycemicSummary s;
+    s.readings = w.histogram.count();
+    if (s.readings == 0) {
+        return s;
+    }
+    double n = double(s.readings);
+    s.meanGlucose = w.sum / n / 1000.0;
+    double variance = (w.sumSquares - double(w.sum) * w.sum / n) / n / 1e6;
+    s.standardDeviation = std::sqrt(qMax(0.0, variance));
+    s.coefficientOfVariation = 100.0 * s.standardDeviation / s.meanGlucose;
+    s.gmi = glucoseManagementIndicator(s.meanGlucose);
+
+    s.timeBelow3_0 = 100.0 * w.bands[VeryLowBand] / n;
+    s.timeBelow3_9 = 100.0 * (w.bands[VeryLowBand] + w.bands[LowBand]) / n;
+    s.timeInRange = 100.0 * w.bands[InRangeBand] / n;
+    s.timeAbove10_0 = 100.0 * (w.bands[HighBand] + w.bands[VeryHighBand]) / n;
+    s.timeAbove13_9 = 100.0 * w.bands[VeryHighBand] / n;
+
+    s.percentile5 = w.histogram.percentile(5.0);
+    s.percentile25 = w.histogram.percentile(25.0);
+    s.median = w.histogram.percentile(50.0);
+    s.percentile75 = w.histogram.percentile(75.0);
+    s.percentile95 = w.histogram.percentile(95.0);
+    return s;
+}
+
+const GlucoseHistogram &GlycemicMetrics::histogram(MetricsWindow window) const
+{
+    return m_windows[window].histogram;
+}
+
+qint64 GlycemicMetrics::windowMs(MetricsWindow window)
+{
+    switch (window) {
+    case DayWindow:
+        return 24 * HOUR_MS;
+    case TwoWeekWindow:
+        return 14 * 24 * HOUR_MS;
+    case NinetyDayWindow:
+    default:
+        return 90 * 24 * HOUR_MS;
+    }
+}
+
+QString GlycemicMetrics::windowName(MetricsWindow window)
+{
+    switch (window) {
+    case DayWindow:
+        return "24 h";
+    case TwoWeekWindow:
+        return "14 d";
+    case NinetyDayWindow:
+    default:
+        return "90 d";
+    }
+}
+
+void GlycemicMetrics::saveState(QDataStream &out) const
+{
+    // Window totals go as raw bytes so a restore needs no recount
+    out << m_samples << m_pushed;
+    out.writeRawData(reinterpret_cast<const char *>(m_windows), int(sizeof(m_windows)));
+}
+
+bool GlycemicMetrics::restoreState(QDataStream &in)
+{
+    qint64 pushed = 0;
+    in >> m_samples >> pushed;
+    Window windows[MetricsWindowCount];
+    bool ok = in.readRawData(reinterpret_cast<char *>(windows), int(sizeof(windows))) == int(sizeof(windows))
+              && in.status() == QDataStream::Ok && pushed >= m_samples.size();
+    for (const Window &w : windows) {
+        ok = ok && w.tail >= pushed - m_samples.size() && w.tail <= pushed;
+    }
+    if (!ok) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        clear();
+        return false;
+    }
+    m_pushed = pushed;
+    for (int i = 0; i < MetricsWindowCount; ++i) {
+        m_windows[i] = windows[i];
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+// glycemicmetrics.h
+#ifndef GLYCEMICMETRICS_H
+#define GLYCEMICMETRICS_H
+
+#include <QDataStream>
+#include <QString>
+#include <array>
+#include "cgm.h"
+#include "ringbuffer.h"
+
+// Width of a histogram bin; percentiles are interpolated within a bin
+const double GLUCOSE_HISTOGRAM_BIN = 0.1;      // mmol/L
+const int GLUCOSE_HISTOGRAM_BINS = int(MAX_VALID_GLUCOSE / GLUCOSE_HISTOGRAM_BIN) + 1;
+
+// Glucose distribution in fixed bins. Two histograms merge by adding
+// counts, so per-thread or per-patient results combine exactly without
+// the raw readings, and a reading can be taken out again, which is what
+// a sliding window needs.
+class GlucoseHistogram
+{
+public:
+    void add(double glucose);
+    void remove(double glucose);
+    void merge(const GlucoseHistogram &other);
+    void clear();
+
+    qint64 count() const;
+
+    // Glucose below which percent % of readings fall; 0 when empty
+    double percentile(double percent) const;
+
+private:
+    static int bin(double glucose);
+
+    std::array<qint64, GLUCOSE_HISTOGRAM_BINS> m_bins = {};
+    qint64 m_count = 0;
+};
+
+// Sliding windows, each ending at the latest reading
+enum MetricsWindow {
+    DayWindow,          // 24 h
+    TwoWeekWindow,      // 14 d
+    NinetyDayWindow,    // 90 d
+    MetricsWindowCount
+};
+
+// Glucose ranges of the consensus time-in-range targets
+enum GlucoseBand {
+    VeryLowBand,        // < 3.0 mmol/L
+    LowBand,            // 3.0 - 3.9
+    InRangeBand,        // 3.9 - 10.0
+    HighBand,           // 10.0 - 13.9
+    VeryHighBand,       // > 13.9
+    GlucoseBandCount
+};
+
+// Outcome over one window; times are % of readings
+struct GlycemicSummary {
+    qint64 readings = 0;
+    double meanGlucose = 0.0;       // mmol/L
+    double standardDeviation = 0.0;
+    double coefficientOfVariation = 0.0;    // %
+    double gmi = 0.0;               // Glucose management indicator, %
+    double timeBelow3_0 = 0.0;
+    double timeBelow3_9 = 0.0;
+    double timeInRange = 0.0;
+    double timeAbove10_0 = 0.0;
+    double timeAbove13_9 = 0.0;
+    double percentile5 = 0.0;
+    double percentile25 = 0.0;
+    double median = 0.0;
+    double percentile75 = 0.0;
+    double percentile95 = 0.0;
+};
+
+// GMI (%) from mean glucose in mmol/L
+double glucoseManagementIndicator(double meanGlucose);
+
+// Running glycemic outcomes over the last 24 h, 14 d and 90 d, fed one
+// CGM reading at a time. Each window keeps integer sums (readings stored
+// to 0.001 mmol/L) and a histogram; a new reading is added to all of
+// them and readings that fall out of a window are taken away, so an
+// update is O(1) amortised and sums never drift. Readings are kept for
+// the longest window, up to one every 5 min; faster data shortens it.
+class GlycemicMetrics
+{
+public:
+    GlycemicMetrics();
+
+    // Readings must come in time order
+    void addReading(qint64 timestampMs, double glucose);
+    void clear();
+
+    GlycemicSummary summary(MetricsWindow window) const;
+    const GlucoseHistogram &histogram(MetricsWindow window) const;
+
+    static qint64 windowMs(MetricsWindow window);
+    static QString windowName(MetricsWindow window);
+
+    // Readings and window totals, for engine snapshots
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+
+private:
+    struct Sample {
+        qint64 timestampMs;
+        qint32 milli;           // Glucose in 0.001 mmol/L
+    };
+
+    struct Window {
+        qint64 tail = 0;        // Sequence number of the oldest reading in it
+        qint64 sum = 0;         // Of milli
+        qint64 sumSquares = 0;
+        qint64 bands[GlucoseBandCount] = {};
+        GlucoseHistogram histogram;
+
+        void add(qint32 milli);
+        void remove(qint32 milli);
+    };
+
+    const Sample &sample(qint64 sequence) const;
+
+    RingBuffer<Sample> m_samples;
+    qint64 m_pushed = 0;        // Sequence number of the next reading
+    Window m_windows[MetricsWindowCount];
+};
+
+#endif // GLYCEMICMETRICS_H
@@ -1,17 +1,34 @@
 #include "insulinpump.h"
+#include "therapyrules.h"
 #include <QDebug>
+#include <utility>
 
 InsulinPump::InsulinPump(QObject *parent)
     : QObject(parent),
       m_battery(100.0),
       m_insulinRemaining(300.0),
-      m_basalActive(false)
+      m_basalActive(false),
+      m_basalMultiplier(1.0),
+      m_recordedBasalRate(-1.0),
+      m_activeProfile(),
+      m_clockMinutes(0.0)
 {
 }
 
 void InsulinPump::setActiveProfile(const ProfileData &profile)
 {
     m_activeProfile = profile;
+    m_schedule = ProfileSchedule(profile);
+}
+
+void InsulinPump::setTimeOfDay(double minutes)
+{
+    m_clockMinutes = minutes;
+}
+
+double InsulinPump::timeOfDay() const
+{
+    return m_clockMinutes;
 }
 
 void InsulinPump::startBasalDelivery()
@@ -29,6 +46,35 @@ bool InsulinPump::isBasalActive() const
     return m_basalActive;
 }
 
+void InsulinPump::setBasalMultiplier(double multiplier)
+{
+    m_basalMultiplier = std::max(0.0, multiplier);
+}
+
+double InsulinPump::basalMultiplier() const
+{
+    return m_basalMultiplier;
+}
+
+void InsulinPump::setRecordedBasalRate(double unitsPerHour)
+{
+    m_recordedBasalRate = unitsPerHour < 0.0 ? -1.0 : unitsPerHour;
+}
+
+double InsulinPump::recordedBasalRate() const
+{
+    return m_recordedBasalRate;
+}
+
+double InsulinPump::currentBasalRate() const
+{
+    if (!m_basalActive) {
+        return 0.0;
+    }
+    return m_recordedBasalRate >= 0.0 ? m_recordedBasalRate
+                                      : m_schedule.basalRateAt(m_clockMinutes) * m_basalMultiplier;
+}
+
 void InsulinPump::setCGM(CGM *cgm) {
     m_cgm = cgm;
 }
@@ -39,15 +85,10 @@ void InsulinPump::setTimeSimulator(TimeSimulator *sim) {
 
 double InsulinPump::calculateBolus(double currentBG, double carbIntake)
 {
-
-    // 1. Carbohydrate coverage: carbs / carbRatio
-    // 2. Correction if currentBG > targetBG: (currentBG - targetBG) / correctionFactor
-    double insulinForCarbs = carbIntake / m_activeProfile.carbRatio;
-    double correction = 0.0;
-    if(currentBG > m_activeProfile.targetBG) {
-        correction = (currentBG - m_activeProfile.targetBG) / m_activeProfile.correctionFactor;
-    }
-    return insulinForCarbs + correction;
+    // Carb coverage plus correction less IOB, with the settings of the
+    // segment in effect now
+    double iob = m_cgm ? m_cgm->insulinOnBoard() : 0.0;
+    return mealBolusUnits(m_schedule.settingsAt(m_clockMinutes), currentBG, carbIntake, iob);
 }
 
 bool InsulinPump::deliverBolus(double units)
@@ -57,9 +98,20 @@ bool InsulinPump::deliverBolus(double units)
         return false;
     }
     consumeInsulin(units);
+    m_bolusDelivered += units;
+
+    // Notify CGM of insulin effect
+    if (m_cgm) {
+        m_cgm->registerBolusEffect(units);
+    }
     return true;
 }
 
+double InsulinPump::bolusUnitsDelivered() const
+{
+    return m_bolusDelivered;
+}
+
 void InsulinPump::useBattery(double amount)
 {
     m_battery -= amount;
@@ -80,19 +132,28 @@ double InsulinPump::insulinUnitsRemaining() const
 
 void InsulinPump::performBasalTick()
 {
-    if (!m_basalActive || m_activeProfile.basalRate <= 0.0)
-        return;
-
-    // 1 unit per hour = basalRate / 60 = units per minute
-    double insulinPerMinute = m_activeProfile.basalRate / 60.0;
-
     // Determine how many minutes each tick represents
     double simMinutesPerTick = SIMULATION_SPEED; // fallback
     if (m_timeSimulator) {
-        simMinutesPerTick = m_timeSimulator->simulationSpeed(); // e.g. 5.0 means 5 minutes per tick
+        simMinutesPerTick = m_timeSimulator->tickMinutes(); // e.g. 5.0 means 5 minutes per tick
     }
 
-    double insulinThisTick = insulinPerMinute * simMinutesPerTick;
+    performBasalTick(simMinutesPerTick);
+}
+
+void InsulinPump::performBasalTick(double simMinutes)
+{
+    double from = m_clockMinutes;
+    m_clockMinutes += simMinutes;
+    if (!m_basalActive)
+        return;
+
+    // Programmed insulin over the tick, across any segment changes in it
+    double insulinThisTick = m_recordedBasalRate >= 0.0
+                             ? m_recordedBasalRate / 60.0 * simMinutes
+                             : scheduledBasalUnits(m_schedule, from, m_clockMinutes, m_basalMultiplier);
+    if (insulinThisTick <= 0.0)
+        return;
 
     if (m_insulinRemaining < insulinThisTick) {
         insulinThisTick = m_insulinRemaining; // don't go negative
@@ -121,3 +182,33 @@ void InsulinPump::rechargeBattery() {
 void InsulinPump::replenishInsulin() {
     m_insulinRemaining = 300.0;
 }
+
+void InsulinPump::saveState(QDataStream &out) const
+{
+    out << m_battery << m_insulinRemaining << m_basalActive << m_basalMultiplier
+        << m_recordedBasalRate << m_activeProfile << m_clockMinutes;
+}
+
+void InsulinPump::swapState(InsulinPump &other)
+{
+    std::swap(m_battery, other.m_battery);
+    std::swap(m_insulinRemaining, other.m_insulinRemaining);
+    std::swap(m_basalActive, other.m_basalActive);
+    std::swap(m_basalMultiplier, other.m_basalMultiplier);
+    std::swap(m_recordedBasalRate, other.m_recordedBasalRate);
+    std::swap(m_activeProfile, other.m_activeProfile);
+    std::swap(m_schedule, other.m_schedule);
+    std::swap(m_clockMinutes, other.m_clockMinutes);
+}
+
+bool InsulinPump::restoreState(QDataStream &in)
+{
+    ProfileData profile;
+    in >> m_battery >> m_insulinRemaining >> m_basalActive >> m_basalMultiplier
+       >> m_recordedBasalRate >> profile >> m_clockMinutes;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    setActiveProfile(profile);
+    return true;
+}
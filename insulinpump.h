@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include "profilemanager.h"
+#include "profileschedule.h"
 #include "cgm.h"
 #include "timesimulator.h"
 
@@ -15,16 +16,37 @@ public:
     // Profile selection
     void setActiveProfile(const ProfileData &profile);
 
+    // Pump clock in minutes since midnight, picking the profile segment for
+    // boluses and basal; basal ticks move it forward
+    void setTimeOfDay(double minutes);
+    double timeOfDay() const;
+
     // Basal delivery
     void startBasalDelivery();
     void stopBasalDelivery();
     bool isBasalActive() const;
+
+    // Control-IQ scaling of the profile basal rate (1 = as programmed)
+    void setBasalMultiplier(double multiplier);
+    double basalMultiplier() const;
     void setCGM(CGM *cgm);
 
+    // Basal rate (U/hr) taken from a recorded trace; it replaces the
+    // profile and Control-IQ scaling until cleared. Negative clears it.
+    void setRecordedBasalRate(double unitsPerHour);
+    double recordedBasalRate() const;
+
+    // Basal rate (U/hr) running now, after scaling; 0 while suspended
+    double currentBasalRate() const;
+
     // Bolus
     double calculateBolus(double currentBG, double carbIntake);
     bool deliverBolus(double units);
 
+    // Total bolus insulin delivered since the pump was created (not saved
+    // in snapshots); differences give the boluses over a span of time
+    double bolusUnitsDelivered() const;
+
     // Battery & insulin management
     void useBattery(double amount);
     double batteryLevel() const;
@@ -34,15 +56,27 @@ public:
 
     // Simulation tick
     void performBasalTick();
+    void performBasalTick(double simMinutes);
 
     // time simulator
     void setTimeSimulator(TimeSimulator *sim);
 
+    // Levels, basal state, active profile and clock, for snapshots, and
+    // exchanging them with another pump
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+    void swapState(InsulinPump &other);
+
 private:
     double m_battery;           // [0..100%]
     double m_insulinRemaining;  // [0..300 units]
     bool   m_basalActive;
+    double m_basalMultiplier;
+    double m_recordedBasalRate;   // < 0 when the profile is in charge
+    double m_bolusDelivered = 0.0;
     ProfileData m_activeProfile;
+    ProfileSchedule m_schedule;
+    double m_clockMinutes;
     CGM *m_cgm = nullptr;
 
     //
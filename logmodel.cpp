@@ -0,0 +1,304 @@
+// logmodel.cpp
+#include "logmodel.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <limits>
+
+namespace {
+
+// Item views count rows in int
+int clampRows(qint64 n)
+{
+    return static_cast<int>(qMin<qint64>(n, std::numeric_limits<int>::max()));
+}
+
+}
+
+LogModel::LogModel(SystemLog *log, QObject *parent)
+    : QAbstractTableModel(parent),
+      m_log(log),
+      m_codeMask(ALL_LOG_EVENTS),
+      m_fromMs(std::numeric_limits<qint64>::min()),
+      m_toMs(std::numeric_limits<qint64>::max()),
+      m_filtered(false),
+      m_rowCount(0),
+      m_seen(0),
+      m_searchRow(0),
+      m_searchVisited(0),
+      m_nameMatches(0),
+      m_literalSearch(false)
+{
+    rebuildRows();
+
+    m_insertTimer.setSingleShot(true);
+    m_insertTimer.setInterval(LOG_MODEL_FRAME_MS);
+    connect(&m_insertTimer, &QTimer::timeout, this, &LogModel::insertAppended);
+    connect(m_log, &SystemLog::appended, this, &LogModel::onAppended);
+
+    m_searchTimer.setInterval(0);
+    connect(&m_searchTimer, &QTimer::timeout, this, &LogModel::searchSlice);
+}
+
+void LogModel::setFilter(quint32 codeMask, qint64 fromMs, qint64 toMs)
+{
+    cancelSearch();
+    beginResetModel();
+    m_codeMask = codeMask;
+    m_fromMs = fromMs;
+    m_toMs = toMs;
+    m_filtered = codeMask != ALL_LOG_EVENTS
+                 || fromMs != std::numeric_limits<qint64>::min()
+                 || toMs != std::numeric_limits<qint64>::max();
+    rebuildRows();
+    endResetModel();
+}
+
+quint32 LogModel::codeMask() const
+{
+    return m_codeMask;
+}
+
+bool LogModel::isFiltered() const
+{
+    return m_filtered;
+}
+
+void LogModel::rebuildRows()
+{
+    std::vector<qint64>().swap(m_rows);
+    m_seen = m_log->size();
+    if (!m_filtered) {
+        m_rowCount = clampRows(m_seen);
+        return;
+    }
+
+    m_log->forEach(m_fromMs, m_toMs, m_codeMask, [this](qint64 i, const LogRecord &) {
+        m_rows.push_back(i);
+        return m_rows.size() < size_t(std::numeric_limits<int>::max());
+    });
+    m_rowCount = static_cast<int>(m_rows.size());
+}
+
+qint64 LogModel::recordIndex(int row) const
+{
+    return m_filtered ? m_rows[row] : row;
+}
+
+LogRecord LogModel::record(int row) const
+{
+    return m_log->at(recordIndex(row));
+}
+
+bool LogModel::matchesFilter(const LogRecord &r) const
+{
+    return (m_codeMask & logEventBit(LogEventCode(r.code)))
+           && r.timestampMs >= m_fromMs && r.timestampMs <= m_toMs;
+}
+
+// --- Batched inserts ---
+
+void LogModel::onAppended()
+{
+    if (!m_insertTimer.isActive()) {
+        m_insertTimer.start();
+    }
+}
+
+void LogModel::insertAppended()
+{
+    qint64 size = m_log->size();
+    if (size < m_seen) {
+        // The log was closed or reopened underneath us
+        cancelSearch();
+        beginResetModel();
+        rebuildRows();
+        endResetModel();
+        return;
+    }
+
+    if (!m_filtered) {
+        int count = clampRows(size);
+        if (count > m_rowCount) {
+            beginInsertRows(QModelIndex(), m_rowCount, count - 1);
+            m_rowCount = count;
+            endInsertRows();
+        }
+    } else {
+        std::vector<qint64> added;
+        for (qint64 i = m_seen; i < size; ++i) {
+            if (matchesFilter(m_log->at(i))) {
+                added.push_back(i);
+            }
+        }
+        if (!added.empty()) {
+            beginInsertRows(QModelIndex(), m_rowCount, m_rowCount + static_cast<int>(added.size()) - 1);
+            m_rows.insert(m_rows.end(), added.begin(), added.end());
+            m_rowCount = static_cast<int>(m_rows.size());
+            endInsertRows();
+        }
+    }
+    m_seen = size;
+}
+
+// --- Incremental search ---
+
+void LogModel::startSearch(const QString &text, int fromRow)
+{
+    cancelSearch();
+    if (text.isEmpty()) {
+        return;
+    }
+    if (m_rowCount == 0) {
+        emit searchFinished(-1);
+        return;
+    }
+
+    m_searchText = text;
+    m_searchRow = qBound(0, fromRow, m_rowCount - 1);
+    m_searchVisited = 0;
+    m_nameMatches = 0;
+    for (int c = 0; c < LogEventCodeCount; ++c) {
+        if (SystemLog::codeName(LogEventCode(c)).contains(text, Qt::CaseInsensitive)) {
+            m_nameMatches |= logEventBit(LogEventCode(c));
+        }
+    }
+    m_literalSearch = true;
+    for (QChar c : text) {
+        if (c.isDigit() || c == '.' || c == '+' || c == '-') {
+            m_literalSearch = false;
+        }
+    }
+    m_textMatches.clear();
+    m_searchTimer.start();
+}
+
+void LogModel::cancelSearch()
+{
+    m_searchTimer.stop();
+    m_searchText.clear();
+}
+
+bool LogModel::isSearching() const
+{
+    return m_searchTimer.isActive();
+}
+
+bool LogModel::matchesSearch(const LogRecord &r)
+{
+    LogEventCode code = LogEventCode(r.code);
+    if (m_nameMatches & logEventBit(code)) {
+        return true;
+    }
+
+    // Notes and fixed texts repeat, so each distinct text is checked once.
+    // Text with no digits or number signs can only match the words around
+    // a payload's numbers, which are the same for all records of a code
+    // and text variant (an alarm's type, a scenario action, ...).
+    bool payload = code != NoteLogEvent && !SystemLog::hasFixedText(code);
+    if (payload && !m_literalSearch) {
+        return m_log->describe(r).contains(m_searchText, Qt::CaseInsensitive);
+    }
+    quint64 key = code == NoteLogEvent ? r.arg : (quint64(code) << 32) | SystemLog::textVariant(r);
+    auto it = m_textMatches.constFind(key);
+    if (it != m_textMatches.constEnd()) {
+        return it.value();
+    }
+    bool match = payload ? matchesLiterals(r)
+                         : m_log->describe(r).contains(m_searchText, Qt::CaseInsensitive);
+    m_textMatches.insert(key, match);
+    return match;
+}
+
+bool LogModel::matchesLiterals(const LogRecord &r) const
+{
+    // Search only between the numbers, which vary within a variant
+    QString text = m_log->describe(r);
+    const int n = text.size();
+    int start = 0;
+    for (int i = 0; i <= n; ++i) {
+        if (i < n && !text.at(i).isDigit() && text.at(i) != '.') {
+            continue;
+        }
+        if (text.mid(start, i - start).contains(m_searchText, Qt::CaseInsensitive)) {
+            return true;
+        }
+        // Skip the whole number, exponent included ("1e-05")
+        while (i + 1 < n && (text.at(i + 1).isDigit() || text.at(i + 1) == '.')) {
+            ++i;
+        }
+        int e = i + 1;
+        if (e < n && (text.at(e) == 'e' || text.at(e) == 'E')) {
+            int d = e + 1 < n && (text.at(e + 1) == '-' || text.at(e + 1) == '+') ? e + 2 : e + 1;
+            if (d < n && text.at(d).isDigit()) {
+                for (i = d; i + 1 < n && text.at(i + 1).isDigit(); ++i) {
+                }
+            }
+        }
+        start = i + 1;
+    }
+    return false;
+}
+
+void LogModel::searchSlice()
+{
+    QElapsedTimer slice;
+    slice.start();
+    while (m_searchVisited < m_rowCount) {
+        if (matchesSearch(record(m_searchRow))) {
+            int row = m_searchRow;
+            cancelSearch();
+            emit searchFinished(row);
+            return;
+        }
+        ++m_searchVisited;
+        m_searchRow = (m_searchRow + 1) % m_rowCount;
+        if ((m_searchVisited & 0xff) == 0 && slice.elapsed() >= LOG_SEARCH_SLICE_MS) {
+            return;     // Resume on the next timer pass
+        }
+    }
+    cancelSearch();
+    emit searchFinished(-1);
+}
+
+// --- QAbstractItemModel ---
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rowCount;
+}
+
+int LogModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= m_rowCount) {
+        return QVariant();
+    }
+
+    LogRecord r = record(index.row());
+    switch (index.column()) {
+    case TimeColumn:
+        return QDateTime::fromMSecsSinceEpoch(r.timestampMs).toString("yyyy-MM-dd hh:mm:ss");
+    case EventColumn:
+        return SystemLog::codeName(LogEventCode(r.code));
+    case DetailsColumn:
+        return m_log->describe(r);
+    }
+    return QVariant();
+}
+
+QVariant LogModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QVariant();
+    }
+    switch (section) {
+    case TimeColumn:    return "Time";
+    case EventColumn:   return "Event";
+    case DetailsColumn: return "Details";
+    }
+    return QVariant();
+}
@@ -0,0 +1,90 @@
+// logmodel.h
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QTimer>
+#include <vector>
+#include "systemlog.h"
+
+// Records appended within one frame are inserted as a single batch
+const int LOG_MODEL_FRAME_MS = 16;
+
+// Wall time one slice of a text search may take before yielding
+const int LOG_SEARCH_SLICE_MS = 8;
+
+// Table model over a SystemLog. Rows are never copied out of the log: with
+// no filter a row is a log index, and a filter keeps only the matching
+// indexes, built from the log's time and type indexes. Views ask for the
+// rows they draw, so the cost of a repaint does not grow with the log.
+class LogModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        TimeColumn,
+        EventColumn,
+        DetailsColumn,
+        ColumnCount
+    };
+
+    explicit LogModel(SystemLog *log, QObject *parent = nullptr);
+
+    // Show only records with a code in the mask and a timestamp in
+    // [fromMs, toMs]; ALL_LOG_EVENTS and the full qint64 range show all
+    void setFilter(quint32 codeMask, qint64 fromMs, qint64 toMs);
+    quint32 codeMask() const;
+    bool isFiltered() const;
+
+    qint64 recordIndex(int row) const;
+    LogRecord record(int row) const;
+
+    // Find the next row from fromRow on (wrapping) whose event name or text
+    // contains the text. Runs in time slices on the event loop and ends
+    // with searchFinished(); a new search or filter cancels the old one.
+    void startSearch(const QString &text, int fromRow);
+    void cancelSearch();
+    bool isSearching() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+signals:
+    void searchFinished(int row);   // -1 if nothing matched
+
+private slots:
+    void onAppended();
+    void insertAppended();
+    void searchSlice();
+
+private:
+    void rebuildRows();
+    bool matchesFilter(const LogRecord &r) const;
+    bool matchesSearch(const LogRecord &r);
+    bool matchesLiterals(const LogRecord &r) const;
+
+    SystemLog *m_log;
+    quint32 m_codeMask;
+    qint64 m_fromMs;
+    qint64 m_toMs;
+    bool m_filtered;
+    std::vector<qint64> m_rows;     // Log index per row, when filtered
+    int m_rowCount;
+    qint64 m_seen;                  // Log records already considered
+    QTimer m_insertTimer;
+
+    // Search in progress
+    QString m_searchText;
+    int m_searchRow;
+    int m_searchVisited;
+    quint32 m_nameMatches;              // Codes whose name contains the text
+    bool m_literalSearch;               // Text can't match inside a number
+    QHash<quint64, bool> m_textMatches; // Per note id / code and text variant
+    QTimer m_searchTimer;
+};
+
+#endif // LOGMODEL_H
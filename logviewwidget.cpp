@@ -0,0 +1,159 @@
+// logviewwidget.cpp
+#include "logviewwidget.h"
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QScrollBar>
+#include <QTableView>
+#include <QVBoxLayout>
+#include <limits>
+
+LogViewWidget::LogViewWidget(SystemLog *log, bool followTail, QWidget *parent)
+    : QWidget(parent),
+      m_log(log),
+      m_model(new LogModel(log, this)),
+      m_followTail(followTail),
+      m_atBottom(true)
+{
+    // Event type filter, as code masks
+    m_typeBox = new QComboBox(this);
+    m_typeBox->addItem("All events", ALL_LOG_EVENTS);
+    m_typeBox->addItem("Meals", logEventBit(MealLogEvent));
+    m_typeBox->addItem("Boluses", logEventBit(MealLogEvent) | logEventBit(CorrectionBolusLogEvent)
+                                  | logEventBit(ExtendedBolusDoneLogEvent));
+    m_typeBox->addItem("Control-IQ", logEventBit(CorrectionBolusLogEvent)
+                                     | logEventBit(BasalSuspendedLogEvent)
+                                     | logEventBit(BasalResumedLogEvent));
+    m_typeBox->addItem("Alarms", logEventBit(CriticalLowLogEvent) | logEventBit(CriticalHighLogEvent)
+                                 | logEventBit(AlarmRaisedLogEvent)
+                                 | logEventBit(AlarmAcknowledgedLogEvent)
+                                 | logEventBit(AlarmClearedLogEvent));
+    m_typeBox->addItem("Pump service", logEventBit(BatteryChargedLogEvent)
+                                       | logEventBit(InsulinReplenishedLogEvent));
+    m_typeBox->addItem("Notes", logEventBit(NoteLogEvent));
+    m_typeBox->addItem("Trace errors", logEventBit(TraceErrorLogEvent));
+    m_typeBox->addItem("Scenario", logEventBit(ScenarioLogEvent));
+
+    // Time range back from the newest entry, in minutes (0 = everything)
+    m_rangeBox = new QComboBox(this);
+    m_rangeBox->addItem("All time", 0);
+    m_rangeBox->addItem("Last hour", 60);
+    m_rangeBox->addItem("Last 24 h", 24 * 60);
+    m_rangeBox->addItem("Last 7 days", 7 * 24 * 60);
+
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setPlaceholderText("Search (Enter for next)");
+    m_searchEdit->setClearButtonEnabled(true);
+    m_countLabel = new QLabel(this);
+
+    m_view = new QTableView(this);
+    m_view->setModel(m_model);
+    m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_view->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_view->setWordWrap(false);
+    m_view->setShowGrid(false);
+    m_view->verticalHeader()->hide();
+    m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_view->verticalHeader()->setDefaultSectionSize(m_view->fontMetrics().height() + 4);
+    m_view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    m_view->horizontalHeader()->setStretchLastSection(true);
+    m_view->setColumnWidth(LogModel::TimeColumn, 150);
+    m_view->setColumnWidth(LogModel::EventColumn, 120);
+
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    filterLayout->addWidget(m_typeBox);
+    filterLayout->addWidget(m_rangeBox);
+    filterLayout->addWidget(m_searchEdit, 1);
+    filterLayout->addWidget(m_countLabel);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(filterLayout);
+    layout->addWidget(m_view);
+
+    connect(m_typeBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &LogViewWidget::onFilterChanged);
+    connect(m_rangeBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &LogViewWidget::onFilterChanged);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &LogViewWidget::onSearchTextChanged);
+    connect(m_searchEdit, &QLineEdit::returnPressed, this, &LogViewWidget::onSearchNext);
+    connect(m_model, &LogModel::searchFinished, this, &LogViewWidget::onSearchFinished);
+    connect(m_model, &LogModel::rowsAboutToBeInserted, this, &LogViewWidget::onRowsAboutToBeInserted);
+    connect(m_model, &LogModel::rowsInserted, this, &LogViewWidget::onRowsInserted);
+
+    updateCountLabel();
+    if (m_followTail) {
+        m_view->scrollToBottom();
+    }
+}
+
+void LogViewWidget::onFilterChanged()
+{
+    quint32 mask = m_typeBox->currentData().toUInt();
+    int minutes = m_rangeBox->currentData().toInt();
+    qint64 fromMs = std::numeric_limits<qint64>::min();
+    if (minutes > 0 && m_log->size() > 0) {
+        fromMs = m_log->at(m_log->size() - 1).timestampMs - qint64(minutes) * 60000;
+    }
+    m_model->setFilter(mask, fromMs, std::numeric_limits<qint64>::max());
+    updateCountLabel();
+    if (m_followTail) {
+        m_view->scrollToBottom();
+    }
+}
+
+void LogViewWidget::onSearchTextChanged(const QString &text)
+{
+    // Search as you type, from the current row so matches stay put
+    QModelIndex current = m_view->currentIndex();
+    m_model->startSearch(text, current.isValid() ? current.row() : 0);
+    updateCountLabel();
+}
+
+void LogViewWidget::onSearchNext()
+{
+    // From the row after the current one, wrapping past the last
+    QModelIndex current = m_view->currentIndex();
+    int rows = m_model->rowCount();
+    int from = current.isValid() && rows > 0 ? (current.row() + 1) % rows : 0;
+    m_model->startSearch(m_searchEdit->text(), from);
+    updateCountLabel();
+}
+
+void LogViewWidget::onSearchFinished(int row)
+{
+    if (row >= 0) {
+        QModelIndex index = m_model->index(row, LogModel::DetailsColumn);
+        m_view->setCurrentIndex(index);
+        m_view->scrollTo(index, QAbstractItemView::PositionAtCenter);
+        m_atBottom = false;
+    }
+    updateCountLabel();
+    if (row < 0) {
+        m_countLabel->setText(m_countLabel->text() + ", no match");
+    }
+}
+
+void LogViewWidget::onRowsAboutToBeInserted()
+{
+    QScrollBar *bar = m_view->verticalScrollBar();
+    m_atBottom = bar->value() == bar->maximum();
+}
+
+void LogViewWidget::onRowsInserted()
+{
+    if (m_followTail && m_atBottom) {
+        m_view->scrollToBottom();
+    }
+    updateCountLabel();
+}
+
+void LogViewWidget::updateCountLabel()
+{
+    QString text = QString("%1 entries").arg(m_model->rowCount());
+    if (m_model->isSearching()) {
+        text += ", searching...";
+    }
+    m_countLabel->setText(text);
+}
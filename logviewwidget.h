@@ -0,0 +1,46 @@
+// logviewwidget.h
+#ifndef LOGVIEWWIDGET_H
+#define LOGVIEWWIDGET_H
+
+#include <QWidget>
+#include "logmodel.h"
+
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QTableView;
+
+// Event log table with type, time range and text search controls. The
+// table has fixed row heights and never sizes columns to their contents,
+// so it only ever asks the model for the rows on screen.
+class LogViewWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    // With followTail the view keeps the newest entry in sight while the
+    // user has not scrolled away from the bottom
+    explicit LogViewWidget(SystemLog *log, bool followTail, QWidget *parent = nullptr);
+
+private slots:
+    void onFilterChanged();
+    void onSearchTextChanged(const QString &text);
+    void onSearchNext();
+    void onSearchFinished(int row);
+    void onRowsAboutToBeInserted();
+    void onRowsInserted();
+
+private:
+    void updateCountLabel();
+
+    SystemLog  *m_log;
+    LogModel   *m_model;
+    QTableView *m_view;
+    QComboBox  *m_typeBox;
+    QComboBox  *m_rangeBox;
+    QLineEdit  *m_searchEdit;
+    QLabel     *m_countLabel;
+    bool        m_followTail;
+    bool        m_atBottom;     // Scrolled to the end before the last insert
+};
+
+#endif // LOGVIEWWIDGET_H
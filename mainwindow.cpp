@@ -1,32 +1,47 @@
 #include "mainwindow.h"
+#include "bolusexplorerdialog.h"
+#include "glycemicmetrics.h"
+#include "tickprofiler.h"
+#include "tickprofilerwidget.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QDockWidget>
 #include <QDialog>
+#include <QFileDialog>
+#include <QSignalBlocker>
 #include <QDateTime>
-#include <QtCharts/QChart>
-#include <QtCharts/QLineSeries>
+#include <QStandardPaths>
+
+namespace {
+
+// The newest simulation state is drawn at most this often
+const int RENDER_INTERVAL_MS = 16;
+
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
-      m_profileManager(new ProfileManager(this)),
-      m_insulinPump(new InsulinPump(this)),
-      m_cgm(new CGM(this)),
-      m_systemLog(new SystemLog(this)),
-      m_timeSimulator(new TimeSimulator(this)),
-      m_extBolusRemaining(0.0),
-      m_extBolusRatePerTick(0.0),
-      m_simulationTimer(new QTimer(this))
+      m_worker(new SimulationWorker(this)),
+      m_renderTimer(new QTimer(this)),
+      m_historyGeneration(0)
 {
+    SimulationEngine *engine = m_worker->engine();
+    TimeSimulator *clock = m_worker->clock();
 
-     m_insulinPump->setTimeSimulator(m_timeSimulator);
+    // Event log persists across runs; the log is safe to read while the
+    // simulation thread appends to it
+    m_systemLog = engine->systemLog();
+    m_systemLog->open(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/eventlog");
+
+    // The chart's longest window
+    engine->cgm()->setRetentionHours(CHART_RETENTION_HOURS);
 
     setupUI();
 
-    // Connect CGM alerts
-    connect(m_cgm, &CGM::criticalLowGlucose, this, &MainWindow::onCriticalLowGlucose);
-    connect(m_cgm, &CGM::criticalHighGlucose, this, &MainWindow::onCriticalHighGlucose);
+    // The end of a replay, queued from the simulation thread
+    connect(m_worker, &SimulationWorker::traceReplayFinished, this, &MainWindow::onTraceReplayFinished);
 
     // Connect UI actions
     connect(m_createProfileBtn, &QPushButton::clicked, this, &MainWindow::onCreateProfile);
@@ -36,31 +51,40 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_stopInsulinBtn,   &QPushButton::clicked, this, &MainWindow::onStopInsulin);
     connect(m_manualBolusBtn,   &QPushButton::clicked, this, &MainWindow::onManualBolus);
     connect(m_viewHistoryBtn,   &QPushButton::clicked, this, &MainWindow::onViewHistory);
+    connect(m_saveSnapshotBtn,  &QPushButton::clicked, this, &MainWindow::onSaveSnapshot);
+    connect(m_loadSnapshotBtn,  &QPushButton::clicked, this, &MainWindow::onLoadSnapshot);
+    connect(m_replayTraceBtn,   &QPushButton::clicked, this, &MainWindow::onReplayTrace);
     connect(m_toggleSimTimeBtn, &QPushButton::clicked, this, &MainWindow::onTimeSimulationToggle);
-    connect(m_graph1hBtn,       &QPushButton::clicked, this, &MainWindow::onGraph1h);
-    connect(m_graph3hBtn,       &QPushButton::clicked, this, &MainWindow::onGraph3h);
-    connect(m_graph6hBtn,       &QPushButton::clicked, this, &MainWindow::onGraph6h);
+    connect(m_glucoseModelBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onGlucoseModelChanged);
+    connect(m_speedBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onSimulationSpeedChanged);
 
-    // Simulation timer
-    connect(m_simulationTimer, &QTimer::timeout, this, &MainWindow::onSimulationTick);
-    m_simulationTimer->start(1000);
+    // The time simulator is the only clock: one engine tick per clock tick
+    clock->setStartTime(engine->currentSimulatedTime());
+    clock->setTickMinutes(engine->tickMinutes());
 
     // Pre-seed 2h CGM data
-    QDateTime now = QDateTime::currentDateTime();
-    for(int i = 0; i < 24; ++i)  {
-        m_cgm->generateReading(now.addSecs(i * 300));
-    }
-    // Start time simulator
-    m_timeSimulator->start();
-    onSimulationTick();
+    engine->seedHistory(24);
+
+    // From here on the engine belongs to the simulation thread
+    m_worker->start();
+    m_worker->post([](SimulationEngine &, TimeSimulator &clock) { clock.start(); });
+
+    connect(m_renderTimer, &QTimer::timeout, this, &MainWindow::onRenderFrame);
+    m_renderTimer->start(RENDER_INTERVAL_MS);
 }
 
-MainWindow::~MainWindow() {}
+MainWindow::~MainWindow()
+{
+    // Before the widgets that read the log go
+    m_worker->stop();
+}
 
 void MainWindow::setupUI()
 {
     setWindowTitle("Tandem t:slim X2 Simulator");
-    resize(900, 600);
+    resize(900, 800);
 
     // Buttons
     m_createProfileBtn  = new QPushButton("Create Profile", this);
@@ -70,20 +94,34 @@ void MainWindow::setupUI()
     m_stopInsulinBtn    = new QPushButton("Stop Insulin", this);
     m_manualBolusBtn    = new QPushButton("Manual Bolus", this);
     m_viewHistoryBtn    = new QPushButton("View History", this);
+    m_saveSnapshotBtn   = new QPushButton("Save State", this);
+    m_loadSnapshotBtn   = new QPushButton("Load State", this);
+    m_replayTraceBtn    = new QPushButton("Replay Trace", this);
     m_toggleSimTimeBtn  = new QPushButton("Pause Simulation", this);
-    m_graph1hBtn        = new QPushButton("Graph 1h", this);
-    m_graph3hBtn        = new QPushButton("Graph 3h", this);
-    m_graph6hBtn        = new QPushButton("Graph 6h", this);
 
     // Labels
     m_simulatedTimeLabel = new QLabel("Simulated Time: Ready", this);
     m_batteryLabel       = new QLabel("Battery: 100%", this);
     m_insulinLabel       = new QLabel("Insulin: 300U / 300U", this);
     m_statusLabel        = new QLabel("Status: Ready", this);
+    m_metricsLabel       = new QLabel("24 h: no readings yet", this);
 
-    // Log viewer
-    m_logViewer = new QTextEdit(this);
-    m_logViewer->setReadOnly(true);
+    // Physiology behind the simulated CGM
+    m_glucoseModelBox = new QComboBox(this);
+    m_glucoseModelBox->addItem(GlucoseModel::name(RandomWalkGlucoseModel), RandomWalkGlucoseModel);
+    m_glucoseModelBox->addItem(GlucoseModel::name(BergmanGlucoseModel), BergmanGlucoseModel);
+
+    // Clock pace as a warp factor; 0 runs as fast as possible
+    m_speedBox = new QComboBox(this);
+    m_speedBox->addItem("Real time", 1.0);
+    m_speedBox->addItem("1 min/s", 60.0);
+    m_speedBox->addItem("5 min/s", SIMULATION_SPEED * 60.0);
+    m_speedBox->addItem("1 h/s", 3600.0);
+    m_speedBox->addItem("Max speed", 0.0);
+    m_speedBox->setCurrentIndex(2);
+
+    // Live log, following the newest entry
+    m_logView = new LogViewWidget(m_systemLog, true, this);
 
     // Layout
     QWidget *central = new QWidget(this);
@@ -96,21 +134,59 @@ void MainWindow::setupUI()
     topLayout->addWidget(m_stopInsulinBtn);
     topLayout->addWidget(m_manualBolusBtn);
     topLayout->addWidget(m_viewHistoryBtn);
+    topLayout->addWidget(m_saveSnapshotBtn);
+    topLayout->addWidget(m_loadSnapshotBtn);
+    topLayout->addWidget(m_replayTraceBtn);
     topLayout->addWidget(m_toggleSimTimeBtn);
-    topLayout->addWidget(m_graph1hBtn);
-    topLayout->addWidget(m_graph3hBtn);
-    topLayout->addWidget(m_graph6hBtn);
+    topLayout->addWidget(m_glucoseModelBox);
+    topLayout->addWidget(m_speedBox);
     mainLayout->addLayout(topLayout);
     mainLayout->addWidget(m_simulatedTimeLabel);
     mainLayout->addWidget(m_batteryLabel);
     mainLayout->addWidget(m_insulinLabel);
     mainLayout->addWidget(m_statusLabel);
-    mainLayout->addWidget(m_logViewer);
+    mainLayout->addWidget(m_metricsLabel);
+    mainLayout->addWidget(m_logView);
     setCentralWidget(central);
+
+    // Live glucose chart, docked under the log
+    m_glucoseChart = new GlucoseChartWidget(this);
+    QDockWidget *chartDock = new QDockWidget("Glucose", this);
+    chartDock->setWidget(m_glucoseChart);
+    addDockWidget(Qt::BottomDockWidgetArea, chartDock);
+
+    // Tick phase timings, tabbed behind the chart
+    QDockWidget *profilerDock = new QDockWidget("Tick Profile", this);
+    profilerDock->setWidget(new TickProfilerWidget(profilerDock));
+    addDockWidget(Qt::BottomDockWidgetArea, profilerDock);
+    tabifyDockWidget(chartDock, profilerDock);
+    chartDock->raise();
 }
 
 // --- User Action Slots ---
 
+void MainWindow::onGlucoseModelChanged(int index)
+{
+    GlucoseModelType type = static_cast<GlucoseModelType>(m_glucoseModelBox->itemData(index).toInt());
+    m_worker->post([type](SimulationEngine &engine, TimeSimulator &) {
+        engine.cgm()->setGlucoseModel(type);
+    });
+    logEvent(QString("Glucose model: %1").arg(GlucoseModel::name(type)));
+}
+
+void MainWindow::onSimulationSpeedChanged(int index)
+{
+    double warp = m_speedBox->itemData(index).toDouble();
+    // Recorded even while paused, so resuming runs at the speed shown
+    m_worker->post([warp](SimulationEngine &, TimeSimulator &clock) {
+        if (warp > 0.0) {
+            clock.setWarpFactor(warp);
+        }
+        clock.setRunMode(warp > 0.0 ? WarpClock : MaxSpeedClock);
+    });
+    logEvent(QString("Simulation speed: %1").arg(m_speedBox->itemText(index)));
+}
+
 void MainWindow::onCreateProfile()
 {
     bool ok;
@@ -129,18 +205,26 @@ void MainWindow::onCreateProfile()
     double tg = QInputDialog::getDouble(this, "Target BG", "Target Blood Glucose (mmol/L):", 5.5, 3.0, 15.0, 1, &ok);
     if (!ok) return;
 
-    if (!m_profileManager->createProfile(name, br, cr, cf, tg)) {
+    bool created = false;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        created = engine.profileManager()->createProfile(name, br, cr, cf, tg);
+        if (created) {
+            engine.setCurrentProfile({br, cr, cf, tg, {}});
+        }
+    });
+    if (!created) {
         QMessageBox::warning(this, "Profile Error", "Profile exists or invalid data");
         return;
     }
 
-    m_currentProfile = {br, cr, cf, tg};
     logEvent(QString("Profile '%1' created").arg(name));
 }
 
 void MainWindow::onUpdateProfile()
 {
-    QStringList names = m_profileManager->profileNames();
+    // Copied: the render timer keeps swapping states while the dialogs are open
+    ProfileData current = m_worker->state().currentProfile;
+    QStringList names = m_worker->state().profileNames;
     if (names.isEmpty()) {
         QMessageBox::warning(this, "No Profiles", "Create a profile first.");
         return;
@@ -150,26 +234,35 @@ void MainWindow::onUpdateProfile()
     QString sel = QInputDialog::getItem(this, "Select Profile to Update", "Profiles:", names, 0, false, &ok);
     if (!ok || sel.isEmpty()) return;
 
-    double br = QInputDialog::getDouble(this, "Basal Rate", "Basal Rate (Units/hour):", m_currentProfile.basalRate, 0.0, 10.0, 1, &ok);
+    double br = QInputDialog::getDouble(this, "Basal Rate", "Basal Rate (Units/hour):", current.basalRate, 0.0, 10.0, 1, &ok);
     if (!ok) return;
 
-    double cr = QInputDialog::getDouble(this, "Carbohydrate Ratio", "1 Unit per X grams of carbs:", m_currentProfile.carbRatio, 1.0, 100.0, 1, &ok);
+    double cr = QInputDialog::getDouble(this, "Carbohydrate Ratio", "1 Unit per X grams of carbs:", current.carbRatio, 1.0, 100.0, 1, &ok);
     if (!ok) return;
 
-    double cf = QInputDialog::getDouble(this, "Correction Factor", "1 Unit lowers BG by X mmol/L:", m_currentProfile.correctionFactor, 0.1, 10.0, 1, &ok);
+    double cf = QInputDialog::getDouble(this, "Correction Factor", "1 Unit lowers BG by X mmol/L:", current.correctionFactor, 0.1, 10.0, 1, &ok);
     if (!ok) return;
 
-    double tg = QInputDialog::getDouble(this, "Target BG", "Target Blood Glucose (mmol/L):", m_currentProfile.targetBG, 3.0, 15.0, 1, &ok);
+    double tg = QInputDialog::getDouble(this, "Target BG", "Target Blood Glucose (mmol/L):", current.targetBG, 3.0, 15.0, 1, &ok);
     if (!ok) return;
 
-    if (!m_profileManager->updateProfile(sel, br, cr, cf, tg)) {
+    bool updatedOk = false;
+    bool suspended = false;
+    ProfileData updated = {};
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        updatedOk = engine.profileManager()->updateProfile(sel, br, cr, cf, tg);
+        if (updatedOk) {
+            //Update active profile after edit
+            updated = engine.profileManager()->profile(sel);
+            engine.setCurrentProfile(updated);
+            engine.insulinPump()->setActiveProfile(updated);
+        }
+        suspended = engine.userSuspendedInsulin();
+    });
+    if (!updatedOk) {
         QMessageBox::warning(this, "Update Failed", "Could not update profile.");
     } else {
-        //Update active profile after edit
-        ProfileData updated = m_profileManager->profile(sel);
-        m_currentProfile = updated;
-        m_insulinPump->setActiveProfile(updated);
-        if(!m_userSuspendedInsulin){
+        if(!suspended){
             m_statusLabel->setText(QString("Basal active: %1 U/hr").arg(updated.basalRate));
         }
         logEvent(QString("Profile updated: %1").arg(sel));
@@ -178,7 +271,7 @@ void MainWindow::onUpdateProfile()
 
 void MainWindow::onDeleteProfile()
 {
-    QStringList names = m_profileManager->profileNames();
+    QStringList names = m_worker->state().profileNames;
     if (names.isEmpty()) {
         QMessageBox::warning(this, "No Profiles", "Nothing to delete.");
         return;
@@ -193,11 +286,17 @@ void MainWindow::onDeleteProfile()
         return;
     }
 
-    if (!m_profileManager->deleteProfile(sel)) {
+    bool deleted = false;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        deleted = engine.profileManager()->deleteProfile(sel);
+        if (deleted) {
+            // If we deleted the active profile, stop basal
+            engine.insulinPump()->stopBasalDelivery();
+        }
+    });
+    if (!deleted) {
         QMessageBox::warning(this, "Delete Failed", "Could not delete profile.");
     } else {
-        // If we deleted the active profile, stop basal
-        m_insulinPump->stopBasalDelivery();
         m_statusLabel->setText("Basal stopped");
         logEvent(QString("Profile deleted: %1").arg(sel));
     }
@@ -205,25 +304,34 @@ void MainWindow::onDeleteProfile()
 
 void MainWindow::onStartInsulin()
 {
-    QStringList names = m_profileManager->profileNames();
+    QStringList names = m_worker->state().profileNames;
     if (names.isEmpty()) { QMessageBox::warning(this, "No Profiles", "Create a profile first"); return; }
     bool ok;
     QString sel = QInputDialog::getItem(this, "Select Profile", "Profiles:", names, 0, false, &ok);
     if (!ok || sel.isEmpty()) return;
-    ProfileData pd = m_profileManager->profile(sel);
-    m_currentProfile = pd;
-    m_userSuspendedInsulin = false;
-    m_insulinPump->setActiveProfile(pd);
-    m_insulinPump->startBasalDelivery();
+    ProfileData pd = {};
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        pd = engine.profileManager()->profile(sel);
+        engine.setCurrentProfile(pd);
+        engine.setUserSuspendedInsulin(false);
+        engine.insulinPump()->setActiveProfile(pd);
+        engine.insulinPump()->startBasalDelivery();
+    });
     m_statusLabel->setText(QString("Basal active: %1 U/hr").arg(pd.basalRate));
     logEvent(QString("Basal started with '%1'").arg(sel));
 }
 
 void MainWindow::onStopInsulin()
 {
-    if(!m_userSuspendedInsulin){
-        m_userSuspendedInsulin = true;
-        m_insulinPump->stopBasalDelivery();
+    bool stopped = false;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        if(!engine.userSuspendedInsulin()){
+            engine.setUserSuspendedInsulin(true);
+            engine.insulinPump()->stopBasalDelivery();
+            stopped = true;
+        }
+    });
+    if(stopped){
         m_statusLabel->setText("Basal stopped");
         logEvent("Basal stopped");
     }
@@ -238,7 +346,7 @@ void MainWindow::onManualBolus()
         this,
         "Current BG",
         "mmol/L:",
-        m_cgm->currentGlucose(),      // default is your CGM reading
+        m_worker->state().glucose,      // default is your CGM reading
         0.0,          // min
         1000.0,       // max
         1,            // decimals
@@ -250,214 +358,320 @@ void MainWindow::onManualBolus()
     double carbs = QInputDialog::getDouble(this, "Carbs", "grams:", 0.0, 0.0, 200.0, 1, &ok);
     if (!ok) return;
 
-    double totalBolus = m_insulinPump->calculateBolus(bg, carbs);
+    // Forecast every split from the current state before choosing one; the
+    // clock holds still so the bolus goes in at the moment forecast
+    double totalBolus = 0.0;
+    bool wasRunning = false;
+    bool tracing = false;
+    QVector<BolusOutcome> outcomes;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &clock) {
+        totalBolus = engine.insulinPump()->calculateBolus(bg, carbs);
+        wasRunning = clock.isRunning();
+        clock.stop();
+        // Forks cannot follow a trace, so their forecast would not be this run's
+        tracing = engine.traceReplay() != nullptr;
+        if (!tracing) {
+            outcomes = m_bolusExplorer.explore(engine, totalBolus, carbs, BolusExplorer::defaultCandidates());
+        }
+    });
+
+    bool accepted = false;
+    BolusCandidate choice{100, 0.0};
+    if (tracing) {
+        // No forecast while replaying: ask for the split directly
+        QMessageBox::information(this, "Bolus Options",
+                                 "A trace is being replayed, so bolus options cannot be forecast.");
+        int frac = QInputDialog::getInt(this, "Immediate Fraction", "% immediate (rest ext):", 60, 0, 100, 1, &ok);
+        int hours = ok ? QInputDialog::getInt(this, "Extended Duration", "Hours:", 3, 1, 12, 1, &ok) : 0;
+        accepted = ok;
+        choice = BolusCandidate{frac, double(hours)};
+    } else {
+        BolusExplorerDialog dialog(outcomes, totalBolus, carbs, m_bolusExplorer.lastRunMs(), this);
+        accepted = dialog.exec() == QDialog::Accepted;
+        choice = dialog.selectedCandidate();
+    }
+
+    m_worker->post([=](SimulationEngine &engine, TimeSimulator &clock) {
+        if (accepted) {
+            double imm = choice.extendedHours > 0.0 ? totalBolus * choice.immediatePercent / 100.0 : totalBolus;
+            double ext = totalBolus - imm;
 
-    // Immediate fraction prompt
-    int frac = QInputDialog::getInt(this, "Immediate Fraction", "% immediate (rest ext):", 60, 0, 100, 1, &ok);
-    if (!ok) return;
+            // The carbs count toward glucose, as they did in the forecast
+            if (carbs > 0)
+                engine.cgm()->registerCarbEffect(carbs);
 
-    // Extended duration prompt
-    int hours = QInputDialog::getInt(this, "Extended Duration", "Hours:", 3, 1, 12, 1, &ok);
-    if (!ok) return;
+            // Deliver immediate
+            if (engine.insulinPump()->deliverBolus(imm))
+                engine.logEvent(QString("Immediate bolus: %1 U").arg(imm));
 
-    double imm = totalBolus * frac / 100.0;
-    double ext = totalBolus - imm;
-
-    // Deliver immediate
-    if (m_insulinPump->deliverBolus(imm))
-        logEvent(QString("Immediate bolus: %1 U").arg(imm));
-
-    // Schedule extended
-    double ticksPerHour = 60.0 / m_timeSimulator->simulationSpeed();
-    double totalTicks = ticksPerHour * hours;
-    m_extBolusRatePerTick = (totalTicks>0 ? ext / totalTicks : 0.0);
-    m_extBolusRemaining = ext;
-    if (ext > 0)
-        logEvent(QString("Scheduled extended bolus: %1 U over %2 h (%3 U/tick)")
-                 .arg(ext).arg(hours).arg(m_extBolusRatePerTick));
+            // Schedule extended
+            if (ext > 0) {
+                engine.scheduleExtendedBolus(ext, choice.extendedHours);
+                engine.logEvent(QString("Scheduled extended bolus: %1 U over %2 h (%3 U/tick)")
+                                .arg(ext).arg(choice.extendedHours).arg(engine.extendedBolusRatePerTick()));
+            }
+        }
+        if (wasRunning) {
+            clock.start();
+        }
+    });
 }
 
-
 void MainWindow::onViewHistory()
 {
-    QString h = m_systemLog->fullLog();
-    if (h.isEmpty()) QMessageBox::information(this, "History", "No logs available.");
-    else QMessageBox::information(this, "History", h);
+    // Browsable history over the same log; stays open alongside the simulation
+    QDialog *dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle("History");
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    layout->addWidget(new LogViewWidget(m_systemLog, false, dialog));
+    dialog->resize(800, 600);
+    dialog->show();
 }
 
-void MainWindow::onCheckForErrors()
+void MainWindow::onSaveSnapshot()
 {
-    if (m_insulinPump->batteryLevel() < 5.0) {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle("Low Battery");
-        msgBox.setText("Battery is critically low.");
-        QPushButton *rechargeBtn = msgBox.addButton("Recharge", QMessageBox::AcceptRole);
-        msgBox.exec();
-
-        if (msgBox.clickedButton() == rechargeBtn) {
-            m_insulinPump->rechargeBattery();
-            logEvent("Pump charged to 100%.");
-        }
+    QString path = QFileDialog::getSaveFileName(this, "Save State", QString(),
+                                                "Simulator state (*.psnap)");
+    if (path.isEmpty()) return;
+    bool saved = false;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        saved = engine.saveSnapshot(path);
+    });
+    if (!saved) {
+        QMessageBox::warning(this, "Save Failed", "Could not write " + path);
+        return;
     }
+    logEvent(QString("State saved to %1").arg(path));
+}
 
-    if (m_insulinPump->insulinUnitsRemaining() < 5.0) {
-        QMessageBox msgBox;
-        msgBox.setWindowTitle("Low Insulin");
-        msgBox.setText("Insulin is critically low.");
-        QPushButton *replaceBtn = msgBox.addButton("Replace Cartridge", QMessageBox::AcceptRole);
-        msgBox.exec();
-
-        if (msgBox.clickedButton() == replaceBtn) {
-            m_insulinPump->replenishInsulin();
-            logEvent("Pump insulin replenished to 300u.");
+void MainWindow::onLoadSnapshot()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Load State", QString(),
+                                                "Simulator state (*.psnap)");
+    if (path.isEmpty()) return;
+    bool loaded = false;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &clock) {
+        loaded = engine.loadSnapshot(path);
+        if (loaded) {
+            // The chart gets the restored history with the next state
+            clock.setTickMinutes(engine.tickMinutes());
+            m_worker->resetHistory();
         }
+    });
+    if (!loaded) {
+        QMessageBox::warning(this, "Load Failed", "Not a valid simulator state: " + path);
+        return;
     }
-}
 
-// --- Simulation Slot ---
-
-void MainWindow::onTimeSimulationToggle()
-{
-    if (m_timeSimulator->isRunning()) {
-        // Stop simulation components
-        m_timeSimulator->stop();
-        m_simulationTimer->stop();  // <-- stop the periodic update timer too
-        m_toggleSimTimeBtn->setText("Start");
-        logEvent("Simulation paused");
-    } else {
-        // Resume simulation
-        m_timeSimulator->start();
-        m_simulationTimer->start(1000);  // <-- resume updates every 1s
-        m_toggleSimTimeBtn->setText("Pause");
-        logEvent("Simulation resumed");
+    // Bring the controls and chart in line with the restored run
+    onRenderFrame();
+    {
+        QSignalBlocker blocker(m_glucoseModelBox);
+        m_glucoseModelBox->setCurrentIndex(m_glucoseModelBox->findData(m_worker->state().glucoseModel));
     }
+    logEvent(QString("State loaded from %1").arg(path));
 }
 
-void MainWindow::onSimulationTick()
+void MainWindow::onReplayTrace()
 {
-    // 1) Simulated time label
-    m_simulatedTimeLabel->setText("Sim Time: " +
-    m_timeSimulator->currentSimulatedTime().toString("hh:mm:ss"));
-
-    // 2) CGM reading
-    m_cgm->setBasalActive(m_insulinPump->isBasalActive());
-    m_cgm->generateReading(m_timeSimulator->currentSimulatedTime());
-    double currentBG = m_cgm->currentGlucose(); //Gets current Blood Glucose Lvl
-
-    // 3) Extended bolus
-    if (m_extBolusRemaining > 0.0) {
-        double deliver = qMin(m_extBolusRatePerTick, m_extBolusRemaining);
-        if (m_insulinPump->deliverBolus(deliver)) {
-            m_extBolusRemaining -= deliver;
-            if (m_extBolusRemaining <= 0.0) {
-                logEvent("Extended bolus completed.");
-            }
-        }
+    if (m_trace.isOpen()) {
+        stopTraceReplay();
+        return;
     }
 
-    // 4) Control-IQ
-    // Allow correction bolus regardless of user insulin pause flag
-    if (currentBG > HIGH_GLUCOSE_THRESHOLD) {
-        double corr = (currentBG - m_currentProfile.targetBG) / m_currentProfile.correctionFactor;
-        if (corr > 0 && m_insulinPump->deliverBolus(corr)) {
-            logEvent(QString("Control-IQ: Correction bolus %1 U").arg(corr));
-        }
+    QString path = QFileDialog::getOpenFileName(this, "Replay Trace", QString(),
+                                                "Recorded trace (*.csv);;All files (*)");
+    if (path.isEmpty()) return;
+    if (!m_trace.open(path)) {
+        QMessageBox::warning(this, "Replay Failed", "Could not open " + path + ": " + m_trace.errorString());
+        return;
     }
-
-    // Basal control — only act if user hasn't explicitly paused
-    if (!m_userSuspendedInsulin) {
-        // Suspend basal if BG is too low
-        if (currentBG < LOW_GLUCOSE_THRESHOLD) {
-            if (m_insulinPump->isBasalActive()) {
-                m_insulinPump->stopBasalDelivery();
-                logEvent("Control-IQ: Basal suspended (low BG)");
-            }
-        } else {
-            // Resume basal if BG is safe
-            if (!m_insulinPump->isBasalActive() && !m_profileManager->profileNames().isEmpty()) {
-                m_insulinPump->startBasalDelivery();
-                logEvent("Control-IQ: Basal resumed (safe BG)");
-            }
-        }
+    if (m_trace.firstTimestampMs() < 0) {
+        QMessageBox::warning(this, "Replay Failed", "No usable rows in " + path);
+        m_trace.close();
+        return;
     }
 
-    // 5) Basal tick + battery
-    m_insulinPump->performBasalTick();
-    m_insulinPump->useBattery(0.01);
+    // One pass up front reports the size of the job and any damage
+    TraceScan scan = m_trace.scan();
+    logEvent(QString("Replaying %1: %2 MB, %3 rows, %4 malformed (parsed at %5 MB/s)")
+             .arg(path).arg(m_trace.fileSize() / 1e6, 0, 'f', 1).arg(scan.records)
+             .arg(scan.errors).arg(scan.megabytesPerSecond, 0, 'f', 0));
+
+    // The trace starts now. Until it is handed back only the simulation
+    // thread reads it.
+    m_worker->run([this](SimulationEngine &engine, TimeSimulator &) {
+        m_trace.setTimeShiftMs(engine.currentSimulatedMsecs() - m_trace.firstTimestampMs());
+        engine.setTraceReplay(&m_trace);
+    });
+    m_replayTraceBtn->setText("Stop Replay");
+}
 
-    // 6) Update labels
-    m_batteryLabel->setText(QString("Battery: %1% ")
-        .arg(m_insulinPump->batteryLevel(), 0, 'f', 1));
-    m_insulinLabel->setText(QString("Insulin: %1U/300U")
-        .arg(m_insulinPump->insulinUnitsRemaining(), 0, 'f', 1));
+void MainWindow::stopTraceReplay()
+{
+    m_worker->run([](SimulationEngine &engine, TimeSimulator &) {
+        engine.setTraceReplay(nullptr);
+    });
+    onTraceReplayFinished();
+}
 
-    // 7) Error checks
-    onCheckForErrors();
+void MainWindow::onTraceReplayFinished()
+{
+    // A stop and the end of the trace can cross; only the first counts, and
+    // a trace attached since then is still running
+    if (!m_trace.isOpen()) return;
+    bool attached = false;
+    m_worker->run([&](SimulationEngine &engine, TimeSimulator &) {
+        attached = engine.traceReplay() != nullptr;
+    });
+    if (attached) return;
+    logEvent(QString("Trace replay stopped after %1 rows, %2 skipped")
+             .arg(m_trace.recordsParsed()).arg(m_trace.errorCount()));
+    m_trace.close();
+    m_replayTraceBtn->setText("Replay Trace");
 }
 
-// --- Graph Slots ---
+// --- Alarms ---
 
-void MainWindow::onGraph1h() { plotGlucoseGraph(1); }
-void MainWindow::onGraph3h() { plotGlucoseGraph(3); }
-void MainWindow::onGraph6h() { plotGlucoseGraph(6); }
+void MainWindow::updateAlarms(const SimulationState &state)
+{
+    for (int i = 0; i < AlarmTypeCount; ++i) {
+        const AlarmInfo &alarm = state.alarms[i];
+        QMessageBox *&box = m_alarmBoxes[i];
+        if (alarm.status != AlarmSounding) {
+            // Acknowledged or cleared: nothing left to answer
+            if (box) box->hide();
+            continue;
+        }
 
-// --- CGM Alerts ---
+        // Each raise, escalation or repeat is shown once; answering it
+        // hides the box until the next one
+        if (alarm.announcements == m_alarmsShown[i]) continue;
+        m_alarmsShown[i] = alarm.announcements;
+        if (!box) box = createAlarmBox(AlarmType(i));
+
+        QString text;
+        switch (i) {
+        case LowGlucoseAlarm:
+        case HighGlucoseAlarm:
+            text = QString("Glucose is %1 mmol/L.").arg(alarm.value, 0, 'f', 1);
+            break;
+        case LowBatteryAlarm:
+            text = QString("Battery is at %1%.").arg(alarm.value, 0, 'f', 1);
+            break;
+        case LowInsulinAlarm:
+            text = QString("%1 U of insulin left.").arg(alarm.value, 0, 'f', 1);
+            break;
+        }
+        if (alarm.level > 0) {
+            text += QString(" Unanswered, level %1.").arg(alarm.level + 1);
+        }
+        box->setText(text);
+        box->show();
+        box->raise();
+    }
+}
 
-void MainWindow::onCriticalLowGlucose(double value)
+QMessageBox *MainWindow::createAlarmBox(AlarmType type)
 {
-    //QMessageBox::warning(this, "Low Glucose",
-                         //QString("Critical low glucose: %1 mmol/L").arg(value));
-    logEvent(QString("Critical low CGM alert: %1").arg(value));
+    // Not modal: the rest of the window keeps working while it is up
+    QMessageBox *box = new QMessageBox(this);
+    box->setWindowModality(Qt::NonModal);
+    box->setIcon(QMessageBox::Warning);
+    box->setWindowTitle(AlarmManager::name(type) + " Alarm");
+    if (type == LowBatteryAlarm) {
+        box->addButton("Recharge", QMessageBox::ActionRole);
+        box->addButton("Snooze", QMessageBox::RejectRole);
+    } else if (type == LowInsulinAlarm) {
+        box->addButton("Replace Cartridge", QMessageBox::ActionRole);
+        box->addButton("Snooze", QMessageBox::RejectRole);
+    } else {
+        box->addButton("Acknowledge", QMessageBox::AcceptRole);
+    }
+
+    connect(box, &QMessageBox::buttonClicked, this, [this, box, type](QAbstractButton *button) {
+        m_worker->acknowledgeAlarm(type);
+        if (box->buttonRole(button) != QMessageBox::ActionRole) return;
+        if (type == LowBatteryAlarm) {
+            m_worker->post([](SimulationEngine &engine, TimeSimulator &) {
+                engine.insulinPump()->rechargeBattery();
+            });
+            logEvent("Pump charged to 100%.");
+        } else {
+            m_worker->post([](SimulationEngine &engine, TimeSimulator &) {
+                engine.insulinPump()->replenishInsulin();
+            });
+            logEvent("Pump insulin replenished to 300u.");
+        }
+    });
+    return box;
 }
 
-void MainWindow::onCriticalHighGlucose(double value)
+// --- Simulation Slot ---
+
+void MainWindow::onTimeSimulationToggle()
 {
-    //QMessageBox::warning(this, "High Glucose",
-                         //QString("Critical high glucose: %1 mmol/L").arg(value));
-    logEvent(QString("Critical high CGM alert: %1").arg(value));
+    bool running = false;
+    m_worker->run([&](SimulationEngine &, TimeSimulator &clock) {
+        if (clock.isRunning()) {
+            // Stop simulation components
+            clock.stop();
+        } else {
+            // Resume simulation
+            clock.start();
+        }
+        running = clock.isRunning();
+    });
+    if (running) {
+        m_toggleSimTimeBtn->setText("Pause");
+        logEvent("Simulation resumed");
+    } else {
+        m_toggleSimTimeBtn->setText("Start");
+        logEvent("Simulation paused");
+    }
 }
 
-// --- Graph Helper ---
-
-void MainWindow::plotGlucoseGraph(int hours)
+void MainWindow::onRenderFrame()
 {
-    auto readings = m_cgm->getReadings(hours);
-    if (readings.isEmpty()) {
-        QMessageBox::information(this, "No Data", "Not enough CGM data for that period.");
-        return;
+    // Ticks run on the simulation thread; this only draws what they left
+    if (!m_worker->updateState()) return;
+    TICK_PROFILE_FRAME(RenderPhase);
+
+    const SimulationState &state = m_worker->state();
+    if (state.historyGeneration != m_historyGeneration) {
+        m_historyGeneration = state.historyGeneration;
+        m_glucoseChart->setReadings(state.readings);
+    } else if (!state.readings.isEmpty()) {
+        m_glucoseChart->addReadings(state.readings);
     }
-    QLineSeries *series = new QLineSeries();
-    for (const auto &r : readings) {
-        series->append(r.timestamp.toMSecsSinceEpoch(), r.value);
+    updateStatusLabels(state);
+    updateAlarms(state);
+}
+
+void MainWindow::updateStatusLabels(const SimulationState &state)
+{
+    m_simulatedTimeLabel->setText("Sim Time: " +
+    QDateTime::fromMSecsSinceEpoch(state.simulatedMs).toString("hh:mm:ss"));
+    m_batteryLabel->setText(QString("Battery: %1% ")
+        .arg(state.batteryLevel, 0, 'f', 1));
+    m_insulinLabel->setText(QString("Insulin: %1U/300U")
+        .arg(state.insulinRemaining, 0, 'f', 1));
+
+    const GlycemicSummary &day = state.day;
+    if (day.readings > 0) {
+        m_metricsLabel->setText(QString("24 h: in range %1%, below 3.9 %2%, above 10 %3%, "
+                                        "mean %4 mmol/L, CV %5%, GMI %6%")
+            .arg(day.timeInRange, 0, 'f', 0).arg(day.timeBelow3_9, 0, 'f', 0)
+            .arg(day.timeAbove10_0, 0, 'f', 0).arg(day.meanGlucose, 0, 'f', 1)
+            .arg(day.coefficientOfVariation, 0, 'f', 0).arg(day.gmi, 0, 'f', 1));
     }
-    QChart *chart = new QChart();
-    chart->addSeries(series);
-    chart->legend()->hide();
-    chart->setTitle(QString("Glucose Trend (%1h)").arg(hours));
-    QDateTimeAxis *axisX = new QDateTimeAxis(); axisX->setFormat("hh:mm");
-    axisX->setTickCount(6);
-    axisX->setLabelsAngle(-45);
-    axisX->setTitleText("Time"); axisX->setMin(readings.front().timestamp);
-    axisX->setMax(readings.back().timestamp); chart->addAxis(axisX, Qt::AlignBottom);
-    series->attachAxis(axisX);
-    QValueAxis *axisY = new QValueAxis(); axisY->setLabelFormat("%.1f");
-    axisY->setTitleText("Glucose (mmol/L)"); chart->addAxis(axisY, Qt::AlignLeft);
-    series->attachAxis(axisY);
-    QChartView *view = new QChartView(chart); view->setRenderHint(QPainter::Antialiasing);
-    QDialog dlg(this); dlg.setWindowTitle("Glucose Graph");
-    QVBoxLayout *layout = new QVBoxLayout(&dlg); layout->addWidget(view);
-    dlg.resize(700, 400); dlg.exec();
 }
 
 // --- Helper ---
 
 void MainWindow::logEvent(const QString &msg)
 {
-    // Use simulated time for log timestamps
-    QString simTs = m_timeSimulator->currentSimulatedTime().toString("yyyy-MM-dd hh:mm:ss");
-    QString entry = QString("[%1] %2").arg(simTs, msg);
-
-    // Store in system log and update text viewer
-    m_systemLog->addLogEntry(entry);
-    m_logViewer->append(entry);
+    // Stored with simulated time by the engine; the log view picks it up
+    m_worker->post([msg](SimulationEngine &engine, TimeSimulator &) { engine.logEvent(msg); });
 }
@@ -6,21 +6,13 @@
 #include <QPushButton>
 #include <QLabel>
 #include <QLineEdit>
-#include <QTextEdit>
-#include <QTimer>
+#include <QComboBox>
 #include <QMessageBox>
-#include "profilemanager.h"
-#include "insulinpump.h"
-#include "cgm.h"
-#include "systemlog.h"
-#include "timesimulator.h"
-#include <QtCharts/QChartView>
-#include <QtCharts/QChart>
-#include <QtCharts/QLineSeries>
-#include <QtCharts/QDateTimeAxis>
-#include <QtCharts/QValueAxis>
-
-QT_CHARTS_USE_NAMESPACE
+#include <QTimer>
+#include "simulationworker.h"
+#include "bolusexplorer.h"
+#include "glucosechartwidget.h"
+#include "logviewwidget.h"
 
 class MainWindow : public QMainWindow
 {
@@ -39,42 +31,36 @@ private slots:
     void onStopInsulin();
     void onManualBolus();
     void onViewHistory();
-    void onCheckForErrors();
+    void onSaveSnapshot();
+    void onLoadSnapshot();
+    void onReplayTrace();
+    void onGlucoseModelChanged(int index);
+    void onSimulationSpeedChanged(int index);
+    void onTraceReplayFinished();
 
     // Simulation controls
-    void onSimulationTick();
+    void onRenderFrame();
     void onTimeSimulationToggle();
 
-    // CGM alerts
-    void onCriticalLowGlucose(double value);
-    void onCriticalHighGlucose(double value);
-
-    // Graphing
-    void onGraph1h();
-    void onGraph3h();
-    void onGraph6h();
-
 private:
     void setupUI();
+    void updateStatusLabels(const SimulationState &state);
+    void updateAlarms(const SimulationState &state);
+    QMessageBox *createAlarmBox(AlarmType type);
     void logEvent(const QString &msg);
-    void plotGlucoseGraph(int hours);
+    void stopTraceReplay();
 
     // Core objects
-    ProfileManager *m_profileManager;
-    InsulinPump    *m_insulinPump;
-    CGM            *m_cgm;
-    SystemLog      *m_systemLog;
-    TimeSimulator  *m_timeSimulator;
-
-    // Current profile for Control-IQ
-    ProfileData     m_currentProfile;
+    SimulationWorker *m_worker;            // Engine and clock, on their own thread
+    QTimer           *m_renderTimer;       // Draws the newest state once per frame
+    quint32           m_historyGeneration; // Of the readings the chart holds
+    SystemLog        *m_systemLog;         // The engine's; safe to read from here
+    BolusExplorer     m_bolusExplorer;     // Forecasts manual bolus splits
+    TraceReplay       m_trace;             // Recorded CGM/pump data, when replaying
 
-    // Extended bolus tracking
-    double m_extBolusRemaining;
-    double m_extBolusRatePerTick;
-
-    //Flag for user suspended basal insulin
-    bool m_userSuspendedInsulin = false;
+    // One box per alarm, and the announcement each last showed
+    QMessageBox *m_alarmBoxes[AlarmTypeCount] = {};
+    quint32      m_alarmsShown[AlarmTypeCount] = {};
 
     // UI elements
     QPushButton *m_createProfileBtn;
@@ -84,18 +70,19 @@ private:
     QPushButton *m_stopInsulinBtn;
     QPushButton *m_manualBolusBtn;
     QPushButton *m_viewHistoryBtn;
+    QPushButton *m_saveSnapshotBtn;
+    QPushButton *m_loadSnapshotBtn;
+    QPushButton *m_replayTraceBtn;
     QPushButton *m_toggleSimTimeBtn;
-    QPushButton *m_graph1hBtn;
-    QPushButton *m_graph3hBtn;
-    QPushButton *m_graph6hBtn;
     QLabel      *m_simulatedTimeLabel;
     QLabel      *m_batteryLabel;
     QLabel      *m_insulinLabel;
     QLabel      *m_statusLabel;
-    QTextEdit   *m_logViewer;
-
-    // Timer
-    QTimer      *m_simulationTimer;
+    QLabel      *m_metricsLabel;
+    QComboBox   *m_glucoseModelBox;
+    QComboBox   *m_speedBox;
+    LogViewWidget *m_logView;
+    GlucoseChartWidget *m_glucoseChart;
 };
 
 #endif // MAINWINDOW_H
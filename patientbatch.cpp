@@ -0,0 +1,418 @@
+// patientbatch.cpp
+#include "patientbatch.h"
+#include "batchpatient.h"
+#include "cohortrunner.h"
+#include "therapyrules.h"
+#include <cmath>
+#include <cstring>
+
+// The vector kernels use GCC/Clang vector extensions and function-level
+// target attributes, so the rest of the build needs no -mavx flags
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PATIENTBATCH_X86_SIMD
+// Lane helpers return vectors by value but are always inlined into the
+// target-specific kernels, so the ABI note does not apply
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace {
+
+// Widest vector is 8 doubles; every array is padded to a multiple of it
+const int MAX_LANES = 8;
+
+#ifdef PATIENTBATCH_X86_SIMD
+typedef double Vec4d __attribute__((vector_size(32)));
+typedef double Vec8d __attribute__((vector_size(64)));
+#endif
+
+template <class V> struct Lanes { static const int count = sizeof(V) / sizeof(double); };
+
+template <class V>
+inline V loadLanes(const double *p)
+{
+    V v;
+    std::memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+template <class V>
+inline void storeLanes(double *p, const V &v)
+{
+    std::memcpy(p, &v, sizeof(V));
+}
+
+// Model inputs for a group of lanes
+template <class V>
+struct LaneInputs {
+    V insulinRate;
+    V carbRate;
+    V baseGlucose;
+    V insulinSensitivity;
+    V basalActive;
+};
+
+// Pointers into the batch's arrays for one physics step
+struct PhysicsArrays {
+    double *compartments[9];    // [curve * 3 + compartment]
+    double *state[4];           // Model state, state[0] is glucose
+    const double *baseGlucose;
+    const double *sensitivity;
+    const double *basalActive;
+    const double *noise;
+    AbsorptionModel::Transition insulin;
+    AbsorptionModel::Transition carbs;
+    double minutes;
+    double h;                   // RK4 substep
+    int substeps;
+    int count;
+};
+
+// Same arithmetic, in the same order, as AbsorptionModel::advance()
+template <class V>
+inline V advanceLanes(double *const *c, int i, const AbsorptionModel::Transition &t)
+{
+    V d1 = loadLanes<V>(c[0] + i);
+    V d2 = loadLanes<V>(c[1] + i);
+    V a = loadLanes<V>(c[2] + i);
+
+    V before = d1 + d2 + a;
+    a = a * t.activeDecay + d2 * t.fromDepot2 + d1 * t.fromDepot1;
+    d2 = d2 * t.depotDecay + d1 * t.depotShift;
+    d1 = d1 * t.depotDecay;
+
+    storeLanes(c[0] + i, d1);
+    storeLanes(c[1] + i, d2);
+    storeLanes(c[2] + i, a);
+    return before - (d1 + d2 + a);
+}
+
+// Absorption, RK4 and noise for every patient, Lanes<V>::count at a time
+template <class Model, class V>
+inline void stepLanes(const PhysicsArrays &p)
+{
+    typedef typename Model::template StateOf<V> State;
+
+    for (int i = 0; i < p.count; i += Lanes<V>::count) {
+        V basalUsed = advanceLanes<V>(p.compartments + 0, i, p.insulin);
+        V bolusUsed = advanceLanes<V>(p.compartments + 3, i, p.insulin);
+        V carbsUsed = advanceLanes<V>(p.compartments + 6, i, p.carbs);
+
+        LaneInputs<V> in;
+        in.insulinRate = (basalUsed + bolusUsed) / p.minutes;
+        in.carbRate = carbsUsed / p.minutes;
+        in.baseGlucose = loadLanes<V>(p.baseGlucose + i);
+        in.insulinSensitivity = loadLanes<V>(p.sensitivity + i);
+        in.basalActive = loadLanes<V>(p.basalActive + i);
+
+        State s;
+        for (int j = 0; j < Model::StateSize; ++j) {
+            s[j] = loadLanes<V>(p.state[j] + i);
+        }
+        rk4Advance<Model, V>(s, p.h, p.substeps, in);
+        s[0] = s[0] + loadLanes<V>(p.noise + i);
+        for (int j = 0; j < Model::StateSize; ++j) {
+            storeLanes(p.state[j] + i, s[j]);
+        }
+    }
+}
+
+template <class Model>
+void stepScalar(const PhysicsArrays &p)
+{
+    stepLanes<Model, double>(p);
+}
+
+#ifdef PATIENTBATCH_X86_SIMD
+// No FMA: fused multiply-adds would round differently from the scalar path
+template <class Model>
+__attribute__((target("avx2"), flatten))
+void stepAvx2(const PhysicsArrays &p)
+{
+    stepLanes<Model, Vec4d>(p);
+}
+
+template <class Model>
+__attribute__((target("avx512f"), flatten))
+void stepAvx512(const PhysicsArrays &p)
+{
+    stepLanes<Model, Vec8d>(p);
+}
+#endif
+
+}
+
+SimdLevel bestSimdLevel()
+{
+#ifdef PATIENTBATCH_X86_SIMD
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return Avx512Simd;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return Avx2Simd;
+        }
+        return ScalarSimd;
+    }();
+    return level;
+#else
+    return ScalarSimd;
+#endif
+}
+
+QString simdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case Avx512Simd:
+        return "AVX-512";
+    case Avx2Simd:
+        return "AVX2";
+    case ScalarSimd:
+    default:
+        return "scalar";
+    }
+}
+
+template <class Model>
+PatientBatch<Model>::PatientBatch(const ProfileData &therapy, const QVector<VirtualPatient> &patients)
+    : m_schedule(therapy),
+      m_segment(0),
+      m_count(patients.size()),
+      m_paddedCount((patients.size() + MAX_LANES - 1) / MAX_LANES * MAX_LANES),
+      m_simdLevel(bestSimdLevel()),
+      m_tickMinutes(SIMULATION_SPEED),
+      m_modelStepMinutes(1.0),
+      m_elapsedMinutes(0.0),
+      m_ticks(0),
+      m_insulinCurve(DEFAULT_INSULIN_PEAK, DEFAULT_INSULIN_DURATION),
+      m_carbCurve(DEFAULT_CARB_PEAK, DEFAULT_CARB_DURATION)
+{
+    for (std::vector<double> &c : m_compartments) {
+        c.assign(m_paddedCount, 0.0);
+    }
+    m_baseGlucose.assign(m_paddedCount, DEFAULT_BASE_GLUCOSE);
+    m_sensitivity.assign(m_paddedCount, 1.0);
+    m_basalActive.assign(m_paddedCount, 1.0);
+    m_noise.assign(m_paddedCount, 0.0);
+    m_glucose.assign(m_paddedCount, DEFAULT_BASE_GLUCOSE);
+    m_iob.assign(m_paddedCount, 0.0);
+    m_cob.assign(m_paddedCount, 0.0);
+    m_basalRate.assign(m_paddedCount, 0.0);
+    m_bolus.assign(m_paddedCount, 0.0);
+
+    m_meals.reserve(m_count);
+    m_rngs.reserve(m_count);
+    m_controllers.resize(m_count);
+    for (const VirtualPatient &p : patients) {
+        m_meals.append(p.meals);
+        m_rngs.emplace_back(p.seed);
+    }
+    for (ControlIQController &c : m_controllers) {
+        c.setTherapy(m_schedule.settings(m_segment));
+    }
+    for (int i = 0; i < m_count; ++i) {
+        m_baseGlucose[i] = patients[i].baseGlucose;
+        m_sensitivity[i] = patients[i].insulinSensitivity;
+        m_glucose[i] = patients[i].baseGlucose;
+    }
+
+    // Padding lanes are simulated too, from a steady state, and ignored
+    for (int j = 0; j < Model::StateSize; ++j) {
+        m_state[j].assign(m_paddedCount, 0.0);
+    }
+    GlucoseInputs in;
+    for (int i = 0; i < m_paddedCount; ++i) {
+        typename Model::State s = Model::initialState(m_glucose[i], in);
+        for (int j = 0; j < Model::StateSize; ++j) {
+            m_state[j][i] = s[j];
+        }
+    }
+}
+
+template <class Model>
+void PatientBatch<Model>::setSimdLevel(SimdLevel level)
+{
+    m_simdLevel = (level <= bestSimdLevel()) ? level : bestSimdLevel();
+}
+
+template <class Model>
+SimdLevel PatientBatch<Model>::simdLevel() const
+{
+    return m_simdLevel;
+}
+
+template <class Model>
+void PatientBatch<Model>::setTickMinutes(double minutes)
+{
+    if (minutes > 0.0) {
+        m_tickMinutes = minutes;
+    }
+}
+
+template <class Model>
+void PatientBatch<Model>::setModelStepMinutes(double minutes)
+{
+    if (minutes > 0.0) {
+        m_modelStepMinutes = minutes;
+    }
+}
+
+template <class Model>
+int PatientBatch<Model>::size() const
+{
+    return m_count;
+}
+
+template <class Model>
+double PatientBatch<Model>::glucose(int patient) const
+{
+    return m_glucose[patient];
+}
+
+template <class Model>
+double PatientBatch<Model>::insulinOnBoard(int patient) const
+{
+    return m_iob[patient];
+}
+
+template <class Model>
+double PatientBatch<Model>::carbsOnBoard(int patient) const
+{
+    return m_cob[patient];
+}
+
+template <class Model>
+double PatientBatch<Model>::basalRate(int patient) const
+{
+    return m_basalRate[patient];
+}
+
+template <class Model>
+double PatientBatch<Model>::bolusUnits(int patient) const
+{
+    return m_bolus[patient];
+}
+
+template <class Model>
+double &PatientBatch<Model>::compartment(Curve curve, Compartment c, int patient)
+{
+    return m_compartments[curve * CompartmentCount + c][patient];
+}
+
+template <class Model>
+void PatientBatch<Model>::tick()
+{
+    // Settings and basal of the profile segment in effect, the same for all
+    int segment = m_schedule.segmentAt(m_elapsedMinutes);
+    if (segment != m_segment) {
+        m_segment = segment;
+        for (ControlIQController &c : m_controllers) {
+            c.setTherapy(m_schedule.settings(segment));
+        }
+    }
+    ProfileData settings = m_schedule.settingsAt(m_elapsedMinutes);
+    double basalRate = m_schedule.basalRateAt(m_elapsedMinutes);
+    double basalUnits = m_schedule.basalUnits(m_elapsedMinutes, m_elapsedMinutes + m_tickMinutes);
+
+    // 1) CGM reading: draw noise per patient, then step the physics in bulk
+    double noiseScale = std::sqrt(m_tickMinutes / 5.0);
+    for (int i = 0; i < m_count; ++i) {
+        m_noise[i] = m_basalActive[i] != 0.0
+                   ? (m_rngs[i].uniform(m_ticks) * 0.4 - 0.2) * noiseScale : 0.0;
+    }
+    stepPhysics();
+
+    double *modelGlucose = m_state[0].data();
+    for (int i = 0; i < m_count; ++i) {
+        double next = modelGlucose[i];
+        if (next > 0.0 && next < MAX_VALID_GLUCOSE) {
+            m_glucose[i] = next;
+        } else {
+            modelGlucose[i] = m_glucose[i];
+        }
+        double bg = m_glucose[i];
+        double &bolusDepot = compartment(BolusCurve, Depot1, i);
+        double iob = bolusDepot + compartment(BolusCurve, Depot2, i)
+                   + compartment(BolusCurve, Active, i);
+
+        // 2) Meals
+        double bolusGiven = 0.0;
+        for (const MealEvent &meal : m_meals[i]) {
+            if (dailyMealDue(meal.minuteOfDay, m_elapsedMinutes, m_tickMinutes)) {
+                compartment(CarbCurve, Depot1, i) += meal.grams;
+                double bolus = mealBolusUnits(settings, bg, meal.grams, iob);
+                if (bolus > 0.0) {
+                    bolusDepot += bolus;
+                    iob += bolus;
+                    bolusGiven += bolus;
+                }
+            }
+        }
+
+        // 3) Control-IQ
+        double cob = compartment(CarbCurve, Depot1, i) + compartment(CarbCurve, Depot2, i)
+                   + compartment(CarbCurve, Active, i);
+        ControlIQDecision d = m_controllers[i].update(bg, m_elapsedMinutes, iob, cob);
+        if (d.correctionBolus > 0.0) {
+            bolusDepot += d.correctionBolus;
+            iob += d.correctionBolus;
+            bolusGiven += d.correctionBolus;
+        }
+        bool active = d.basalMultiplier > 0.0;
+        m_basalActive[i] = active ? 1.0 : 0.0;
+
+        // 4) Basal, as scheduledBasalUnits() with the lookup hoisted
+        double units = active ? basalUnits * d.basalMultiplier : 0.0;
+        if (units > 0.0) {
+            compartment(BasalCurve, Depot1, i) += units;
+        }
+
+        m_iob[i] = iob;
+        m_cob[i] = cob;
+        m_basalRate[i] = active ? basalRate * d.basalMultiplier : 0.0;
+        m_bolus[i] = bolusGiven;
+    }
+
+    m_elapsedMinutes += m_tickMinutes;
+    ++m_ticks;
+}
+
+template <class Model>
+void PatientBatch<Model>::stepPhysics()
+{
+    PhysicsArrays p;
+    for (int c = 0; c < CurveCount * CompartmentCount; ++c) {
+        p.compartments[c] = m_compartments[c].data();
+    }
+    for (int j = 0; j < Model::StateSize; ++j) {
+        p.state[j] = m_state[j].data();
+    }
+    p.baseGlucose = m_baseGlucose.data();
+    p.sensitivity = m_sensitivity.data();
+    p.basalActive = m_basalActive.data();
+    p.noise = m_noise.data();
+    p.insulin = m_insulinCurve.transition(m_tickMinutes);
+    p.carbs = m_carbCurve.transition(m_tickMinutes);
+    p.minutes = m_tickMinutes;
+    p.substeps = rk4Substeps(m_tickMinutes, m_modelStepMinutes);
+    p.h = m_tickMinutes / p.substeps;
+    p.count = m_paddedCount;
+
+    switch (m_simdLevel) {
+#ifdef PATIENTBATCH_X86_SIMD
+    case Avx512Simd:
+        stepAvx512<Model>(p);
+        break;
+    case Avx2Simd:
+        stepAvx2<Model>(p);
+        break;
+#endif
+    case ScalarSimd:
+    default:
+        stepScalar<Model>(p);
+        break;
+    }
+}
+
+template class PatientBatch<RandomWalkModel>;
+template class PatientBatch<BergmanMinimalModel>;
@@ -0,0 +1,103 @@
+// patientbatch.h
+#ifndef PATIENTBATCH_H
+#define PATIENTBATCH_H
+
+#include <QVector>
+#include <QString>
+#include <vector>
+#include "absorptionmodel.h"
+#include "controliqcontroller.h"
+#include "glucosemodel.h"
+#include "philox.h"
+#include "profileschedule.h"
+#include "simulationengine.h"
+
+struct VirtualPatient;
+
+// Instruction set used for the batched physics step
+enum SimdLevel {
+    ScalarSimd,     // One patient at a time
+    Avx2Simd,       // 4 patients per instruction
+    Avx512Simd      // 8 patients per instruction
+};
+
+// Largest difference in glucose (mmol/L) allowed between vector and scalar
+const double PATIENT_BATCH_TOLERANCE = 1e-6;
+
+// Best level this CPU supports, and a display name
+SimdLevel bestSimdLevel();
+QString simdLevelName(SimdLevel level);
+
+// Many patients simulated side by side with the same logic as
+// BatchPatient<Model>, and so with the same omissions. Absorption
+// compartments and model state are kept as structure-of-arrays so the
+// physics step (absorption, RK4, noise) runs 4 or 8 patients per
+// instruction; meals and Control-IQ decisions stay per patient. All
+// patients share one profile schedule and clock, so the segment and its
+// basal are looked up once per tick. The vector paths match the scalar
+// path to within PATIENT_BATCH_TOLERANCE, the difference coming only from
+// rounding.
+template <class Model>
+class PatientBatch
+{
+public:
+    PatientBatch(const ProfileData &therapy, const QVector<VirtualPatient> &patients);
+
+    // Defaults to bestSimdLevel(); levels the CPU lacks fall back to it
+    void setSimdLevel(SimdLevel level);
+    SimdLevel simdLevel() const;
+
+    void setTickMinutes(double minutes);
+    void setModelStepMinutes(double minutes);
+
+    int size() const;
+    double glucose(int patient) const;
+
+    // State after the last tick, for output: insulin (U) and carbs (g) on
+    // board, basal rate running (U/hr) and boluses given in the tick (U)
+    double insulinOnBoard(int patient) const;
+    double carbsOnBoard(int patient) const;
+    double basalRate(int patient) const;
+    double bolusUnits(int patient) const;
+
+    // One simulation tick for every patient
+    void tick();
+
+private:
+    enum Curve { BasalCurve, BolusCurve, CarbCurve, CurveCount };
+    enum Compartment { Depot1, Depot2, Active, CompartmentCount };
+
+    double &compartment(Curve curve, Compartment c, int patient);
+    void stepPhysics();
+
+    ProfileSchedule m_schedule;
+    int m_segment;
+    QVector<QVector<MealEvent> > m_meals;
+    std::vector<PhiloxRandom> m_rngs;   // Noise for tick n is uniform(n)
+    std::vector<ControlIQController> m_controllers;
+    int m_count;
+    int m_paddedCount;          // Rounded up to a whole number of vectors
+    SimdLevel m_simdLevel;
+    double m_tickMinutes;
+    double m_modelStepMinutes;
+    double m_elapsedMinutes;
+    quint64 m_ticks;
+
+    AbsorptionModel m_insulinCurve;
+    AbsorptionModel m_carbCurve;
+
+    // Structure-of-arrays state, m_paddedCount entries each
+    std::vector<double> m_compartments[CurveCount * CompartmentCount];
+    std::vector<double> m_state[Model::StateSize];
+    std::vector<double> m_baseGlucose;
+    std::vector<double> m_sensitivity;
+    std::vector<double> m_basalActive;  // 1.0 or 0.0
+    std::vector<double> m_noise;        // Noise for this tick, 0 when suspended
+    std::vector<double> m_glucose;      // Last valid reading
+    std::vector<double> m_iob;          // Reported state, see insulinOnBoard()
+    std::vector<double> m_cob;
+    std::vector<double> m_basalRate;
+    std::vector<double> m_bolus;
+};
+
+#endif // PATIENTBATCH_H
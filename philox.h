@@ -0,0 +1,52 @@
+// philox.h
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <QtGlobal>
+#include <array>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). Output is a pure function of (key,
+// counter), so the n-th number of any stream can be computed directly,
+// with no state shared between threads or carried from one draw to the next.
+class PhiloxRandom
+{
+public:
+    typedef std::array<quint32, 4> Block;
+
+    explicit PhiloxRandom(quint64 seed = 0) : m_seed(seed) {}
+
+    void setSeed(quint64 seed) { m_seed = seed; }
+    quint64 seed() const { return m_seed; }
+
+    // Raw 128-bit output for a counter
+    static Block block(const Block &counter, quint64 key)
+    {
+        Block c = counter;
+        quint32 k0 = quint32(key);
+        quint32 k1 = quint32(key >> 32);
+        for (int round = 0; round < 10; ++round) {
+            quint64 p0 = quint64(0xD2511F53u) * c[0];
+            quint64 p1 = quint64(0xCD9E8D57u) * c[2];
+            c = Block{{quint32(p1 >> 32) ^ c[1] ^ k0, quint32(p1),
+                       quint32(p0 >> 32) ^ c[3] ^ k1, quint32(p0)}};
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return c;
+    }
+
+    // Uniform double in [0, 1) for draw number index of a stream
+    double uniform(quint64 index, quint64 stream = 0) const
+    {
+        Block out = block(Block{{quint32(index), quint32(index >> 32),
+                                 quint32(stream), quint32(stream >> 32)}}, m_seed);
+        quint64 bits = ((quint64(out[0]) << 32) | out[1]) >> 11;     // 53 bits
+        return bits * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    quint64 m_seed;
+};
+
+#endif // PHILOX_H
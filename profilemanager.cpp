@@ -1,5 +1,36 @@
 #include "profilemanager.h"
 
+QDataStream &operator<<(QDataStream &out, const ProfileSegment &segment)
+{
+    return out << qint32(segment.startMinute) << segment.basalRate << segment.carbRatio
+               << segment.correctionFactor << segment.targetBG;
+}
+
+QDataStream &operator>>(QDataStream &in, ProfileSegment &segment)
+{
+    qint32 start = 0;
+    in >> start >> segment.basalRate >> segment.carbRatio
+       >> segment.correctionFactor >> segment.targetBG;
+    segment.startMinute = start;
+    return in;
+}
+
+QDataStream &operator<<(QDataStream &out, const ProfileData &profile)
+{
+    return out << profile.basalRate << profile.carbRatio << profile.correctionFactor
+               << profile.targetBG << profile.segments;
+}
+
+QDataStream &operator>>(QDataStream &in, ProfileData &profile)
+{
+    in >> profile.basalRate >> profile.carbRatio >> profile.correctionFactor
+       >> profile.targetBG >> profile.segments;
+    if (in.status() == QDataStream::Ok && !ProfileManager::validSegments(profile.segments)) {
+        in.setStatus(QDataStream::ReadCorruptData);
+    }
+    return in;
+}
+
 ProfileManager::ProfileManager(QObject *parent)
     : QObject(parent)
 {
@@ -40,6 +71,46 @@ bool ProfileManager::updateProfile(const QString &name,
     data.carbRatio        = carbRatio;
     data.correctionFactor = correctionFactor;
     data.targetBG         = targetBG;
+    if (!data.segments.isEmpty()) {
+        data.segments[0] = {0, basalRate, carbRatio, correctionFactor, targetBG};
+    }
+    return true;
+}
+
+bool ProfileManager::setSegments(const QString &name, const QVector<ProfileSegment> &segments)
+{
+    if (!m_profiles.contains(name) || !validSegments(segments)) {
+        return false;
+    }
+
+    ProfileData &data = m_profiles[name];
+    data.segments = segments;
+    if (!segments.isEmpty()) {
+        data.basalRate        = segments[0].basalRate;
+        data.carbRatio        = segments[0].carbRatio;
+        data.correctionFactor = segments[0].correctionFactor;
+        data.targetBG         = segments[0].targetBG;
+    }
+    return true;
+}
+
+bool ProfileManager::validSegments(const QVector<ProfileSegment> &segments)
+{
+    if (segments.isEmpty()) {
+        return true;
+    }
+    if (segments.size() > MAX_PROFILE_SEGMENTS || segments[0].startMinute != 0) {
+        return false;
+    }
+    for (int i = 0; i < segments.size(); ++i) {
+        const ProfileSegment &s = segments[i];
+        if (s.startMinute >= 1440 || (i > 0 && s.startMinute <= segments[i - 1].startMinute)) {
+            return false;
+        }
+        if (s.basalRate < 0.0 || s.carbRatio <= 0.0 || s.correctionFactor <= 0.0) {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -66,3 +137,29 @@ QStringList ProfileManager::profileNames() const
 {
     return m_profiles.keys();
 }
+
+int ProfileManager::profileCount() const
+{
+    return m_profiles.size();
+}
+
+void ProfileManager::saveState(QDataStream &out) const
+{
+    out << m_profiles;
+}
+
+void ProfileManager::swapState(ProfileManager &other)
+{
+    m_profiles.swap(other.m_profiles);
+}
+
+bool ProfileManager::restoreState(QDataStream &in)
+{
+    QMap<QString, ProfileData> profiles;
+    in >> profiles;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    m_profiles = profiles;
+    return true;
+}
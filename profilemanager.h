@@ -4,6 +4,21 @@
 #include <QObject>
 #include <QMap>
 #include <QStringList>
+#include <QVector>
+#include <QDataStream>
+
+// Most timed segments a pump profile can hold
+const int MAX_PROFILE_SEGMENTS = 16;
+
+// Settings in effect from startMinute until the next segment starts
+struct ProfileSegment
+{
+    int    startMinute;       // Minutes after midnight
+    double basalRate;         // U/hr
+    double carbRatio;
+    double correctionFactor;
+    double targetBG;
+};
 
 struct ProfileData
 {
@@ -11,8 +26,17 @@ struct ProfileData
     double carbRatio;         // 1U for X grams of carb
     double correctionFactor;  // 1U lowers BG by X mg/dL
     double targetBG;          // mg/dL
+
+    // Time-of-day segments, the first at midnight. Empty when the values
+    // above hold all day; otherwise they mirror the midnight segment.
+    QVector<ProfileSegment> segments;
 };
 
+QDataStream &operator<<(QDataStream &out, const ProfileSegment &segment);
+QDataStream &operator>>(QDataStream &in, ProfileSegment &segment);
+QDataStream &operator<<(QDataStream &out, const ProfileData &profile);
+QDataStream &operator>>(QDataStream &in, ProfileData &profile);
+
 class ProfileManager : public QObject
 {
     Q_OBJECT
@@ -31,11 +55,23 @@ public:
                        double correctionFactor,
                        double targetBG);
 
+    // Replace a profile's time-of-day segments (empty for one setting all
+    // day). Segments must start at midnight, in order, at most
+    // MAX_PROFILE_SEGMENTS of them.
+    bool setSegments(const QString &name, const QVector<ProfileSegment> &segments);
+    static bool validSegments(const QVector<ProfileSegment> &segments);
+
     bool deleteProfile(const QString &name);
 
     bool hasProfile(const QString &name) const;
     ProfileData profile(const QString &name) const;
     QStringList profileNames() const;
+    int profileCount() const;
+
+    // All profiles, for snapshots, and exchanging them with another manager
+    void saveState(QDataStream &out) const;
+    bool restoreState(QDataStream &in);
+    void swapState(ProfileManager &other);
 
 private:
     QMap<QString, ProfileData> m_profiles;
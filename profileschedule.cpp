@@ -0,0 +1,117 @@
+// profileschedule.cpp
+#include "profileschedule.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double MINUTES_PER_DAY = 1440.0;
+
+// Whole days and minute of day for a time, also before minute 0
+double splitDay(double minutes, double *minuteOfDay)
+{
+    double day = std::floor(minutes / MINUTES_PER_DAY);
+    *minuteOfDay = minutes - day * MINUTES_PER_DAY;
+    return day;
+}
+
+}
+
+ProfileSchedule::ProfileSchedule()
+    : ProfileSchedule(ProfileData())
+{
+}
+
+ProfileSchedule::ProfileSchedule(const ProfileData &profile)
+    : m_dailyUnits(0.0)
+{
+    ProfileData flat = profile;
+    flat.segments.clear();
+
+    if (profile.segments.isEmpty()) {
+        m_starts.push_back(0.0);
+        m_settings.push_back(flat);
+    } else {
+        for (const ProfileSegment &s : profile.segments) {
+            ProfileData settings = flat;
+            settings.basalRate = s.basalRate;
+            settings.carbRatio = s.carbRatio;
+            settings.correctionFactor = s.correctionFactor;
+            settings.targetBG = s.targetBG;
+            m_starts.push_back(s.startMinute);
+            m_settings.push_back(settings);
+        }
+    }
+
+    for (size_t i = 0; i < m_starts.size(); ++i) {
+        double end = (i + 1 < m_starts.size()) ? m_starts[i + 1] : MINUTES_PER_DAY;
+        m_cumulative.push_back(m_dailyUnits);
+        m_dailyUnits += std::max(0.0, m_settings[i].basalRate) / 60.0 * (end - m_starts[i]);
+    }
+}
+
+int ProfileSchedule::segmentCount() const
+{
+    return static_cast<int>(m_starts.size());
+}
+
+int ProfileSchedule::segmentAt(double minutes) const
+{
+    double minuteOfDay;
+    splitDay(minutes, &minuteOfDay);
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), minuteOfDay);
+    return std::max(0, static_cast<int>(it - m_starts.begin()) - 1);
+}
+
+ProfileData ProfileSchedule::settings(int segment) const
+{
+    return m_settings[segment];
+}
+
+ProfileData ProfileSchedule::settingsAt(double minutes) const
+{
+    return m_settings[segmentAt(minutes)];
+}
+
+double ProfileSchedule::nextBoundary(double minutes) const
+{
+    if (m_starts.size() < 2) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double minuteOfDay;
+    double day = splitDay(minutes, &minuteOfDay);
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), minuteOfDay);
+    double start = (it == m_starts.end()) ? MINUTES_PER_DAY : *it;
+    return day * MINUTES_PER_DAY + start;
+}
+
+double ProfileSchedule::basalRateAt(double minutes) const
+{
+    return m_settings[segmentAt(minutes)].basalRate;
+}
+
+double ProfileSchedule::basalUnits(double fromMinutes, double toMinutes) const
+{
+    if (toMinutes <= fromMinutes) {
+        return 0.0;
+    }
+    if (m_starts.size() == 1) {
+        return std::max(0.0, m_settings[0].basalRate) / 60.0 * (toMinutes - fromMinutes);
+    }
+    return cumulativeUnits(toMinutes) - cumulativeUnits(fromMinutes);
+}
+
+double ProfileSchedule::dailyBasalUnits() const
+{
+    return m_dailyUnits;
+}
+
+double ProfileSchedule::cumulativeUnits(double minutes) const
+{
+    double minuteOfDay;
+    double day = splitDay(minutes, &minuteOfDay);
+    int i = segmentAt(minuteOfDay);
+    return day * m_dailyUnits + m_cumulative[i]
+           + std::max(0.0, m_settings[i].basalRate) / 60.0 * (minuteOfDay - m_starts[i]);
+}
@@ -0,0 +1,53 @@
+// profileschedule.h
+#ifndef PROFILESCHEDULE_H
+#define PROFILESCHEDULE_H
+
+#include "profilemanager.h"
+#include <vector>
+
+// A profile laid out for lookups by time. Times are minutes since some
+// midnight and may run over any number of days.
+//
+// Next to each segment start it keeps the basal insulin delivered since
+// midnight (a prefix sum), so the insulin over any interval is two binary
+// searches and a subtraction. A one-hour step or a jump between events is
+// then as exact as stepping minute by minute.
+class ProfileSchedule
+{
+public:
+    ProfileSchedule();
+    explicit ProfileSchedule(const ProfileData &profile);
+
+    int segmentCount() const;
+
+    // Segment in effect at the given time
+    int segmentAt(double minutes) const;
+
+    // Settings of one segment, as a profile without segments
+    ProfileData settings(int segment) const;
+    ProfileData settingsAt(double minutes) const;
+
+    // Start of the first segment after the given time; infinity for a
+    // profile with one setting all day
+    double nextBoundary(double minutes) const;
+
+    // Programmed basal rate (U/hr) at the given time
+    double basalRateAt(double minutes) const;
+
+    // Programmed basal insulin (U) over [fromMinutes, toMinutes)
+    double basalUnits(double fromMinutes, double toMinutes) const;
+
+    // Programmed basal insulin over a whole day
+    double dailyBasalUnits() const;
+
+private:
+    // Basal delivered from minute 0 up to the given time
+    double cumulativeUnits(double minutes) const;
+
+    std::vector<double> m_starts;          // Minute of day each segment starts
+    std::vector<double> m_cumulative;      // Units delivered since midnight at each start
+    std::vector<ProfileData> m_settings;
+    double m_dailyUnits;
+};
+
+#endif // PROFILESCHEDULE_H
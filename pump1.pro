@@ -2,29 +2,29 @@ QT       += core gui charts
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG += c++11
+CONFIG += c++17
 QT += charts
 
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(core.pri)
+
 SOURCES += \
-    cgm.cpp \
-    insulinpump.cpp \
+    bolusexplorerdialog.cpp \
+    glucosechartwidget.cpp \
+    logviewwidget.cpp \
     main.cpp \
     mainwindow.cpp \
-    profilemanager.cpp \
-    systemlog.cpp \
-    timesimulator.cpp
+    tickprofilerwidget.cpp
 
 HEADERS += \
-    cgm.h \
-    insulinpump.h \
+    bolusexplorerdialog.h \
+    glucosechartwidget.h \
+    logviewwidget.h \
     mainwindow.h \
-    profilemanager.h \
-    systemlog.h \
-    timesimulator.h
+    tickprofilerwidget.h
 
 FORMS += \
     mainwindow.ui
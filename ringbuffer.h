@@ -0,0 +1,201 @@
+// ringbuffer.h
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QVector>
+#include <QDataStream>
+#include <iterator>
+#include <type_traits>
+
+// Fixed-capacity circular buffer. Pushing onto a full buffer overwrites the
+// oldest element, so appending is O(1) and nothing is ever shifted.
+// Index 0 is the oldest element, size() - 1 the newest.
+template <typename T>
+class RingBuffer
+{
+public:
+    class View;
+
+    // Random-access iterator over a logical index range
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = int;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator() = default;
+        const_iterator(const RingBuffer *ring, int index) : m_ring(ring), m_index(index) {}
+
+        reference operator*() const { return m_ring->at(m_index); }
+        pointer operator->() const { return &m_ring->at(m_index); }
+        reference operator[](int n) const { return m_ring->at(m_index + n); }
+
+        const_iterator &operator++() { ++m_index; return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; ++m_index; return it; }
+        const_iterator &operator--() { --m_index; return *this; }
+        const_iterator operator--(int) { const_iterator it = *this; --m_index; return it; }
+        const_iterator &operator+=(int n) { m_index += n; return *this; }
+        const_iterator &operator-=(int n) { m_index -= n; return *this; }
+        const_iterator operator+(int n) const { return const_iterator(m_ring, m_index + n); }
+        const_iterator operator-(int n) const { return const_iterator(m_ring, m_index - n); }
+        int operator-(const const_iterator &other) const { return m_index - other.m_index; }
+
+        bool operator==(const const_iterator &other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator &other) const { return m_index != other.m_index; }
+        bool operator<(const const_iterator &other) const { return m_index < other.m_index; }
+
+    private:
+        const RingBuffer *m_ring = nullptr;
+        int m_index = 0;
+    };
+
+    explicit RingBuffer(int capacity = 0)
+    {
+        setCapacity(capacity);
+    }
+
+    // Change the capacity, keeping the newest elements that still fit
+    void setCapacity(int capacity)
+    {
+        if (capacity < 0) {
+            capacity = 0;
+        }
+        QVector<T> data(capacity);
+        int keep = qMin(m_size, capacity);
+        for (int i = 0; i < keep; ++i) {
+            data[i] = at(m_size - keep + i);
+        }
+        m_data = data;
+        m_start = 0;
+        m_size = keep;
+    }
+
+    int capacity() const { return m_data.size(); }
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    bool isFull() const { return m_size == m_data.size(); }
+
+    void clear()
+    {
+        m_start = 0;
+        m_size = 0;
+    }
+
+    void push(const T &value)
+    {
+        int cap = m_data.size();
+        if (cap == 0) {
+            return;
+        }
+        if (m_size < cap) {
+            m_data[physical(m_size)] = value;
+            ++m_size;
+        } else {
+            // Full: overwrite the oldest element and move the start forward
+            m_data[m_start] = value;
+            m_start = (m_start + 1 == cap) ? 0 : m_start + 1;
+        }
+    }
+
+    const T &at(int i) const { return m_data.at(physical(i)); }
+    const T &operator[](int i) const { return at(i); }
+    const T &first() const { return at(0); }
+    const T &last() const { return at(m_size - 1); }
+    T &last() { return m_data[physical(m_size - 1)]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+    // Zero-copy view of the newest count elements (all of them if count
+    // exceeds size()). Valid until the buffer is next modified.
+    View newest(int count) const
+    {
+        count = qBound(0, count, m_size);
+        return View(this, m_size - count, count);
+    }
+
+    View all() const { return View(this, 0, m_size); }
+
+    // Non-owning window onto a contiguous logical range of the buffer
+    class View
+    {
+    public:
+        View() = default;
+        View(const RingBuffer *ring, int offset, int count)
+            : m_ring(ring), m_offset(offset), m_count(count) {}
+
+        int size() const { return m_count; }
+        bool isEmpty() const { return m_count == 0; }
+        const T &at(int i) const { return m_ring->at(m_offset + i); }
+        const T &operator[](int i) const { return at(i); }
+        const T &front() const { return at(0); }
+        const T &back() const { return at(m_count - 1); }
+
+        const_iterator begin() const { return const_iterator(m_ring, m_offset); }
+        const_iterator end() const { return const_iterator(m_ring, m_offset + m_count); }
+
+    private:
+        const RingBuffer *m_ring = nullptr;
+        int m_offset = 0;
+        int m_count = 0;
+    };
+
+private:
+    template <typename U> friend QDataStream &operator<<(QDataStream &, const RingBuffer<U> &);
+    template <typename U> friend QDataStream &operator>>(QDataStream &, RingBuffer<U> &);
+
+    int physical(int i) const
+    {
+        int p = m_start + i;
+        int cap = m_data.size();
+        return p >= cap ? p - cap : p;
+    }
+
+    QVector<T> m_data;
+    int m_start = 0;     // Physical index of the oldest element
+    int m_size = 0;
+};
+
+// Capacity and contents, oldest first, as raw element bytes in host byte
+// order: two block copies however large the buffer
+template <typename T>
+QDataStream &operator<<(QDataStream &out, const RingBuffer<T> &ring)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Ring elements are copied as bytes");
+    int capacity = ring.capacity();
+    int head = qMin(ring.m_size, capacity - ring.m_start);
+    out << qint32(capacity) << qint32(ring.m_size);
+    if (ring.m_size > 0) {
+        out.writeRawData(reinterpret_cast<const char *>(ring.m_data.constData() + ring.m_start),
+                         int(head * sizeof(T)));
+        out.writeRawData(reinterpret_cast<const char *>(ring.m_data.constData()),
+                         int((ring.m_size - head) * sizeof(T)));
+    }
+    return out;
+}
+
+// Reads into a ring of the capacity that was written
+template <typename T>
+QDataStream &operator>>(QDataStream &in, RingBuffer<T> &ring)
+{
+    qint32 capacity = 0;
+    qint32 size = 0;
+    in >> capacity >> size;
+    ring.clear();
+    if (in.status() != QDataStream::Ok || capacity != ring.capacity() || size < 0 || size > capacity) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return in;
+    }
+    int bytes = int(size * sizeof(T));
+    if (in.readRawData(reinterpret_cast<char *>(ring.m_data.data()), bytes) != bytes) {
+        in.setStatus(QDataStream::ReadPastEnd);
+        return in;
+    }
+    ring.m_size = size;
+    return in;
+}
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,393 @@
+// scenario.cpp
+#include "scenario.h"
+#include "timesimulator.h"
+#include <QFile>
+#include <algorithm>
+
+namespace {
+
+// "HH:MM" as minutes after midnight
+bool parseClock(const QString &word, double &minutes)
+{
+    int colon = word.indexOf(':');
+    if (colon < 1) {
+        return false;
+    }
+    bool hoursOk = false, minutesOk = false;
+    int h = word.left(colon).toInt(&hoursOk);
+    int m = word.mid(colon + 1).toInt(&minutesOk);
+    if (!hoursOk || !minutesOk || h < 0 || h > 23 || m < 0 || m > 59 || word.size() - colon != 3) {
+        return false;
+    }
+    minutes = h * 60.0 + m;
+    return true;
+}
+
+bool parsePositive(const QString &word, double &value)
+{
+    bool ok = false;
+    value = word.toDouble(&ok);
+    return ok && value > 0.0;
+}
+
+QStringList splitWords(const QByteArray &line)
+{
+    QString text = QString::fromUtf8(line);
+    int hash = text.indexOf('#');
+    if (hash >= 0) {
+        text.truncate(hash);
+    }
+    text = text.simplified();
+    return text.isEmpty() ? QStringList() : text.split(' ');
+}
+
+bool isEventLine(const QStringList &words)
+{
+    return words.first() == "day" || words.first().contains(':');
+}
+
+}
+
+Scenario::Scenario()
+    : m_days(1),
+      m_startMinuteOfDay(0.0),
+      m_tickMinutes(SIMULATION_SPEED),
+      m_glucoseModel(RandomWalkGlucoseModel),
+      m_hasNoiseSeed(false),
+      m_noiseSeed(0),
+      m_startGlucose(0.0)
+{
+}
+
+bool Scenario::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *this = Scenario();
+        m_error = file.errorString();
+        return false;
+    }
+    return parse(file.readAll());
+}
+
+bool Scenario::parse(const QByteArray &text)
+{
+    *this = Scenario();
+    QList<QByteArray> lines = text.split('\n');
+
+    // Settings and profiles first, wherever they are, so events can use them
+    for (int i = 0; i < lines.size(); ++i) {
+        QStringList words = splitWords(lines.at(i));
+        if (!words.isEmpty() && !isEventLine(words) && !parseSetting(i + 1, words)) {
+            return false;
+        }
+    }
+    if (m_profiles.isEmpty()) {
+        return fail(0, "no profile");
+    }
+
+    for (int i = 0; i < lines.size(); ++i) {
+        QStringList words = splitWords(lines.at(i));
+        if (!words.isEmpty() && isEventLine(words) && !parseEvent(i + 1, words)) {
+            return false;
+        }
+    }
+
+    std::stable_sort(m_events.begin(), m_events.end(), [](const ScenarioEvent &a, const ScenarioEvent &b) {
+        return a.minutes < b.minutes;
+    });
+    return true;
+}
+
+bool Scenario::fail(int line, const QString &message)
+{
+    QString error = line > 0 ? QString("line %1: %2").arg(line).arg(message) : message;
+    *this = Scenario();
+    m_error = error;
+    return false;
+}
+
+bool Scenario::parseSetting(int line, const QStringList &words)
+{
+    const QString &key = words.first();
+    if (key == "profile") {
+        if (words.size() != 10) {
+            return fail(line, "expected: profile NAME basal U/h carbs g/U correction mmol/L/U target mmol/L");
+        }
+        const QString &name = words.at(1);
+        if (m_profileNames.contains(name)) {
+            return fail(line, "profile " + name + " defined twice");
+        }
+        ProfileData p{0.0, 0.0, 0.0, 0.0, {}};
+        for (int i = 2; i < words.size(); i += 2) {
+            double value = 0.0;
+            bool ok = false;
+            value = words.at(i + 1).toDouble(&ok);
+            if (!ok || value < 0.0) {
+                return fail(line, "bad " + words.at(i) + " value " + words.at(i + 1));
+            }
+            if (words.at(i) == "basal") {
+                p.basalRate = value;
+            } else if (words.at(i) == "carbs") {
+                p.carbRatio = value;
+            } else if (words.at(i) == "correction") {
+                p.correctionFactor = value;
+            } else if (words.at(i) == "target") {
+                p.targetBG = value;
+            } else {
+                return fail(line, "unknown profile setting " + words.at(i));
+            }
+        }
+        if (p.carbRatio <= 0.0 || p.correctionFactor <= 0.0 || p.targetBG <= 0.0) {
+            return fail(line, "profile " + name + " needs carbs, correction and target");
+        }
+        m_profiles.append(p);
+        m_profileNames.append(name);
+        return true;
+    }
+
+    if (words.size() != 2) {
+        return fail(line, "expected one value after " + key);
+    }
+    const QString &word = words.at(1);
+    double value = 0.0;
+    if (key == "days") {
+        bool ok = false;
+        m_days = word.toInt(&ok);
+        if (!ok || m_days < 1) {
+            return fail(line, "bad day count " + word);
+        }
+    } else if (key == "start") {
+        if (!parseClock(word, m_startMinuteOfDay)) {
+            return fail(line, "bad time " + word);
+        }
+    } else if (key == "tick") {
+        if (!parsePositive(word, m_tickMinutes)) {
+            return fail(line, "bad tick length " + word);
+        }
+    } else if (key == "model") {
+        if (word == "bergman") {
+            m_glucoseModel = BergmanGlucoseModel;
+        } else if (word == "randomwalk") {
+            m_glucoseModel = RandomWalkGlucoseModel;
+        } else {
+            return fail(line, "unknown model " + word);
+        }
+    } else if (key == "seed") {
+        bool ok = false;
+        m_noiseSeed = word.toULongLong(&ok);
+        m_hasNoiseSeed = ok;
+        if (!ok) {
+            return fail(line, "bad seed " + word);
+        }
+    } else if (key == "glucose") {
+        if (!parsePositive(word, value)) {
+            return fail(line, "bad glucose " + word);
+        }
+        m_startGlucose = value;
+    } else {
+        return fail(line, "unknown setting " + key);
+    }
+    return true;
+}
+
+bool Scenario::parseEvent(int line, QStringList words)
+{
+    int day = 1;
+    if (words.first() == "day") {
+        bool ok = false;
+        day = words.value(1).toInt(&ok);
+        if (!ok || day < 1) {
+            return fail(line, "bad day " + words.value(1));
+        }
+        words = words.mid(2);
+    }
+    double clock = 0.0;
+    if (words.isEmpty() || !parseClock(words.first(), clock)) {
+        return fail(line, "expected a time HH:MM");
+    }
+    bool daily = words.last() == "daily";
+    if (daily) {
+        words.removeLast();
+    }
+    words.removeFirst();
+    if (words.isEmpty()) {
+        return fail(line, "expected an event after the time");
+    }
+
+    double minutes = (day - 1) * 1440.0 + clock - m_startMinuteOfDay;
+    // A daily event earlier in the day than the start first happens the day after
+    while (daily && minutes < 0.0) {
+        minutes += 1440.0;
+    }
+    if (minutes < 0.0) {
+        return fail(line, "before the start of the run");
+    }
+    if (minutes >= durationMinutes()) {
+        return fail(line, "after the end of the run");
+    }
+
+    ScenarioEvent e = {minutes, 0, 0, 0.0, 0.0};
+    const QString &action = words.first();
+    if (action == "meal") {
+        e.action = ScenarioMeal;
+        if (words.size() < 2 || !parsePositive(words.at(1), e.value)) {
+            return fail(line, "expected: meal GRAMS [absorption MINUTES] [bolus]");
+        }
+        for (int i = 2; i < words.size(); ++i) {
+            if (words.at(i) == "bolus") {
+                e.index = 1;
+            } else if (words.at(i) == "absorption" && i + 1 < words.size()
+                       && parsePositive(words.at(i + 1), e.value2)) {
+                ++i;
+            } else {
+                return fail(line, "unexpected " + words.at(i));
+            }
+        }
+    } else if (action == "bolus") {
+        e.action = ScenarioBolus;
+        bool ok = false;
+        e.value = words.value(1).toDouble(&ok);
+        if (!ok || e.value < 0.0) {
+            return fail(line, "expected: bolus UNITS [extended UNITS hours HOURS]");
+        }
+        if (words.size() > 2) {
+            double hours = 0.0;
+            if (words.size() != 6 || words.at(2) != "extended" || words.at(4) != "hours"
+                || !parsePositive(words.at(3), e.value2) || !parsePositive(words.at(5), hours)) {
+                return fail(line, "expected: bolus UNITS [extended UNITS hours HOURS]");
+            }
+            e.index = qint32(qRound(hours * 60.0));
+        }
+        if (e.value <= 0.0 && e.value2 <= 0.0) {
+            return fail(line, "bolus of nothing");
+        }
+    } else if (action == "profile") {
+        e.action = ScenarioProfileSwitch;
+        e.index = words.size() == 2 ? m_profileNames.indexOf(words.at(1)) : -1;
+        if (e.index < 0) {
+            return fail(line, "unknown profile " + words.value(1));
+        }
+    } else if (action == "dropout") {
+        e.action = ScenarioDropout;
+        if (words.size() != 2 || !parsePositive(words.at(1), e.value)) {
+            return fail(line, "expected: dropout MINUTES");
+        }
+    } else if (words.size() == 1 && action == "suspend") {
+        e.action = ScenarioSuspend;
+    } else if (words.size() == 1 && action == "resume") {
+        e.action = ScenarioResume;
+    } else if (words.size() == 1 && action == "cartridge") {
+        e.action = ScenarioCartridge;
+    } else {
+        return fail(line, "unknown event " + words.join(' '));
+    }
+
+    // A daily event repeats up to the end of the run
+    do {
+        m_events.append(e);
+        e.minutes += 1440.0;
+    } while (daily && e.minutes < durationMinutes());
+    return true;
+}
+
+QString Scenario::errorString() const
+{
+    return m_error;
+}
+
+int Scenario::days() const
+{
+    return m_days;
+}
+
+double Scenario::durationMinutes() const
+{
+    return m_days * 1440.0;
+}
+
+double Scenario::startMinuteOfDay() const
+{
+    return m_startMinuteOfDay;
+}
+
+double Scenario::tickMinutes() const
+{
+    return m_tickMinutes;
+}
+
+GlucoseModelType Scenario::glucoseModel() const
+{
+    return m_glucoseModel;
+}
+
+bool Scenario::hasNoiseSeed() const
+{
+    return m_hasNoiseSeed;
+}
+
+quint64 Scenario::noiseSeed() const
+{
+    return m_noiseSeed;
+}
+
+double Scenario::startGlucose() const
+{
+    return m_startGlucose;
+}
+
+const QVector<ProfileData> &Scenario::profiles() const
+{
+    return m_profiles;
+}
+
+const QStringList &Scenario::profileNames() const
+{
+    return m_profileNames;
+}
+
+const QVector<ScenarioEvent> &Scenario::events() const
+{
+    return m_events;
+}
+
+QString Scenario::actionName(ScenarioAction action)
+{
+    switch (action) {
+    case ScenarioMeal:          return "Meal";
+    case ScenarioBolus:         return "Bolus";
+    case ScenarioSuspend:       return "Suspend";
+    case ScenarioResume:        return "Resume";
+    case ScenarioProfileSwitch: return "Profile";
+    case ScenarioCartridge:     return "Cartridge";
+    case ScenarioDropout:       return "Sensor dropout";
+    case ScenarioActionCount:   break;
+    }
+    return "Unknown";
+}
+
+QString Scenario::describe(ScenarioAction action, double value, double value2, int index)
+{
+    switch (action) {
+    case ScenarioMeal:
+        return QString("Scenario: meal %1 g").arg(value);
+    case ScenarioBolus:
+        if (value2 > 0.0) {
+            return QString("Scenario: bolus %1 U, %2 U extended over %3 min").arg(value).arg(value2).arg(index);
+        }
+        return QString("Scenario: bolus %1 U").arg(value);
+    case ScenarioSuspend:
+        return "Scenario: basal suspended";
+    case ScenarioResume:
+        return value > 0.0 ? "Scenario: basal resumed" : "Scenario: basal not resumed, no profile";
+    case ScenarioProfileSwitch:
+        return QString("Scenario: switched to profile %1").arg(index + 1);
+    case ScenarioCartridge:
+        return "Scenario: cartridge replaced";
+    case ScenarioDropout:
+        return QString("Scenario: sensor dropout for %1 min").arg(value);
+    case ScenarioActionCount:
+        break;
+    }
+    return "Scenario: unknown event";
+}
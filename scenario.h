@@ -0,0 +1,109 @@
+// scenario.h
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "glucosemodel.h"
+#include "profilemanager.h"
+
+// What a scenario event does. Stored in log records, so only append.
+enum ScenarioAction {
+    ScenarioMeal,           // value = grams, value2 = absorption minutes (0: shared curve), index = 1 to bolus
+    ScenarioBolus,          // value = units now, value2 = extended units, index = extended minutes
+    ScenarioSuspend,        // Basal off until a resume
+    ScenarioResume,         // Logged with value = 1 if basal restarted
+    ScenarioProfileSwitch,  // index = position in profiles()
+    ScenarioCartridge,      // Reservoir replaced
+    ScenarioDropout,        // value = minutes without sensor readings
+    ScenarioActionCount
+};
+
+// One compiled event; the whole run is a flat array of these
+struct ScenarioEvent {
+    double minutes;         // Since the scenario start
+    qint32 action;          // ScenarioAction
+    qint32 index;
+    double value;
+    double value2;
+};
+
+// A repeatable run, written as text and compiled once. Everything is
+// parsed, checked, expanded (daily events) and sorted by time up front, so
+// the engine plays it with one cursor over events() and does no parsing
+// or allocation on the way.
+//
+// One statement per line; '#' starts a comment:
+//
+//     days 3                          run length (default 1)
+//     start 06:00                     time of day the run starts (default 00:00)
+//     tick 5                          minutes per engine tick (default 5)
+//     model bergman                   or randomwalk (default)
+//     seed 42                         sensor noise seed
+//     glucose 7.0                     starting glucose, mmol/L
+//     profile Day basal 0.9 carbs 10 correction 2 target 5.5
+//                                     the first profile runs from the start
+//     07:30 meal 60 absorption 240 bolus daily
+//     day 2 12:00 bolus 3 extended 2 hours 2
+//     day 2 14:00 suspend
+//     day 2 15:30 resume
+//     day 3 00:00 profile Night
+//     day 3 09:00 cartridge
+//     day 3 10:00 dropout 45
+//
+// Times are clock times on day 1 unless a "day N" comes first; "daily"
+// repeats an event on every day of the run from that one on, starting the
+// next day if it falls before the start of the run. A meal with "bolus"
+// is bolused from the current profile and glucose. A meal with an
+// absorption time is absorbed on the default curve shape stretched to
+// that time; other meals use the CGM's carb curve as set.
+class Scenario
+{
+public:
+    Scenario();
+
+    bool load(const QString &path);
+    bool parse(const QByteArray &text);
+    QString errorString() const;        // "line N: ..." after a failed load
+
+    int days() const;
+    double durationMinutes() const;
+    double startMinuteOfDay() const;
+    double tickMinutes() const;
+    GlucoseModelType glucoseModel() const;
+    bool hasNoiseSeed() const;
+    quint64 noiseSeed() const;
+    double startGlucose() const;        // 0 when not given
+
+    const QVector<ProfileData> &profiles() const;
+    const QStringList &profileNames() const;
+
+    // Time order; events at the same minute keep their file order
+    const QVector<ScenarioEvent> &events() const;
+
+    static QString actionName(ScenarioAction action);
+
+    // Log text for an event, without its time
+    static QString describe(ScenarioAction action, double value, double value2, int index);
+
+private:
+    bool fail(int line, const QString &message);
+    bool parseSetting(int line, const QStringList &words);
+    bool parseEvent(int line, QStringList words);
+
+    int m_days;
+    double m_startMinuteOfDay;
+    double m_tickMinutes;
+    GlucoseModelType m_glucoseModel;
+    bool m_hasNoiseSeed;
+    quint64 m_noiseSeed;
+    double m_startGlucose;
+    QVector<ProfileData> m_profiles;
+    QStringList m_profileNames;
+    QVector<ScenarioEvent> m_events;
+    QString m_error;
+};
+
+#endif // SCENARIO_H
@@ -0,0 +1,978 @@
+// simulationengine.cpp
+#include "simulationengine.h"
+#include "columnarwriter.h"
+#include "therapyrules.h"
+#include "tickprofiler.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <cmath>
+#include <limits>
+
+QDataStream &operator<<(QDataStream &out, const MealEvent &meal)
+{
+    return out << qint32(meal.minuteOfDay) << meal.grams;
+}
+
+QDataStream &operator>>(QDataStream &in, MealEvent &meal)
+{
+    qint32 minuteOfDay = 0;
+    in >> minuteOfDay >> meal.grams;
+    meal.minuteOfDay = minuteOfDay;
+    return in;
+}
+
+SimulationEngine::SimulationEngine(QObject *parent)
+    : QObject(parent),
+      m_profileManager(new ProfileManager(this)),
+      m_insulinPump(new InsulinPump(this)),
+      m_cgm(new CGM(this)),
+      m_systemLog(new SystemLog(this)),
+      m_startMs(QDateTime(QDate(2025, 1, 1), QTime(0, 0, 0)).toMSecsSinceEpoch()),
+      m_startMinuteOfDay(0.0),
+      m_elapsedMinutes(0.0),
+      m_tickMinutes(SIMULATION_SPEED),
+      m_currentProfile(),
+      m_profileSegment(0),
+      m_extBolusRemaining(0.0),
+      m_extBolusRatePerTick(0.0)
+{
+    m_insulinPump->setCGM(m_cgm);
+
+    // Every reading, simulated or replayed, feeds the glucose alarms
+    connect(m_cgm, &CGM::readingAdded, this, &SimulationEngine::onReadingAdded);
+
+    AlarmSettings low;
+    low.raiseAt = LOW_GLUCOSE_THRESHOLD;
+    low.clearAt = LOW_GLUCOSE_CLEAR;
+    low.escalateMinutes = 5.0;
+    low.snoozeMinutes = 15.0;
+    m_alarms.setSettings(LowGlucoseAlarm, low);
+
+    AlarmSettings high;
+    high.below = false;
+    high.raiseAt = HIGH_GLUCOSE_THRESHOLD;
+    high.clearAt = HIGH_GLUCOSE_CLEAR;
+    high.escalateMinutes = 30.0;
+    high.snoozeMinutes = 180.0;
+    m_alarms.setSettings(HighGlucoseAlarm, high);
+
+    AlarmSettings battery;
+    battery.raiseAt = LOW_BATTERY_LEVEL;
+    battery.clearAt = LOW_BATTERY_CLEAR;
+    battery.escalateMinutes = 60.0;
+    battery.snoozeMinutes = 240.0;
+    m_alarms.setSettings(LowBatteryAlarm, battery);
+
+    AlarmSettings insulin = battery;
+    insulin.raiseAt = LOW_INSULIN_LEVEL;
+    insulin.clearAt = LOW_INSULIN_CLEAR;
+    m_alarms.setSettings(LowInsulinAlarm, insulin);
+}
+
+CGM *SimulationEngine::cgm() const
+{
+    return m_cgm;
+}
+
+InsulinPump *SimulationEngine::insulinPump() const
+{
+    return m_insulinPump;
+}
+
+ProfileManager *SimulationEngine::profileManager() const
+{
+    return m_profileManager;
+}
+
+AlarmManager *SimulationEngine::alarms()
+{
+    return &m_alarms;
+}
+
+SystemLog *SimulationEngine::systemLog() const
+{
+    return m_systemLog;
+}
+
+void SimulationEngine::setStartTime(const QDateTime &start)
+{
+    m_startMs = start.toMSecsSinceEpoch();
+    m_startMinuteOfDay = start.time().msecsSinceStartOfDay() / 60000.0;
+}
+
+QDateTime SimulationEngine::currentSimulatedTime() const
+{
+    return QDateTime::fromMSecsSinceEpoch(currentSimulatedMsecs());
+}
+
+qint64 SimulationEngine::currentSimulatedMsecs() const
+{
+    return m_startMs + std::llround(m_elapsedMinutes * 60000.0);
+}
+
+double SimulationEngine::elapsedSimulatedMinutes() const
+{
+    return m_elapsedMinutes;
+}
+
+void SimulationEngine::setTickMinutes(double minutes)
+{
+    if (minutes > 0.0) {
+        m_tickMinutes = minutes;
+    }
+}
+
+double SimulationEngine::tickMinutes() const
+{
+    return m_tickMinutes;
+}
+
+void SimulationEngine::seedHistory(int readings)
+{
+    qint64 now = currentSimulatedMsecs();
+    for (int i = readings; i > 0; --i) {
+        m_cgm->generateReading(now - std::llround(i * m_tickMinutes * 60000.0));
+    }
+}
+
+void SimulationEngine::setCurrentProfile(const ProfileData &profile)
+{
+    m_currentProfile = profile;
+    m_profileSchedule = ProfileSchedule(profile);
+    m_profileSegment = m_profileSchedule.segmentAt(clockMinutes());
+    m_controller.setTherapy(m_profileSchedule.settings(m_profileSegment));
+    if (m_eventsPrimed) {
+        scheduleProfileSegment(clockMinutes());
+    }
+}
+
+ProfileData SimulationEngine::currentProfile() const
+{
+    return m_currentProfile;
+}
+
+int SimulationEngine::currentProfileSegment() const
+{
+    return m_profileSegment;
+}
+
+void SimulationEngine::setUserSuspendedInsulin(bool suspended)
+{
+    m_userSuspendedInsulin = suspended;
+}
+
+bool SimulationEngine::userSuspendedInsulin() const
+{
+    return m_userSuspendedInsulin;
+}
+
+void SimulationEngine::scheduleExtendedBolus(double units, double hours)
+{
+    double ticksPerHour = 60.0 / m_tickMinutes;
+    double totalTicks = ticksPerHour * hours;
+    m_extBolusRatePerTick = (totalTicks > 0 ? units / totalTicks : 0.0);
+    m_extBolusRemaining = units;
+
+    // Event-driven runs pulse every sensor interval instead of every tick
+    double pulses = hours * 60.0 / NOMINAL_READING_MINUTES;
+    m_extBolusPerPulse = (pulses > 0 ? units / pulses : 0.0);
+    if (m_eventsPrimed) {
+        m_events.schedule(m_elapsedMinutes, ExtendedBolusEvent, 0, ++m_extBolusGeneration);
+    }
+}
+
+double SimulationEngine::extendedBolusRemaining() const
+{
+    return m_extBolusRemaining;
+}
+
+double SimulationEngine::extendedBolusRatePerTick() const
+{
+    return m_extBolusRatePerTick;
+}
+
+void SimulationEngine::setMealPattern(const QVector<MealEvent> &meals)
+{
+    m_meals = meals;
+    if (m_eventsPrimed) {
+        scheduleMeals();
+    }
+}
+
+void SimulationEngine::setAutoService(bool enabled)
+{
+    m_autoService = enabled;
+}
+
+void SimulationEngine::setTraceReplay(TraceReplay *trace)
+{
+    m_trace = trace;
+    m_traceErrorsLogged = 0;
+    if (!trace) {
+        m_insulinPump->setRecordedBasalRate(-1.0);
+    }
+}
+
+TraceReplay *SimulationEngine::traceReplay() const
+{
+    return m_trace;
+}
+
+void SimulationEngine::setScenario(const Scenario *scenario)
+{
+    m_scenario = scenario;
+    m_scenarioStart = m_elapsedMinutes;
+    m_scenarioNext = 0;
+    m_sensorDropoutUntil = 0.0;
+    if (m_eventsPrimed) {
+        scheduleScenario();
+    }
+}
+
+const Scenario *SimulationEngine::scenario() const
+{
+    return m_scenario;
+}
+
+bool SimulationEngine::scenarioFinished() const
+{
+    return !std::isfinite(nextScenarioMinutes());
+}
+
+void SimulationEngine::setOutputWriter(ColumnarWriter *writer)
+{
+    m_output = writer;
+    m_outputBolusMark = m_insulinPump->bolusUnitsDelivered();
+}
+
+ColumnarWriter *SimulationEngine::outputWriter() const
+{
+    return m_output;
+}
+
+void SimulationEngine::setLoggingEnabled(bool enabled)
+{
+    m_loggingEnabled = enabled;
+}
+
+// --- Simulation ---
+
+void SimulationEngine::tick()
+{
+    // Polling moves the clock without the queue, which is rebuilt if needed
+    m_eventsPrimed = false;
+    syncProfileClock();
+
+    // 1) CGM reading
+    {
+        TICK_PROFILE_SCOPE(SensorPhase);
+        sampleSensor();
+    }
+    double currentBG = m_cgm->currentGlucose(); // Gets current Blood Glucose Lvl
+
+    // 2) Meals and scenario events due in this tick
+    {
+        TICK_PROFILE_SCOPE(MealsPhase);
+        eatScheduledMeals(currentBG);
+        double tickEnd = m_elapsedMinutes + m_tickMinutes;
+        while (nextScenarioMinutes() < tickEnd) {
+            applyScenarioEvent(m_scenario->events().at(m_scenarioNext++));
+        }
+    }
+
+    // 3) Extended bolus
+    {
+        TICK_PROFILE_SCOPE(ExtendedBolusPhase);
+        deliverExtendedBolus(m_extBolusRatePerTick);
+    }
+
+    // 4) Control-IQ
+    {
+        TICK_PROFILE_SCOPE(ControlIqPhase);
+        runControlIQ(currentBG);
+    }
+
+    // 5) Basal tick + battery
+    {
+        TICK_PROFILE_SCOPE(BasalPhase);
+        m_insulinPump->performBasalTick(m_tickMinutes);
+        m_insulinPump->useBattery(BATTERY_DRAIN_PER_TICK);
+    }
+
+    // 6) Error checks
+    {
+        TICK_PROFILE_SCOPE(ErrorChecksPhase);
+        checkForErrors();
+    }
+
+    if (m_output) {
+        writeOutputRow(m_insulinPump->batteryLevel());
+    }
+    m_elapsedMinutes += m_tickMinutes;
+    emit tickCompleted();
+}
+
+void SimulationEngine::runTicks(qint64 ticks)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for (qint64 i = 0; i < ticks; ++i) {
+        tick();
+    }
+
+    qint64 ns = timer.nsecsElapsed();
+    m_ticksRun = ticks;
+    m_ticksPerSecond = (ns > 0 ? ticks * 1e9 / ns : 0.0);
+}
+
+void SimulationEngine::runFor(double simulatedMinutes)
+{
+    runTicks(static_cast<qint64>(simulatedMinutes / m_tickMinutes));
+}
+
+qint64 SimulationEngine::ticksRun() const
+{
+    return m_ticksRun;
+}
+
+double SimulationEngine::ticksPerSecond() const
+{
+    return m_ticksPerSecond;
+}
+
+void SimulationEngine::runEventsFor(double simulatedMinutes)
+{
+    if (!m_eventsPrimed) {
+        primeEvents();
+    }
+
+    double end = m_elapsedMinutes + simulatedMinutes;
+    qint64 events = 0;
+    while (!m_events.isEmpty() && m_events.next().minutes < end) {
+        ScheduledEvent e = m_events.pop();
+        m_elapsedMinutes = e.minutes;
+        handleEvent(e);
+        ++events;
+    }
+    m_elapsedMinutes = end;
+    settleBattery();
+    m_eventsRun = events;
+}
+
+qint64 SimulationEngine::eventsRun() const
+{
+    return m_eventsRun;
+}
+
+double SimulationEngine::clockMinutes() const
+{
+    return m_startMinuteOfDay + m_elapsedMinutes;
+}
+
+void SimulationEngine::syncProfileClock()
+{
+    // The pump picks its segment from its own clock; the controller gets
+    // new settings when the segment changes
+    double now = clockMinutes();
+    m_insulinPump->setTimeOfDay(now);
+    followProfileSegment(m_profileSchedule, now, m_profileSegment, m_controller);
+}
+
+void SimulationEngine::sampleSensor()
+{
+    m_cgm->setBasalActive(m_insulinPump->isBasalActive());
+    if (!m_trace) {
+        if (sensorDropout()) {
+            m_cgm->skipReading(currentSimulatedMsecs());
+        } else {
+            m_cgm->generateReading(currentSimulatedMsecs());
+        }
+        return;
+    }
+
+    m_trace->replayUntil(currentSimulatedMsecs(), m_cgm, m_insulinPump);
+    const QVector<TraceError> &errors = m_trace->errors();
+    if (m_traceErrorsLogged > errors.size()) {
+        m_traceErrorsLogged = 0;    // Trace was rewound
+    }
+    for (; m_traceErrorsLogged < errors.size(); ++m_traceErrorsLogged) {
+        const TraceError &error = errors.at(m_traceErrorsLogged);
+        logRecord(TraceErrorLogEvent, error.issue, 0.0, quint32(error.line));
+    }
+}
+
+void SimulationEngine::eatScheduledMeals(double currentBG)
+{
+    if (m_meals.isEmpty()) {
+        return;
+    }
+
+    // Meals whose time of day falls inside this tick
+    for (const MealEvent &meal : m_meals) {
+        if (dailyMealDue(meal.minuteOfDay, clockMinutes(), m_tickMinutes)) {
+            eatMeal(meal, currentBG);
+        }
+    }
+}
+
+void SimulationEngine::eatMeal(const MealEvent &meal, double currentBG, double absorptionMinutes)
+{
+    registerCarbs(meal.grams, absorptionMinutes);
+    double bolus = m_insulinPump->calculateBolus(currentBG, meal.grams);
+    if (m_insulinPump->deliverBolus(bolus)) {
+        logRecord(MealLogEvent, meal.grams, bolus);
+    } else {
+        logRecord(MealLogEvent, meal.grams);
+    }
+}
+
+double SimulationEngine::nextScenarioMinutes() const
+{
+    if (!m_scenario || m_scenarioNext >= m_scenario->events().size()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return m_scenarioStart + m_scenario->events().at(m_scenarioNext).minutes;
+}
+
+void SimulationEngine::applyScenarioEvent(const ScenarioEvent &e)
+{
+    double value = e.value;
+    switch (ScenarioAction(e.action)) {
+    case ScenarioMeal:
+        if (e.index) {
+            eatMeal(MealEvent{int(std::fmod(clockMinutes(), 1440.0)), e.value}, m_cgm->currentGlucose(),
+                    e.value2);
+        } else {
+            registerCarbs(e.value, e.value2);
+            logRecord(MealLogEvent, e.value);
+        }
+        return;     // Logged as a meal
+
+    case ScenarioBolus:
+        if (value > 0.0 && !m_insulinPump->deliverBolus(value)) {
+            value = 0.0;
+        }
+        if (e.value2 > 0.0) {
+            scheduleExtendedBolus(e.value2, e.index / 60.0);
+        }
+        break;
+
+    case ScenarioSuspend:
+        setUserSuspendedInsulin(true);
+        m_insulinPump->stopBasalDelivery();
+        break;
+
+    case ScenarioResume:
+        // As from the UI, only with a profile to deliver; value = 1 if resumed
+        setUserSuspendedInsulin(false);
+        value = m_profileManager->profileCount() > 0 ? 1.0 : 0.0;
+        if (value > 0.0) {
+            m_insulinPump->startBasalDelivery();
+        }
+        break;
+
+    case ScenarioProfileSwitch: {
+        const ProfileData &profile = m_scenario->profiles().at(e.index);
+        setCurrentProfile(profile);
+        m_insulinPump->setActiveProfile(profile);
+        break;
+    }
+
+    case ScenarioCartridge:
+        m_insulinPump->replenishInsulin();
+        break;
+
+    case ScenarioDropout:
+        m_sensorDropoutUntil = m_elapsedMinutes + e.value;
+        break;
+
+    case ScenarioActionCount:
+        return;
+    }
+    logRecord(ScenarioLogEvent, value, e.value2, quint32(e.action) | quint32(e.index) << 8);
+}
+
+bool SimulationEngine::sensorDropout() const
+{
+    return m_elapsedMinutes < m_sensorDropoutUntil;
+}
+
+void SimulationEngine::registerCarbs(double grams, double absorptionMinutes)
+{
+    if (absorptionMinutes > 0.0) {
+        // Default curve shape, stretched to the meal's own absorption time
+        m_cgm->registerCarbEffect(grams, absorptionMinutes * DEFAULT_CARB_PEAK / DEFAULT_CARB_DURATION,
+                                  absorptionMinutes);
+    } else {
+        m_cgm->registerCarbEffect(grams);
+    }
+}
+
+void SimulationEngine::deliverExtendedBolus(double units)
+{
+    if (m_extBolusRemaining > 0.0) {
+        double deliver = qMin(units, m_extBolusRemaining);
+        if (m_insulinPump->deliverBolus(deliver)) {
+            m_extBolusRemaining -= deliver;
+            if (m_extBolusRemaining <= 0.0) {
+                logRecord(ExtendedBolusDoneLogEvent);
+            }
+        }
+    }
+}
+
+void SimulationEngine::runControlIQ(double currentBG)
+{
+    if (sensorDropout()) {
+        // Nothing new to act on: the pump falls back to the profile basal
+        if (!m_userSuspendedInsulin) {
+            if (!m_insulinPump->isBasalActive() && m_profileManager->profileCount() > 0) {
+                m_insulinPump->startBasalDelivery();
+                logRecord(BasalResumedLogEvent, 0.0, 0.0, 1);
+            }
+            m_insulinPump->setBasalMultiplier(1.0);
+        }
+        return;
+    }
+
+    ControlIQDecision d = m_controller.update(currentBG, m_elapsedMinutes,
+                                              m_cgm->insulinOnBoard(), m_cgm->carbsOnBoard());
+
+    // Allow correction bolus regardless of user insulin pause flag
+    if (d.correctionBolus > 0.0 && m_insulinPump->deliverBolus(d.correctionBolus)) {
+        logRecord(CorrectionBolusLogEvent, d.correctionBolus, d.correctionPrediction,
+                  static_cast<quint32>(m_controller.correctionHorizon()));
+    }
+
+    // Basal control — only act if user hasn't explicitly paused
+    if (!m_userSuspendedInsulin) {
+        if (d.basalMultiplier <= 0.0) {
+            // Suspend basal if BG is heading low
+            if (m_insulinPump->isBasalActive()) {
+                m_insulinPump->stopBasalDelivery();
+                logRecord(BasalSuspendedLogEvent, d.predictedGlucose, 0.0,
+                          static_cast<quint32>(m_controller.basalHorizon()));
+            }
+        } else {
+            // Resume basal once the prediction is safe
+            if (!m_insulinPump->isBasalActive() && m_profileManager->profileCount() > 0) {
+                m_insulinPump->startBasalDelivery();
+                logRecord(BasalResumedLogEvent);
+            }
+        }
+        m_insulinPump->setBasalMultiplier(d.basalMultiplier);
+    }
+}
+
+void SimulationEngine::checkForErrors()
+{
+    checkBattery();
+    checkReservoir();
+}
+
+void SimulationEngine::checkBattery()
+{
+    if (m_autoService && m_insulinPump->batteryLevel() < LOW_BATTERY_LEVEL) {
+        m_insulinPump->rechargeBattery();
+        logRecord(BatteryChargedLogEvent);
+    }
+    if (updateAlarm(LowBatteryAlarm, m_insulinPump->batteryLevel())) {
+        emit lowBattery();
+    }
+}
+
+void SimulationEngine::checkReservoir()
+{
+    if (m_autoService && m_insulinPump->insulinUnitsRemaining() < LOW_INSULIN_LEVEL) {
+        m_insulinPump->replenishInsulin();
+        logRecord(InsulinReplenishedLogEvent);
+    }
+    if (updateAlarm(LowInsulinAlarm, m_insulinPump->insulinUnitsRemaining())) {
+        emit lowInsulin();
+    }
+}
+
+// One record per change of the alarm, not one per check
+bool SimulationEngine::updateAlarm(AlarmType type, double value)
+{
+    switch (m_alarms.update(type, value, m_elapsedMinutes)) {
+    case NoAlarmChange:
+        return false;
+    case AlarmRaised:
+    case AlarmEscalated:
+    case AlarmRepeated:
+        logRecord(AlarmRaisedLogEvent, value, m_alarms.info(type).level, quint32(type));
+        return true;
+    case AlarmAcknowledged:
+        logRecord(AlarmAcknowledgedLogEvent, value, 0.0, quint32(type));
+        return false;
+    case AlarmCleared:
+        logRecord(AlarmClearedLogEvent, value, 0.0, quint32(type));
+        return false;
+    }
+    return false;
+}
+
+void SimulationEngine::writeOutputRow(double battery)
+{
+    double bolusTotal = m_insulinPump->bolusUnitsDelivered();
+    OutputRow row;
+    row.timeMs = currentSimulatedMsecs();
+    row.value(GlucoseColumn) = float(m_cgm->currentGlucose());
+    row.value(IobColumn) = float(m_cgm->insulinOnBoard());
+    row.value(CobColumn) = float(m_cgm->carbsOnBoard());
+    row.value(BasalRateColumn) = float(m_insulinPump->currentBasalRate());
+    row.value(BolusColumn) = float(bolusTotal - m_outputBolusMark);
+    row.value(BatteryColumn) = float(battery);
+    row.value(ReservoirColumn) = float(m_insulinPump->insulinUnitsRemaining());
+    m_output->append(row);
+    m_outputBolusMark = bolusTotal;
+}
+
+// --- Event-driven mode ---
+
+void SimulationEngine::primeEvents()
+{
+    m_events.clear();
+    m_sampleOrigin = m_elapsedMinutes;
+    m_events.schedule(m_elapsedMinutes, CgmSampleEvent);
+    syncProfileClock();
+    scheduleProfileSegment(clockMinutes());
+    scheduleMeals();
+    scheduleScenario();
+    if (m_extBolusRemaining > 0.0) {
+        m_events.schedule(m_elapsedMinutes, ExtendedBolusEvent, 0, ++m_extBolusGeneration);
+    }
+    m_batterySettledMinutes = m_elapsedMinutes;
+    scheduleBatteryAlarm();
+    m_eventsPrimed = true;
+}
+
+// Sensor sample an event due at the given time is applied at: the one
+// that starts its interval, ahead of that sample's Control-IQ decision, as
+// tick() applies it at the start of its tick. Never before now.
+double SimulationEngine::dueSampleMinutes(double minutes) const
+{
+    double samples = std::floor((minutes - m_sampleOrigin) / NOMINAL_READING_MINUTES + 1e-9);
+    return qMax(m_elapsedMinutes, m_sampleOrigin + samples * NOMINAL_READING_MINUTES);
+}
+
+void SimulationEngine::scheduleMeals()
+{
+    ++m_mealGeneration;
+    for (int i = 0; i < m_meals.size(); ++i) {
+        scheduleMeal(i, m_elapsedMinutes);
+    }
+}
+
+void SimulationEngine::scheduleMeal(int index, double fromMinutes)
+{
+    // Next occurrence at or after fromMinutes
+    double minuteOfDay = std::fmod(m_startMinuteOfDay + fromMinutes, 1440.0);
+    double wait = m_meals[index].minuteOfDay - minuteOfDay;
+    if (wait < 0.0) {
+        wait += 1440.0;
+    }
+    m_events.schedule(dueSampleMinutes(fromMinutes + wait), MealDueEvent, index, m_mealGeneration);
+}
+
+void SimulationEngine::scheduleScenario()
+{
+    // Only the next event is queued; it plays everything due and queues on
+    ++m_scenarioGeneration;
+    double next = nextScenarioMinutes();
+    if (std::isfinite(next)) {
+        m_events.schedule(dueSampleMinutes(next), ScenarioDueEvent, 0, m_scenarioGeneration);
+    }
+}
+
+void SimulationEngine::scheduleProfileSegment(double afterMinutes)
+{
+    // Only the next boundary is queued; each one queues the one after
+    ++m_profileGeneration;
+    double next = m_profileSchedule.nextBoundary(afterMinutes);
+    if (std::isfinite(next)) {
+        m_events.schedule(next - m_startMinuteOfDay, ProfileSegmentEvent, 0, m_profileGeneration);
+    }
+}
+
+void SimulationEngine::scheduleBatteryAlarm()
+{
+    // When the battery will cross the low level at the standing drain; while
+    // it stays low, check every reading so the alarm can escalate or clear
+    double level = m_insulinPump->batteryLevel();
+    double wait = NOMINAL_READING_MINUTES;
+    if (level >= LOW_BATTERY_LEVEL) {
+        wait = qMax(1.0 / 60.0, (level - LOW_BATTERY_LEVEL) / BATTERY_DRAIN_PER_MINUTE);
+    }
+    m_events.schedule(m_elapsedMinutes + wait, BatteryAlarmEvent, 0, ++m_batteryGeneration);
+}
+
+void SimulationEngine::settleBattery()
+{
+    m_insulinPump->useBattery(BATTERY_DRAIN_PER_MINUTE * (m_elapsedMinutes - m_batterySettledMinutes));
+    m_batterySettledMinutes = m_elapsedMinutes;
+}
+
+void SimulationEngine::handleEvent(const ScheduledEvent &e)
+{
+    m_insulinPump->setTimeOfDay(clockMinutes());
+
+    switch (e.type) {
+    case ProfileSegmentEvent:
+        if (e.generation == m_profileGeneration) {
+            // Boundaries are whole minutes; round off the clock's float error
+            double boundary = std::round(clockMinutes());
+            followProfileSegment(m_profileSchedule, boundary, m_profileSegment, m_controller);
+            scheduleProfileSegment(boundary);
+        }
+        break;
+
+    case CgmSampleEvent:
+        sampleSensor();
+        m_events.schedule(e.minutes, ControlDecisionEvent);
+        m_events.schedule(e.minutes + NOMINAL_READING_MINUTES, CgmSampleEvent);
+        break;
+
+    case MealDueEvent:
+        if (e.generation == m_mealGeneration && e.index < m_meals.size()) {
+            eatMeal(m_meals[e.index], m_cgm->currentGlucose());
+            scheduleMeal(e.index, e.minutes + NOMINAL_READING_MINUTES);
+        }
+        break;
+
+    case ScenarioDueEvent:
+        if (e.generation == m_scenarioGeneration) {
+            while (dueSampleMinutes(nextScenarioMinutes()) <= e.minutes) {
+                applyScenarioEvent(m_scenario->events().at(m_scenarioNext++));
+            }
+            scheduleScenario();
+        }
+        break;
+
+    case ExtendedBolusEvent:
+        if (e.generation == m_extBolusGeneration && m_extBolusRemaining > 0.0) {
+            deliverExtendedBolus(m_extBolusPerPulse);
+            if (m_extBolusRemaining > 0.0) {
+                m_events.schedule(e.minutes + NOMINAL_READING_MINUTES, ExtendedBolusEvent,
+                                  0, e.generation);
+            }
+        }
+        break;
+
+    case ControlDecisionEvent:
+        // Basal for the coming sensor interval, as performBasalTick() does per tick
+        runControlIQ(m_cgm->currentGlucose());
+        m_insulinPump->performBasalTick(NOMINAL_READING_MINUTES);
+        checkReservoir();
+        if (m_output) {
+            // Battery drain is settled lazily; report it as of now
+            double drained = BATTERY_DRAIN_PER_MINUTE * (m_elapsedMinutes - m_batterySettledMinutes);
+            writeOutputRow(qMax(0.0, m_insulinPump->batteryLevel() - drained));
+        }
+        emit tickCompleted();
+        break;
+
+    case BatteryAlarmEvent:
+        if (e.generation == m_batteryGeneration) {
+            settleBattery();
+            checkBattery();
+            scheduleBatteryAlarm();
+        }
+        break;
+    }
+}
+
+// --- Snapshots ---
+
+QByteArray SimulationEngine::saveSnapshot() const
+{
+    QByteArray snapshot;
+    QDataStream out(&snapshot, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << SNAPSHOT_MAGIC << SNAPSHOT_VERSION << quint8(QSysInfo::ByteOrder);
+
+    out << m_startMs << m_startMinuteOfDay << m_elapsedMinutes << m_tickMinutes;
+    m_profileManager->saveState(out);
+    out << m_currentProfile;
+    m_controller.saveState(out);
+    m_insulinPump->saveState(out);
+    m_cgm->saveState(out);
+
+    out << m_extBolusRemaining << m_extBolusRatePerTick << m_extBolusPerPulse
+        << m_meals << m_userSuspendedInsulin << m_autoService << m_loggingEnabled;
+
+    out << m_eventsPrimed;
+    m_events.saveState(out);
+    out << m_mealGeneration << m_profileGeneration << m_extBolusGeneration
+        << m_batteryGeneration << m_batterySettledMinutes << m_sampleOrigin;
+    m_alarms.saveState(out);
+    out << m_scenarioStart << qint32(m_scenarioNext) << m_scenarioGeneration << m_sensorDropoutUntil;
+    return snapshot;
+}
+
+bool SimulationEngine::restoreSnapshot(const QByteArray &snapshot)
+{
+    if (!readSnapshot(snapshot)) {
+        return false;
+    }
+    m_alarms.announceAll();
+    return true;
+}
+
+bool SimulationEngine::readSnapshot(const QByteArray &snapshot)
+{
+    QDataStream in(snapshot);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint8 byteOrder = 0;
+    in >> magic >> version >> byteOrder;
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION
+        || byteOrder != quint8(QSysInfo::ByteOrder)) {
+        return false;
+    }
+
+    // Everything is read into temporaries and committed only once the
+    // whole snapshot has checked out. The spare CGM is kept between
+    // restores, as building one allocates its whole history.
+    if (!m_restoreCgm) {
+        m_restoreCgm.reset(new CGM);
+    }
+    ProfileManager profiles;
+    InsulinPump pump;
+    ControlIQController controller = m_controller;
+    EventScheduler events;
+    AlarmManager alarms = m_alarms;
+
+    qint64 startMs;
+    double startMinuteOfDay, elapsedMinutes, tickMinutes;
+    ProfileData profile;
+    in >> startMs >> startMinuteOfDay >> elapsedMinutes >> tickMinutes;
+    if (!profiles.restoreState(in)) {
+        return false;
+    }
+    in >> profile;
+    if (in.status() != QDataStream::Ok || !controller.restoreState(in)
+        || !pump.restoreState(in) || !m_restoreCgm->restoreState(in)) {
+        return false;
+    }
+
+    double extBolusRemaining, extBolusRatePerTick, extBolusPerPulse;
+    QVector<MealEvent> meals;
+    bool userSuspendedInsulin, autoService, loggingEnabled, eventsPrimed;
+    in >> extBolusRemaining >> extBolusRatePerTick >> extBolusPerPulse
+       >> meals >> userSuspendedInsulin >> autoService >> loggingEnabled;
+
+    in >> eventsPrimed;
+    if (in.status() != QDataStream::Ok || !events.restoreState(in)) {
+        return false;
+    }
+    quint32 mealGeneration, profileGeneration, extBolusGeneration, batteryGeneration;
+    double batterySettledMinutes, sampleOrigin;
+    in >> mealGeneration >> profileGeneration >> extBolusGeneration
+       >> batteryGeneration >> batterySettledMinutes >> sampleOrigin;
+    if (in.status() != QDataStream::Ok || !alarms.restoreState(in)) {
+        return false;
+    }
+    double scenarioStart, sensorDropoutUntil;
+    qint32 scenarioNext = 0;
+    quint32 scenarioGeneration;
+    in >> scenarioStart >> scenarioNext >> scenarioGeneration >> sensorDropoutUntil;
+    if (in.status() != QDataStream::Ok || scenarioNext < 0 || tickMinutes <= 0.0 || !in.atEnd()) {
+        return false;
+    }
+
+    // Commit
+    m_startMs = startMs;
+    m_startMinuteOfDay = startMinuteOfDay;
+    m_elapsedMinutes = elapsedMinutes;
+    m_tickMinutes = tickMinutes;
+    m_profileManager->swapState(profiles);
+    m_insulinPump->swapState(pump);
+    m_cgm->swapState(*m_restoreCgm);
+    m_controller = controller;
+    m_currentProfile = profile;
+    m_profileSchedule = ProfileSchedule(profile);
+    m_profileSegment = m_profileSchedule.segmentAt(clockMinutes());
+    m_controller.setTherapy(m_profileSchedule.settings(m_profileSegment));
+
+    m_extBolusRemaining = extBolusRemaining;
+    m_extBolusRatePerTick = extBolusRatePerTick;
+    m_extBolusPerPulse = extBolusPerPulse;
+    m_meals = meals;
+    m_userSuspendedInsulin = userSuspendedInsulin;
+    m_autoService = autoService;
+    m_loggingEnabled = loggingEnabled;
+
+    m_eventsPrimed = eventsPrimed;
+    std::swap(m_events, events);
+    m_mealGeneration = mealGeneration;
+    m_profileGeneration = profileGeneration;
+    m_extBolusGeneration = extBolusGeneration;
+    m_batteryGeneration = batteryGeneration;
+    m_batterySettledMinutes = batterySettledMinutes;
+    m_sampleOrigin = sampleOrigin;
+    m_alarms = alarms;
+    m_scenarioStart = scenarioStart;
+    m_scenarioNext = scenarioNext;
+    m_scenarioGeneration = scenarioGeneration;
+    m_sensorDropoutUntil = sensorDropoutUntil;
+    return true;
+}
+
+bool SimulationEngine::saveSnapshot(const QString &path) const
+{
+    // Written to a temporary file and renamed, so a crash mid-write
+    // leaves the previous checkpoint intact
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray snapshot = saveSnapshot();
+    if (file.write(snapshot) != snapshot.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool SimulationEngine::loadSnapshot(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return restoreSnapshot(file.readAll());
+}
+
+// --- CGM Alarms ---
+
+void SimulationEngine::onReadingAdded(qint64, double value)
+{
+    updateAlarm(LowGlucoseAlarm, value);
+    updateAlarm(HighGlucoseAlarm, value);
+}
+
+// --- Helper ---
+
+void SimulationEngine::logEvent(const QString &msg)
+{
+    if (!m_loggingEnabled) {
+        return;
+    }
+
+    m_systemLog->appendNote(currentSimulatedMsecs(), msg);
+}
+
+void SimulationEngine::logRecord(LogEventCode code, double value, double value2, quint32 arg)
+{
+    if (!m_loggingEnabled) {
+        return;
+    }
+
+    m_systemLog->append(currentSimulatedMsecs(), code, value, value2, arg);
+}
@@ -0,0 +1,275 @@
+// simulationengine.h
+#ifndef SIMULATIONENGINE_H
+#define SIMULATIONENGINE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <memory>
+#include "alarmmanager.h"
+#include "profilemanager.h"
+#include "profileschedule.h"
+#include "scenario.h"
+#include "insulinpump.h"
+#include "cgm.h"
+#include "controliqcontroller.h"
+#include "eventscheduler.h"
+#include "systemlog.h"
+#include "tracereplay.h"
+
+class ColumnarWriter;
+
+// A meal eaten every day at the same time and bolused with the current profile
+struct MealEvent {
+    int    minuteOfDay;   // Minutes after midnight
+    double grams;         // Carbohydrates
+};
+
+QDataStream &operator<<(QDataStream &out, const MealEvent &meal);
+QDataStream &operator>>(QDataStream &in, MealEvent &meal);
+
+// Snapshot header; bump the version whenever the saved state changes.
+// Bulk data is stored in host byte order, so snapshots only load on
+// machines of the same byte order.
+const quint32 SNAPSHOT_MAGIC = 0x504e5350;     // "PSNP"
+const quint16 SNAPSHOT_VERSION = 7;
+
+// Battery drained from the pump on every simulation tick (percent), and
+// the same drain per simulated minute for the event-driven loop
+const double BATTERY_DRAIN_PER_TICK = 0.01;
+const double BATTERY_DRAIN_PER_MINUTE = BATTERY_DRAIN_PER_TICK / SIMULATION_SPEED;
+
+// Battery / insulin levels below which the pump raises an error
+const double LOW_BATTERY_LEVEL = 5.0;
+const double LOW_INSULIN_LEVEL = 5.0;
+
+// Glucose (mmol/L), battery (%) and reservoir (U) levels that clear the
+// alarms raised at the thresholds above
+const double LOW_GLUCOSE_CLEAR = 4.4;
+const double HIGH_GLUCOSE_CLEAR = 9.4;
+const double LOW_BATTERY_CLEAR = 10.0;
+const double LOW_INSULIN_CLEAR = 10.0;
+
+// GUI-free simulation core. Owns the CGM, pump, profiles and log and runs
+// the per-tick logic (CGM read, extended bolus, Control-IQ, basal, battery,
+// error checks). SimulationWorker drives it one tick at a time; batch runs call
+// runFor() and advance time as fast as the CPU allows, or runEventsFor()
+// to jump from one scheduled event to the next instead of polling.
+class SimulationEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SimulationEngine(QObject *parent = nullptr);
+
+    // Core objects
+    CGM            *cgm() const;
+    InsulinPump    *insulinPump() const;
+    ProfileManager *profileManager() const;
+    SystemLog      *systemLog() const;
+    AlarmManager   *alarms();
+
+    // Simulated clock
+    void setStartTime(const QDateTime &start);
+    QDateTime currentSimulatedTime() const;
+    qint64 currentSimulatedMsecs() const;       // Cheap: no QDateTime
+    double elapsedSimulatedMinutes() const;
+    void setTickMinutes(double minutes);
+    double tickMinutes() const;
+
+    // Fill the CGM history with readings leading up to the current time
+    void seedHistory(int readings);
+
+    // Current profile used by Control-IQ. With time-of-day segments the
+    // controller follows the segment in effect.
+    void setCurrentProfile(const ProfileData &profile);
+    ProfileData currentProfile() const;
+    int currentProfileSegment() const;
+
+    // User-requested basal pause (Control-IQ will not resume basal)
+    void setUserSuspendedInsulin(bool suspended);
+    bool userSuspendedInsulin() const;
+
+    // Extended bolus: deliver units evenly over the given number of hours
+    void scheduleExtendedBolus(double units, double hours);
+    double extendedBolusRemaining() const;
+    double extendedBolusRatePerTick() const;
+
+    // Daily meal pattern for virtual patients (carbs + matching bolus)
+    void setMealPattern(const QVector<MealEvent> &meals);
+
+    // Automatically recharge / replace the cartridge when low (headless runs)
+    void setAutoService(bool enabled);
+
+    // Drive the CGM and pump from a recorded trace (not owned) instead of
+    // the glucose model: at each sensor sample the rows the clock has passed
+    // are applied, and skipped rows are logged. nullptr returns to simulated
+    // readings and the programmed basal. Snapshots do not include the trace.
+    void setTraceReplay(TraceReplay *trace);
+    TraceReplay *traceReplay() const;
+
+    // Play a compiled scenario (not owned) from the current time: its event
+    // times count from here, and one cursor walks its sorted events as the
+    // clock passes them, in tick and event runs alike. nullptr stops it.
+    // Snapshots keep the cursor but not the scenario; set the same one
+    // again before restoring to carry on with it.
+    void setScenario(const Scenario *scenario);
+    const Scenario *scenario() const;
+    bool scenarioFinished() const;          // Also true with none set
+
+    // Stream one row of outputs (glucose, IOB, COB, basal rate, boluses,
+    // battery, reservoir) to a column file (not owned): one per tick, or
+    // one per Control-IQ decision in event runs. nullptr stops it.
+    void setOutputWriter(ColumnarWriter *writer);
+    ColumnarWriter *outputWriter() const;
+
+    // Text logging can be switched off for large batch runs
+    void setLoggingEnabled(bool enabled);
+
+    // Advance the simulation
+    void tick();
+    void runTicks(qint64 ticks);
+    void runFor(double simulatedMinutes);
+
+    // Throughput of the last runTicks()/runFor() call
+    qint64 ticksRun() const;
+    double ticksPerSecond() const;
+
+    // Event-driven run: CGM samples, meals, scenario events, extended bolus pulses, Control-IQ
+    // decisions, profile segment changes and the battery alarm are queued and the clock jumps straight
+    // to the next one. The sensor still reads every 5 min, but nothing else
+    // is re-checked between events. Meals and scenario events are applied at
+    // the sample that starts their 5 min interval, before its Control-IQ
+    // decision, so a run matches runFor() at a 5 min tick whatever the
+    // minute they fall on.
+    void runEventsFor(double simulatedMinutes);
+    qint64 eventsRun() const;
+
+    // Append a free-text note, stamped with simulated time, to the log
+    void logEvent(const QString &msg);
+
+    // Checkpoint of everything that decides how the run continues: clock,
+    // profiles, pump, CGM history and physiology, noise stream position,
+    // controller memory and pending events. A restored engine continues
+    // exactly as the saved one would have. The event log is not included;
+    // it is already on disk and a resumed run appends to it. A snapshot is
+    // read in full before any of it is applied, so a failed restore leaves
+    // the engine as it was.
+    QByteArray saveSnapshot() const;
+    bool restoreSnapshot(const QByteArray &snapshot);
+    bool saveSnapshot(const QString &path) const;
+    bool loadSnapshot(const QString &path);
+
+signals:
+    void tickCompleted();
+
+    // When the alarm is raised, escalates or sounds again after a snooze;
+    // not on every check while it stays low
+    void lowBattery();
+    void lowInsulin();
+
+private slots:
+    void onReadingAdded(qint64 timestampMs, double value);
+
+private:
+    double clockMinutes() const;            // Since the first simulated midnight
+    void syncProfileClock();
+    void sampleSensor();
+    void eatScheduledMeals(double currentBG);
+    void eatMeal(const MealEvent &meal, double currentBG, double absorptionMinutes = 0.0);
+    void registerCarbs(double grams, double absorptionMinutes);     // 0: the shared curve
+    double nextScenarioMinutes() const;     // Infinite when none is left
+    void applyScenarioEvent(const ScenarioEvent &e);
+    bool sensorDropout() const;
+    void deliverExtendedBolus(double units);
+    void runControlIQ(double currentBG);
+    void checkForErrors();
+    void checkBattery();
+    void checkReservoir();
+    bool updateAlarm(AlarmType type, double value);    // True when announced
+    void writeOutputRow(double battery);
+
+    // Event-driven mode
+    void primeEvents();
+    double dueSampleMinutes(double minutes) const;
+    void scheduleMeals();
+    void scheduleMeal(int index, double fromMinutes);
+    void scheduleScenario();
+    void scheduleProfileSegment(double afterMinutes);
+    void scheduleBatteryAlarm();
+    void settleBattery();
+    void handleEvent(const ScheduledEvent &e);
+
+    bool readSnapshot(const QByteArray &snapshot);
+
+    // Append a typed record stamped with simulated time
+    void logRecord(LogEventCode code, double value = 0.0, double value2 = 0.0, quint32 arg = 0);
+
+    // Core objects
+    ProfileManager *m_profileManager;
+    InsulinPump    *m_insulinPump;
+    CGM            *m_cgm;
+    SystemLog      *m_systemLog;
+
+    // Simulated clock
+    qint64    m_startMs;            // Simulated epoch, ms since 1970
+    double    m_startMinuteOfDay;   // For placing daily meals
+    double    m_elapsedMinutes;
+    double    m_tickMinutes;
+
+    // Current profile and the predictive controller acting on it
+    ProfileData m_currentProfile;
+    ProfileSchedule m_profileSchedule;
+    int m_profileSegment;
+    ControlIQController m_controller;
+
+    // Glucose, battery and reservoir alarms
+    AlarmManager m_alarms;
+
+    // Extended bolus tracking
+    double m_extBolusRemaining;
+    double m_extBolusRatePerTick;
+
+    // Daily meals
+    QVector<MealEvent> m_meals;
+
+    // Recorded trace in place of simulated readings
+    TraceReplay *m_trace = nullptr;
+    int m_traceErrorsLogged = 0;
+
+    // Scenario playing and the next of its events; minutes since the start
+    const Scenario *m_scenario = nullptr;
+    double m_scenarioStart = 0.0;
+    int m_scenarioNext = 0;
+    double m_sensorDropoutUntil = 0.0;
+
+    // Column output, and the pump's bolus total at the previous row
+    ColumnarWriter *m_output = nullptr;
+    double m_outputBolusMark = 0.0;
+
+    // Flag for user suspended basal insulin
+    bool m_userSuspendedInsulin = false;
+    bool m_autoService = false;
+    bool m_loggingEnabled = true;
+
+    // Throughput of the last batch run
+    qint64 m_ticksRun = 0;
+    double m_ticksPerSecond = 0.0;
+
+    // Spare CGM a snapshot is read into before it is swapped in
+    std::unique_ptr<CGM> m_restoreCgm;
+
+    // Event queue; stale once tick() is used, rebuilt by the next event run.
+    // Generations drop queued events that a newer schedule replaced.
+    EventScheduler m_events;
+    bool m_eventsPrimed = false;
+    quint32 m_mealGeneration = 0;
+    quint32 m_scenarioGeneration = 0;
+    quint32 m_profileGeneration = 0;
+    quint32 m_extBolusGeneration = 0;
+    quint32 m_batteryGeneration = 0;
+    double m_extBolusPerPulse = 0.0;
+    double m_batterySettledMinutes = 0.0;   // Drain applied up to here
+    double m_sampleOrigin = 0.0;            // First sensor sample; one every 5 min after
+    qint64 m_eventsRun = 0;
+};
+
+#endif // SIMULATIONENGINE_H
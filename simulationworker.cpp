@@ -0,0 +1,247 @@
+// simulationworker.cpp
+#include "simulationworker.h"
+#include "tickprofiler.h"
+#include <future>
+#include <limits>
+
+SimulationWorker::SimulationWorker(QObject *parent)
+    : QObject(parent),
+      m_engine(new SimulationEngine()),
+      m_clock(new TimeSimulator()),
+      m_commands(SIMULATION_COMMAND_CAPACITY),
+      m_historyGeneration(1),
+      m_takenReadingMs(std::numeric_limits<qint64>::min()),
+      m_takenGeneration(0)
+{
+    m_thread.setObjectName("Simulation");
+
+    // The clock lives on the simulation thread once started, so this runs
+    // there; the worker's own signals then reach the UI queued
+    connect(m_clock, &TimeSimulator::simulationTick, m_clock, [this]() { onTick(); });
+}
+
+SimulationWorker::~SimulationWorker()
+{
+    stop();
+    delete m_clock;
+    delete m_engine;
+}
+
+SimulationEngine *SimulationWorker::engine() const
+{
+    return m_engine;
+}
+
+TimeSimulator *SimulationWorker::clock() const
+{
+    return m_clock;
+}
+
+void SimulationWorker::start()
+{
+    if (m_running) {
+        return;
+    }
+    m_engine->moveToThread(&m_thread);
+    m_clock->moveToThread(&m_thread);
+    m_running = true;
+    m_thread.start();
+    post([this](SimulationEngine &, TimeSimulator &) {
+        m_sincePublish.start();
+        publishState();
+    });
+}
+
+void SimulationWorker::stop()
+{
+    if (!m_running) {
+        return;
+    }
+
+    // Objects can only be pushed to another thread from their own
+    QThread *ui = thread();
+    run([ui](SimulationEngine &engine, TimeSimulator &clock) {
+        clock.stop();
+        engine.moveToThread(ui);
+        clock.moveToThread(ui);
+    });
+    m_thread.quit();
+    m_thread.wait();
+    m_running = false;
+}
+
+bool SimulationWorker::isRunning() const
+{
+    return m_running;
+}
+
+void SimulationWorker::post(const Command &command)
+{
+    if (!m_running) {
+        command(*m_engine, *m_clock);
+        return;
+    }
+    while (!m_commands.push(command)) {
+        // Full: the simulation thread is behind by a whole queue
+        wake();
+        QThread::yieldCurrentThread();
+    }
+    wake();
+}
+
+void SimulationWorker::run(const Command &command)
+{
+    if (!m_running) {
+        command(*m_engine, *m_clock);
+        return;
+    }
+    std::promise<void> done;
+    std::future<void> finished = done.get_future();
+    post([&, this](SimulationEngine &engine, TimeSimulator &clock) {
+        command(engine, clock);
+        // So state() shows the result once run() returns
+        publishState();
+        done.set_value();
+    });
+    finished.wait();
+}
+
+// One queued call per batch of commands, however many are posted before
+// the simulation thread gets to them
+void SimulationWorker::wake()
+{
+    if (!m_wakePending.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(m_clock, [this]() { runCommands(); }, Qt::QueuedConnection);
+    }
+}
+
+void SimulationWorker::runCommands()
+{
+    m_wakePending.store(false, std::memory_order_release);
+    Command command;
+    bool ran = false;
+    while (m_commands.pop(command)) {
+        command(*m_engine, *m_clock);
+        ran = true;
+    }
+
+    // The UI waits to see what its commands did
+    if (ran) {
+        publishState();
+    }
+}
+
+void SimulationWorker::onTick()
+{
+    runCommands();
+    {
+        TICK_PROFILE_FRAME(WholeTickPhase);
+        m_engine->tick();
+    }
+
+    TraceReplay *trace = m_engine->traceReplay();
+    if (trace && trace->atEnd()) {
+        m_engine->setTraceReplay(nullptr);
+        emit traceReplayFinished();
+    }
+
+    if (m_sincePublish.elapsed() >= STATE_PUBLISH_MS) {
+        publishState();
+    }
+}
+
+void SimulationWorker::publishState()
+{
+    CGM *cgm = m_engine->cgm();
+    InsulinPump *pump = m_engine->insulinPump();
+
+    SimulationState &s = m_states.back();
+    s.sequence = ++m_published;
+    s.simulatedMs = m_engine->currentSimulatedMsecs();
+    s.glucose = cgm->currentGlucose();
+    s.insulinOnBoard = cgm->insulinOnBoard();
+    s.carbsOnBoard = cgm->carbsOnBoard();
+    s.batteryLevel = pump->batteryLevel();
+    s.insulinRemaining = pump->insulinUnitsRemaining();
+    s.basalRate = pump->currentBasalRate();
+    s.basalActive = pump->isBasalActive();
+    s.userSuspendedInsulin = m_engine->userSuspendedInsulin();
+    s.extendedBolusRemaining = m_engine->extendedBolusRemaining();
+    s.currentProfile = m_engine->currentProfile();
+    s.profileNames = m_engine->profileManager()->profileNames();
+    s.glucoseModel = cgm->glucoseModelType();
+    s.tickMinutes = m_engine->tickMinutes();
+    s.clockMode = m_clock->mode();
+    s.traceReplaying = m_engine->traceReplay() != nullptr;
+    s.day = cgm->metrics().summary(DayWindow);
+    for (int i = 0; i < AlarmTypeCount; ++i) {
+        s.alarms[i] = m_engine->alarms()->info(AlarmType(i));
+    }
+    fillReadings(s);
+    m_states.publish();
+    m_sincePublish.start();
+}
+
+void SimulationWorker::fillReadings(SimulationState &s)
+{
+    // Generation first: a matching one means the time stored before it
+    // belongs to the current history
+    bool sameHistory = m_takenGeneration.load(std::memory_order_acquire) == m_historyGeneration;
+    qint64 takenMs = m_takenReadingMs.load(std::memory_order_acquire);
+
+    GlucoseReadingView view = m_engine->cgm()->getReadings(m_engine->cgm()->retentionHours());
+    int first = 0;
+    if (sameHistory) {
+        int last = view.size();
+        while (first < last) {
+            int mid = (first + last) / 2;
+            if (view.timeAt(mid) <= takenMs) {
+                first = mid + 1;
+            } else {
+                last = mid;
+            }
+        }
+    }
+
+    s.historyGeneration = m_historyGeneration;
+    s.readings.clear();
+    for (int i = first; i < view.size(); ++i) {
+        s.readings.append(view.at(i));
+    }
+}
+
+void SimulationWorker::resetHistory()
+{
+    ++m_historyGeneration;
+}
+
+void SimulationWorker::acknowledgeAlarm(AlarmType type)
+{
+    post([type](SimulationEngine &engine, TimeSimulator &) {
+        engine.alarms()->acknowledge(type);
+    });
+}
+
+bool SimulationWorker::updateState()
+{
+    if (!m_states.update()) {
+        return false;
+    }
+
+    // Time before generation, so the simulation thread never pairs a new
+    // generation with a time from the old history
+    const SimulationState &s = m_states.front();
+    if (!s.readings.isEmpty()) {
+        m_takenReadingMs.store(s.readings.last().timestampMs, std::memory_order_release);
+    } else if (s.historyGeneration != m_uiGeneration) {
+        m_takenReadingMs.store(std::numeric_limits<qint64>::min(), std::memory_order_release);
+    }
+    m_uiGeneration = s.historyGeneration;
+    m_takenGeneration.store(s.historyGeneration, std::memory_order_release);
+    return true;
+}
+
+const SimulationState &SimulationWorker::state() const
+{
+    return m_states.front();
+}
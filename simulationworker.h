@@ -0,0 +1,127 @@
+// simulationworker.h
+#ifndef SIMULATIONWORKER_H
+#define SIMULATIONWORKER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "glycemicmetrics.h"
+#include "simulationengine.h"
+#include "spscqueue.h"
+#include "timesimulator.h"
+
+// Commands the UI can have in flight before posting waits
+const int SIMULATION_COMMAND_CAPACITY = 256;
+
+// Shortest wall time between two published states while ticking; the
+// UI renders at most once per frame anyway
+const int STATE_PUBLISH_MS = 8;
+
+// What the UI shows of the simulation, copied out on the simulation thread
+struct SimulationState {
+    quint64 sequence = 0;               // States published so far
+    qint64 simulatedMs = 0;
+    double glucose = 0.0;
+    double insulinOnBoard = 0.0;
+    double carbsOnBoard = 0.0;
+    double batteryLevel = 0.0;
+    double insulinRemaining = 0.0;
+    double basalRate = 0.0;             // U/hr running now
+    bool basalActive = false;
+    bool userSuspendedInsulin = false;
+    double extendedBolusRemaining = 0.0;
+    ProfileData currentProfile = {};
+    QStringList profileNames;
+    GlucoseModelType glucoseModel = RandomWalkGlucoseModel;
+    double tickMinutes = SIMULATION_SPEED;
+    ClockMode clockMode = PausedClock;
+    bool traceReplaying = false;
+    GlycemicSummary day;
+    AlarmInfo alarms[AlarmTypeCount];
+
+    // CGM readings newer than the last ones the UI took, oldest first.
+    // When the history is replaced (a saved state is loaded) the
+    // generation changes and the whole retained history is sent again.
+    quint32 historyGeneration = 0;
+    QVector<GlucoseReading> readings;
+};
+
+// Runs a SimulationEngine and its TimeSimulator on a thread of their own.
+// While the thread runs the UI never touches the engine: it reads the
+// newest SimulationState through a TripleBuffer and changes things by
+// posting commands to an SpscQueue, which the thread runs in order
+// between ticks. Alarms travel with the state, so nothing on the UI
+// thread holds up simulated time.
+class SimulationWorker : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(SimulationEngine &engine, TimeSimulator &clock)> Command;
+
+    explicit SimulationWorker(QObject *parent = nullptr);
+    ~SimulationWorker() override;
+
+    // Set up directly before start(); afterwards only through commands
+    SimulationEngine *engine() const;
+    TimeSimulator *clock() const;
+
+    // Move the engine and clock to the simulation thread and back.
+    // stop() runs the commands still queued first.
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    // UI thread. post() returns at once; run() waits for the command to
+    // finish, for the few actions that need an answer. Without the
+    // thread running, both run the command straight away.
+    void post(const Command &command);
+    void run(const Command &command);
+
+    // UI thread: true if a newer state was published since the last call.
+    // The caller takes state().readings; they are not sent again. The
+    // reference from state() is only good until the next call.
+    bool updateState();
+    const SimulationState &state() const;
+
+    // Simulation thread (inside a command): the CGM history was replaced
+    void resetHistory();
+
+    // Queued like any other command; takes effect at the alarm's next check
+    void acknowledgeAlarm(AlarmType type);
+
+signals:
+    void traceReplayFinished();
+
+private:
+    void wake();
+    void runCommands();
+    void onTick();
+    void publishState();
+    void fillReadings(SimulationState &s);
+
+    SimulationEngine *m_engine;
+    TimeSimulator    *m_clock;
+    QThread           m_thread;
+    bool              m_running = false;
+
+    // UI to simulation thread
+    SpscQueue<Command> m_commands;
+    std::atomic<bool>  m_wakePending{false};
+
+    // Simulation thread to UI
+    TripleBuffer<SimulationState> m_states;
+    QElapsedTimer m_sincePublish;
+    quint64 m_published = 0;
+    quint32 m_historyGeneration = 0;
+
+    // Newest reading the UI has taken, and its history generation
+    std::atomic<qint64>  m_takenReadingMs;
+    std::atomic<quint32> m_takenGeneration;
+    quint32 m_uiGeneration = 0;
+};
+
+#endif // SIMULATIONWORKER_H
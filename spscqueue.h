@@ -0,0 +1,116 @@
+// spscqueue.h
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// Keeps the producer's and consumer's indexes on separate cache lines
+const int SPSC_CACHE_LINE = 64;
+
+// Bounded queue between exactly one producer thread and one consumer
+// thread, with no locks. Each side owns one index and only reads the
+// other's, so push() and pop() are a few loads and one release store.
+template <typename T>
+class SpscQueue
+{
+public:
+    // Capacity is rounded up to a power of two, of which one slot stays free
+    explicit SpscQueue(int capacity)
+    {
+        int size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        m_mask = quint32(size - 1);
+        m_slots.reset(new T[size]);
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side; false when the queue is full
+    bool push(T item)
+    {
+        quint32 tail = m_tail.load(std::memory_order_relaxed);
+        quint32 next = (tail + 1) & m_mask;
+        if (next == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        m_slots[tail] = std::move(item);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when the queue is empty
+    bool pop(T &item)
+    {
+        quint32 head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(m_slots[head]);
+        m_slots[head] = T();
+        m_head.store((head + 1) & m_mask, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; only a hint while the other side is running
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::unique_ptr<T[]> m_slots;
+    quint32 m_mask = 0;
+    alignas(SPSC_CACHE_LINE) std::atomic<quint32> m_head{0};   // Next to pop, consumer's
+    alignas(SPSC_CACHE_LINE) std::atomic<quint32> m_tail{0};   // Next to fill, producer's
+};
+
+// Latest-value channel between one producer and one consumer: a triple
+// buffer. The producer fills its back slot and swaps it with the middle
+// one; the consumer swaps the middle slot for its front one when it holds
+// something newer. Neither side ever waits, values the consumer was too
+// slow to see are skipped, and slots are reused so nothing is allocated
+// once their contents have grown to size.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // Producer side: the slot to fill, then publish() it
+    T &back() { return m_slots[m_back]; }
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side: true if a newer value was published since the last
+    // call, which front() then holds
+    bool update()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T &front() const { return m_slots[m_front]; }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;     // Middle slot not yet taken by the consumer
+
+    T m_slots[3];
+    int m_back = 0;                 // Producer's
+    int m_front = 1;                // Consumer's
+    alignas(SPSC_CACHE_LINE) std::atomic<int> m_middle{2};
+};
+
+#endif // SPSCQUEUE_H
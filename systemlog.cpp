@@ -1,19 +1,480 @@
+// systemlog.cpp
 #include "systemlog.h"
+#include "alarmmanager.h"
+#include "scenario.h"
+#include "tracereplay.h"
 #include <QDateTime>
+#include <QDir>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(LogRecord) == 32, "LogRecord is an on-disk format");
+static_assert(LogEventCodeCount <= 32, "Event codes must fit a 32-bit mask");
+
+namespace {
+
+const quint32 SEGMENT_MAGIC = 0x474f4c50;   // "PLOG"
+const quint32 SEGMENT_VERSION = 1;
+const int SEGMENT_BLOCKS = LOG_SEGMENT_RECORDS / LOG_BLOCK_RECORDS;
+
+// Records start on the first page after the header
+const qint64 HEADER_BYTES = 4096;
+const qint64 SEGMENT_BYTES = HEADER_BYTES + qint64(LOG_SEGMENT_RECORDS) * sizeof(LogRecord);
+
+}
+
+struct SystemLog::SegmentHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 capacity;
+    quint32 count;                      // Written last, so a record is never half there
+    qint64  firstMs;
+    qint64  lastMs;
+    quint32 codeCounts[32];
+    quint32 blockMasks[SEGMENT_BLOCKS]; // Codes present in each block of records
+};
+
+SystemLog::SegmentHeader *SystemLog::Segment::header() const
+{
+    static_assert(sizeof(SegmentHeader) <= HEADER_BYTES, "Segment header outgrew its page");
+    return reinterpret_cast<SegmentHeader *>(base);
+}
+
+LogRecord *SystemLog::Segment::records() const
+{
+    return reinterpret_cast<LogRecord *>(base + HEADER_BYTES);
+}
 
 SystemLog::SystemLog(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_size(0),
+      m_nextSegment(0)
+{
+}
+
+SystemLog::~SystemLog()
+{
+    close();
+}
+
+bool SystemLog::open(const QString &directory)
+{
+    close();
+    QMutexLocker locker(&m_mutex);
+    QMutexLocker notesLocker(&m_notesMutex);
+    QDir dir(directory);
+    if (!dir.mkpath(".")) {
+        return false;
+    }
+    m_directory = dir.absolutePath();
+
+    // Segments sort by number, which is append order
+    QStringList files = dir.entryList(QStringList() << "segment-*.plog", QDir::Files, QDir::Name);
+    for (const QString &name : files) {
+        mapSegment(dir.filePath(name), false);
+        m_nextSegment = qMax(m_nextSegment, name.mid(8, 6).toInt() + 1);
+    }
+
+    QFile notes(noteFilePath());
+    if (notes.open(QIODevice::ReadOnly)) {
+        while (!notes.atEnd()) {
+            QString line = QString::fromUtf8(notes.readLine()).chopped(1);
+            m_noteIds.insert(line, m_notes.size());
+            m_notes.append(line);
+        }
+    }
+    return true;
+}
+
+void SystemLog::close()
+{
+    QMutexLocker locker(&m_mutex);
+    QMutexLocker notesLocker(&m_notesMutex);
+    // Trim the unused tail off segments written this session
+    for (auto &seg : m_segments) {
+        if (seg->file) {
+            qint64 used = HEADER_BYTES + qint64(seg->header()->count) * sizeof(LogRecord);
+            seg->file->unmap(seg->base);
+            if (seg->writable) {
+                seg->file->resize(used);
+            }
+            seg->file->close();
+        }
+    }
+    m_segments.clear();
+    m_size = 0;
+    m_nextSegment = 0;
+    m_directory.clear();
+    m_notes.clear();
+    m_noteIds.clear();
+}
+
+QString SystemLog::directory() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_directory;
+}
+
+bool SystemLog::mapSegment(const QString &path, bool create)
 {
+    std::unique_ptr<Segment> seg(new Segment);
+    seg->file.reset(new QFile(path));
+    seg->writable = create;
+    if (!seg->file->open(create ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (create && !seg->file->resize(SEGMENT_BYTES)) {
+        return false;
+    }
+    qint64 bytes = seg->file->size();
+    if (bytes < HEADER_BYTES) {
+        return false;
+    }
+    seg->base = seg->file->map(0, bytes);
+    if (!seg->base) {
+        return false;
+    }
+
+    SegmentHeader *h = seg->header();
+    if (create) {
+        std::memset(h, 0, sizeof(SegmentHeader));
+        h->magic = SEGMENT_MAGIC;
+        h->version = SEGMENT_VERSION;
+        h->capacity = LOG_SEGMENT_RECORDS;
+    } else if (h->magic != SEGMENT_MAGIC || h->version != SEGMENT_VERSION
+               || h->count > h->capacity
+               || HEADER_BYTES + qint64(h->count) * qint64(sizeof(LogRecord)) > bytes) {
+        return false;   // Not ours, or torn: leave it alone
+    }
+    seg->firstIndex = m_size;
+    m_size += h->count;
+    m_segments.push_back(std::move(seg));
+    return true;
+}
+
+// Segments from earlier sessions are read-only; a new one is started when
+// the current one is full or time goes backwards (e.g. a restarted clock)
+SystemLog::Segment *SystemLog::writableSegment(qint64 timeMs)
+{
+    if (!m_segments.empty()) {
+        Segment *seg = m_segments.back().get();
+        SegmentHeader *h = seg->header();
+        if (seg->writable && h->count < h->capacity
+            && (h->count == 0 || timeMs >= h->lastMs)) {
+            return seg;
+        }
+    }
+
+    if (!m_directory.isEmpty()) {
+        QString name = QString("segment-%1.plog").arg(m_nextSegment++, 6, 10, QChar('0'));
+        if (!mapSegment(QDir(m_directory).filePath(name), true)) {
+            return nullptr;
+        }
+        return m_segments.back().get();
+    }
+
+    std::unique_ptr<Segment> seg(new Segment);
+    seg->heap = QByteArray(SEGMENT_BYTES, '\0');
+    seg->base = reinterpret_cast<uchar *>(seg->heap.data());
+    seg->writable = true;
+    seg->header()->magic = SEGMENT_MAGIC;
+    seg->header()->version = SEGMENT_VERSION;
+    seg->header()->capacity = LOG_SEGMENT_RECORDS;
+    seg->firstIndex = m_size;
+    m_segments.push_back(std::move(seg));
+    return m_segments.back().get();
+}
+
+LogRecord SystemLog::append(qint64 timeMs, LogEventCode code, double value,
+                            double value2, quint32 arg)
+{
+    LogRecord r = {timeMs, static_cast<quint16>(code), 0, arg, value, value2};
+    QMutexLocker locker(&m_mutex);
+    Segment *seg = writableSegment(timeMs);
+    if (!seg) {
+        return r;
+    }
+
+    SegmentHeader *h = seg->header();
+    quint32 i = h->count;
+    seg->records()[i] = r;
+    if (i == 0) {
+        h->firstMs = timeMs;
+    }
+    h->lastMs = timeMs;
+    h->codeCounts[code]++;
+    h->blockMasks[i / LOG_BLOCK_RECORDS] |= logEventBit(code);
+    h->count = i + 1;
+    ++m_size;
+    locker.unlock();
+    if (m_notifyArmed.exchange(false, std::memory_order_acq_rel)) {
+        emit appended();
+    }
+    return r;
 }
 
-void SystemLog::addLogEntry(const QString &entry)
+LogRecord SystemLog::appendNote(qint64 timeMs, const QString &text)
 {
-    // entry already contains the simulated‐time timestamp
-    m_entries.append(entry);
+    return append(timeMs, NoteLogEvent, 0.0, 0.0, noteId(text));
 }
 
+// Notes are interned: repeated messages cost one id, not one string each
+quint32 SystemLog::noteId(const QString &text)
+{
+    QMutexLocker locker(&m_notesMutex);
+    QString line = text;
+    line.replace('\n', ' ');
+    if (m_noteIds.contains(line)) {
+        return m_noteIds.value(line);
+    }
+
+    quint32 id = m_notes.size();
+    m_notes.append(line);
+    m_noteIds.insert(line, id);
+    // open() and close() hold both locks to change the directory
+    if (!m_directory.isEmpty()) {
+        QFile notes(noteFilePath());
+        if (notes.open(QIODevice::Append)) {
+            notes.write(line.toUtf8() + '\n');
+        }
+    }
+    return id;
+}
+
+QString SystemLog::noteFilePath() const
+{
+    return QDir(m_directory).filePath("notes.txt");
+}
+
+qint64 SystemLog::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    m_notifyArmed.store(true, std::memory_order_release);
+    return m_size;
+}
+
+int SystemLog::segmentCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_segments.size());
+}
+
+LogRecord SystemLog::at(qint64 i) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (i < 0 || i >= m_size) {
+        return LogRecord();
+    }
+    auto it = std::upper_bound(m_segments.begin(), m_segments.end(), i,
+                               [](qint64 index, const std::unique_ptr<Segment> &seg) {
+                                   return index < seg->firstIndex;
+                               });
+    const Segment *seg = (it - 1)->get();
+    return seg->records()[i - seg->firstIndex];
+}
+
+void SystemLog::forEach(qint64 fromMs, qint64 toMs, quint32 codeMask,
+                        const std::function<bool(qint64, const LogRecord &)> &visit) const
+{
+    auto before = [](const LogRecord &r, qint64 t) { return r.timestampMs < t; };
+    auto after = [](qint64 t, const LogRecord &r) { return t < r.timestampMs; };
+
+    QMutexLocker locker(&m_mutex);
+    for (const auto &seg : m_segments) {
+        const SegmentHeader *h = seg->header();
+        if (h->count == 0 || h->lastMs < fromMs || h->firstMs > toMs) {
+            continue;
+        }
+
+        // Time index: records are in time order within a segment
+        const LogRecord *r = seg->records();
+        int lo = std::lower_bound(r, r + h->count, fromMs, before) - r;
+        int hi = std::upper_bound(r + lo, r + h->count, toMs, after) - r;
+
+        // Type index: skip blocks without any wanted code
+        for (int b = lo / LOG_BLOCK_RECORDS; b * LOG_BLOCK_RECORDS < hi; ++b) {
+            if (!(h->blockMasks[b] & codeMask)) {
+                continue;
+            }
+            int end = qMin(hi, (b + 1) * LOG_BLOCK_RECORDS);
+            for (int i = qMax(lo, b * LOG_BLOCK_RECORDS); i < end; ++i) {
+                if ((codeMask & logEventBit(LogEventCode(r[i].code)))
+                    && !visit(seg->firstIndex + i, r[i])) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+qint64 SystemLog::count(qint64 fromMs, qint64 toMs, quint32 codeMask) const
+{
+    qint64 n = 0;
+    QMutexLocker locker(&m_mutex);
+    for (const auto &seg : m_segments) {
+        const SegmentHeader *h = seg->header();
+        if (h->count == 0 || h->lastMs < fromMs || h->firstMs > toMs) {
+            continue;
+        }
+        if (h->firstMs >= fromMs && h->lastMs <= toMs) {
+            // Whole segment in range: the per-code counts answer it
+            for (int c = 0; c < LogEventCodeCount; ++c) {
+                if (codeMask & logEventBit(LogEventCode(c))) {
+                    n += h->codeCounts[c];
+                }
+            }
+            continue;
+        }
+        qint64 first = qMax(fromMs, h->firstMs);
+        qint64 last = qMin(toMs, h->lastMs);
+        const LogRecord *r = seg->records();
+        auto before = [](const LogRecord &rec, qint64 t) { return rec.timestampMs < t; };
+        auto after = [](qint64 t, const LogRecord &rec) { return t < rec.timestampMs; };
+        int lo = std::lower_bound(r, r + h->count, first, before) - r;
+        int hi = std::upper_bound(r + lo, r + h->count, last, after) - r;
+        if (codeMask == ALL_LOG_EVENTS) {
+            n += hi - lo;
+            continue;
+        }
+        for (int b = lo / LOG_BLOCK_RECORDS; b * LOG_BLOCK_RECORDS < hi; ++b) {
+            if (!(h->blockMasks[b] & codeMask)) {
+                continue;
+            }
+            int end = qMin(hi, (b + 1) * LOG_BLOCK_RECORDS);
+            for (int i = qMax(lo, b * LOG_BLOCK_RECORDS); i < end; ++i) {
+                if (codeMask & logEventBit(LogEventCode(r[i].code))) {
+                    ++n;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+std::vector<LogRecord> SystemLog::query(qint64 fromMs, qint64 toMs, quint32 codeMask, int limit) const
+{
+    std::vector<LogRecord> out;
+    if (limit == 0) {
+        return out;
+    }
+    forEach(fromMs, toMs, codeMask, [&](qint64, const LogRecord &r) {
+        out.push_back(r);
+        return limit < 0 || static_cast<int>(out.size()) < limit;
+    });
+    return out;
+}
+
+QString SystemLog::describe(const LogRecord &r) const
+{
+    switch (r.code) {
+    case NoteLogEvent: {
+        QMutexLocker locker(&m_notesMutex);
+        return m_notes.value(r.arg);
+    }
+    case MealLogEvent:
+        if (r.value2 > 0.0) {
+            return QString("Meal: %1 g carbs, bolus %2 U").arg(r.value).arg(r.value2);
+        }
+        return QString("Meal: %1 g carbs").arg(r.value);
+    case ExtendedBolusDoneLogEvent:
+        return "Extended bolus completed.";
+    case CorrectionBolusLogEvent:
+        return QString("Control-IQ: Correction bolus %1 U (predicted %2 mmol/L in %3 min)")
+               .arg(r.value, 0, 'f', 2)
+               .arg(r.value2, 0, 'f', 1)
+               .arg(r.arg);
+    case BasalSuspendedLogEvent:
+        return QString("Control-IQ: Basal suspended (predicted %1 mmol/L in %2 min)")
+               .arg(r.value, 0, 'f', 1)
+               .arg(r.arg);
+    case BasalResumedLogEvent:
+        if (r.arg == 1) {
+            return "Control-IQ: Basal resumed at the profile rate (no sensor readings)";
+        }
+        return "Control-IQ: Basal resumed (safe predicted BG)";
+    case BatteryChargedLogEvent:
+        return "Pump charged to 100%.";
+    case InsulinReplenishedLogEvent:
+        return "Pump insulin replenished to 300u.";
+    case CriticalLowLogEvent:
+        return QString("Critical low CGM alert: %1").arg(r.value);
+    case CriticalHighLogEvent:
+        return QString("Critical high CGM alert: %1").arg(r.value);
+    case TraceErrorLogEvent:
+        return QString("Trace line %1 skipped: %2")
+               .arg(r.arg).arg(TraceReplay::issueText(TraceIssue(int(r.value))));
+    case AlarmRaisedLogEvent:
+        if (r.value2 > 0.0) {
+            return QString("%1 alarm, level %2: %3")
+                   .arg(AlarmManager::name(AlarmType(r.arg))).arg(int(r.value2) + 1).arg(r.value, 0, 'f', 1);
+        }
+        return QString("%1 alarm: %2").arg(AlarmManager::name(AlarmType(r.arg))).arg(r.value, 0, 'f', 1);
+    case AlarmAcknowledgedLogEvent:
+        return QString("%1 alarm acknowledged at %2")
+               .arg(AlarmManager::name(AlarmType(r.arg))).arg(r.value, 0, 'f', 1);
+    case AlarmClearedLogEvent:
+        return QString("%1 alarm cleared at %2")
+               .arg(AlarmManager::name(AlarmType(r.arg))).arg(r.value, 0, 'f', 1);
+    case ScenarioLogEvent:
+        return Scenario::describe(ScenarioAction(r.arg & 0xff), r.value, r.value2, int(r.arg >> 8));
+    }
+    return QString("Unknown event %1").arg(r.code);
+}
+
+QString SystemLog::codeName(LogEventCode code)
+{
+    switch (code) {
+    case NoteLogEvent:               return "Note";
+    case MealLogEvent:               return "Meal";
+    case ExtendedBolusDoneLogEvent:  return "Extended bolus";
+    case CorrectionBolusLogEvent:    return "Correction bolus";
+    case BasalSuspendedLogEvent:     return "Basal suspended";
+    case BasalResumedLogEvent:       return "Basal resumed";
+    case BatteryChargedLogEvent:     return "Battery";
+    case InsulinReplenishedLogEvent: return "Reservoir";
+    case CriticalLowLogEvent:        return "Low alert";
+    case CriticalHighLogEvent:       return "High alert";
+    case TraceErrorLogEvent:         return "Trace error";
+    case AlarmRaisedLogEvent:        return "Alarm";
+    case AlarmAcknowledgedLogEvent:  return "Alarm acknowledged";
+    case AlarmClearedLogEvent:       return "Alarm cleared";
+    case ScenarioLogEvent:           return "Scenario";
+    case LogEventCodeCount:          break;
+    }
+    return "Unknown";
+}
+
+bool SystemLog::hasFixedText(LogEventCode code)
+{
+    return code == ExtendedBolusDoneLogEvent || code == BasalResumedLogEvent
+        || code == BatteryChargedLogEvent || code == InsulinReplenishedLogEvent;
+}
+
+quint32 SystemLog::textVariant(const LogRecord &r)
+{
+    switch (r.code) {
+    case MealLogEvent:
+        return r.value2 > 0.0 ? 1 : 0;
+    case BasalResumedLogEvent:
+        return r.arg;                                   // Sensor dropout or not
+    case TraceErrorLogEvent:
+        return quint32(r.value);                        // TraceIssue
+    case AlarmRaisedLogEvent:
+        return r.arg | (r.value2 > 0.0 ? 1u << 8 : 0);  // AlarmType, level shown
+    case AlarmAcknowledgedLogEvent:
+    case AlarmClearedLogEvent:
+        return r.arg;
+    case ScenarioLogEvent:
+        // Action, extended part, resumed or not
+        return (r.arg & 0xff) | (r.value2 > 0.0 ? 1u << 8 : 0) | (r.value > 0.0 ? 1u << 9 : 0);
+    default:
+        return 0;
+    }
+}
 
-QString SystemLog::fullLog() const
+QString SystemLog::format(const LogRecord &r) const
 {
-    return m_entries.join("\n");
+    QString ts = QDateTime::fromMSecsSinceEpoch(r.timestampMs).toString("yyyy-MM-dd hh:mm:ss");
+    return QString("[%1] %2").arg(ts, describe(r));
 }
@@ -1,20 +1,141 @@
+// systemlog.h
 #ifndef SYSTEMLOG_H
 #define SYSTEMLOG_H
 
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QHash>
+#include <QFile>
+#include <QByteArray>
+#include <QMutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
 
+// What a log record describes. Codes are stored on disk, so only append.
+enum LogEventCode {
+    NoteLogEvent,               // Free text; arg = note id
+    MealLogEvent,               // value = carbs (g), value2 = bolus (U, 0 if none)
+    ExtendedBolusDoneLogEvent,
+    CorrectionBolusLogEvent,    // value = units, value2 = prediction, arg = horizon (min)
+    BasalSuspendedLogEvent,     // value = prediction, arg = horizon (min)
+    BasalResumedLogEvent,       // arg = 1 if resumed for a sensor dropout
+    BatteryChargedLogEvent,
+    InsulinReplenishedLogEvent,
+    CriticalLowLogEvent,        // value = glucose; logs from before alarms
+    CriticalHighLogEvent,       // value = glucose; logs from before alarms
+    TraceErrorLogEvent,         // value = TraceIssue, arg = trace line
+    AlarmRaisedLogEvent,        // value = reading, value2 = level, arg = AlarmType
+    AlarmAcknowledgedLogEvent,  // value = reading, arg = AlarmType
+    AlarmClearedLogEvent,       // value = reading, arg = AlarmType
+    ScenarioLogEvent,           // value, value2 = payload, arg = ScenarioAction | index << 8
+    LogEventCodeCount
+};
+
+// Event type filters are bit masks over LogEventCode
+const quint32 ALL_LOG_EVENTS = 0xffffffffu;
+inline quint32 logEventBit(LogEventCode code) { return 1u << code; }
+
+// One fixed-size, binary log record
+struct LogRecord {
+    qint64  timestampMs;    // Simulated time, ms since epoch
+    quint16 code;           // LogEventCode
+    quint16 reserved;
+    quint32 arg;            // Integer payload
+    double  value;          // Numeric payloads, meaning depends on code
+    double  value2;
+};
+
+// Records per segment file, and records per type-index block
+const int LOG_SEGMENT_RECORDS = 1 << 16;
+const int LOG_BLOCK_RECORDS = 256;
+
+// Typed, append-only event log. Records go into fixed-size segments, each a
+// memory-mapped file once open() has pointed the log at a directory (until
+// then segments live on the heap). A segment header keeps its time span,
+// per-code counts and a code bit mask for every block of 256 records, and
+// records within a segment are in time order, so a query binary searches
+// the time range and skips blocks that hold none of the wanted codes.
+// Nothing is read into RAM on open(); the OS pages segments in as queried.
+// One thread may append while others read; every call takes the log's lock.
 class SystemLog : public QObject
 {
     Q_OBJECT
 public:
     explicit SystemLog(QObject *parent = nullptr);
-    void addLogEntry(const QString &entry);
-    QString fullLog() const;
+    ~SystemLog();
+
+    // Persist to a directory, picking up the segments already there.
+    // Records appended before the call are dropped.
+    bool open(const QString &directory);
+    void close();
+    QString directory() const;
+
+    // Append a record; returns it for formatting
+    LogRecord append(qint64 timeMs, LogEventCode code, double value = 0.0,
+                     double value2 = 0.0, quint32 arg = 0);
+    LogRecord appendNote(qint64 timeMs, const QString &text);
+
+    // Also re-arms appended()
+    qint64 size() const;
+    int segmentCount() const;
+    LogRecord at(qint64 i) const;   // 0 = oldest
+
+    // Visit records with timestamps in [fromMs, toMs] whose code is in the
+    // mask, in log order, with their index; return false from visit to stop.
+    // The log stays locked meanwhile: visit may only call describe/format.
+    void forEach(qint64 fromMs, qint64 toMs, quint32 codeMask,
+                 const std::function<bool(qint64, const LogRecord &)> &visit) const;
+    qint64 count(qint64 fromMs, qint64 toMs, quint32 codeMask = ALL_LOG_EVENTS) const;
+    std::vector<LogRecord> query(qint64 fromMs, qint64 toMs,
+                                 quint32 codeMask = ALL_LOG_EVENTS, int limit = -1) const;
+
+    // Human-readable text, with and without the "[timestamp] " prefix
+    QString describe(const LogRecord &record) const;
+    QString format(const LogRecord &record) const;
+    static QString codeName(LogEventCode code);
+    static bool hasFixedText(LogEventCode code);   // describe() shows no numbers
+
+    // The part of the payload that picks the words of describe() rather
+    // than the numbers in them: records of one code and variant differ
+    // only in numbers. Keep in step with describe().
+    static quint32 textVariant(const LogRecord &record);
+
+signals:
+    // Emitted for the first record appended since size() was last called,
+    // so a reader on another thread gets one queued call per catch-up
+    void appended();
 
 private:
-    QStringList m_entries;
+    struct SegmentHeader;
+    struct Segment {
+        std::unique_ptr<QFile> file;    // Null for heap segments
+        QByteArray heap;
+        uchar *base = nullptr;
+        bool writable = false;
+        qint64 firstIndex = 0;          // Log index of the first record
+
+        SegmentHeader *header() const;
+        LogRecord *records() const;
+    };
+
+    Segment *writableSegment(qint64 timeMs);
+    bool mapSegment(const QString &path, bool create);
+    quint32 noteId(const QString &text);
+    QString noteFilePath() const;
+
+    mutable QMutex m_mutex;         // Segments and size
+    mutable QMutex m_notesMutex;    // Interned notes; taken on its own
+    mutable std::atomic<bool> m_notifyArmed{true};
+
+    std::vector<std::unique_ptr<Segment>> m_segments;
+    qint64 m_size;
+    int m_nextSegment;          // Number of the next segment file
+    QString m_directory;
+    QStringList m_notes;
+    QHash<QString, quint32> m_noteIds;
 };
 
 #endif // SYSTEMLOG_H
@@ -0,0 +1,57 @@
+// therapyrules.h
+#ifndef THERAPYRULES_H
+#define THERAPYRULES_H
+
+#include <algorithm>
+#include <cmath>
+#include "controliqcontroller.h"
+#include "profileschedule.h"
+
+// Per-tick therapy rules shared by SimulationEngine (through InsulinPump)
+// and the cohort paths, BatchPatient and PatientBatch. Each path keeps its
+// own state, but the arithmetic that decides what is delivered lives here
+// so the paths cannot drift apart.
+
+// Meal bolus: carb coverage plus any correction above target not already
+// covered by insulin on board, with the settings of the segment in effect
+inline double mealBolusUnits(const ProfileData &settings, double glucose, double grams, double iob)
+{
+    double bolus = grams / settings.carbRatio;
+    if (glucose > settings.targetBG) {
+        double correction = (glucose - settings.targetBG) / settings.correctionFactor;
+        bolus += std::max(0.0, correction - iob);
+    }
+    return bolus;
+}
+
+// Whether a daily meal falls inside the tick starting at clockMinutes
+// (minutes since some midnight)
+inline bool dailyMealDue(double minuteOfDay, double clockMinutes, double tickMinutes)
+{
+    double tickStart = std::fmod(clockMinutes, 1440.0);
+    if (minuteOfDay < tickStart) {
+        minuteOfDay += 1440.0;     // tick wraps past midnight
+    }
+    return minuteOfDay < tickStart + tickMinutes;
+}
+
+// Move to the profile segment in effect at clockMinutes; the controller
+// gets the segment's settings when it changes
+inline void followProfileSegment(const ProfileSchedule &schedule, double clockMinutes,
+                                 int &segment, ControlIQController &controller)
+{
+    int now = schedule.segmentAt(clockMinutes);
+    if (now != segment) {
+        segment = now;
+        controller.setTherapy(schedule.settings(now));
+    }
+}
+
+// Programmed basal over [fromMinutes, toMinutes) at Control-IQ's multiplier
+inline double scheduledBasalUnits(const ProfileSchedule &schedule, double fromMinutes,
+                                  double toMinutes, double multiplier)
+{
+    return schedule.basalUnits(fromMinutes, toMinutes) * multiplier;
+}
+
+#endif // THERAPYRULES_H
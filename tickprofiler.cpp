@@ -0,0 +1,294 @@
+// tickprofiler.cpp
+#include "tickprofiler.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// One thread's ring. Lanes outlive their threads and are handed to the
+// next thread that starts recording, so pools that create threads per
+// run do not grow the registry.
+struct Lane {
+    TickSample samples[TICK_TRACE_CAPACITY];
+    std::atomic<quint64> written{0};
+    std::atomic<bool> inUse{false};
+    qint32 id = 0;
+};
+
+struct Registry {
+    QMutex mutex;
+    std::vector<std::unique_ptr<Lane>> lanes;
+};
+
+Registry &registry()
+{
+    static Registry r;
+    return r;
+}
+
+std::atomic<int> g_sampleInterval{8};
+std::atomic<qint64> g_clearedNs{0};
+
+// Returns the lane to the registry when its thread ends
+struct LaneLease {
+    Lane *lane = nullptr;
+    ~LaneLease()
+    {
+        if (lane) {
+            lane->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local LaneLease t_lease;
+thread_local quint64 t_frames = 0;
+
+Lane *acquireLane()
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (const std::unique_ptr<Lane> &lane : r.lanes) {
+        bool expected = false;
+        if (lane->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return lane.get();
+        }
+    }
+    r.lanes.push_back(std::make_unique<Lane>());
+    Lane *lane = r.lanes.back().get();
+    lane->id = qint32(r.lanes.size());
+    lane->inUse.store(true, std::memory_order_relaxed);
+    return lane;
+}
+
+double nearestRank(const std::vector<qint64> &sorted, double percent)
+{
+    size_t rank = size_t(std::ceil(percent / 100.0 * sorted.size()));
+    return double(sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)]);
+}
+
+}
+
+bool TickProfiler::compiledIn()
+{
+#ifdef PUMP1_TICK_PROFILER
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TickProfiler::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int TickProfiler::sampleInterval()
+{
+    return g_sampleInterval.load(std::memory_order_relaxed);
+}
+
+void TickProfiler::setSampleInterval(int ticks)
+{
+    g_sampleInterval.store(qMax(1, ticks), std::memory_order_relaxed);
+}
+
+void TickProfiler::clear()
+{
+    // Writers never wait for readers, so nothing is erased; samples that
+    // started before now are simply no longer reported
+    g_clearedNs.store(nowNs(), std::memory_order_relaxed);
+}
+
+void TickProfiler::record(TickPhase phase, qint64 startNs, qint64 endNs)
+{
+    Lane *lane = t_lease.lane;
+    if (!lane) {
+        lane = t_lease.lane = acquireLane();
+    }
+    quint64 n = lane->written.load(std::memory_order_relaxed);
+    TickSample &s = lane->samples[n % TICK_TRACE_CAPACITY];
+    s.startNs = startNs;
+    s.durationNs = endNs - startNs;
+    s.phase = phase;
+    s.lane = lane->id;
+    lane->written.store(n + 1, std::memory_order_release);
+}
+
+QVector<TickSample> TickProfiler::samples()
+{
+    const quint64 capacity = TICK_TRACE_CAPACITY;
+    qint64 clearedNs = g_clearedNs.load(std::memory_order_relaxed);
+    QVector<TickSample> all;
+
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    std::vector<TickSample> copy;
+    for (const std::unique_ptr<Lane> &lane : r.lanes) {
+        quint64 end = lane->written.load(std::memory_order_acquire);
+        quint64 begin = end > capacity ? end - capacity : 0;
+        copy.clear();
+        for (quint64 i = begin; i < end; ++i) {
+            copy.push_back(lane->samples[i % capacity]);
+        }
+
+        // Slots the writer reached while we copied, including the one it
+        // may be in the middle of, hold newer samples or torn ones
+        std::atomic_thread_fence(std::memory_order_acquire);
+        quint64 after = lane->written.load(std::memory_order_relaxed);
+        quint64 firstIntact = after >= capacity ? after - capacity + 1 : 0;
+        for (quint64 i = qMax(begin, firstIntact); i < end; ++i) {
+            const TickSample &s = copy[i - begin];
+            if (s.startNs >= clearedNs) {
+                all.append(s);
+            }
+        }
+    }
+    locker.unlock();
+
+    std::sort(all.begin(), all.end(), [](const TickSample &a, const TickSample &b) {
+        return a.startNs < b.startNs;
+    });
+    return all;
+}
+
+QVector<TickPhaseStats> TickProfiler::phaseStats()
+{
+    QVector<TickSample> all = samples();
+    QVector<TickPhaseStats> stats(TickPhaseCount);
+    std::vector<qint64> durations[TickPhaseCount];
+    for (int i = all.size() - 1; i >= 0; --i) {
+        std::vector<qint64> &d = durations[all.at(i).phase];
+        if (int(d.size()) < TICK_STATS_SAMPLES) {
+            d.push_back(all.at(i).durationNs);
+        }
+    }
+
+    for (int p = 0; p < TickPhaseCount; ++p) {
+        std::vector<qint64> &d = durations[p];
+        if (d.empty()) {
+            continue;
+        }
+        std::sort(d.begin(), d.end());
+        double sum = 0.0;
+        for (qint64 ns : d) {
+            sum += ns;
+        }
+        TickPhaseStats &s = stats[p];
+        s.samples = qint64(d.size());
+        s.p50Us = nearestRank(d, 50.0) / 1000.0;
+        s.p99Us = nearestRank(d, 99.0) / 1000.0;
+        s.maxUs = d.back() / 1000.0;
+        s.meanUs = sum / d.size() / 1000.0;
+    }
+    return stats;
+}
+
+QByteArray TickProfiler::chromeTrace()
+{
+    QVector<TickSample> all = samples();
+    qint64 originNs = all.isEmpty() ? 0 : all.first().startNs;
+
+    QJsonArray events;
+    QJsonObject process;
+    process.insert("name", "process_name");
+    process.insert("ph", "M");
+    process.insert("pid", 1);
+    QJsonObject processArgs;
+    processArgs.insert("name", "pump1");
+    process.insert("args", processArgs);
+    events.append(process);
+
+    std::vector<bool> named;
+    for (const TickSample &s : all) {
+        if (size_t(s.lane) >= named.size()) {
+            named.resize(s.lane + 1);
+        }
+        if (!named[s.lane]) {
+            named[s.lane] = true;
+            QJsonObject thread;
+            thread.insert("name", "thread_name");
+            thread.insert("ph", "M");
+            thread.insert("pid", 1);
+            thread.insert("tid", s.lane);
+            QJsonObject threadArgs;
+            threadArgs.insert("name", QString("Lane %1").arg(s.lane));
+            thread.insert("args", threadArgs);
+            events.append(thread);
+        }
+
+        // Complete events; times are microseconds from the first sample
+        QJsonObject e;
+        e.insert("name", phaseName(TickPhase(s.phase)));
+        e.insert("cat", "tick");
+        e.insert("ph", "X");
+        e.insert("ts", (s.startNs - originNs) / 1000.0);
+        e.insert("dur", s.durationNs / 1000.0);
+        e.insert("pid", 1);
+        e.insert("tid", s.lane);
+        events.append(e);
+    }
+
+    QJsonObject root;
+    root.insert("traceEvents", events);
+    root.insert("displayTimeUnit", "ns");
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool TickProfiler::writeChromeTrace(const QString &path)
+{
+    QByteArray json = chromeTrace();
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(json) == json.size();
+}
+
+QString TickProfiler::phaseName(TickPhase phase)
+{
+    switch (phase) {
+    case WholeTickPhase:
+        return "Tick";
+    case SensorPhase:
+        return "CGM reading";
+    case MealsPhase:
+        return "Meals";
+    case ExtendedBolusPhase:
+        return "Extended bolus";
+    case ControlIqPhase:
+        return "Control-IQ";
+    case BasalPhase:
+        return "Basal + battery";
+    case ErrorChecksPhase:
+        return "Error checks";
+    case RenderPhase:
+        return "UI render";
+    default:
+        return "Unknown";
+    }
+}
+
+// --- TickProfileFrame ---
+
+TickProfileFrame::TickProfileFrame(TickPhase phase)
+    : m_phase(phase), m_outerSampling(TickProfiler::t_sampling), m_startNs(-1)
+{
+    bool sampled = TickProfiler::isEnabled() && t_frames++ % quint64(TickProfiler::sampleInterval()) == 0;
+    TickProfiler::t_sampling = sampled;
+    if (sampled) {
+        m_startNs = TickProfiler::nowNs();
+    }
+}
+
+TickProfileFrame::~TickProfileFrame()
+{
+    if (m_startNs >= 0) {
+        TickProfiler::record(m_phase, m_startNs, TickProfiler::nowNs());
+    }
+    TickProfiler::t_sampling = m_outerSampling;
+}
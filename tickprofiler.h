@@ -0,0 +1,153 @@
+// tickprofiler.h
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <chrono>
+
+// Phases of one simulation tick, and the UI frame that draws the result
+enum TickPhase {
+    WholeTickPhase,         // One engine tick on the simulation thread
+    SensorPhase,            // CGM reading and its listeners (chart, metrics)
+    MealsPhase,
+    ExtendedBolusPhase,
+    ControlIqPhase,
+    BasalPhase,             // Basal delivery and battery drain
+    ErrorChecksPhase,       // Low battery / insulin checks
+    RenderPhase,            // UI thread: chart and status labels from the newest state
+    TickPhaseCount
+};
+
+// One timed phase. Lane numbers the per-thread buffer it came from.
+struct TickSample {
+    qint64 startNs = 0;
+    qint64 durationNs = 0;
+    qint32 phase = 0;
+    qint32 lane = 0;
+};
+
+// Rolling figures for one phase, in microseconds
+struct TickPhaseStats {
+    qint64 samples = 0;
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+    double meanUs = 0.0;
+};
+
+// Samples kept per thread; older ones are overwritten
+const int TICK_TRACE_CAPACITY = 16384;
+
+// Newest samples of each phase that the rolling figures cover
+const int TICK_STATS_SAMPLES = 1000;
+
+// Process-wide tick phase recorder. Each thread writes to a ring of its
+// own with no locks: the writer publishes a sample by bumping an atomic
+// count, and readers copy the ring and drop whatever the writer may have
+// overwritten meanwhile. Recording is off until enabled, and then covers
+// one tick in every sampleInterval() (8 by default), so switching it on
+// costs two clock reads per phase of a sampled tick and nothing on the
+// others. Phases only record inside a tick frame, so headless runs of the
+// engine never pay more than a thread-local flag test.
+class TickProfiler
+{
+public:
+    // True when this build has the TICK_PROFILE_* macros compiled in
+    static bool compiledIn();
+
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static int sampleInterval();
+    static void setSampleInterval(int ticks);
+
+    // Forgets everything recorded so far
+    static void clear();
+
+    // Recorded samples of all threads, oldest first
+    static QVector<TickSample> samples();
+
+    // Percentiles over the newest TICK_STATS_SAMPLES of each phase
+    static QVector<TickPhaseStats> phaseStats();
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto), one complete
+    // event per sample and one track per lane
+    static QByteArray chromeTrace();
+    static bool writeChromeTrace(const QString &path);
+
+    static QString phaseName(TickPhase phase);
+
+    static qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Appends to the calling thread's ring
+    static void record(TickPhase phase, qint64 startNs, qint64 endNs);
+
+private:
+    friend class TickProfileFrame;
+    friend class TickPhaseTimer;
+
+    // Defined here so the timers test them without a call
+    static inline std::atomic<bool> s_enabled{false};
+    static inline thread_local bool t_sampling = false;     // Inside a sampled tick frame
+};
+
+// Times a phase from construction to destruction, if the enclosing tick
+// frame is sampled
+class TickPhaseTimer
+{
+public:
+    explicit TickPhaseTimer(TickPhase phase)
+        : m_phase(phase), m_startNs(TickProfiler::t_sampling ? TickProfiler::nowNs() : -1) {}
+    ~TickPhaseTimer()
+    {
+        if (m_startNs >= 0) {
+            TickProfiler::record(m_phase, m_startNs, TickProfiler::nowNs());
+        }
+    }
+
+    TickPhaseTimer(const TickPhaseTimer &) = delete;
+    TickPhaseTimer &operator=(const TickPhaseTimer &) = delete;
+
+private:
+    TickPhase m_phase;
+    qint64 m_startNs;
+};
+
+// One whole tick or render frame. Decides whether it is sampled, records
+// it as the given phase and lets the phase timers inside it record. Frames
+// may nest; each restores the outer frame's state when it ends.
+class TickProfileFrame
+{
+public:
+    explicit TickProfileFrame(TickPhase phase = WholeTickPhase);
+    ~TickProfileFrame();
+
+    TickProfileFrame(const TickProfileFrame &) = delete;
+    TickProfileFrame &operator=(const TickProfileFrame &) = delete;
+
+private:
+    TickPhase m_phase;
+    bool m_outerSampling;
+    qint64 m_startNs;
+};
+
+// Instrumentation is compiled in with CONFIG+=tick_profiler (which defines
+// PUMP1_TICK_PROFILER); otherwise the macros expand to nothing.
+#ifdef PUMP1_TICK_PROFILER
+#define TICK_PROFILE_CONCAT_(a, b) a##b
+#define TICK_PROFILE_CONCAT(a, b) TICK_PROFILE_CONCAT_(a, b)
+#define TICK_PROFILE_FRAME(phase) TickProfileFrame TICK_PROFILE_CONCAT(tickProfileFrame, __LINE__)(phase)
+#define TICK_PROFILE_SCOPE(phase) TickPhaseTimer TICK_PROFILE_CONCAT(tickPhaseTimer, __LINE__)(phase)
+#else
+#define TICK_PROFILE_FRAME(phase) static_cast<void>(0)
+#define TICK_PROFILE_SCOPE(phase) static_cast<void>(0)
+#endif
+
+#endif // TICKPROFILER_H
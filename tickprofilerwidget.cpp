@@ -0,0 +1,128 @@
+// tickprofilerwidget.cpp
+#include "tickprofilerwidget.h"
+#include "tickprofiler.h"
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+
+const int REFRESH_MS = 1000;
+
+QTableWidgetItem *numberItem(double value, int decimals)
+{
+    QTableWidgetItem *item = new QTableWidgetItem(QString::number(value, 'f', decimals));
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    return item;
+}
+
+}
+
+TickProfilerWidget::TickProfilerWidget(QWidget *parent)
+    : QWidget(parent),
+      m_recordBox(new QCheckBox("Record", this)),
+      m_intervalBox(new QSpinBox(this)),
+      m_table(new QTableWidget(TickPhaseCount, 5, this)),
+      m_statusLabel(new QLabel(this)),
+      m_refreshTimer(new QTimer(this))
+{
+    m_intervalBox->setRange(1, 1000);
+    m_intervalBox->setValue(TickProfiler::sampleInterval());
+    m_intervalBox->setPrefix("every ");
+    m_intervalBox->setSuffix(" ticks");
+    m_recordBox->setChecked(TickProfiler::isEnabled());
+
+    QPushButton *clearBtn = new QPushButton("Clear", this);
+    QPushButton *exportBtn = new QPushButton("Export Trace...", this);
+
+    m_table->setHorizontalHeaderLabels({"Phase", "Samples", "p50 us", "p99 us", "Max us"});
+    m_table->verticalHeader()->hide();
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+    m_table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    for (int p = 0; p < TickPhaseCount; ++p) {
+        m_table->setItem(p, 0, new QTableWidgetItem(TickProfiler::phaseName(TickPhase(p))));
+    }
+
+    QHBoxLayout *controls = new QHBoxLayout;
+    controls->addWidget(m_recordBox);
+    controls->addWidget(m_intervalBox);
+    controls->addStretch();
+    controls->addWidget(clearBtn);
+    controls->addWidget(exportBtn);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(controls);
+    layout->addWidget(m_table);
+    layout->addWidget(m_statusLabel);
+
+    // Without the instrumentation there is nothing to show
+    if (!TickProfiler::compiledIn()) {
+        m_recordBox->setEnabled(false);
+        m_intervalBox->setEnabled(false);
+        exportBtn->setEnabled(false);
+        m_statusLabel->setText("Tick timers are not compiled in (build with CONFIG+=tick_profiler)");
+    }
+
+    connect(m_recordBox, &QCheckBox::toggled, this, &TickProfilerWidget::onRecordToggled);
+    connect(m_intervalBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &TickProfilerWidget::onIntervalChanged);
+    connect(clearBtn, &QPushButton::clicked, this, &TickProfilerWidget::onClear);
+    connect(exportBtn, &QPushButton::clicked, this, &TickProfilerWidget::onExport);
+    connect(m_refreshTimer, &QTimer::timeout, this, &TickProfilerWidget::refresh);
+    m_refreshTimer->setInterval(REFRESH_MS);
+}
+
+void TickProfilerWidget::onRecordToggled(bool on)
+{
+    TickProfiler::setEnabled(on);
+    if (on) {
+        m_refreshTimer->start();
+    } else {
+        m_refreshTimer->stop();
+    }
+    refresh();
+}
+
+void TickProfilerWidget::onIntervalChanged(int ticks)
+{
+    TickProfiler::setSampleInterval(ticks);
+}
+
+void TickProfilerWidget::onClear()
+{
+    TickProfiler::clear();
+    refresh();
+}
+
+void TickProfilerWidget::onExport()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export Tick Trace", "tick-trace.json",
+                                                "Chrome trace (*.json);;All files (*)");
+    if (path.isEmpty()) return;
+    if (!TickProfiler::writeChromeTrace(path)) {
+        QMessageBox::warning(this, "Export Failed", "Could not write " + path);
+        return;
+    }
+    m_statusLabel->setText("Trace written to " + path + " (open in chrome://tracing or Perfetto)");
+}
+
+void TickProfilerWidget::refresh()
+{
+    QVector<TickPhaseStats> stats = TickProfiler::phaseStats();
+    for (int p = 0; p < TickPhaseCount; ++p) {
+        const TickPhaseStats &s = stats.at(p);
+        m_table->setItem(p, 1, numberItem(s.samples, 0));
+        m_table->setItem(p, 2, numberItem(s.p50Us, 1));
+        m_table->setItem(p, 3, numberItem(s.p99Us, 1));
+        m_table->setItem(p, 4, numberItem(s.maxUs, 1));
+    }
+}
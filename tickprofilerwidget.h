@@ -0,0 +1,36 @@
+// tickprofilerwidget.h
+#ifndef TICKPROFILERWIDGET_H
+#define TICKPROFILERWIDGET_H
+
+#include <QWidget>
+
+class QCheckBox;
+class QLabel;
+class QSpinBox;
+class QTableWidget;
+class QTimer;
+
+// Rolling p50/p99 of each tick phase from the TickProfiler, refreshed
+// once a second while recording, with Chrome trace export
+class TickProfilerWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TickProfilerWidget(QWidget *parent = nullptr);
+
+private slots:
+    void onRecordToggled(bool on);
+    void onIntervalChanged(int ticks);
+    void onClear();
+    void onExport();
+    void refresh();
+
+private:
+    QCheckBox    *m_recordBox;
+    QSpinBox     *m_intervalBox;
+    QTableWidget *m_table;
+    QLabel       *m_statusLabel;
+    QTimer       *m_refreshTimer;
+};
+
+#endif // TICKPROFILERWIDGET_H
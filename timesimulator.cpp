@@ -1,33 +1,135 @@
-// Fixed TimeSimulator: Starts at 00:00:00, adds 5 simulated minutes per real second
+// TimeSimulator: one monotonic simulated clock, paced by a steady wall clock
 #include "timesimulator.h"
+#include <cmath>
 
 TimeSimulator::TimeSimulator(QObject *parent)
    : QObject(parent),
-     m_minutesPerSecond(SIMULATION_SPEED),
-     m_running(false),
-     m_totalSimulatedMinutes(0.0)
+     m_timer(this),
+     m_anchorMs(0),
+     m_startMs(QDateTime(QDate(2025, 1, 1), QTime(0, 0, 0)).toMSecsSinceEpoch()),
+     m_elapsedMs(0),
+     m_tickMs(static_cast<qint64>(SIMULATION_SPEED * 60000)),
+     m_warpFactor(SIMULATION_SPEED * 60.0),
+     m_runMode(WarpClock),
+     m_running(false)
 {
-   m_timer.setInterval(1000);  // 1-second real time interval
+   m_timer.setSingleShot(true);
+   m_timer.setTimerType(Qt::PreciseTimer);
    connect(&m_timer, &QTimer::timeout, this, &TimeSimulator::onTimerTick);
 }
 
+void TimeSimulator::setStartTime(const QDateTime &start)
+{
+   m_startMs = start.toMSecsSinceEpoch();
+}
+
+qint64 TimeSimulator::startMsecs() const
+{
+   return m_startMs;
+}
+
+void TimeSimulator::setTickMinutes(double minutes)
+{
+   qint64 ms = std::llround(minutes * 60000);
+   if (ms > 0) {
+       m_tickMs = ms;
+       if (m_running) {
+           reanchor();
+           scheduleNextTick();
+       }
+   }
+}
+
+double TimeSimulator::tickMinutes() const
+{
+   return m_tickMs / 60000.0;
+}
+
+void TimeSimulator::setSimulationSpeed(double minutesPerSecond)
+{
+   setWarpFactor(minutesPerSecond * 60.0);
+}
+
 double TimeSimulator::simulationSpeed() const
 {
-   return m_minutesPerSecond;
+   return m_warpFactor / 60.0;
+}
+
+void TimeSimulator::setWarpFactor(double factor)
+{
+   if (factor <= 0.0) {
+       return;
+   }
+   m_warpFactor = factor;
+   if (m_running && m_runMode == WarpClock) {
+       reanchor();
+       scheduleNextTick();
+   }
+}
+
+double TimeSimulator::warpFactor() const
+{
+   return m_warpFactor;
+}
+
+void TimeSimulator::setMode(ClockMode mode)
+{
+   if (mode == PausedClock) {
+       stop();
+       return;
+   }
+   setRunMode(mode);
+   start();
+}
+
+ClockMode TimeSimulator::mode() const
+{
+   return m_running ? m_runMode : PausedClock;
+}
+
+void TimeSimulator::setRunMode(ClockMode mode)
+{
+   if (mode == PausedClock) {
+       return;
+   }
+   m_runMode = mode;
+   if (m_running) {
+       reanchor();
+       scheduleNextTick();
+   }
+}
+
+ClockMode TimeSimulator::runMode() const
+{
+   return m_runMode;
+}
+
+qint64 TimeSimulator::elapsedMsecs() const
+{
+   return m_elapsedMs;
+}
+
+double TimeSimulator::elapsedSimulatedMinutes() const
+{
+   return m_elapsedMs / 60000.0;
+}
+
+qint64 TimeSimulator::currentSimulatedMsecs() const
+{
+   return m_startMs + m_elapsedMs;
 }
 
 QDateTime TimeSimulator::currentSimulatedTime() const
 {
-   // Always start from a zero time and add total simulated minutes
-   QDateTime base(QDate(2025, 1, 1), QTime(0, 0, 0));
-   return base.addSecs(static_cast<qint64>(m_totalSimulatedMinutes * 60));
+   return QDateTime::fromMSecsSinceEpoch(currentSimulatedMsecs());
 }
 
 void TimeSimulator::start()
 {
    if (!m_running) {
        m_running = true;
-       m_timer.start();
+       reanchor();
+       scheduleNextTick();
    }
 }
 
@@ -47,22 +149,75 @@ bool TimeSimulator::isRunning() const
 void TimeSimulator::reset()
 {
    stop();
-   m_totalSimulatedMinutes = 0.0;
+   m_elapsedMs = 0;
 }
 
 double TimeSimulator::realToSimulatedSeconds(double realSeconds) const
 {
-   return realSeconds * m_minutesPerSecond * 60;
+   return realSeconds * m_warpFactor;
 }
 
 double TimeSimulator::realToSimulatedMinutes(double realSeconds) const
 {
-   return realSeconds * m_minutesPerSecond;
+   return realSeconds * m_warpFactor / 60.0;
 }
 
 void TimeSimulator::onTimerTick()
 {
-   // Add simulated minutes per tick
-   m_totalSimulatedMinutes += m_minutesPerSecond;
-   emit simulationTick(m_minutesPerSecond);
+   if (!m_running) {
+       return;
+   }
+
+   if (m_runMode == MaxSpeedClock) {
+       // Tick flat out for a slice, then give the event loop a turn
+       QElapsedTimer slice;
+       slice.start();
+       do {
+           advanceTick();
+       } while (m_running && m_runMode == MaxSpeedClock && slice.elapsed() < MAX_SPEED_SLICE_MS);
+       if (m_running) {
+           scheduleNextTick();
+       }
+       return;
+   }
+
+   // Every tick the steady clock says is due by now
+   qint64 dueMs = m_anchorMs + static_cast<qint64>(m_steadyClock.nsecsElapsed() / 1e6 * m_warpFactor);
+   int ticks = 0;
+   while (m_running && m_elapsedMs + m_tickMs <= dueMs) {
+       advanceTick();
+       if (++ticks == MAX_CATCH_UP_TICKS) {
+           // A long stall (e.g. a modal dialog): slip rather than burst
+           reanchor();
+           break;
+       }
+   }
+   if (m_running) {
+       scheduleNextTick();
+   }
+}
+
+void TimeSimulator::advanceTick()
+{
+   m_elapsedMs += m_tickMs;
+   emit simulationTick(elapsedSimulatedMinutes());
+}
+
+void TimeSimulator::reanchor()
+{
+   m_anchorMs = m_elapsedMs;
+   m_steadyClock.start();
+}
+
+void TimeSimulator::scheduleNextTick()
+{
+   if (m_runMode == MaxSpeedClock) {
+       m_timer.start(0);
+       return;
+   }
+
+   // Wall time at which the next tick falls due, measured from the anchor
+   double dueRealMs = (m_elapsedMs + m_tickMs - m_anchorMs) / m_warpFactor;
+   double waitMs = dueRealMs - m_steadyClock.nsecsElapsed() / 1e6;
+   m_timer.start(qMax(0, static_cast<int>(std::ceil(waitMs))));
 }
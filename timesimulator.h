@@ -4,29 +4,72 @@
 
 #include <QObject>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QTimer>
 //Constant for how many minutes pass in simulation per tick
 const double SIMULATION_SPEED = 5.0;
 
+// Longest burst of overdue ticks run in one go before the clock slips
+const int MAX_CATCH_UP_TICKS = 12;
+
+// Wall time spent ticking back to back before yielding, in max-speed mode
+const int MAX_SPEED_SLICE_MS = 15;
+
+// How simulated time is paced against the wall clock
+enum ClockMode {
+    PausedClock,        // Simulated time stands still
+    WarpClock,          // warpFactor() simulated seconds per real second
+    MaxSpeedClock       // Ticks back to back, yielding to the event loop in slices
+};
+
+// The simulation's single clock. Simulated time is a whole number of
+// milliseconds after an int64 epoch and only moves in tick steps, so every
+// simulationTick() lands exactly on the tick grid. In warp mode the time a
+// tick is due is worked out from a steady clock anchored when the pace was
+// last set, so timer jitter never accumulates into drift.
 class TimeSimulator : public QObject
 {
     Q_OBJECT
 public:
     explicit TimeSimulator(QObject *parent = nullptr);
 
+    // Simulated time at elapsed zero
+    void setStartTime(const QDateTime &start);
+    qint64 startMsecs() const;
+
+    // Simulated minutes per simulationTick
+    void setTickMinutes(double minutes);
+    double tickMinutes() const;
+
     // Configure simulation speed (simulatedMinutes per real second)
     void setSimulationSpeed(double minutesPerSecond);
     double simulationSpeed() const;
 
+    // Same pace as a factor: 1 is real time, 300 is 5 simulated min per second
+    void setWarpFactor(double factor);
+    double warpFactor() const;
+
+    // PausedClock stops; the other modes start the clock if needed
+    void setMode(ClockMode mode);
+    ClockMode mode() const;
+
+    // Mode start() resumes, taking effect at once if the clock is running;
+    // never starts it. PausedClock is ignored.
+    void setRunMode(ClockMode mode);
+    ClockMode runMode() const;
+
     // Get current simulated time
+    qint64 elapsedMsecs() const;
+    double elapsedSimulatedMinutes() const;
+    qint64 currentSimulatedMsecs() const;
     QDateTime currentSimulatedTime() const;
 
-    // Start/stop time simulation
+    // Start/stop time simulation; start() resumes the last running mode
     void start();
     void stop();
     bool isRunning() const;
 
-    // Reset simulation time to current real time
+    // Back to elapsed zero, paused
     void reset();
 
     // Convert real time delta to simulated time delta
@@ -41,12 +84,20 @@ private slots:
     void onTimerTick();
 
 private:
-    QTimer m_timer;                // Timer for regular updates
-    QDateTime m_simulationStart;   // Real time when simulation started
-    QDateTime m_simulatedStart;    // Initial simulated time
-    double m_minutesPerSecond;     // Simulation speed
+    void advanceTick();
+    void reanchor();
+    void scheduleNextTick();
+
+    QTimer m_timer;                // Single-shot, re-armed for the next due tick; a
+                                   // child, so moveToThread() takes it along
+    QElapsedTimer m_steadyClock;   // Wall time since the pace was anchored
+    qint64 m_anchorMs;             // Elapsed simulated ms at the anchor
+    qint64 m_startMs;              // Simulated epoch, ms since 1970
+    qint64 m_elapsedMs;            // Simulated ms since the start
+    qint64 m_tickMs;
+    double m_warpFactor;
+    ClockMode m_runMode;           // Mode start() resumes
     bool m_running;                // Is simulation running?
-    double m_totalSimulatedMinutes; // Total simulated minutes since start
 };
 
 #endif // TIMESIMULATOR_H
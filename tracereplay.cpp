@@ -0,0 +1,492 @@
+// tracereplay.cpp
+#include "tracereplay.h"
+#include "cgm.h"
+#include "insulinpump.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const double MGDL_PER_MMOL = 18.0;
+const qint64 MS_PER_DAY = 86400000;
+
+// Epoch times at or above this are taken as ms, below it as seconds
+// (1e11 s is the year 5138; 1e11 ms is 1973)
+const qint64 EPOCH_MS_THRESHOLD = 100000000000LL;
+
+const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+void trimSpaces(const char *&begin, const char *&end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        ++begin;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+        --end;
+    }
+}
+
+// Strip spaces and one pair of quotes around a field
+void trimField(const char *&begin, const char *&end)
+{
+    trimSpaces(begin, end);
+    if (end - begin >= 2 && *begin == '"' && end[-1] == '"') {
+        ++begin;
+        --end;
+    }
+}
+
+// Unsigned integer of exactly the given span
+bool parseDigits(const char *begin, const char *end, qint64 &value)
+{
+    if (begin == end || end - begin > 18) {
+        return false;
+    }
+    value = 0;
+    for (const char *p = begin; p < end; ++p) {
+        if (!isDigit(*p)) {
+            return false;
+        }
+        value = value * 10 + (*p - '0');
+    }
+    return true;
+}
+
+// Plain decimal: optional sign, digits, optional fraction. The digits are
+// gathered as an integer and divided once, which rounds correctly for the
+// short values a trace holds.
+bool parseNumber(const char *begin, const char *end, double &value)
+{
+    bool negative = false;
+    if (begin < end && (*begin == '-' || *begin == '+')) {
+        negative = (*begin == '-');
+        ++begin;
+    }
+    qint64 mantissa = 0;
+    int digits = 0;
+    int fraction = 0;
+    bool point = false;
+    for (const char *p = begin; p < end; ++p) {
+        if (isDigit(*p)) {
+            if (++digits > 18) {
+                return false;
+            }
+            mantissa = mantissa * 10 + (*p - '0');
+            fraction += point ? 1 : 0;
+        } else if (*p == '.' && !point) {
+            point = true;
+        } else {
+            return false;
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    value = double(mantissa) / POW10[fraction];
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+int daysInMonth(qint64 y, int m)
+{
+    static const int DAYS[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return DAYS[m - 1] + (m == 2 && leap ? 1 : 0);
+}
+
+// Days from 1970-01-01 to a proleptic Gregorian date
+qint64 daysFromCivil(qint64 y, int m, int d)
+{
+    y -= m <= 2;
+    qint64 era = (y >= 0 ? y : y - 399) / 400;
+    qint64 yoe = y - era * 400;
+    qint64 doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    qint64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+bool sameToken(const char *begin, const char *end, const char *token)
+{
+    size_t length = std::strlen(token);
+    if (size_t(end - begin) != length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        char c = begin[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = char(c - 'A' + 'a');
+        }
+        if (c != token[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TraceReplay::TraceReplay()
+{
+}
+
+TraceReplay::~TraceReplay()
+{
+    close();
+}
+
+bool TraceReplay::open(const QString &path)
+{
+    close();
+    m_file.reset(new QFile(path));
+    if (!m_file->open(QIODevice::ReadOnly)) {
+        m_error = m_file->errorString();
+        m_file.reset();
+        return false;
+    }
+    if (m_file->size() > 0) {
+        uchar *base = m_file->map(0, m_file->size());
+        if (!base) {
+            m_error = m_file->errorString();
+            m_file.reset();
+            return false;
+        }
+        m_begin = reinterpret_cast<const char *>(base);
+        m_end = m_begin + m_file->size();
+    }
+    m_error.clear();
+    m_offsetKnown = false;
+    rewind();
+
+    // Find where the trace starts, then go back for the real run
+    TraceRecord first;
+    qint64 shift = m_shiftMs;
+    m_shiftMs = 0;
+    m_firstMs = next(first) ? first.timestampMs : -1;
+    m_shiftMs = shift;
+    rewind();
+    return true;
+}
+
+void TraceReplay::close()
+{
+    if (m_file && m_begin) {
+        m_file->unmap(reinterpret_cast<uchar *>(const_cast<char *>(m_begin)));
+    }
+    m_file.reset();
+    m_begin = m_end = m_cursor = nullptr;
+    m_firstMs = -1;
+    rewind();
+}
+
+bool TraceReplay::isOpen() const
+{
+    return m_file != nullptr;
+}
+
+QString TraceReplay::errorString() const
+{
+    return m_error;
+}
+
+void TraceReplay::rewind()
+{
+    m_cursor = m_begin;
+    m_lastMs = std::numeric_limits<qint64>::min();
+    m_headerChecked = false;
+    m_hasPending = false;
+    m_lines = 0;
+    m_records = 0;
+    m_errorCount = 0;
+    m_errors.clear();
+}
+
+void TraceReplay::setTimeShiftMs(qint64 shiftMs)
+{
+    m_shiftMs = shiftMs;
+}
+
+qint64 TraceReplay::timeShiftMs() const
+{
+    return m_shiftMs;
+}
+
+qint64 TraceReplay::firstTimestampMs() const
+{
+    return m_firstMs;
+}
+
+bool TraceReplay::next(TraceRecord &record)
+{
+    bool found = false;
+
+    while (!found && m_cursor < m_end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(m_cursor, '\n', m_end - m_cursor));
+        if (!lineEnd) {
+            lineEnd = m_end;
+        }
+        const char *begin = m_cursor;
+        const char *end = lineEnd;
+        m_cursor = (lineEnd < m_end) ? lineEnd + 1 : m_end;
+        ++m_lines;
+
+        if (end > begin && end[-1] == '\r') {
+            --end;
+        }
+        trimSpaces(begin, end);
+        if (begin == end || *begin == '#') {
+            continue;
+        }
+
+        // A first row that does not start with a time is the header
+        if (!m_headerChecked) {
+            m_headerChecked = true;
+            const char *p = (*begin == '"') ? begin + 1 : begin;
+            if (p < end && !isDigit(*p)) {
+                continue;
+            }
+        }
+
+        TraceIssue issue;
+        if (!parseLine(begin, end, record, issue)) {
+            addError(m_lines, issue);
+        } else if (record.timestampMs < m_lastMs) {
+            addError(m_lines, TraceOutOfOrder);
+        } else {
+            m_lastMs = record.timestampMs;
+            record.timestampMs += m_shiftMs;
+            record.line = m_lines;
+            ++m_records;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool TraceReplay::atEnd() const
+{
+    return !m_hasPending && m_cursor >= m_end;
+}
+
+int TraceReplay::replayUntil(qint64 timeMs, CGM *cgm, InsulinPump *pump)
+{
+    int applied = 0;
+    for (;;) {
+        if (!m_hasPending) {
+            if (!next(m_pending)) {
+                break;
+            }
+            m_hasPending = true;
+        }
+        if (m_pending.timestampMs > timeMs) {
+            break;
+        }
+        m_hasPending = false;
+        if (apply(m_pending, cgm, pump)) {
+            ++applied;
+        } else {
+            addError(m_pending.line, TraceRejected);
+        }
+    }
+    return applied;
+}
+
+TraceScan TraceReplay::scan()
+{
+    rewind();
+    QElapsedTimer timer;
+    timer.start();
+    TraceRecord record;
+    while (next(record)) {
+    }
+    TraceScan result;
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.records = m_records;
+    result.errors = m_errorCount;
+    result.megabytesPerSecond = result.seconds > 0.0 ? fileSize() / 1e6 / result.seconds : 0.0;
+    rewind();
+    return result;
+}
+
+qint64 TraceReplay::fileSize() const
+{
+    return m_end - m_begin;
+}
+
+qint64 TraceReplay::bytesParsed() const
+{
+    return m_cursor - m_begin;
+}
+
+qint64 TraceReplay::linesParsed() const
+{
+    return m_lines;
+}
+
+qint64 TraceReplay::recordsParsed() const
+{
+    return m_records;
+}
+
+
+qint64 TraceReplay::errorCount() const
+{
+    return m_errorCount;
+}
+
+const QVector<TraceError> &TraceReplay::errors() const
+{
+    return m_errors;
+}
+
+QString TraceReplay::issueText(TraceIssue issue)
+{
+    switch (issue) {
+    case TraceBadTime:     return "unreadable time";
+    case TraceUnknownType: return "unknown record type";
+    case TraceBadValue:    return "missing or invalid value";
+    case TraceOutOfOrder:  return "time earlier than the row before";
+    case TraceRejected:    return "value refused by the CGM or pump";
+    }
+    return "unknown problem";
+}
+
+bool TraceReplay::parseLine(const char *begin, const char *end, TraceRecord &record, TraceIssue &issue)
+{
+    // time,type,value; anything after the value is ignored
+    const char *fields[3][2];
+    int count = 0;
+    const char *p = begin;
+    while (count < 3) {
+        const char *comma = static_cast<const char *>(std::memchr(p, ',', end - p));
+        const char *fieldEnd = comma ? comma : end;
+        fields[count][0] = p;
+        fields[count][1] = fieldEnd;
+        trimField(fields[count][0], fields[count][1]);
+        ++count;
+        if (!comma) {
+            break;
+        }
+        p = comma + 1;
+    }
+
+    if (!parseTime(fields[0][0], fields[0][1], record.timestampMs)) {
+        issue = TraceBadTime;
+        return false;
+    }
+    if (count < 2) {
+        issue = TraceUnknownType;
+        return false;
+    }
+
+    const char *typeBegin = fields[1][0];
+    const char *typeEnd = fields[1][1];
+    double scale = 1.0;
+    if (sameToken(typeBegin, typeEnd, "cgm") || sameToken(typeBegin, typeEnd, "glucose")) {
+        record.type = TraceGlucoseRecord;
+    } else if (sameToken(typeBegin, typeEnd, "cgm_mgdl")) {
+        record.type = TraceGlucoseRecord;
+        scale = 1.0 / MGDL_PER_MMOL;
+    } else if (sameToken(typeBegin, typeEnd, "bolus")) {
+        record.type = TraceBolusRecord;
+    } else if (sameToken(typeBegin, typeEnd, "basal")) {
+        record.type = TraceBasalRateRecord;
+    } else if (sameToken(typeBegin, typeEnd, "carbs")) {
+        record.type = TraceCarbsRecord;
+    } else {
+        issue = TraceUnknownType;
+        return false;
+    }
+
+    if (count < 3 || !parseNumber(fields[2][0], fields[2][1], record.value) || record.value < 0.0) {
+        issue = TraceBadValue;
+        return false;
+    }
+    record.value *= scale;
+    return true;
+}
+
+bool TraceReplay::parseTime(const char *begin, const char *end, qint64 &timeMs)
+{
+    // Epoch seconds or ms
+    qint64 epoch;
+    if (parseDigits(begin, end, epoch)) {
+        timeMs = epoch >= EPOCH_MS_THRESHOLD ? epoch : epoch * 1000;
+        return true;
+    }
+
+    // yyyy-MM-dd hh:mm[:ss[.zzz]]
+    qint64 year, month, day, hour, minute, second = 0, msec = 0;
+    if (end - begin < 16 || begin[4] != '-' || begin[7] != '-'
+        || (begin[10] != ' ' && begin[10] != 'T') || begin[13] != ':'
+        || !parseDigits(begin, begin + 4, year) || !parseDigits(begin + 5, begin + 7, month)
+        || !parseDigits(begin + 8, begin + 10, day) || !parseDigits(begin + 11, begin + 13, hour)
+        || !parseDigits(begin + 14, begin + 16, minute)) {
+        return false;
+    }
+    const char *p = begin + 16;
+    if (p < end) {
+        if (end - p < 3 || *p != ':' || !parseDigits(p + 1, p + 3, second)) {
+            return false;
+        }
+        p += 3;
+        if (p < end) {
+            if (*p != '.' || !parseDigits(p + 1, end, msec) || end - p > 4) {
+                return false;
+            }
+            msec *= p + 4 == end ? 1 : (p + 3 == end ? 10 : 100);
+        }
+    }
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, int(month))
+        || hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+
+    qint64 wallMs = daysFromCivil(year, int(month), int(day)) * MS_PER_DAY
+                    + ((hour * 60 + minute) * 60 + second) * 1000 + msec;
+
+    // The zone offset is looked up once; a DST change mid-trace is not followed
+    if (!m_offsetKnown) {
+        QDate date(static_cast<int>(year), static_cast<int>(month), static_cast<int>(day));
+        QDateTime local(date, QTime(static_cast<int>(hour), static_cast<int>(minute)));
+        m_localOffsetMs = qint64(local.offsetFromUtc()) * 1000;
+        m_offsetKnown = true;
+    }
+    timeMs = wallMs - m_localOffsetMs;
+    return true;
+}
+
+bool TraceReplay::apply(const TraceRecord &record, CGM *cgm, InsulinPump *pump)
+{
+    switch (record.type) {
+    case TraceGlucoseRecord:
+        return cgm->addRecordedReading(record.timestampMs, record.value);
+    case TraceBolusRecord:
+        return record.value == 0.0 || pump->deliverBolus(record.value);
+    case TraceBasalRateRecord:
+        pump->setRecordedBasalRate(record.value);
+        return true;
+    case TraceCarbsRecord:
+        cgm->registerCarbEffect(record.value);
+        return true;
+    }
+    return false;
+}
+
+void TraceReplay::addError(qint64 line, TraceIssue issue)
+{
+    ++m_errorCount;
+    if (m_errors.size() < MAX_TRACE_ERRORS_KEPT) {
+        m_errors.append(TraceError{line, issue});
+    }
+}
@@ -0,0 +1,139 @@
+// tracereplay.h
+#ifndef TRACEREPLAY_H
+#define TRACEREPLAY_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+class CGM;
+class InsulinPump;
+
+// What a trace row records
+enum TraceRecordType {
+    TraceGlucoseRecord,         // CGM reading, mmol/L
+    TraceBolusRecord,           // Units delivered at once
+    TraceBasalRateRecord,       // New basal rate, U/hr, until the next one
+    TraceCarbsRecord            // Grams eaten
+};
+
+struct TraceRecord {
+    qint64 timestampMs;         // Trace time plus the time shift
+    TraceRecordType type;
+    double value;
+    qint64 line;                // 1-based line in the file
+};
+
+// Why a row was skipped
+enum TraceIssue {
+    TraceBadTime,
+    TraceUnknownType,
+    TraceBadValue,
+    TraceOutOfOrder,            // Earlier than the row before
+    TraceRejected               // Parsed, but the CGM or pump refused it
+};
+
+struct TraceError {
+    qint64 line;                // 1-based
+    TraceIssue issue;
+};
+
+// Result of a full pass over a trace
+struct TraceScan {
+    qint64 records;
+    qint64 errors;
+    double seconds;
+    double megabytesPerSecond;
+};
+
+// Malformed rows beyond this many are counted but not kept
+const int MAX_TRACE_ERRORS_KEPT = 1000;
+
+// Streams a recorded CSV trace into the CGM and pump. Rows are
+//
+//     time,type,value
+//
+// where time is ms or s since the epoch, or local "yyyy-MM-dd hh:mm[:ss]"
+// (a 'T' separator is fine too), and type is one of cgm (mmol/L),
+// cgm_mgdl, bolus (U), basal (U/hr) or carbs (g). A header row, blank
+// lines, '#' comments, quotes and a trailing CR are all accepted.
+//
+// The file is memory-mapped and parsed in place, row by row as the replay
+// reaches it, so nothing is copied and only the pages being read are
+// resident however large the file. A bad row is recorded and skipped;
+// the replay carries on with the next one.
+class TraceReplay
+{
+public:
+    TraceReplay();
+    ~TraceReplay();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    // Back to the first row; errors and counters are cleared
+    void rewind();
+
+    // Added to every trace time, to line the trace up with the simulated clock
+    void setTimeShiftMs(qint64 shiftMs);
+    qint64 timeShiftMs() const;
+
+    // Time of the first valid row, without the shift; -1 if there is none
+    qint64 firstTimestampMs() const;
+
+    // Next valid row, skipping and recording bad ones; false at the end
+    bool next(TraceRecord &record);
+    bool atEnd() const;
+
+    // Apply every row up to and including timeMs: readings to the CGM,
+    // boluses and basal rates to the pump, carbs to the CGM. Returns the
+    // number applied.
+    int replayUntil(qint64 timeMs, CGM *cgm, InsulinPump *pump);
+
+    // Parse the whole file once, timed, then rewind. Rows are not applied.
+    TraceScan scan();
+
+    // Progress
+    qint64 fileSize() const;
+    qint64 bytesParsed() const;
+    qint64 linesParsed() const;
+    qint64 recordsParsed() const;
+
+    // Skipped rows: the total, and the first MAX_TRACE_ERRORS_KEPT of them
+    qint64 errorCount() const;
+    const QVector<TraceError> &errors() const;
+
+    static QString issueText(TraceIssue issue);
+
+private:
+    bool parseLine(const char *begin, const char *end, TraceRecord &record, TraceIssue &issue);
+    bool parseTime(const char *begin, const char *end, qint64 &timeMs);
+    bool apply(const TraceRecord &record, CGM *cgm, InsulinPump *pump);
+    void addError(qint64 line, TraceIssue issue);
+
+    std::unique_ptr<QFile> m_file;
+    QString m_error;
+    const char *m_begin = nullptr;      // Mapped file
+    const char *m_end = nullptr;
+    const char *m_cursor = nullptr;     // Start of the next unread line
+
+    qint64 m_shiftMs = 0;
+    qint64 m_firstMs = -1;
+    qint64 m_lastMs = 0;                // Latest valid row, for order checks
+    qint64 m_localOffsetMs = 0;         // Local time offset, fixed at the first dated row
+    bool m_offsetKnown = false;
+    bool m_headerChecked = false;       // First content line looked at
+
+    TraceRecord m_pending;              // Read ahead by replayUntil()
+    bool m_hasPending = false;
+
+    qint64 m_lines = 0;
+    qint64 m_records = 0;
+    qint64 m_errorCount = 0;
+    QVector<TraceError> m_errors;
+};
+
+#endif // TRACEREPLAY_H
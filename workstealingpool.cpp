@@ -0,0 +1,134 @@
+// workstealingpool.cpp
+#include "workstealingpool.h"
+#include <QThread>
+
+WorkStealingPool::WorkStealingPool(int threads)
+    : m_threads(threads > 0 ? threads : QThread::idealThreadCount()),
+      m_steals(0)
+{
+    if (m_threads < 1) {
+        m_threads = 1;
+    }
+    m_ranges.reset(new WorkerRange[m_threads]);
+    for (int i = 0; i < m_threads; ++i) {
+        m_ranges[i].range.store(0, std::memory_order_relaxed);
+    }
+}
+
+int WorkStealingPool::threadCount() const
+{
+    return m_threads;
+}
+
+int WorkStealingPool::stealCount() const
+{
+    return m_steals.load(std::memory_order_relaxed);
+}
+
+void WorkStealingPool::run(int count, const std::function<void(int, int)> &task)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // Split [0, count) evenly; later workers get the remainder one by one
+    int base = count / m_threads;
+    int extra = count % m_threads;
+    int next = 0;
+    for (int w = 0; w < m_threads; ++w) {
+        int size = base + (w < extra ? 1 : 0);
+        m_ranges[w].range.store(pack(next, next + size), std::memory_order_relaxed);
+        next += size;
+    }
+    m_steals.store(0, std::memory_order_relaxed);
+
+    // Worker 0 runs on the calling thread
+    QVector<QThread *> threads;
+    for (int w = 1; w < m_threads; ++w) {
+        QThread *thread = QThread::create([this, w, &task]() { workerLoop(w, task); });
+        threads.append(thread);
+        thread->start();
+    }
+
+    workerLoop(0, task);
+
+    for (QThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void WorkStealingPool::workerLoop(int worker, const std::function<void(int, int)> &task)
+{
+    int index;
+    for (;;) {
+        while (takeOne(worker, index)) {
+            task(index, worker);
+        }
+
+        // Own range is empty: try every other worker once, starting with the
+        // neighbour so thieves spread out instead of all hitting worker 0
+        bool stole = false;
+        for (int i = 1; i < m_threads && !stole; ++i) {
+            stole = stealFrom(worker, (worker + i) % m_threads);
+        }
+        if (!stole) {
+            // Nothing left worth stealing; owners finish their last items
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::takeOne(int worker, int &index)
+{
+    std::atomic<quint64> &slot = m_ranges[worker].range;
+    quint64 current = slot.load(std::memory_order_acquire);
+    for (;;) {
+        quint32 begin = rangeBegin(current);
+        quint32 end = rangeEnd(current);
+        if (begin >= end) {
+            return false;
+        }
+        if (slot.compare_exchange_weak(current, pack(begin + 1, end),
+                                       std::memory_order_acq_rel)) {
+            index = static_cast<int>(begin);
+            return true;
+        }
+    }
+}
+
+bool WorkStealingPool::stealFrom(int thief, int victim)
+{
+    std::atomic<quint64> &slot = m_ranges[victim].range;
+    quint64 current = slot.load(std::memory_order_acquire);
+    for (;;) {
+        quint32 begin = rangeBegin(current);
+        quint32 end = rangeEnd(current);
+        if (begin >= end || end - begin < 2) {
+            return false;   // leave single items to their owner
+        }
+        quint32 mid = begin + (end - begin) / 2;
+        if (slot.compare_exchange_weak(current, pack(begin, mid),
+                                       std::memory_order_acq_rel)) {
+            // Our own range is empty, and nobody steals from an empty range
+            m_ranges[thief].range.store(pack(mid, end), std::memory_order_release);
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+quint64 WorkStealingPool::pack(quint32 begin, quint32 end)
+{
+    return (static_cast<quint64>(begin) << 32) | end;
+}
+
+quint32 WorkStealingPool::rangeBegin(quint64 range)
+{
+    return static_cast<quint32>(range >> 32);
+}
+
+quint32 WorkStealingPool::rangeEnd(quint64 range)
+{
+    return static_cast<quint32>(range & 0xffffffffu);
+}
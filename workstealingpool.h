@@ -0,0 +1,49 @@
+// workstealingpool.h
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Fork/join pool for independent jobs (e.g. one virtual patient each).
+// The index range is split evenly across workers up front; a worker that runs
+// dry steals the upper half of another worker's remaining range. Ranges are a
+// single packed atomic word, so neither taking nor stealing ever locks.
+class WorkStealingPool
+{
+public:
+    // threads <= 0 uses QThread::idealThreadCount()
+    explicit WorkStealingPool(int threads = 0);
+
+    int threadCount() const;
+
+    // Run task(index, worker) for every index in [0, count) and block until all
+    // are done. worker is in [0, threadCount()) and is stable for the calling
+    // thread, so tasks can write per-worker results without synchronisation.
+    void run(int count, const std::function<void(int index, int worker)> &task);
+
+    // Number of successful steals during the last run()
+    int stealCount() const;
+
+private:
+    struct alignas(64) WorkerRange {
+        std::atomic<quint64> range;     // begin in the high word, end in the low word
+    };
+
+    void workerLoop(int worker, const std::function<void(int, int)> &task);
+    bool takeOne(int worker, int &index);
+    bool stealFrom(int thief, int victim);
+
+    static quint64 pack(quint32 begin, quint32 end);
+    static quint32 rangeBegin(quint64 range);
+    static quint32 rangeEnd(quint64 range);
+
+    int m_threads;
+    std::unique_ptr<WorkerRange[]> m_ranges;
+    std::atomic<int> m_steals;
+};
+
+#endif // WORKSTEALINGPOOL_H